@@ -152,6 +152,9 @@ int esp_tls_conn_destroy(esp_tls_t *tls)
 {
     if (tls != NULL) {
         int ret = 0;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        esp_mbedtls_session_cache_save(tls);
+#endif
         _esp_tls_conn_delete(tls);
         if (tls->sockfd >= 0) {
             ret = close(tls->sockfd);
@@ -459,15 +462,20 @@ static int esp_tls_low_level_conn(const char *hostname, int hostlen, int port, c
         if (tls->is_tls == false) {
             tls->read = tcp_read;
             tls->write = tcp_write;
+        }
+        if (tls->is_tls == false && !(cfg && cfg->non_block)) {
             ESP_LOGD(TAG, "non-tls connection established");
             return 1;
         }
+        tls->conn_state = ESP_TLS_CONNECTING;
         if (cfg && cfg->non_block) {
             FD_ZERO(&tls->rset);
             FD_SET(tls->sockfd, &tls->rset);
             tls->wset = tls->rset;
+            /* Return to the caller while the connection is being established,
+               so that it can wait for the socket to become writable */
+            return 0;
         }
-        tls->conn_state = ESP_TLS_CONNECTING;
     /* falls through */
     case ESP_TLS_CONNECTING:
         if (cfg && cfg->non_block) {
@@ -493,9 +501,21 @@ static int esp_tls_low_level_conn(const char *hostname, int hostlen, int port, c
                     tls->conn_state = ESP_TLS_FAIL;
                     return -1;
                 }
+                if (error != 0) {
+                    ESP_LOGD(TAG, "Non blocking connect failed: %s", strerror(error));
+                    ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_SYSTEM, error);
+                    ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ESP_TLS_ERR_TYPE_ESP, ESP_ERR_ESP_TLS_FAILED_CONNECT_TO_HOST);
+                    tls->conn_state = ESP_TLS_FAIL;
+                    return -1;
+                }
             }
         }
         /* By now, the connection has been established */
+        if (tls->is_tls == false) {
+            ESP_LOGD(TAG, "non-tls connection established");
+            tls->conn_state = ESP_TLS_DONE;
+            return 1;
+        }
         esp_ret = create_ssl_handle(hostname, hostlen, cfg, tls);
         if (esp_ret != ESP_OK) {
             ESP_LOGE(TAG, "create_ssl_handle failed");
@@ -503,6 +523,11 @@ static int esp_tls_low_level_conn(const char *hostname, int hostlen, int port, c
             tls->conn_state = ESP_TLS_FAIL;
             return -1;
         }
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        if (cfg->client_session == NULL) {
+            esp_mbedtls_session_cache_lookup(tls, hostname, hostlen, port, cfg);
+        }
+#endif
         tls->read = _esp_tls_read;
         tls->write = _esp_tls_write;
         tls->conn_state = ESP_TLS_HANDSHAKE;
@@ -796,10 +821,17 @@ esp_err_t esp_tls_init_global_ca_store(void)
 
 esp_err_t esp_tls_set_global_ca_store(const unsigned char *cacert_pem_buf, const unsigned int cacert_pem_bytes)
 {
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    // sessions were verified against the previous CA store
+    esp_tls_client_session_cache_clear();
+#endif
     return _esp_tls_set_global_ca_store(cacert_pem_buf, cacert_pem_bytes);
 }
 
 void esp_tls_free_global_ca_store(void)
 {
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    esp_tls_client_session_cache_clear();
+#endif
     return _esp_tls_free_global_ca_store();
 }
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2017-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2017-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -752,6 +752,39 @@ esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls);
  */
 void esp_tls_free_client_session(esp_tls_client_session_t *client_session);
 #endif /* CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS */
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+/**
+ * @brief Statistics of the client session cache
+ */
+typedef struct esp_tls_client_session_cache_stats {
+    uint32_t hits;          /*!< Number of connections which resumed a cached session */
+    uint32_t misses;        /*!< Number of connections which found no valid session in the cache */
+    uint32_t entries;       /*!< Number of servers with a session in the cache */
+} esp_tls_client_session_cache_stats_t;
+
+/**
+ * @brief Drop all sessions from the client session cache
+ *
+ * Next connection to every server performs a full handshake. This function should be called
+ * when the trust settings of the application change, e.g. a CA certificate is revoked.
+ * The cache is cleared automatically when the global CA store is set or freed.
+ *
+ * @note This function is only available if CONFIG_ESP_TLS_CLIENT_SESSION_CACHE=y
+ */
+void esp_tls_client_session_cache_clear(void);
+
+/**
+ * @brief Get statistics of the client session cache
+ *
+ * @param[out] stats   Statistics of the cache
+ *
+ * @return
+ *             - ESP_OK on success
+ *             - ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t esp_tls_client_session_cache_get_stats(esp_tls_client_session_cache_stats_t *stats);
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE */
 #ifdef __cplusplus
 }
 #endif
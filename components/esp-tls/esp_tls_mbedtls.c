@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2019-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2019-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -17,6 +17,8 @@
 #include "esp_tls_private.h"
 #include "esp_tls_error_capture_internal.h"
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include "esp_log.h"
 #include "esp_check.h"
 
@@ -205,6 +207,214 @@ void esp_mbedtls_free_client_session(esp_tls_client_session_t *client_session)
 }
 #endif /* CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS */
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+/* Settings of esp_tls_cfg_t which a resumed session must have been established with */
+typedef struct {
+    const unsigned char *cacert_buf;
+    const unsigned char *clientcert_buf;
+    const unsigned char *clientkey_buf;
+    const psk_hint_key_t *psk_hint_key;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    const char **alpn_protos;
+    void *ds_data;
+    bool use_global_ca_store;
+    bool use_secure_element;
+    bool use_ecdsa_peripheral;
+    bool skip_common_name;
+    esp_tls_proto_ver_t tls_version;
+} session_cache_cfg_t;
+
+typedef struct {
+    char *hostname;                 /* NULL if the entry is not used */
+    char *common_name;
+    int port;
+    session_cache_cfg_t cfg;
+    uint32_t generation;            /* incremented whenever the entry is reused for another server */
+    bool has_session;
+    mbedtls_ssl_session session;
+    time_t saved_at;
+    time_t last_used;
+} session_cache_entry_t;
+
+static session_cache_entry_t s_session_cache[CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE];
+static esp_tls_client_session_cache_stats_t s_session_cache_stats;
+static pthread_mutex_t s_session_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static time_t session_cache_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+static void session_cache_cfg_init(session_cache_cfg_t *cache_cfg, const esp_tls_cfg_t *cfg)
+{
+    // zeroed, so that the padding doesn't break memcmp()
+    memset(cache_cfg, 0, sizeof(session_cache_cfg_t));
+    cache_cfg->cacert_buf = cfg->cacert_buf;
+    cache_cfg->clientcert_buf = cfg->clientcert_buf;
+    cache_cfg->clientkey_buf = cfg->clientkey_buf;
+    cache_cfg->psk_hint_key = cfg->psk_hint_key;
+    cache_cfg->crt_bundle_attach = cfg->crt_bundle_attach;
+    cache_cfg->alpn_protos = cfg->alpn_protos;
+    cache_cfg->ds_data = cfg->ds_data;
+    cache_cfg->use_global_ca_store = cfg->use_global_ca_store;
+    cache_cfg->use_secure_element = cfg->use_secure_element;
+    cache_cfg->use_ecdsa_peripheral = cfg->use_ecdsa_peripheral;
+    cache_cfg->skip_common_name = cfg->skip_common_name;
+    cache_cfg->tls_version = cfg->tls_version;
+}
+
+static void session_cache_drop_session(session_cache_entry_t *entry)
+{
+    if (entry->has_session) {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->has_session = false;
+    }
+}
+
+static void session_cache_free_entry(session_cache_entry_t *entry)
+{
+    session_cache_drop_session(entry);
+    free(entry->hostname);
+    free(entry->common_name);
+    entry->hostname = NULL;
+    entry->common_name = NULL;
+    entry->generation++;
+}
+
+static bool session_cache_entry_matches(const session_cache_entry_t *entry, const char *hostname, size_t hostlen,
+                                        int port, const session_cache_cfg_t *cache_cfg, const char *common_name)
+{
+    return entry->hostname != NULL && entry->port == port &&
+           strlen(entry->hostname) == hostlen && memcmp(entry->hostname, hostname, hostlen) == 0 &&
+           memcmp(&entry->cfg, cache_cfg, sizeof(session_cache_cfg_t)) == 0 &&
+           ((entry->common_name == NULL && common_name == NULL) ||
+            (entry->common_name != NULL && common_name != NULL && strcmp(entry->common_name, common_name) == 0));
+}
+
+void esp_mbedtls_session_cache_lookup(esp_tls_t *tls, const char *hostname, size_t hostlen, int port, const esp_tls_cfg_t *cfg)
+{
+    session_cache_cfg_t cache_cfg;
+    session_cache_cfg_init(&cache_cfg, cfg);
+    time_t now = session_cache_now();
+    session_cache_entry_t *entry = NULL;
+
+    pthread_mutex_lock(&s_session_cache_lock);
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (session_cache_entry_matches(&s_session_cache[i], hostname, hostlen, port, &cache_cfg, cfg->common_name)) {
+            entry = &s_session_cache[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        // take a free entry, or the least recently used one
+        entry = &s_session_cache[0];
+        for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE && entry->hostname != NULL; i++) {
+            if (s_session_cache[i].hostname == NULL || s_session_cache[i].last_used < entry->last_used) {
+                entry = &s_session_cache[i];
+            }
+        }
+        session_cache_free_entry(entry);
+        entry->hostname = strndup(hostname, hostlen);
+        entry->common_name = cfg->common_name ? strdup(cfg->common_name) : NULL;
+        if (entry->hostname == NULL || (cfg->common_name && entry->common_name == NULL)) {
+            session_cache_free_entry(entry);
+            pthread_mutex_unlock(&s_session_cache_lock);
+            return;
+        }
+        entry->port = port;
+        entry->cfg = cache_cfg;
+    }
+    entry->last_used = now;
+    if (entry->has_session && now - entry->saved_at >= CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_TIMEOUT) {
+        ESP_LOGD(TAG, "Cached session of %s expired", entry->hostname);
+        session_cache_drop_session(entry);
+    }
+    if (entry->has_session) {
+        int ret = mbedtls_ssl_set_session(&tls->ssl, &entry->session);
+        if (ret != 0) {
+            ESP_LOGD(TAG, "mbedtls_ssl_set_session returned -0x%04X", -ret);
+            session_cache_drop_session(entry);
+        }
+    }
+    if (entry->has_session) {
+        ESP_LOGD(TAG, "Resuming cached session of %s", entry->hostname);
+        s_session_cache_stats.hits++;
+    } else {
+        s_session_cache_stats.misses++;
+    }
+    tls->session_cache_entry = entry;
+    tls->session_cache_generation = entry->generation;
+    pthread_mutex_unlock(&s_session_cache_lock);
+}
+
+void esp_mbedtls_session_cache_save(esp_tls_t *tls)
+{
+    session_cache_entry_t *entry = tls->session_cache_entry;
+    if (entry == NULL) {
+        return;
+    }
+    tls->session_cache_entry = NULL;
+
+    // In TLS 1.3 the ticket is received after the handshake, so the session is saved when the connection is closed
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    bool has_session = false;
+    if (tls->conn_state == ESP_TLS_DONE) {
+        int ret = mbedtls_ssl_get_session(&tls->ssl, &session);
+        if (ret == 0) {
+            has_session = true;
+        } else {
+            ESP_LOGD(TAG, "mbedtls_ssl_get_session returned -0x%04X", -ret);
+        }
+    }
+
+    pthread_mutex_lock(&s_session_cache_lock);
+    if (entry->generation == tls->session_cache_generation) {
+        // the cached session is dropped also when the handshake failed, it might be the reason
+        session_cache_drop_session(entry);
+        if (has_session) {
+            entry->session = session;
+            entry->has_session = true;
+            entry->saved_at = session_cache_now();
+            has_session = false;
+        }
+    }
+    pthread_mutex_unlock(&s_session_cache_lock);
+
+    if (has_session) {
+        mbedtls_ssl_session_free(&session);
+    }
+}
+
+void esp_tls_client_session_cache_clear(void)
+{
+    pthread_mutex_lock(&s_session_cache_lock);
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        session_cache_free_entry(&s_session_cache[i]);
+    }
+    pthread_mutex_unlock(&s_session_cache_lock);
+}
+
+esp_err_t esp_tls_client_session_cache_get_stats(esp_tls_client_session_cache_stats_t *stats)
+{
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_session_cache_lock);
+    *stats = s_session_cache_stats;
+    stats->entries = 0;
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (s_session_cache[i].has_session) {
+            stats->entries++;
+        }
+    }
+    pthread_mutex_unlock(&s_session_cache_lock);
+    return ESP_OK;
+}
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE */
+
 int esp_mbedtls_handshake(esp_tls_t *tls, const esp_tls_cfg_t *cfg)
 {
     int ret;
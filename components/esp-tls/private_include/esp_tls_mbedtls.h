@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2019-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2019-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -109,6 +109,18 @@ esp_tls_client_session_t *esp_mbedtls_get_client_session(esp_tls_t *tls);
 void esp_mbedtls_free_client_session(esp_tls_client_session_t *client_session);
 #endif
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+/**
+ * Internal function to resume the cached session of the server, if any, in a new client connection
+ */
+void esp_mbedtls_session_cache_lookup(esp_tls_t *tls, const char *hostname, size_t hostlen, int port, const esp_tls_cfg_t *cfg);
+
+/**
+ * Internal function to save the session of a client connection to the cache before the connection is deleted
+ */
+void esp_mbedtls_session_cache_save(esp_tls_t *tls);
+#endif
+
 /**
  * Internal Callback for mbedtls_init_global_ca_store
  */
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -93,6 +93,11 @@ struct esp_tls {
                                                                                      - ESP_TLS_SERVER */
 
     esp_tls_error_handle_t error_handle;                                        /*!< handle to error descriptor */
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    void *session_cache_entry;                                                  /*!< client session cache entry of the server,
+                                                                                     NULL if the cache is not used */
+    uint32_t session_cache_generation;                                          /*!< generation of the entry when it was looked up */
+#endif
 
 };
 
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -11,6 +11,14 @@
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "sys/socket.h"
+#include "netinet/in.h"
+#include "unistd.h"
+#include "test_utils.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
 
 const char *test_cert_pem =   "-----BEGIN CERTIFICATE-----\n"\
                               "MIICrDCCAZQCCQD88gCs5AFs/jANBgkqhkiG9w0BAQsFADAYMRYwFAYDVQQDDA1F\n"\
@@ -76,6 +84,129 @@ TEST_CASE("esp-tls global_ca_store set free", "[esp-tls]")
     esp_tls_free_global_ca_store();
 }
 
+#if CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+TEST_CASE("esp-tls client session cache clear", "[esp-tls]")
+{
+    esp_tls_client_session_cache_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_tls_client_session_cache_get_stats(NULL));
+    esp_tls_client_session_cache_clear();
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_client_session_cache_get_stats(&stats));
+    TEST_ASSERT_EQUAL(0, stats.entries);
+}
+
+#if CONFIG_ESP_TLS_SERVER_SESSION_TICKETS && CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#define SESSION_CACHE_TEST_CONNECTIONS  2
+
+typedef struct {
+    int listen_fd;
+    esp_tls_cfg_server_t cfg;
+    SemaphoreHandle_t done;
+} session_cache_test_server_t;
+
+static mbedtls_x509_crt s_session_cache_test_ca;
+static int s_session_cache_test_verify_count;
+
+static int session_cache_test_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    s_session_cache_test_verify_count++;
+    return 0;
+}
+
+/* Trusts the test certificate and counts the certificates verified, a resumed handshake verifies none */
+static esp_err_t session_cache_test_attach(void *conf)
+{
+    mbedtls_ssl_conf_ca_chain(conf, &s_session_cache_test_ca, NULL);
+    mbedtls_ssl_conf_verify(conf, session_cache_test_verify, NULL);
+    return ESP_OK;
+}
+
+static void session_cache_test_server_task(void *arg)
+{
+    session_cache_test_server_t *server = arg;
+    for (int i = 0; i < SESSION_CACHE_TEST_CONNECTIONS; i++) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        esp_tls_t *tls = esp_tls_init();
+        if (tls != NULL) {
+            if (esp_tls_server_session_create(&server->cfg, fd, tls) == 0) {
+                // wait until the client closes the connection
+                char c;
+                esp_tls_conn_read(tls, &c, 1);
+            }
+            esp_tls_server_session_delete(tls);
+        }
+        close(fd);
+    }
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("esp-tls client session cache resumes the session", "[esp-tls]")
+{
+    test_case_uses_tcpip();
+
+    mbedtls_x509_crt_init(&s_session_cache_test_ca);
+    TEST_ASSERT_EQUAL(0, mbedtls_x509_crt_parse(&s_session_cache_test_ca, (const unsigned char *)test_cert_pem,
+                                                strlen(test_cert_pem) + 1));
+    session_cache_test_server_t server = {
+        .listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP),
+        .cfg = {
+            .servercert_buf = (const unsigned char *)test_cert_pem,
+            .servercert_bytes = strlen(test_cert_pem) + 1,
+            .serverkey_buf = (const unsigned char *)test_key_pem,
+            .serverkey_bytes = strlen(test_key_pem) + 1,
+        },
+        .done = xSemaphoreCreateBinary(),
+    };
+    TEST_ASSERT_NOT_NULL(server.done);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_cfg_server_session_tickets_init(&server.cfg));
+    TEST_ASSERT_GREATER_OR_EQUAL(0, server.listen_fd);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addr_len = sizeof(addr);
+    TEST_ASSERT_EQUAL(0, bind(server.listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, getsockname(server.listen_fd, (struct sockaddr *)&addr, &addr_len));
+    TEST_ASSERT_EQUAL(0, listen(server.listen_fd, SESSION_CACHE_TEST_CONNECTIONS));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(session_cache_test_server_task, "tls_server", 8192, &server, 5, NULL));
+
+    esp_tls_client_session_cache_clear();
+    esp_tls_client_session_cache_stats_t before, after;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_client_session_cache_get_stats(&before));
+    esp_tls_cfg_t cfg = {
+        .crt_bundle_attach = session_cache_test_attach,
+        .common_name = "ESP-TLS Tests",
+        .tls_version = ESP_TLS_VER_TLS_1_2,
+        .timeout_ms = 10000,
+    };
+    s_session_cache_test_verify_count = 0;
+    for (int i = 0; i < SESSION_CACHE_TEST_CONNECTIONS; i++) {
+        esp_tls_t *tls = esp_tls_init();
+        TEST_ASSERT_NOT_NULL(tls);
+        TEST_ASSERT_EQUAL(1, esp_tls_conn_new_sync("127.0.0.1", strlen("127.0.0.1"), ntohs(addr.sin_port), &cfg, tls));
+        esp_tls_conn_destroy(tls);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, esp_tls_client_session_cache_get_stats(&after));
+    // The first connection saves the session, the second one resumes it without verifying the certificate again
+    TEST_ASSERT_EQUAL(1, after.misses - before.misses);
+    TEST_ASSERT_EQUAL(1, after.hits - before.hits);
+    TEST_ASSERT_EQUAL(1, after.entries);
+    TEST_ASSERT_EQUAL(1, s_session_cache_test_verify_count);
+
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server.done, pdMS_TO_TICKS(10000)));
+    esp_tls_client_session_cache_clear();
+    close(server.listen_fd);
+    vSemaphoreDelete(server.done);
+    esp_tls_cfg_server_session_tickets_free(&server.cfg);
+    mbedtls_x509_crt_free(&s_session_cache_test_ca);
+}
+#endif // CONFIG_ESP_TLS_SERVER_SESSION_TICKETS && CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#endif // CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+
 TEST_CASE("esp_tls_server session create delete", "[esp-tls]")
 {
     struct esp_tls *tls = esp_tls_init();
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -22,6 +22,10 @@
 #include "errno.h"
 #include "esp_random.h"
 #include "esp_tls.h"
+#include "esp_http_client_internal.h"
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+#include "http_inflate.h"
+#endif
 
 #ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
 #include "esp_transport_ssl.h"
@@ -131,12 +135,20 @@ struct esp_http_client {
     bool                        first_line_prepared;
     int                         header_index;
     bool                        is_async;
+    bool                        nonblocking_read;   /*!< reads don't wait for data, set while driven by a multiplexer */
     esp_transport_keep_alive_t  keep_alive_cfg;
     struct ifreq                *if_name;
     unsigned                    cache_data_in_fetch_hdr: 1;
 #ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
     session_ticket_state_t      session_ticket_state;
 #endif
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    bool                        decode_content;     /*!< gzip and deflate are accepted and decoded */
+    int                         content_encoding;   /*!< http_inflate_format_t of the response, CONTENT_ENCODING_NONE if not encoded */
+    bool                        inflate_active;     /*!< body of the current response is decoded */
+    bool                        inflate_pending;    /*!< decoded data may be waiting for esp_http_client_read() */
+    http_inflate_handle_t       inflate;            /*!< allocated on the first encoded response, then reused */
+#endif
 };
 
 typedef struct esp_http_client esp_http_client_t;
@@ -152,6 +164,8 @@ static esp_err_t _clear_connection_info(esp_http_client_handle_t client);
 #define ASYNC_TRANS_CONNECTING 0
 #define ASYNC_TRANS_CONNECT_PASS 1
 
+#define CONTENT_ENCODING_NONE (-1)
+
 static const char *DEFAULT_HTTP_USER_AGENT = "ESP32 HTTP Client/1.0";
 static const char *DEFAULT_HTTP_PROTOCOL = "HTTP/1.1";
 static const char *DEFAULT_HTTP_PATH = "/";
@@ -215,6 +229,11 @@ static int http_on_message_begin(http_parser *parser)
 
     client->response->is_chunked = false;
     client->is_chunk_complete = false;
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    client->content_encoding = CONTENT_ENCODING_NONE;
+    client->inflate_active = false;
+    client->inflate_pending = false;
+#endif
     return 0;
 }
 
@@ -267,6 +286,17 @@ static int http_on_header_value(http_parser *parser, const char *at, size_t leng
     } else if (strcasecmp(client->current_header_key, "WWW-Authenticate") == 0) {
         http_utils_append_string(&client->auth_header, at, length);
     }
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    if (client->decode_content && strcasecmp(client->current_header_key, "Content-Encoding") == 0) {
+        if ((length == 4 && strncasecmp(at, "gzip", length) == 0) || (length == 6 && strncasecmp(at, "x-gzip", length) == 0)) {
+            client->content_encoding = HTTP_INFLATE_GZIP;
+        } else if (length == 7 && strncasecmp(at, "deflate", length) == 0) {
+            client->content_encoding = HTTP_INFLATE_DEFLATE;
+        } else if (!(length == 8 && strncasecmp(at, "identity", length) == 0)) {
+            ESP_LOGW(TAG, "Unsupported Content-Encoding: %.*s, body is not decoded", (int)length, at);
+        }
+    }
+#endif
     http_utils_append_string(&client->current_header_value, at, length);
     http_on_header_event(client);
     return 0;
@@ -282,6 +312,16 @@ static int http_on_headers_complete(http_parser *parser)
     client->response->data_process = 0;
     ESP_LOGD(TAG, "http_on_headers_complete, status=%d, offset=%d, nread=%" PRId32, parser->status_code, client->response->data_offset, parser->nread);
     client->state = HTTP_STATE_RES_COMPLETE_HEADER;
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    if (client->content_encoding != CONTENT_ENCODING_NONE && client->connection_info.method != HTTP_METHOD_HEAD) {
+        if (client->inflate == NULL && (client->inflate = http_inflate_init(client->buffer_size_rx)) == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate memory for decoding the response");
+            return -1;
+        }
+        http_inflate_reset(client->inflate, client->content_encoding);
+        client->inflate_active = true;
+    }
+#endif
     if (client->connection_info.method == HTTP_METHOD_HEAD) {
         /* In a HTTP_RESPONSE parser returning '1' from on_headers_complete will tell the
            parser that it should not expect a body. This is used when receiving a response
@@ -292,11 +332,9 @@ static int http_on_headers_complete(http_parser *parser)
     return 0;
 }
 
-static int http_on_body(http_parser *parser, const char *at, size_t length)
+/* Pass the response body, decoded if needed, to esp_http_client_read(), the cache and the event handler */
+static int http_client_output_body(esp_http_client_t *client, const char *at, size_t length)
 {
-    esp_http_client_t *client = parser->data;
-    ESP_LOGD(TAG, "http_on_body %zu", length);
-
     if (client->response->buffer->output_ptr) {
         memcpy(client->response->buffer->output_ptr, (char *)at, length);
         client->response->buffer->output_ptr += length;
@@ -316,7 +354,6 @@ static int http_on_body(http_parser *parser, const char *at, size_t length)
         }
     }
 
-    client->response->data_process += length;
     client->response->buffer->raw_len += length;
     http_dispatch_event(client, HTTP_EVENT_ON_DATA, (void *)at, length);
     esp_http_client_on_data_t evt_data = {};
@@ -326,11 +363,61 @@ static int http_on_body(http_parser *parser, const char *at, size_t length)
     return 0;
 }
 
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+static int http_client_inflate_body(esp_http_client_t *client, const char *at, size_t length)
+{
+    if (http_inflate_write(client->inflate, at, length) != ESP_OK) {
+        return -1;
+    }
+    if (client->response->buffer->output_ptr ||
+        (client->state < HTTP_STATE_RES_ON_DATA_START && client->cache_data_in_fetch_hdr)) {
+        /* The decoded data may not fit in the buffer, it's copied by esp_http_client_read().
+           The body received with the headers is kept in the decoder as well, caching it decoded
+           could take any amount of memory. */
+        client->inflate_pending = true;
+        return 0;
+    }
+    const char *data;
+    int len;
+    while ((len = http_inflate_read(client->inflate, &data, SIZE_MAX)) > 0) {
+        if (http_client_output_body(client, data, len) != 0) {
+            return -1;
+        }
+    }
+    if (len < 0) {
+        ESP_LOGE(TAG, "Failed to decode the response");
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+static int http_on_body(http_parser *parser, const char *at, size_t length)
+{
+    esp_http_client_t *client = parser->data;
+    ESP_LOGD(TAG, "http_on_body %zu", length);
+
+    /* Encoded data is counted, to compare it with the content length */
+    client->response->data_process += length;
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    if (client->inflate_active) {
+        return http_client_inflate_body(client, at, length);
+    }
+#endif
+    return http_client_output_body(client, at, length);
+}
+
 static int http_on_message_complete(http_parser *parser)
 {
     ESP_LOGD(TAG, "http_on_message_complete, parser=%p", parser);
     esp_http_client_handle_t client = parser->data;
     client->is_chunk_complete = true;
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    if (client->inflate_active && client->response->data_process > 0 && !client->inflate_pending &&
+        !http_inflate_is_done(client->inflate)) {
+        ESP_LOGW(TAG, "Encoded response ended before the end of the compressed data");
+    }
+#endif
     return 0;
 }
 
@@ -859,6 +946,16 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
         goto error;
     }
 
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    if (config->decode_content) {
+        if (esp_http_client_set_header(client, "Accept-Encoding", "gzip, deflate") != ESP_OK) {
+            ESP_LOGE(TAG, "Error while setting default configurations");
+            goto error;
+        }
+        client->decode_content = true;
+    }
+#endif
+
     /* As default behavior, cache data received in fetch header state. This will be
      * used in esp_http_client_read API only. For esp_http_perform we shall disable
      * this as data will be processed by event handler */
@@ -925,6 +1022,9 @@ esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
         free(client->response->buffer);
         free(client->response);
     }
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    http_inflate_cleanup(client->inflate);
+#endif
     if (client->if_name) {
         free(client->if_name);
     }
@@ -1127,6 +1227,25 @@ esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int ti
     return ESP_OK;
 }
 
+static int http_client_read_timeout_ms(esp_http_client_handle_t client)
+{
+    return client->nonblocking_read ? 0 : client->timeout_ms;
+}
+
+/* Returns true if esp_http_client_get_data() returned no data only because none was available yet */
+static bool http_client_read_would_block(esp_http_client_handle_t client, int rlen)
+{
+    if (!client->is_async) {
+        return false;
+    }
+    if (errno == EAGAIN) {
+        return true;
+    }
+    /* Nothing is read for HEAD requests, which doesn't mean that the data isn't available */
+    return client->nonblocking_read && rlen == ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT &&
+           client->connection_info.method != HTTP_METHOD_HEAD;
+}
+
 static int esp_http_client_get_data(esp_http_client_handle_t client)
 {
     if (client->state < HTTP_STATE_RES_ON_DATA_START) {
@@ -1141,7 +1260,7 @@ static int esp_http_client_get_data(esp_http_client_handle_t client)
 
     ESP_LOGD(TAG, "data_process=%"PRId64", content_length=%"PRId64, client->response->data_process, client->response->content_length);
     errno = 0;
-    int rlen = esp_transport_read(client->transport, res_buffer->data, client->buffer_size_rx, client->timeout_ms);
+    int rlen = esp_transport_read(client->transport, res_buffer->data, client->buffer_size_rx, http_client_read_timeout_ms(client));
     if (rlen >= 0) {
         // When tls error is ESP_TLS_ERR_SSL_WANT_READ (-0x6900), esp_trasnport_read returns ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT (0x0).
         // We should not execute http_parser_execute() on this condition as it sets the internal state machine in an
@@ -1166,9 +1285,40 @@ bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
             return false;
         }
     }
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    if (client->inflate_pending) {
+        ESP_LOGD(TAG, "Decoded data was not completely read");
+        return false;
+    }
+#endif
     return true;
 }
 
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+static int http_client_read_inflated(esp_http_client_handle_t client, char *buffer, int len)
+{
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+    const char *data;
+    int ridx = 0, dlen = 0;
+
+    res_buffer->output_ptr = buffer;
+    while (ridx < len && (dlen = http_inflate_read(client->inflate, &data, len - ridx)) > 0) {
+        http_client_output_body(client, data, dlen);
+        ridx += dlen;
+    }
+    res_buffer->raw_len = 0;
+    res_buffer->output_ptr = NULL;
+    if (dlen <= 0) {
+        client->inflate_pending = false;
+    }
+    if (dlen < 0) {
+        ESP_LOGE(TAG, "Failed to decode the response");
+        return ESP_FAIL;
+    }
+    return ridx;
+}
+#endif
+
 int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
 {
     esp_http_buffer_t *res_buffer = client->response->buffer;
@@ -1190,6 +1340,20 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
     int need_read = len - ridx;
     bool is_data_remain = true;
     while (need_read > 0 && is_data_remain) {
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+        /* Data decoded from the previous read is returned before reading more from the transport */
+        if (client->inflate_pending) {
+            int dlen = http_client_read_inflated(client, buffer + ridx, need_read);
+            if (dlen < 0) {
+                return ridx ? ridx : ESP_FAIL;
+            }
+            ridx += dlen;
+            need_read -= dlen;
+            if (need_read == 0) {
+                break;
+            }
+        }
+#endif
         if (client->response->is_chunked) {
             is_data_remain = !client->is_chunk_complete;
         } else {
@@ -1200,6 +1364,12 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
             break;
         }
         int byte_to_read = need_read;
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+        if (client->inflate_active) {
+            /* Encoded data is buffered by the decoder, not copied to the caller's buffer */
+            byte_to_read = client->buffer_size_rx;
+        }
+#endif
         if (byte_to_read > client->buffer_size_rx) {
             byte_to_read = client->buffer_size_rx;
         }
@@ -1318,20 +1488,23 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     http_dispatch_event_to_event_loop(HTTP_EVENT_ERROR, &client, sizeof(esp_http_client_handle_t));
                     return ESP_ERR_HTTP_FETCH_HEADER;
                 }
-                /* falls through */
-            case HTTP_STATE_RES_ON_DATA_START:
                 /* Enable caching after fetch headers state because next
                  * request could be performed using native APIs */
                 client->cache_data_in_fetch_hdr = 1;
+                /* The response is checked only once, before the state changes to HTTP_STATE_RES_ON_DATA_START,
+                   as reading the body may be resumed by another call in case of non-blocking esp_http_client_perform() */
                 if ((err = esp_http_check_response(client)) != ESP_OK) {
                     ESP_LOGE(TAG, "Error response");
                     http_dispatch_event(client, HTTP_EVENT_ERROR, esp_transport_get_error_handle(client->transport), 0);
                     http_dispatch_event_to_event_loop(HTTP_EVENT_ERROR, &client, sizeof(esp_http_client_handle_t));
                     return err;
                 }
+                /* falls through */
+            case HTTP_STATE_RES_ON_DATA_START:
                 while (client->response->is_chunked && !client->is_chunk_complete) {
-                    if (esp_http_client_get_data(client) <= 0) {
-                        if (client->is_async && errno == EAGAIN) {
+                    int rlen = esp_http_client_get_data(client);
+                    if (rlen <= 0) {
+                        if (http_client_read_would_block(client, rlen)) {
                             return ESP_ERR_HTTP_EAGAIN;
                         }
                         ESP_LOGD(TAG, "Read finish or server requests close");
@@ -1339,8 +1512,9 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     }
                 }
                 while (client->response->data_process < client->response->content_length) {
-                    if (esp_http_client_get_data(client) <= 0) {
-                        if (client->is_async && errno == EAGAIN) {
+                    int rlen = esp_http_client_get_data(client);
+                    if (rlen <= 0) {
+                        if (http_client_read_would_block(client, rlen)) {
                             return ESP_ERR_HTTP_EAGAIN;
                         }
                         ESP_LOGD(TAG, "Read finish or server requests close");
@@ -1380,10 +1554,10 @@ int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
 
     while (client->state < HTTP_STATE_RES_COMPLETE_HEADER) {
         errno = 0;
-        buffer->len = esp_transport_read(client->transport, buffer->data, client->buffer_size_rx, client->timeout_ms);
+        buffer->len = esp_transport_read(client->transport, buffer->data, client->buffer_size_rx, http_client_read_timeout_ms(client));
         if (buffer->len <= 0) {
             if (buffer->len == ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT) {
-                ESP_LOGW(TAG, "Connection timed out before data was ready!");
+                ESP_LOG_LEVEL(client->nonblocking_read ? ESP_LOG_DEBUG : ESP_LOG_WARN, TAG, "Connection timed out before data was ready!");
                 return -ESP_ERR_HTTP_EAGAIN;
             }
             return ESP_FAIL;
@@ -1836,3 +2010,27 @@ esp_err_t esp_http_client_get_chunk_length(esp_http_client_handle_t client, int
     }
     return ESP_OK;
 }
+
+esp_err_t http_client_set_nonblocking_read(esp_http_client_handle_t client, bool enable)
+{
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (enable && !client->is_async) {
+        ESP_LOGE(TAG, "Non-blocking reads need a client in asynchronous mode");
+        return ESP_ERR_INVALID_ARG;
+    }
+    client->nonblocking_read = enable;
+    return ESP_OK;
+}
+
+void http_client_get_poll_info(esp_http_client_handle_t client, int *fd, bool *connecting)
+{
+    *fd = client->transport ? esp_transport_get_socket(client->transport) : -1;
+    *connecting = client->state < HTTP_STATE_CONNECTED;
+}
+
+int http_client_get_timeout_ms(esp_http_client_handle_t client)
+{
+    return client->timeout_ms;
+}
@@ -0,0 +1,310 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "esp_http_client_mux.h"
+#include "esp_http_client_internal.h"
+
+#if CONFIG_IDF_TARGET_LINUX || CONFIG_LWIP_IPV4
+#define MUX_CTRL_SOCK_IPV4  1
+#else
+#define MUX_CTRL_SOCK_IPV4  0
+#endif
+
+static const char *TAG = "HTTP_CLIENT_MUX";
+
+typedef struct {
+    esp_http_client_handle_t client;
+    esp_http_client_mux_done_cb_t done_cb;
+    void *arg;
+} mux_request_t;
+
+typedef enum {
+    MUX_WAIT_NONE,          /* perform the next step without waiting */
+    MUX_WAIT_READ,
+    MUX_WAIT_WRITE,
+} mux_wait_t;
+
+typedef struct {
+    mux_request_t req;      /* client is NULL if the slot is free */
+    mux_wait_t wait;
+    int fd;
+    bool connecting;
+    TickType_t last_activity;
+    TickType_t timeout;
+} mux_slot_t;
+
+struct esp_http_client_mux {
+    QueueHandle_t queue;
+    SemaphoreHandle_t exit_sem;
+    int ctrl_sock;          /* UDP socket connected to itself, to wake up select() */
+    volatile bool stop;
+    size_t max_requests;
+    size_t active;
+    mux_slot_t slots[];
+};
+
+static int mux_create_ctrl_sock(void)
+{
+    int fd = socket(MUX_CTRL_SOCK_IPV4 ? AF_INET : AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_storage addr = {};
+    socklen_t addr_len = sizeof(addr);
+#if MUX_CTRL_SOCK_IPV4
+    struct sockaddr_in *addr4 = (struct sockaddr_in *)&addr;
+    addr4->sin_family = AF_INET;
+    inet_aton("127.0.0.1", &addr4->sin_addr);
+#else
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&addr;
+    addr6->sin6_family = AF_INET6;
+    inet6_aton("::1", &addr6->sin6_addr);
+#endif
+    // Bind to any free port and connect to it, so that send() wakes up the task waiting in select()
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) < 0 ||
+        connect(fd, (struct sockaddr *)&addr, addr_len) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void mux_wakeup(esp_http_client_mux_handle_t mux)
+{
+    uint8_t msg = 0;
+    // If the socket queue is full, the task is going to be woken up anyway
+    send(mux->ctrl_sock, &msg, sizeof(msg), MSG_DONTWAIT);
+}
+
+static void mux_finish(esp_http_client_mux_handle_t mux, mux_slot_t *slot, esp_err_t result)
+{
+    mux_request_t req = slot->req;
+    slot->req.client = NULL;
+    mux->active--;
+    http_client_set_nonblocking_read(req.client, false);
+    if (req.done_cb) {
+        req.done_cb(req.client, result, req.arg);
+    }
+}
+
+static void mux_accept_requests(esp_http_client_mux_handle_t mux)
+{
+    mux_request_t req;
+    for (size_t i = 0; i < mux->max_requests && mux->active < mux->max_requests; i++) {
+        mux_slot_t *slot = &mux->slots[i];
+        if (slot->req.client != NULL) {
+            continue;
+        }
+        if (xQueueReceive(mux->queue, &req, 0) != pdTRUE) {
+            break;
+        }
+        slot->req = req;
+        slot->wait = MUX_WAIT_NONE;
+        slot->fd = -1;
+        slot->connecting = false;
+        slot->last_activity = xTaskGetTickCount();
+        slot->timeout = pdMS_TO_TICKS(http_client_get_timeout_ms(req.client));
+        mux->active++;
+    }
+}
+
+/* Advances the request and decides what to wait for before the next step */
+static void mux_step(esp_http_client_mux_handle_t mux, mux_slot_t *slot)
+{
+    esp_http_client_handle_t client = slot->req.client;
+    esp_err_t err = esp_http_client_perform(client);
+    if (err != ESP_ERR_HTTP_EAGAIN) {
+        mux_finish(mux, slot, err);
+        return;
+    }
+
+    bool was_connecting = slot->connecting;
+    http_client_get_poll_info(client, &slot->fd, &slot->connecting);
+    if (slot->fd < 0) {
+        ESP_LOGE(TAG, "Request in progress without a socket");
+        esp_http_client_close(client);
+        mux_finish(mux, slot, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    // The TCP connection is established when the socket becomes writable. Then the TLS client only
+    // has to wait for the server, as its handshake messages fit into the socket buffer.
+    slot->wait = (slot->connecting && !was_connecting) ? MUX_WAIT_WRITE : MUX_WAIT_READ;
+    slot->last_activity = xTaskGetTickCount();
+}
+
+static void mux_abort_all(esp_http_client_mux_handle_t mux)
+{
+    for (size_t i = 0; i < mux->max_requests; i++) {
+        mux_slot_t *slot = &mux->slots[i];
+        if (slot->req.client != NULL) {
+            esp_http_client_close(slot->req.client);
+            mux_finish(mux, slot, ESP_ERR_INVALID_STATE);
+        }
+    }
+    mux_request_t req;
+    while (xQueueReceive(mux->queue, &req, 0) == pdTRUE) {
+        http_client_set_nonblocking_read(req.client, false);
+        if (req.done_cb) {
+            req.done_cb(req.client, ESP_ERR_INVALID_STATE, req.arg);
+        }
+    }
+}
+
+static void mux_task(void *arg)
+{
+    esp_http_client_mux_handle_t mux = arg;
+    uint8_t ctrl_buf[16];
+
+    while (!mux->stop) {
+        mux_accept_requests(mux);
+
+        fd_set read_set, write_set;
+        FD_ZERO(&read_set);
+        FD_ZERO(&write_set);
+        FD_SET(mux->ctrl_sock, &read_set);
+        int max_fd = mux->ctrl_sock;
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait_ticks = portMAX_DELAY;
+        for (size_t i = 0; i < mux->max_requests; i++) {
+            mux_slot_t *slot = &mux->slots[i];
+            if (slot->req.client == NULL) {
+                continue;
+            }
+            if (slot->wait == MUX_WAIT_NONE) {
+                wait_ticks = 0;
+                continue;
+            }
+            FD_SET(slot->fd, slot->wait == MUX_WAIT_READ ? &read_set : &write_set);
+            max_fd = MAX(max_fd, slot->fd);
+            TickType_t elapsed = now - slot->last_activity;
+            wait_ticks = MIN(wait_ticks, elapsed < slot->timeout ? slot->timeout - elapsed : 0);
+        }
+
+        struct timeval tv = {
+            .tv_sec = pdTICKS_TO_MS(wait_ticks) / 1000,
+            .tv_usec = (pdTICKS_TO_MS(wait_ticks) % 1000) * 1000,
+        };
+        int ready = select(max_fd + 1, &read_set, &write_set, NULL, wait_ticks == portMAX_DELAY ? NULL : &tv);
+        if (ready < 0) {
+            // Let the timeouts fail the requests whose sockets are broken
+            ESP_LOGE(TAG, "select() failed, errno=%d", errno);
+            vTaskDelay(1);
+        }
+        if (ready > 0 && FD_ISSET(mux->ctrl_sock, &read_set)) {
+            while (recv(mux->ctrl_sock, ctrl_buf, sizeof(ctrl_buf), MSG_DONTWAIT) > 0) {
+            }
+        }
+        if (mux->stop) {
+            break;
+        }
+
+        now = xTaskGetTickCount();
+        for (size_t i = 0; i < mux->max_requests; i++) {
+            mux_slot_t *slot = &mux->slots[i];
+            if (slot->req.client == NULL) {
+                continue;
+            }
+            if (slot->wait == MUX_WAIT_NONE ||
+                (ready > 0 && FD_ISSET(slot->fd, slot->wait == MUX_WAIT_READ ? &read_set : &write_set))) {
+                mux_step(mux, slot);
+            } else if (now - slot->last_activity >= slot->timeout) {
+                ESP_LOGW(TAG, "Request timed out");
+                esp_http_client_close(slot->req.client);
+                mux_finish(mux, slot, ESP_ERR_TIMEOUT);
+            }
+        }
+    }
+
+    mux_abort_all(mux);
+    xSemaphoreGive(mux->exit_sem);
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_http_client_mux_create(const esp_http_client_mux_config_t *config, esp_http_client_mux_handle_t *out_mux)
+{
+    ESP_RETURN_ON_FALSE(config && out_mux, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+    ESP_RETURN_ON_FALSE(config->max_requests > 0 && config->queue_size > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid sizes");
+
+    esp_err_t ret = ESP_OK;
+    esp_http_client_mux_handle_t mux = calloc(1, sizeof(struct esp_http_client_mux) + config->max_requests * sizeof(mux_slot_t));
+    ESP_RETURN_ON_FALSE(mux, ESP_ERR_NO_MEM, TAG, "Memory exhausted");
+    mux->ctrl_sock = -1;
+    mux->max_requests = config->max_requests;
+
+    mux->queue = xQueueCreate(config->queue_size, sizeof(mux_request_t));
+    mux->exit_sem = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(mux->queue && mux->exit_sem, ESP_ERR_NO_MEM, error, TAG, "Memory exhausted");
+    mux->ctrl_sock = mux_create_ctrl_sock();
+    ESP_GOTO_ON_FALSE(mux->ctrl_sock >= 0, ESP_FAIL, error, TAG, "Failed to create control socket, errno=%d", errno);
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(mux_task, "http_client_mux", config->task_stack_size, mux,
+                                              config->task_priority, NULL, config->task_core_id) == pdPASS,
+                      ESP_ERR_NO_MEM, error, TAG, "Failed to create task");
+    *out_mux = mux;
+    return ESP_OK;
+
+error:
+    if (mux->ctrl_sock >= 0) {
+        close(mux->ctrl_sock);
+    }
+    if (mux->exit_sem) {
+        vSemaphoreDelete(mux->exit_sem);
+    }
+    if (mux->queue) {
+        vQueueDelete(mux->queue);
+    }
+    free(mux);
+    return ret;
+}
+
+esp_err_t esp_http_client_mux_submit(esp_http_client_mux_handle_t mux, esp_http_client_handle_t client,
+                                     esp_http_client_mux_done_cb_t done_cb, void *arg)
+{
+    ESP_RETURN_ON_FALSE(mux && client, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+    ESP_RETURN_ON_ERROR(http_client_set_nonblocking_read(client, true), TAG, "Client is not in asynchronous mode");
+
+    mux_request_t req = {
+        .client = client,
+        .done_cb = done_cb,
+        .arg = arg,
+    };
+    if (xQueueSend(mux->queue, &req, 0) != pdTRUE) {
+        http_client_set_nonblocking_read(client, false);
+        ESP_LOGE(TAG, "Request queue is full");
+        return ESP_ERR_NO_MEM;
+    }
+    mux_wakeup(mux);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_mux_destroy(esp_http_client_mux_handle_t mux)
+{
+    ESP_RETURN_ON_FALSE(mux, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+    mux->stop = true;
+    mux_wakeup(mux);
+    xSemaphoreTake(mux->exit_sem, portMAX_DELAY);
+
+    close(mux->ctrl_sock);
+    vSemaphoreDelete(mux->exit_sem);
+    vQueueDelete(mux->queue);
+    free(mux);
+    return ESP_OK;
+}
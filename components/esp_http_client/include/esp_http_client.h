@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -189,6 +189,10 @@ typedef struct {
 #if CONFIG_ESP_HTTP_CLIENT_ENABLE_CUSTOM_TRANSPORT
     struct esp_transport_item_t *transport;
 #endif
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+    bool decode_content;                    /*!< Send `Accept-Encoding: gzip, deflate` and decode gzip and deflate encoded responses,
+                                                 the data returned by esp_http_client_read() and HTTP_EVENT_ON_DATA is decoded */
+#endif
 } esp_http_client_config_t;
 
 /**
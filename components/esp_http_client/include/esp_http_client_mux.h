@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_http_client_mux *esp_http_client_mux_handle_t;
+
+/**
+ * @brief      Callback called when a request submitted to the multiplexer is complete
+ *
+ * The callback is called from the multiplexer task. The client is not used by the multiplexer
+ * anymore, so the callback may read its status, submit it again or clean it up.
+ *
+ * @param[in]  client  The client handle of the request
+ * @param[in]  result  Result of the request:
+ *                     - ESP_OK if the request was performed, same as returned by esp_http_client_perform()
+ *                     - ESP_ERR_TIMEOUT if no data was exchanged for the timeout of the client
+ *                     - ESP_ERR_INVALID_STATE if the multiplexer was destroyed before the request was complete
+ *                     - Other errors returned by esp_http_client_perform()
+ * @param[in]  arg     The argument passed to esp_http_client_mux_submit()
+ */
+typedef void (*esp_http_client_mux_done_cb_t)(esp_http_client_handle_t client, esp_err_t result, void *arg);
+
+/**
+ * @brief Multiplexer configuration
+ */
+typedef struct {
+    size_t      max_requests;       /*!< Maximum number of requests performed at the same time */
+    size_t      queue_size;         /*!< Maximum number of submitted requests waiting for a free slot */
+    size_t      task_stack_size;    /*!< Stack size of the multiplexer task, the event handlers of the clients and the completion callbacks run in this task */
+    unsigned    task_priority;      /*!< Priority of the multiplexer task */
+    int         task_core_id;       /*!< Core the multiplexer task is pinned to, tskNO_AFFINITY for no affinity */
+} esp_http_client_mux_config_t;
+
+#define ESP_HTTP_CLIENT_MUX_DEFAULT_CONFIG() {  \
+        .max_requests = 8,                      \
+        .queue_size = 16,                       \
+        .task_stack_size = 8192,                \
+        .task_priority = 5,                     \
+        .task_core_id = tskNO_AFFINITY,         \
+}
+
+/**
+ * @brief      Create a multiplexer, which performs the requests of many clients from a single task
+ *
+ * The multiplexer task waits for the sockets of all its requests in a single select() call and advances a request
+ * with non-blocking esp_http_client_perform() whenever its socket is ready, so the requests are performed concurrently
+ * without a task per client.
+ *
+ * @param[in]  config   The multiplexer configuration
+ * @param[out] out_mux  The created multiplexer
+ *
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_ARG if an argument is invalid
+ *     - ESP_ERR_NO_MEM if there is not enough memory
+ *     - ESP_FAIL if the control socket, used to wake up the task, can't be created
+ */
+esp_err_t esp_http_client_mux_create(const esp_http_client_mux_config_t *config, esp_http_client_mux_handle_t *out_mux);
+
+/**
+ * @brief      Submit a request to the multiplexer
+ *
+ * The request is performed as configured in the client, as esp_http_client_perform() would do. The client must have been
+ * initialized with `is_async` set in esp_http_client_config_t, and must not be used by the application until the callback
+ * is called.
+ *
+ * Time spent without exchanging any data, including the connection establishment, is limited by the timeout of the
+ * client. The host name is resolved in the multiplexer task, which blocks the other requests meanwhile.
+ *
+ * @param[in]  mux      The multiplexer handle
+ * @param[in]  client   The client handle of the request
+ * @param[in]  done_cb  Callback called when the request is complete, may be NULL
+ * @param[in]  arg      Argument passed to the callback
+ *
+ * @return
+ *     - ESP_OK if the request was queued
+ *     - ESP_ERR_INVALID_ARG if an argument is invalid or the client is not in asynchronous mode
+ *     - ESP_ERR_NO_MEM if the queue of the multiplexer is full
+ */
+esp_err_t esp_http_client_mux_submit(esp_http_client_mux_handle_t mux, esp_http_client_handle_t client,
+                                     esp_http_client_mux_done_cb_t done_cb, void *arg);
+
+/**
+ * @brief      Destroy the multiplexer
+ *
+ * The connections of the requests in progress are closed, and the callbacks of these and the queued requests
+ * are called with ESP_ERR_INVALID_STATE before this function returns. Must not be called from a completion callback.
+ *
+ * @param[in]  mux  The multiplexer handle
+ *
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_ARG if mux is NULL
+ */
+esp_err_t esp_http_client_mux_destroy(esp_http_client_mux_handle_t mux);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,320 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "miniz.h"
+#include "http_inflate.h"
+
+static const char *TAG = "HTTP_INFLATE";
+
+#define GZIP_ID1            (0x1f)
+#define GZIP_ID2            (0x8b)
+#define GZIP_CM_DEFLATE     (8)
+#define GZIP_FHCRC          (0x02)
+#define GZIP_FEXTRA         (0x04)
+#define GZIP_FNAME          (0x08)
+#define GZIP_FCOMMENT       (0x10)
+#define GZIP_FRESERVED      (0xe0)
+#define GZIP_HEADER_LEN     (10)
+#define GZIP_TRAILER_LEN    (8)
+/* Both bytes of the zlib header are needed to tell it from raw deflate data */
+#define ZLIB_HEADER_LEN     (2)
+
+typedef enum {
+    INFLATE_STATE_HEADER = 0,   /* fixed part of the gzip header, or detection of the zlib header */
+    INFLATE_STATE_EXTRA_LEN,
+    INFLATE_STATE_EXTRA,
+    INFLATE_STATE_NAME,
+    INFLATE_STATE_COMMENT,
+    INFLATE_STATE_HEADER_CRC,
+    INFLATE_STATE_DATA,
+    INFLATE_STATE_TRAILER,
+    INFLATE_STATE_DONE,
+    INFLATE_STATE_ERROR,
+} inflate_state_t;
+
+/**
+ * Streaming decoder state
+ */
+struct http_inflate {
+    tinfl_decompressor      decomp;
+    http_inflate_format_t   format;
+    inflate_state_t         state;
+    uint32_t                decomp_flags;
+    bool                    has_more_output;    /*!< the decompressor has output which didn't fit in the window */
+    uint8_t                 *window;            /*!< last TINFL_LZ_DICT_SIZE bytes of output, used as LZ dictionary */
+    size_t                  window_ofs;         /*!< offset of the next output in the window */
+    size_t                  out_ofs;            /*!< offset of the output not returned yet */
+    size_t                  out_len;            /*!< length of the output not returned yet */
+    uint8_t                 *in;                /*!< input not decoded yet */
+    size_t                  in_size;
+    size_t                  in_ofs;
+    size_t                  in_len;
+    uint8_t                 field[GZIP_HEADER_LEN]; /*!< fixed size gzip field being received */
+    size_t                  field_len;
+    size_t                  skip_len;           /*!< remaining length of the gzip extra field */
+    uint8_t                 flags;              /*!< gzip header flags */
+    uint32_t                crc;                /*!< CRC-32 of the gzip output */
+    uint32_t                size;               /*!< length of the gzip output modulo 2^32 */
+};
+
+http_inflate_handle_t http_inflate_init(size_t max_input_len)
+{
+    http_inflate_handle_t inflate = calloc(1, sizeof(struct http_inflate));
+    ESP_RETURN_ON_FALSE(inflate, NULL, TAG, "Memory exhausted");
+    inflate->in_size = max_input_len + ZLIB_HEADER_LEN;
+    inflate->in = malloc(inflate->in_size);
+    inflate->window = malloc(TINFL_LZ_DICT_SIZE);
+    if (inflate->in == NULL || inflate->window == NULL) {
+        ESP_LOGE(TAG, "Memory exhausted");
+        http_inflate_cleanup(inflate);
+        return NULL;
+    }
+    http_inflate_reset(inflate, HTTP_INFLATE_GZIP);
+    return inflate;
+}
+
+void http_inflate_reset(http_inflate_handle_t inflate, http_inflate_format_t format)
+{
+    tinfl_init(&inflate->decomp);
+    inflate->format = format;
+    inflate->state = INFLATE_STATE_HEADER;
+    inflate->decomp_flags = TINFL_FLAG_HAS_MORE_INPUT;
+    inflate->has_more_output = false;
+    inflate->window_ofs = 0;
+    inflate->out_ofs = 0;
+    inflate->out_len = 0;
+    inflate->in_ofs = 0;
+    inflate->in_len = 0;
+    inflate->field_len = 0;
+    inflate->crc = MZ_CRC32_INIT;
+    inflate->size = 0;
+}
+
+esp_err_t http_inflate_write(http_inflate_handle_t inflate, const char *data, size_t len)
+{
+    ESP_RETURN_ON_FALSE(inflate->in_len + len <= inflate->in_size, ESP_ERR_INVALID_SIZE, TAG,
+                        "Input of %zu bytes doesn't fit, %zu bytes not decoded yet", len, inflate->in_len);
+    if (inflate->in_ofs) {
+        memmove(inflate->in, inflate->in + inflate->in_ofs, inflate->in_len);
+        inflate->in_ofs = 0;
+    }
+    memcpy(inflate->in + inflate->in_len, data, len);
+    inflate->in_len += len;
+    return ESP_OK;
+}
+
+/* Move to the next optional gzip header field present in the stream, or to the compressed data */
+static void inflate_next_header_field(http_inflate_handle_t inflate)
+{
+    static const struct {
+        inflate_state_t state;
+        uint8_t flag;
+    } fields[] = {
+        { INFLATE_STATE_EXTRA_LEN, GZIP_FEXTRA },
+        { INFLATE_STATE_NAME, GZIP_FNAME },
+        { INFLATE_STATE_COMMENT, GZIP_FCOMMENT },
+        { INFLATE_STATE_HEADER_CRC, GZIP_FHCRC },
+    };
+
+    inflate->field_len = 0;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (fields[i].state > inflate->state && (inflate->flags & fields[i].flag)) {
+            inflate->state = fields[i].state;
+            return;
+        }
+    }
+    inflate->state = INFLATE_STATE_DATA;
+}
+
+static uint32_t inflate_field_u32(const uint8_t *field)
+{
+    return field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24);
+}
+
+/* Checks the gzip trailer once all its bytes were received */
+static esp_err_t inflate_check_trailer(http_inflate_handle_t inflate)
+{
+    if (inflate->field_len == GZIP_TRAILER_LEN) {
+        ESP_RETURN_ON_FALSE(inflate_field_u32(inflate->field) == inflate->crc, ESP_FAIL, TAG, "gzip CRC mismatch");
+        ESP_RETURN_ON_FALSE(inflate_field_u32(inflate->field + 4) == inflate->size, ESP_FAIL, TAG, "gzip size mismatch");
+        inflate->state = INFLATE_STATE_DONE;
+    }
+    return ESP_OK;
+}
+
+/* Consume the gzip header or trailer, byte by byte as it may be split between writes */
+static esp_err_t inflate_parse_gzip(http_inflate_handle_t inflate)
+{
+    while (inflate->in_len > 0 && inflate->state != INFLATE_STATE_DATA && inflate->state != INFLATE_STATE_DONE) {
+        uint8_t byte = inflate->in[inflate->in_ofs++];
+        inflate->in_len--;
+        switch (inflate->state) {
+        case INFLATE_STATE_HEADER:
+            inflate->field[inflate->field_len++] = byte;
+            if (inflate->field_len == GZIP_HEADER_LEN) {
+                ESP_RETURN_ON_FALSE(inflate->field[0] == GZIP_ID1 && inflate->field[1] == GZIP_ID2 &&
+                                    inflate->field[2] == GZIP_CM_DEFLATE && !(inflate->field[3] & GZIP_FRESERVED),
+                                    ESP_FAIL, TAG, "Invalid gzip header");
+                inflate->flags = inflate->field[3];
+                inflate_next_header_field(inflate);
+            }
+            break;
+        case INFLATE_STATE_EXTRA_LEN:
+            inflate->field[inflate->field_len++] = byte;
+            if (inflate->field_len == 2) {
+                inflate->skip_len = inflate->field[0] | (inflate->field[1] << 8);
+                inflate->state = INFLATE_STATE_EXTRA;
+                if (inflate->skip_len == 0) {
+                    inflate_next_header_field(inflate);
+                }
+            }
+            break;
+        case INFLATE_STATE_EXTRA:
+            if (--inflate->skip_len == 0) {
+                inflate_next_header_field(inflate);
+            }
+            break;
+        case INFLATE_STATE_NAME:
+        case INFLATE_STATE_COMMENT:
+            if (byte == 0) {
+                inflate_next_header_field(inflate);
+            }
+            break;
+        case INFLATE_STATE_HEADER_CRC:
+            if (++inflate->field_len == 2) {
+                inflate_next_header_field(inflate);
+            }
+            break;
+        case INFLATE_STATE_TRAILER:
+            inflate->field[inflate->field_len++] = byte;
+            if (inflate_check_trailer(inflate) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            break;
+        default:
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+/* "deflate" is defined as the zlib format, but some servers send raw deflate data */
+static void inflate_detect_zlib(http_inflate_handle_t inflate)
+{
+    uint8_t cmf = inflate->in[inflate->in_ofs];
+    uint8_t flg = inflate->in[inflate->in_ofs + 1];
+    if ((cmf & 0x0f) == GZIP_CM_DEFLATE && (cmf >> 4) <= 7 && ((cmf << 8) | flg) % 31 == 0) {
+        inflate->decomp_flags |= TINFL_FLAG_PARSE_ZLIB_HEADER;
+    } else {
+        ESP_LOGD(TAG, "No zlib header, decoding raw deflate data");
+    }
+    inflate->state = INFLATE_STATE_DATA;
+}
+
+static esp_err_t inflate_decompress(http_inflate_handle_t inflate)
+{
+    size_t in_bytes = inflate->in_len;
+    /* The window is used as a wrapping output buffer, the output mustn't cross its end */
+    size_t out_bytes = TINFL_LZ_DICT_SIZE - inflate->window_ofs;
+    tinfl_status status = tinfl_decompress(&inflate->decomp, inflate->in + inflate->in_ofs, &in_bytes,
+                                           inflate->window, inflate->window + inflate->window_ofs, &out_bytes,
+                                           inflate->decomp_flags);
+    inflate->in_ofs += in_bytes;
+    inflate->in_len -= in_bytes;
+    inflate->has_more_output = (status == TINFL_STATUS_HAS_MORE_OUTPUT);
+    ESP_RETURN_ON_FALSE(status >= TINFL_STATUS_DONE, ESP_FAIL, TAG, "Failed to decompress, status %d", status);
+
+    inflate->out_ofs = inflate->window_ofs;
+    inflate->out_len = out_bytes;
+    inflate->window_ofs = (inflate->window_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+    if (inflate->format == HTTP_INFLATE_GZIP) {
+        inflate->crc = mz_crc32(inflate->crc, inflate->window + inflate->out_ofs, out_bytes);
+        inflate->size += out_bytes;
+    }
+    if (status == TINFL_STATUS_DONE) {
+        inflate->field_len = 0;
+        inflate->state = (inflate->format == HTTP_INFLATE_GZIP) ? INFLATE_STATE_TRAILER : INFLATE_STATE_DONE;
+        if (inflate->format == HTTP_INFLATE_GZIP) {
+            /* The ROM decompressor reads the input ahead and doesn't give back the bytes it didn't use at the end
+               of the stream, so the first bytes of the trailer may be in its bit buffer, after the padding bits */
+            tinfl_bit_buf_t bits = inflate->decomp.m_bit_buf >> (inflate->decomp.m_num_bits & 7);
+            for (uint32_t i = 0; i < inflate->decomp.m_num_bits / 8 && inflate->field_len < GZIP_TRAILER_LEN; i++) {
+                inflate->field[inflate->field_len++] = (uint8_t)bits;
+                bits >>= 8;
+            }
+            return inflate_check_trailer(inflate);
+        }
+    }
+    return ESP_OK;
+}
+
+int http_inflate_read(http_inflate_handle_t inflate, const char **data, size_t max_len)
+{
+    while (inflate->out_len == 0) {
+        esp_err_t err;
+        switch (inflate->state) {
+        case INFLATE_STATE_DATA:
+            if (inflate->in_len == 0 && !inflate->has_more_output) {
+                return 0;
+            }
+            err = inflate_decompress(inflate);
+            break;
+        case INFLATE_STATE_DONE:
+            if (inflate->in_len) {
+                ESP_LOGD(TAG, "Ignoring %zu bytes after the end of the stream", inflate->in_len);
+                inflate->in_len = 0;
+            }
+            return 0;
+        case INFLATE_STATE_ERROR:
+            return -1;
+        case INFLATE_STATE_HEADER:
+            if (inflate->format == HTTP_INFLATE_DEFLATE) {
+                if (inflate->in_len < ZLIB_HEADER_LEN) {
+                    return 0;
+                }
+                inflate_detect_zlib(inflate);
+                continue;
+            }
+        /* fall through */
+        default:
+            if (inflate->in_len == 0) {
+                return 0;
+            }
+            err = inflate_parse_gzip(inflate);
+            break;
+        }
+        if (err != ESP_OK) {
+            inflate->state = INFLATE_STATE_ERROR;
+            return -1;
+        }
+    }
+
+    size_t len = inflate->out_len < max_len ? inflate->out_len : max_len;
+    *data = (const char *)inflate->window + inflate->out_ofs;
+    inflate->out_ofs += len;
+    inflate->out_len -= len;
+    return len;
+}
+
+bool http_inflate_is_done(http_inflate_handle_t inflate)
+{
+    return inflate->state == INFLATE_STATE_DONE && inflate->out_len == 0;
+}
+
+void http_inflate_cleanup(http_inflate_handle_t inflate)
+{
+    if (inflate) {
+        free(inflate->in);
+        free(inflate->window);
+        free(inflate);
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _HTTP_INFLATE_H_
+#define _HTTP_INFLATE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct http_inflate *http_inflate_handle_t;
+
+/**
+ * Content codings which can be decoded
+ */
+typedef enum {
+    HTTP_INFLATE_GZIP,      /*!< gzip file format (RFC 1952) */
+    HTTP_INFLATE_DEFLATE,   /*!< zlib format (RFC 1950), raw deflate data (RFC 1951) is accepted as well */
+} http_inflate_format_t;
+
+/**
+ * @brief      Allocate a streaming decoder
+ *
+ * The decoder keeps the last 32 KB of output as the sliding window, so its memory use doesn't depend
+ * on the size of the decoded content.
+ *
+ * @param[in]  max_input_len  Maximum length of the input written at once with http_inflate_write()
+ *
+ * @return
+ *     - http_inflate_handle_t
+ *     - NULL if any errors
+ */
+http_inflate_handle_t http_inflate_init(size_t max_input_len);
+
+/**
+ * @brief      Prepare the decoder for a new stream
+ *
+ * @param[in]  inflate  The decoder
+ * @param[in]  format   Format of the stream
+ */
+void http_inflate_reset(http_inflate_handle_t inflate, http_inflate_format_t format);
+
+/**
+ * @brief      Write encoded data to the decoder
+ *
+ * The data is copied, so that it can be decoded by later calls of http_inflate_read().
+ * All the previously written data must have been read before, except for a few bytes of the stream header.
+ *
+ * @param[in]  inflate  The decoder
+ * @param[in]  data     The encoded data
+ * @param[in]  len      Length of the data, up to max_input_len
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_SIZE if the data doesn't fit in the input buffer
+ */
+esp_err_t http_inflate_write(http_inflate_handle_t inflate, const char *data, size_t len);
+
+/**
+ * @brief      Decode the written data
+ *
+ * @param[in]  inflate  The decoder
+ * @param[out] data     Set to the decoded data, valid until the next call of this function
+ * @param[in]  max_len  Maximum length of the decoded data to return
+ *
+ * @return
+ *     - Length of the decoded data
+ *     - 0 if all the written data was decoded
+ *     - (-1) if the stream is corrupted
+ */
+int http_inflate_read(http_inflate_handle_t inflate, const char **data, size_t max_len);
+
+/**
+ * @brief      Check whether the end of the stream was decoded
+ *
+ * @param[in]  inflate  The decoder
+ *
+ * @return
+ *     - true if the whole stream was decoded and its checksum matched
+ *     - false otherwise
+ */
+bool http_inflate_is_done(http_inflate_handle_t inflate);
+
+/**
+ * @brief      Free the decoder
+ *
+ * @param[in]  inflate  The decoder
+ */
+void http_inflate_cleanup(http_inflate_handle_t inflate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
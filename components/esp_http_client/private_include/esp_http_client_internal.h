@@ -0,0 +1,47 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "esp_http_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Make the response reads of an asynchronous client non-blocking
+ *
+ * When enabled, esp_http_client_perform() returns ESP_ERR_HTTP_EAGAIN as soon as no response
+ * data is available, instead of waiting for it up to the timeout of the client.
+ *
+ * @param[in]  client  The client handle
+ * @param[in]  enable  true to enable non-blocking reads
+ *
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_INVALID_ARG if the client is not in asynchronous mode
+ */
+esp_err_t http_client_set_nonblocking_read(esp_http_client_handle_t client, bool enable);
+
+/**
+ * @brief Get the socket of the client and whether its connection is being established
+ *
+ * @param[in]  client      The client handle
+ * @param[out] fd          Socket of the client, -1 if it has no socket yet
+ * @param[out] connecting  true if the connection is not established yet
+ */
+void http_client_get_poll_info(esp_http_client_handle_t client, int *fd, bool *connecting);
+
+/**
+ * @brief Get the network timeout of the client in milliseconds
+ */
+int http_client_get_timeout_ms(esp_http_client_handle_t client);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,16 +1,24 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
 #include <esp_system.h>
 #include <esp_http_client.h>
+#include <esp_http_client_mux.h>
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
 
 #include "unity.h"
 #include "test_utils.h"
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+#include "http_inflate.h"
+#endif
 
 #define HOST  "httpbin.org"
 #define USERNAME  "user"
@@ -146,6 +154,463 @@ TEST_CASE("esp_http_client_init() should return NULL if configured with wrong ur
     esp_http_client_cleanup(client);
 }
 
+typedef struct {
+    SemaphoreHandle_t done;
+    esp_err_t result;
+} mux_test_ctx_t;
+
+static void mux_test_done(esp_http_client_handle_t client, esp_err_t result, void *arg)
+{
+    mux_test_ctx_t *ctx = arg;
+    ctx->result = result;
+    xSemaphoreGive(ctx->done);
+}
+
+/**
+ * Test case to verify that a request submitted to the multiplexer completes with an error if the connection fails,
+ * and that only clients in asynchronous mode are accepted.
+ **/
+TEST_CASE("esp_http_client_mux reports failed requests", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    esp_http_client_mux_config_t mux_config = ESP_HTTP_CLIENT_MUX_DEFAULT_CONFIG();
+    esp_http_client_mux_handle_t mux = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_mux_create(&mux_config, &mux));
+
+    esp_http_client_config_t config = {
+        .url = "http://127.0.0.1:1/get",
+        .timeout_ms = 1000,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_http_client_mux_submit(mux, client, NULL, NULL));
+    esp_http_client_cleanup(client);
+
+    // Nothing listens on the port, so the connection is refused
+    config.is_async = true;
+    client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    mux_test_ctx_t ctx = {
+        .done = xSemaphoreCreateBinary(),
+        .result = ESP_OK,
+    };
+    TEST_ASSERT_NOT_NULL(ctx.done);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_mux_submit(mux, client, mux_test_done, &ctx));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(ctx.done, pdMS_TO_TICKS(5000)));
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, ctx.result);
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_mux_destroy(mux));
+    esp_http_client_cleanup(client);
+    vSemaphoreDelete(ctx.done);
+}
+
+/* Server task on the loopback interface, it gives done when it has served its requests */
+typedef struct {
+    int listen_fd;
+    SemaphoreHandle_t done;
+} loopback_server_t;
+
+/* Starts the server task on a free port and returns the port */
+static int loopback_server_start(loopback_server_t *server, int backlog, TaskFunction_t task, void *task_arg)
+{
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    server->done = xSemaphoreCreateBinary();
+    TEST_ASSERT_GREATER_OR_EQUAL(0, server->listen_fd);
+    TEST_ASSERT_NOT_NULL(server->done);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addr_len = sizeof(addr);
+    TEST_ASSERT_EQUAL(0, bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, getsockname(server->listen_fd, (struct sockaddr *)&addr, &addr_len));
+    TEST_ASSERT_EQUAL(0, listen(server->listen_fd, backlog));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(task, "loopback_server", 4096, task_arg, 5, NULL));
+    return ntohs(addr.sin_port);
+}
+
+static void loopback_server_stop(loopback_server_t *server)
+{
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(server->done, pdMS_TO_TICKS(5000)));
+    close(server->listen_fd);
+    vSemaphoreDelete(server->done);
+}
+
+#define MUX_TEST_REQUESTS   2
+#define MUX_TEST_BODY       "Hello from the loopback server"
+
+static void mux_test_server_task(void *arg)
+{
+    loopback_server_t *server = arg;
+    for (int i = 0; i < MUX_TEST_REQUESTS; i++) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        // Receive the whole request before responding
+        char buf[512];
+        int len = 0, ret;
+        while (len < (int)sizeof(buf) - 1 && (ret = recv(fd, buf + len, sizeof(buf) - 1 - len, 0)) > 0) {
+            len += ret;
+            buf[len] = '\0';
+            if (strstr(buf, "\r\n\r\n") != NULL) {
+                break;
+            }
+        }
+        len = snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n%s",
+                       (int)strlen(MUX_TEST_BODY), MUX_TEST_BODY);
+        send(fd, buf, len, 0);
+        close(fd);
+    }
+    xSemaphoreGive(server->done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t mux_test_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_DATA) {
+        int *received = evt->user_data;
+        *received += evt->data_len;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Test case to verify that plain HTTP requests run by the multiplexer complete successfully.
+ **/
+TEST_CASE("esp_http_client_mux completes requests", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    loopback_server_t server;
+    int port = loopback_server_start(&server, MUX_TEST_REQUESTS, mux_test_server_task, &server);
+
+    esp_http_client_mux_config_t mux_config = ESP_HTTP_CLIENT_MUX_DEFAULT_CONFIG();
+    esp_http_client_mux_handle_t mux = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_mux_create(&mux_config, &mux));
+
+    esp_http_client_handle_t clients[MUX_TEST_REQUESTS];
+    mux_test_ctx_t ctx[MUX_TEST_REQUESTS];
+    int received[MUX_TEST_REQUESTS] = { 0 };
+    char url[40];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/get", port);
+    for (int i = 0; i < MUX_TEST_REQUESTS; i++) {
+        esp_http_client_config_t config = {
+            .url = url,
+            .timeout_ms = 5000,
+            .is_async = true,
+            .event_handler = mux_test_event_handler,
+            .user_data = &received[i],
+        };
+        clients[i] = esp_http_client_init(&config);
+        TEST_ASSERT_NOT_NULL(clients[i]);
+        ctx[i].done = xSemaphoreCreateBinary();
+        ctx[i].result = ESP_FAIL;
+        TEST_ASSERT_NOT_NULL(ctx[i].done);
+        TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_mux_submit(mux, clients[i], mux_test_done, &ctx[i]));
+    }
+    for (int i = 0; i < MUX_TEST_REQUESTS; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(ctx[i].done, pdMS_TO_TICKS(10000)));
+        TEST_ASSERT_EQUAL(ESP_OK, ctx[i].result);
+        TEST_ASSERT_EQUAL(200, esp_http_client_get_status_code(clients[i]));
+        TEST_ASSERT_EQUAL(strlen(MUX_TEST_BODY), received[i]);
+    }
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_mux_destroy(mux));
+    for (int i = 0; i < MUX_TEST_REQUESTS; i++) {
+        esp_http_client_cleanup(clients[i]);
+        vSemaphoreDelete(ctx[i].done);
+    }
+    loopback_server_stop(&server);
+}
+
+#if CONFIG_ESP_HTTP_CLIENT_ENABLE_CONTENT_DECODING
+#define ENCODED_TEST_DECODED_LEN    40000
+
+/* The lowercase alphabet repeated up to ENCODED_TEST_DECODED_LEN bytes, compressed with gzip */
+static const uint8_t gzip_test_body[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0xc9,
+    0xb7, 0x01, 0x80, 0x20, 0x00, 0x00, 0xb0, 0x5b, 0xb1, 0x77, 0x11, 0xec,
+    0xd7, 0x7b, 0x88, 0xc9, 0x9a, 0x50, 0x94, 0x55, 0xdd, 0xb4, 0x5d, 0x3f,
+    0x8c, 0xd3, 0xbc, 0xac, 0x71, 0x4b, 0x79, 0x3f, 0xce, 0xeb, 0x7e, 0xde,
+    0x60, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c,
+    0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6,
+    0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63,
+    0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31,
+    0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18,
+    0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c,
+    0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6,
+    0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63,
+    0xcc, 0xef, 0xe6, 0x03, 0xb1, 0xfb, 0x88, 0x84, 0x40, 0x9c, 0x00, 0x00,
+};
+
+/* The same data in the zlib format */
+static const uint8_t zlib_test_body[] = {
+    0x78, 0xda, 0xed, 0xc9, 0xb7, 0x01, 0x80, 0x20, 0x00, 0x00, 0xb0, 0x5b,
+    0xb1, 0x77, 0x11, 0xec, 0xd7, 0x7b, 0x88, 0xc9, 0x9a, 0x50, 0x94, 0x55,
+    0xdd, 0xb4, 0x5d, 0x3f, 0x8c, 0xd3, 0xbc, 0xac, 0x71, 0x4b, 0x79, 0x3f,
+    0xce, 0xeb, 0x7e, 0xde, 0x60, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31,
+    0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18,
+    0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c,
+    0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6,
+    0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63,
+    0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31,
+    0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18,
+    0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c,
+    0x31, 0xc6, 0x18, 0x63, 0xcc, 0xef, 0xe6, 0x03, 0xa0, 0x33, 0xd8, 0xeb,
+};
+
+/* The same data as raw deflate data, without the zlib header */
+static const uint8_t deflate_test_body[] = {
+    0xed, 0xc9, 0xb7, 0x01, 0x80, 0x20, 0x00, 0x00, 0xb0, 0x5b, 0xb1, 0x77,
+    0x11, 0xec, 0xd7, 0x7b, 0x88, 0xc9, 0x9a, 0x50, 0x94, 0x55, 0xdd, 0xb4,
+    0x5d, 0x3f, 0x8c, 0xd3, 0xbc, 0xac, 0x71, 0x4b, 0x79, 0x3f, 0xce, 0xeb,
+    0x7e, 0xde, 0x60, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18,
+    0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c,
+    0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6,
+    0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63,
+    0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31,
+    0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18,
+    0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c,
+    0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6, 0x18, 0x63, 0x8c, 0x31, 0xc6,
+    0x18, 0x63, 0xcc, 0xef, 0xe6, 0x03,
+};
+
+typedef struct {
+    loopback_server_t loopback;
+    const char *encoding;
+    const uint8_t *body;
+    size_t body_len;
+    bool split;             /* send the body after the client received the headers */
+} encoded_test_server_t;
+
+static void encoded_test_server_task(void *arg)
+{
+    encoded_test_server_t *server = arg;
+    int fd = accept(server->loopback.listen_fd, NULL, NULL);
+    if (fd >= 0) {
+        char buf[512];
+        recv(fd, buf, sizeof(buf), 0);
+        int len = snprintf(buf, sizeof(buf), "HTTP/1.1 200 OK\r\nContent-Encoding: %s\r\nContent-Length: %d\r\n\r\n",
+                           server->encoding, (int)server->body_len);
+        if (server->split) {
+            send(fd, buf, len, 0);
+            // Let the client fetch the headers alone, so that the body is decoded by esp_http_client_read()
+            vTaskDelay(pdMS_TO_TICKS(100));
+            send(fd, server->body, server->body_len, 0);
+        } else if (len + server->body_len <= sizeof(buf)) {
+            // The headers and the body are received at once
+            memcpy(buf + len, server->body, server->body_len);
+            send(fd, buf, len + server->body_len, 0);
+        }
+        close(fd);
+    }
+    xSemaphoreGive(server->loopback.done);
+    vTaskDelete(NULL);
+}
+
+/* Starts a server sending one encoded response on a free port, returns the URL of the response */
+static void encoded_test_start_server(encoded_test_server_t *server, char *url, size_t url_size)
+{
+    int port = loopback_server_start(&server->loopback, 1, encoded_test_server_task, server);
+    snprintf(url, url_size, "http://127.0.0.1:%d/encoded", port);
+}
+
+static bool encoded_test_check_data(const char *data, int offset, int len)
+{
+    for (int i = 0; i < len; i++) {
+        if (data[i] != 'a' + (offset + i) % 26) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Reads an encoded response, a corrupted response must make esp_http_client_read() fail */
+static void encoded_test_read(const char *encoding, const uint8_t *body, size_t body_len, bool split, bool corrupted)
+{
+    encoded_test_server_t server = {
+        .encoding = encoding,
+        .body = body,
+        .body_len = body_len,
+        .split = split,
+    };
+    char url[48];
+    encoded_test_start_server(&server, url, sizeof(url));
+
+    esp_http_client_config_t config = {
+        .url = url,
+        .decode_content = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_open(client, 0));
+    // The content length is the length of the encoded data
+    TEST_ASSERT_EQUAL(body_len, esp_http_client_fetch_headers(client));
+    char buf[100];
+    int total = 0, len;
+    while ((len = esp_http_client_read(client, buf, sizeof(buf))) > 0) {
+        TEST_ASSERT_TRUE(encoded_test_check_data(buf, total, len));
+        total += len;
+    }
+    if (corrupted) {
+        TEST_ASSERT_LESS_THAN(0, len);
+    } else {
+        TEST_ASSERT_EQUAL(0, len);
+        TEST_ASSERT_EQUAL(ENCODED_TEST_DECODED_LEN, total);
+        TEST_ASSERT_TRUE(esp_http_client_is_complete_data_received(client));
+    }
+
+    esp_http_client_cleanup(client);
+    loopback_server_stop(&server.loopback);
+}
+
+/**
+ * Test case to verify that a gzip encoded response is decoded by esp_http_client_read(),
+ * when the decoded data is much larger than the buffer of the caller.
+ **/
+TEST_CASE("esp_http_client_read decodes gzip encoded responses", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    esp_http_client_config_t config = {
+        .url = "http://127.0.0.1/encoded",
+        .decode_content = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TEST_ASSERT_NOT_NULL(client);
+    char *value = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_get_header(client, "Accept-Encoding", &value));
+    TEST_ASSERT_EQUAL_STRING("gzip, deflate", value);
+    esp_http_client_cleanup(client);
+
+    // The body is received after the headers
+    encoded_test_read("gzip", gzip_test_body, sizeof(gzip_test_body), true, false);
+    // The body is received with the headers, esp_http_client_fetch_headers() leaves it in the decoder
+    encoded_test_read("gzip", gzip_test_body, sizeof(gzip_test_body), false, false);
+}
+
+/**
+ * Test case to verify that the gzip trailer is checked, also when the decompressor has read its first bytes ahead.
+ **/
+TEST_CASE("http_inflate checks the gzip trailer", "[ESP HTTP CLIENT]")
+{
+    const size_t chunk_sizes[] = { 1, 7, 64, sizeof(gzip_test_body) };
+    uint8_t *corrupted = malloc(sizeof(gzip_test_body));
+    TEST_ASSERT_NOT_NULL(corrupted);
+    memcpy(corrupted, gzip_test_body, sizeof(gzip_test_body));
+    // The trailer is the CRC-32 and the length of the decoded data
+    corrupted[sizeof(gzip_test_body) - 8] ^= 0x01;
+
+    http_inflate_handle_t inflate = http_inflate_init(sizeof(gzip_test_body));
+    TEST_ASSERT_NOT_NULL(inflate);
+    for (int i = 0; i < 2; i++) {
+        const uint8_t *body = i ? corrupted : gzip_test_body;
+        for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+            http_inflate_reset(inflate, HTTP_INFLATE_GZIP);
+            size_t pos = 0;
+            int total = 0, len = 0;
+            while (len >= 0) {
+                const char *data;
+                while ((len = http_inflate_read(inflate, &data, 100)) > 0) {
+                    TEST_ASSERT_TRUE(encoded_test_check_data(data, total, len));
+                    total += len;
+                }
+                if (len < 0 || pos == sizeof(gzip_test_body)) {
+                    break;
+                }
+                size_t chunk = MIN(chunk_sizes[c], sizeof(gzip_test_body) - pos);
+                TEST_ASSERT_EQUAL(ESP_OK, http_inflate_write(inflate, (const char *)body + pos, chunk));
+                pos += chunk;
+            }
+            if (body == corrupted) {
+                TEST_ASSERT_EQUAL(-1, len);
+                TEST_ASSERT_FALSE(http_inflate_is_done(inflate));
+            } else {
+                TEST_ASSERT_EQUAL(0, len);
+                TEST_ASSERT_EQUAL(ENCODED_TEST_DECODED_LEN, total);
+                TEST_ASSERT_TRUE(http_inflate_is_done(inflate));
+            }
+        }
+    }
+    http_inflate_cleanup(inflate);
+
+    // esp_http_client_read() reports the error after the decoded data
+    test_case_uses_tcpip();
+    encoded_test_read("gzip", corrupted, sizeof(gzip_test_body), true, true);
+    encoded_test_read("gzip", corrupted, sizeof(gzip_test_body), false, true);
+    free(corrupted);
+}
+
+/**
+ * Test case to verify that deflate encoded responses are decoded, in the zlib format and as raw deflate data.
+ **/
+TEST_CASE("esp_http_client_read decodes deflate encoded responses", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    encoded_test_read("deflate", zlib_test_body, sizeof(zlib_test_body), true, false);
+    encoded_test_read("deflate", zlib_test_body, sizeof(zlib_test_body), false, false);
+    encoded_test_read("deflate", deflate_test_body, sizeof(deflate_test_body), true, false);
+    encoded_test_read("deflate", deflate_test_body, sizeof(deflate_test_body), false, false);
+}
+
+typedef struct {
+    int total;
+    bool valid;
+} encoded_test_data_t;
+
+static esp_err_t encoded_test_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_DATA) {
+        encoded_test_data_t *data = evt->user_data;
+        data->valid = data->valid && encoded_test_check_data(evt->data, data->total, evt->data_len);
+        data->total += evt->data_len;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Test case to verify that esp_http_client_perform() passes the decoded response to HTTP_EVENT_ON_DATA.
+ **/
+TEST_CASE("esp_http_client_perform decodes encoded responses", "[ESP HTTP CLIENT]")
+{
+    test_case_uses_tcpip();
+
+    for (int split = 0; split < 2; split++) {
+        encoded_test_server_t server = {
+            .encoding = "gzip",
+            .body = gzip_test_body,
+            .body_len = sizeof(gzip_test_body),
+            .split = split,
+        };
+        char url[48];
+        encoded_test_start_server(&server, url, sizeof(url));
+
+        encoded_test_data_t data = {
+            .valid = true,
+        };
+        esp_http_client_config_t config = {
+            .url = url,
+            .decode_content = true,
+            .event_handler = encoded_test_event_handler,
+            .user_data = &data,
+        };
+        esp_http_client_handle_t client = esp_http_client_init(&config);
+        TEST_ASSERT_NOT_NULL(client);
+        TEST_ASSERT_EQUAL(ESP_OK, esp_http_client_perform(client));
+        TEST_ASSERT_EQUAL(200, esp_http_client_get_status_code(client));
+        TEST_ASSERT_TRUE(data.valid);
+        TEST_ASSERT_EQUAL(ENCODED_TEST_DECODED_LEN, data.total);
+
+        esp_http_client_cleanup(client);
+        loopback_server_stop(&server.loopback);
+    }
+}
+#endif
+
 void app_main(void)
 {
     unity_run_menu();
@@ -420,6 +420,20 @@ typedef struct httpd_req {
     bool ignore_sess_ctx_changes;
 } httpd_req_t;
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+/**
+ * @brief Response cache configuration of a URI handler
+ *
+ * Only complete "200 OK" responses to GET requests are cached. Entries are keyed on
+ * the full request URI (path and query) and the values of the headers listed in `key_hdrs`.
+ */
+typedef struct httpd_resp_cache_config {
+    uint32_t    ttl_ms;     /*!< Time for which a cached response is replayed, 0 disables caching */
+    size_t      max_bytes;  /*!< Maximum memory used by cached responses of this URI handler */
+    const char *key_hdrs;   /*!< Comma separated list of request headers which are part of the cache key, or NULL */
+} httpd_resp_cache_config_t;
+#endif
+
 /**
  * @brief Structure for URI handler
  */
@@ -456,6 +470,15 @@ typedef struct httpd_uri {
      */
     const char *supported_subprotocol;
 #endif
+
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    /**
+     * Response cache configuration. Leave zeroed to always invoke the handler.
+     * Handlers using this must produce the same response for the same cache key
+     * and must not rely on side effects of being called.
+     */
+    httpd_resp_cache_config_t resp_cache;
+#endif
 } httpd_uri_t;
 
 /**
@@ -542,6 +565,25 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
  */
 esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char* uri);
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+/**
+ * @brief   Invalidate cached responses
+ *
+ * @note    When called from a URI handler the entries are dropped immediately,
+ *          otherwise the invalidation is queued to the server task.
+ *
+ * @param[in] handle  Handle to server returned by httpd_start
+ * @param[in] uri     URI (as registered) whose cached responses are dropped,
+ *                    NULL to drop all cached responses
+ * @return
+ *  - ESP_OK : On successfully invalidating (or queuing the invalidation)
+ *  - ESP_ERR_INVALID_ARG : Null handle
+ *  - ESP_ERR_NO_MEM : Unable to allocate memory
+ *  - ESP_FAIL : Failed to queue the invalidation
+ */
+esp_err_t httpd_resp_cache_invalidate(httpd_handle_t handle, const char *uri);
+#endif
+
 /** End of URI Handlers
  * @}
  */
@@ -1801,6 +1843,53 @@ esp_err_t httpd_ws_send_data(httpd_handle_t handle, int socket, httpd_ws_frame_t
 esp_err_t httpd_ws_send_data_async(httpd_handle_t handle, int socket, httpd_ws_frame_t *frame,
                                    transfer_complete_cb callback, void *arg);
 
+/**
+ * @brief Filter deciding whether a websocket client receives a broadcast frame
+ *
+ * @note  Invoked from the HTTP server task for each active websocket client
+ *
+ * @param[in] hd   Server instance data
+ * @param[in] fd   Socket descriptor of the websocket client
+ * @param[in] arg  User data passed to httpd_ws_broadcast()
+ * @return
+ *  - true  : Send the frame to this client
+ *  - false : Skip this client
+ */
+typedef bool (*httpd_ws_broadcast_filter_t)(httpd_handle_t hd, int fd, void *arg);
+
+/**
+ * @brief Broadcast complete callback
+ *
+ * @param[in] err      ESP_OK if the frame was sent to all matching clients, ESP_FAIL otherwise
+ * @param[in] clients  Number of clients the frame was successfully sent to
+ * @param[in] arg      User data passed to httpd_ws_broadcast()
+ */
+typedef void (*httpd_ws_broadcast_done_cb)(esp_err_t err, size_t clients, void *arg);
+
+/**
+ * @brief Sends a websocket frame to all (or a filtered subset of) websocket clients
+ *
+ * The frame is encoded once, header and payload are copied into a single buffer which
+ * is then sent to every matching client from the HTTP server task in one pass. This is
+ * considerably cheaper than calling httpd_ws_send_data_async() for each client.
+ *
+ * @note  The payload is copied, so the frame buffer can be reused as soon as this function returns
+ *
+ * @param[in] handle      Server instance data
+ * @param[in] filter      Filter function selecting the clients, NULL to send to all websocket clients
+ * @param[in] filter_arg  User data passed to the filter function
+ * @param[in] frame       Websocket frame
+ * @param[in] callback    Callback invoked after the frame has been sent to all clients (can be NULL)
+ * @param[in] arg         User data passed to provided callback
+ * @return
+ *  - ESP_OK                    : On successfully queuing the broadcast
+ *  - ESP_FAIL                  : When the work could not be queued
+ *  - ESP_ERR_NO_MEM            : Unable to allocate memory
+ *  - ESP_ERR_INVALID_ARG       : Argument is invalid
+ */
+esp_err_t httpd_ws_broadcast(httpd_handle_t handle, httpd_ws_broadcast_filter_t filter, void *filter_arg,
+                             httpd_ws_frame_t *frame, httpd_ws_broadcast_done_cb callback, void *arg);
+
 #endif /* CONFIG_HTTPD_WS_SUPPORT */
 /** End of WebSocket related stuff
  * @}
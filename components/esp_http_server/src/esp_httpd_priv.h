@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -106,6 +106,15 @@ struct httpd_req_aux {
     bool ws_final;                                  /*!< WebSocket FIN bit (final frame or not) */
     uint8_t mask_key[4];                            /*!< WebSocket mask key for this payload */
 #endif
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    char           *cache_key;                      /*!< Response cache key of this request, NULL if not cacheable */
+    char           *cache_buf;                      /*!< Captured response bytes */
+    size_t          cache_len;                      /*!< Length of captured response */
+    size_t          cache_size;                     /*!< Allocated size of capture buffer */
+    size_t          cache_max;                      /*!< Cache budget of the URI handler */
+    bool            cache_overflow;                 /*!< Response exceeded the cache budget of the URI handler */
+    bool            cache_last_chunk;               /*!< Terminating chunk of a chunked response was sent */
+#endif
 };
 
 /**
@@ -130,6 +139,10 @@ struct httpd_data {
 
     /* Array of registered error handler functions */
     httpd_err_handler_func_t *err_handler_fns;
+
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    struct httpd_resp_cache_entry *resp_cache;  /*!< Cached responses, oldest first */
+#endif
 };
 
 /******************* Group : Session Management ********************/
@@ -398,6 +411,74 @@ esp_err_t httpd_req_handle_err(httpd_req_t *req, httpd_err_code_t error);
  * @}
  */
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+/****************** Group : Response Cache ********************/
+/** @name Response Cache
+ * Methods for caching and replaying responses of GET URI handlers
+ * @{
+ */
+
+/**
+ * @brief   Replays a cached response for the current request, if any
+ *
+ * If the URI handler is cacheable but no valid entry exists, the cache
+ * key is saved and capturing of the response sent by the handler starts.
+ *
+ * @param[in] hd   Server instance data
+ * @param[in] uri  Matched URI handler
+ *
+ * @return
+ *  - ESP_OK             : response served from the cache
+ *  - ESP_ERR_NOT_FOUND  : handler needs to be invoked
+ *  - ESP_FAIL           : failed to send the cached response
+ */
+esp_err_t httpd_resp_cache_lookup(struct httpd_data *hd, const httpd_uri_t *uri);
+
+/**
+ * @brief   Stores the captured response after the URI handler returns
+ *
+ * The response is stored only if the handler succeeded and a complete
+ * "200" response fitting the cache budget was captured. Capture buffers
+ * are released in any case.
+ *
+ * @param[in] hd           Server instance data
+ * @param[in] uri          Matched URI handler
+ * @param[in] handler_ret  Return value of the URI handler
+ */
+void httpd_resp_cache_store(struct httpd_data *hd, const httpd_uri_t *uri, esp_err_t handler_ret);
+
+/**
+ * @brief   Appends sent response data to the capture buffer of the request
+ *
+ * @param[in] ra   Auxiliary request data
+ * @param[in] buf  Data sent
+ * @param[in] len  Length of data sent
+ */
+void httpd_resp_cache_capture(struct httpd_req_aux *ra, const char *buf, size_t len);
+
+/**
+ * @brief   Stops capturing the response of the request
+ *
+ * Used when the response is completed by an asynchronous request,
+ * which is never cached.
+ *
+ * @param[in] ra   Auxiliary request data
+ */
+void httpd_resp_cache_abort(struct httpd_req_aux *ra);
+
+/**
+ * @brief   Drops cached responses of a URI handler
+ *
+ * @param[in] hd   Server instance data
+ * @param[in] uri  URI handler, NULL to drop all cached responses
+ */
+void httpd_resp_cache_drop(struct httpd_data *hd, const httpd_uri_t *uri);
+
+/** End of Group : Response Cache
+ * @}
+ */
+#endif
+
 /****************** Group : Send/Receive ********************/
 /** @name Send and Receive
  * Methods for transmitting and receiving HTTP requests and responses
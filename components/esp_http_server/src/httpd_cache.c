@@ -0,0 +1,357 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+#ifdef CONFIG_HTTPD_RESP_CACHE
+
+static const char *TAG = "httpd_cache";
+
+/* Initial size of the capture buffer, grown by doubling */
+#define HTTPD_RESP_CACHE_MIN_CAPTURE  256
+
+/* Max length of a single header name listed in key_hdrs */
+#define HTTPD_RESP_CACHE_MAX_HDR_NAME 64
+
+/**
+ * @brief A complete response (status line, headers and body) as it was sent
+ */
+struct httpd_resp_cache_entry {
+    struct httpd_resp_cache_entry *next;
+    const httpd_uri_t *uri;     /*!< URI handler which produced this response */
+    char *key;                  /*!< URI with query followed by values of key headers */
+    int64_t expiry_us;          /*!< Time after which this entry is stale */
+    size_t len;                 /*!< Length of data */
+    char data[];
+};
+
+typedef struct {
+    struct httpd_data *hd;
+    char *uri;
+} invalidate_work_t;
+
+static size_t httpd_resp_cache_entry_size(const struct httpd_resp_cache_entry *entry)
+{
+    return sizeof(*entry) + entry->len + strlen(entry->key) + 1;
+}
+
+static void httpd_resp_cache_unlink(struct httpd_resp_cache_entry **link)
+{
+    struct httpd_resp_cache_entry *entry = *link;
+    *link = entry->next;
+    free(entry->key);
+    free(entry);
+}
+
+/* Builds the cache key from the request URI and the values of key headers.
+ * Must be called before the response is started, as request headers
+ * are not available anymore afterwards */
+static char *httpd_resp_cache_make_key(httpd_req_t *req, const char *key_hdrs)
+{
+    size_t uri_len = strlen(req->uri);
+    size_t key_len = uri_len + 1;
+    char *key = malloc(key_len);
+    if (!key) {
+        return NULL;
+    }
+    memcpy(key, req->uri, key_len);
+
+    const char *p = key_hdrs;
+    while (p && *p) {
+        /* Extract next header name from the comma separated list */
+        p += strspn(p, ", ");
+        size_t name_len = strcspn(p, ", ");
+        if (name_len == 0) {
+            break;
+        }
+        if (name_len >= HTTPD_RESP_CACHE_MAX_HDR_NAME) {
+            ESP_LOGW(TAG, LOG_FMT("key header name too long"));
+            free(key);
+            return NULL;
+        }
+        char name[HTTPD_RESP_CACHE_MAX_HDR_NAME];
+        memcpy(name, p, name_len);
+        name[name_len] = '\0';
+        p += name_len;
+
+        /* Append "\n<value>" (an absent header yields an empty value) */
+        size_t val_len = httpd_req_get_hdr_value_len(req, name);
+        char *new_key = realloc(key, key_len + val_len + 1);
+        if (!new_key) {
+            free(key);
+            return NULL;
+        }
+        key = new_key;
+        key[key_len - 1] = '\n';
+        if (val_len) {
+            httpd_req_get_hdr_value_str(req, name, key + key_len, val_len + 1);
+        } else {
+            key[key_len] = '\0';
+        }
+        key_len += val_len + 1;
+    }
+    return key;
+}
+
+static esp_err_t httpd_resp_cache_send(httpd_req_t *req, const char *buf, size_t len)
+{
+    while (len > 0) {
+        int ret = httpd_send(req, buf, len);
+        if (ret < 0) {
+            return ESP_FAIL;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_cache_lookup(struct httpd_data *hd, const httpd_uri_t *uri)
+{
+    httpd_req_t *req = &hd->hd_req;
+    struct httpd_req_aux *ra = req->aux;
+
+    if (req->method != HTTP_GET || uri->resp_cache.ttl_ms == 0 || uri->resp_cache.max_bytes == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (uri->is_websocket) {
+        return ESP_ERR_NOT_FOUND;
+    }
+#endif
+
+    char *key = httpd_resp_cache_make_key(req, uri->resp_cache.key_hdrs);
+    if (!key) {
+        /* Not cacheable, serve the request normally */
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    int64_t now = httpd_os_get_time_us();
+    struct httpd_resp_cache_entry **link = &hd->resp_cache;
+    while (*link) {
+        struct httpd_resp_cache_entry *entry = *link;
+        if (entry->uri == uri && strcmp(entry->key, key) == 0) {
+            if (entry->expiry_us <= now) {
+                ESP_LOGD(TAG, LOG_FMT("stale entry for %s"), req->uri);
+                httpd_resp_cache_unlink(link);
+                break;
+            }
+            ESP_LOGD(TAG, LOG_FMT("replaying %"NEWLIB_NANO_COMPAT_FORMAT" bytes for %s"),
+                     NEWLIB_NANO_COMPAT_CAST(entry->len), req->uri);
+            free(key);
+            /* Request headers are no longer available, same as after httpd_resp_send() */
+            ra->req_hdrs_count = 0;
+            return httpd_resp_cache_send(req, entry->data, entry->len);
+        }
+        link = &entry->next;
+    }
+
+    /* Miss, capture what the handler sends */
+    ra->cache_key = key;
+    ra->cache_buf = NULL;
+    ra->cache_len = 0;
+    ra->cache_size = 0;
+    ra->cache_max = uri->resp_cache.max_bytes;
+    ra->cache_overflow = false;
+    ra->cache_last_chunk = false;
+    return ESP_ERR_NOT_FOUND;
+}
+
+void httpd_resp_cache_capture(struct httpd_req_aux *ra, const char *buf, size_t len)
+{
+    if (!ra->cache_key || ra->cache_overflow || len == 0) {
+        return;
+    }
+
+    if (ra->cache_len + len > ra->cache_max) {
+        /* Will never fit, stop capturing */
+        free(ra->cache_buf);
+        ra->cache_buf = NULL;
+        ra->cache_len = 0;
+        ra->cache_size = 0;
+        ra->cache_overflow = true;
+        return;
+    }
+
+    if (ra->cache_len + len > ra->cache_size) {
+        size_t new_size = ra->cache_size ? ra->cache_size : HTTPD_RESP_CACHE_MIN_CAPTURE;
+        while (new_size < ra->cache_len + len) {
+            new_size *= 2;
+        }
+        new_size = MIN(new_size, ra->cache_max);
+        char *new_buf = realloc(ra->cache_buf, new_size);
+        if (!new_buf) {
+            ra->cache_overflow = true;
+            return;
+        }
+        ra->cache_buf = new_buf;
+        ra->cache_size = new_size;
+    }
+    memcpy(ra->cache_buf + ra->cache_len, buf, len);
+    ra->cache_len += len;
+}
+
+void httpd_resp_cache_abort(struct httpd_req_aux *ra)
+{
+    /* The key is kept, it's released by httpd_resp_cache_store() when the handler returns */
+    free(ra->cache_buf);
+    ra->cache_buf = NULL;
+    ra->cache_len = 0;
+    ra->cache_size = 0;
+    ra->cache_overflow = true;
+}
+
+void httpd_resp_cache_store(struct httpd_data *hd, const httpd_uri_t *uri, esp_err_t handler_ret)
+{
+    struct httpd_req_aux *ra = &hd->hd_req_aux;
+    if (!ra->cache_key) {
+        return;
+    }
+
+    char *key = ra->cache_key;
+    char *buf = ra->cache_buf;
+    size_t len = ra->cache_len;
+    ra->cache_key = NULL;
+    ra->cache_buf = NULL;
+    ra->cache_len = 0;
+    ra->cache_size = 0;
+
+    /* Only complete and successful responses are worth replaying; responses
+     * completed asynchronously are never captured in full */
+    bool complete = len > 0 && (!ra->first_chunk_sent || ra->cache_last_chunk);
+    size_t entry_size = sizeof(struct httpd_resp_cache_entry) + len + strlen(key) + 1;
+    if (handler_ret != ESP_OK || ra->cache_overflow || !complete || ra->sd->for_async_req ||
+            strncmp(ra->status, "200", 3) != 0 || entry_size > uri->resp_cache.max_bytes) {
+        free(buf);
+        free(key);
+        return;
+    }
+
+    struct httpd_resp_cache_entry *entry = malloc(sizeof(struct httpd_resp_cache_entry) + len);
+    if (!entry) {
+        free(buf);
+        free(key);
+        return;
+    }
+    entry->next = NULL;
+    entry->uri = uri;
+    entry->key = key;
+    entry->expiry_us = httpd_os_get_time_us() + (int64_t)uri->resp_cache.ttl_ms * 1000;
+    entry->len = len;
+    memcpy(entry->data, buf, len);
+    free(buf);
+
+    /* Make room within the budget of this URI handler, dropping stale
+     * entries first and then the oldest ones */
+    size_t used = 0;
+    int64_t now = httpd_os_get_time_us();
+    struct httpd_resp_cache_entry **link = &hd->resp_cache;
+    while (*link) {
+        if ((*link)->uri == uri && (*link)->expiry_us <= now) {
+            httpd_resp_cache_unlink(link);
+            continue;
+        }
+        if ((*link)->uri == uri) {
+            used += httpd_resp_cache_entry_size(*link);
+        }
+        link = &(*link)->next;
+    }
+    link = &hd->resp_cache;
+    while (*link && used + entry_size > uri->resp_cache.max_bytes) {
+        if ((*link)->uri == uri) {
+            used -= httpd_resp_cache_entry_size(*link);
+            httpd_resp_cache_unlink(link);
+            continue;
+        }
+        link = &(*link)->next;
+    }
+
+    /* Append, keeping the list ordered oldest first */
+    link = &hd->resp_cache;
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = entry;
+    ESP_LOGD(TAG, LOG_FMT("cached %"NEWLIB_NANO_COMPAT_FORMAT" bytes for %s"),
+             NEWLIB_NANO_COMPAT_CAST(len), hd->hd_req.uri);
+}
+
+void httpd_resp_cache_drop(struct httpd_data *hd, const httpd_uri_t *uri)
+{
+    struct httpd_resp_cache_entry **link = &hd->resp_cache;
+    while (*link) {
+        if (!uri || (*link)->uri == uri) {
+            httpd_resp_cache_unlink(link);
+        } else {
+            link = &(*link)->next;
+        }
+    }
+}
+
+static void httpd_resp_cache_drop_by_name(struct httpd_data *hd, const char *uri)
+{
+    struct httpd_resp_cache_entry **link = &hd->resp_cache;
+    while (*link) {
+        if (!uri || strcmp((*link)->uri->uri, uri) == 0) {
+            httpd_resp_cache_unlink(link);
+        } else {
+            link = &(*link)->next;
+        }
+    }
+}
+
+static void httpd_resp_cache_invalidate_cb(void *arg)
+{
+    invalidate_work_t *work = arg;
+    httpd_resp_cache_drop_by_name(work->hd, work->uri);
+    free(work->uri);
+    free(work);
+}
+
+esp_err_t httpd_resp_cache_invalidate(httpd_handle_t handle, const char *uri)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+
+    /* The cache is only ever touched from the server task */
+    if (httpd_os_thread_handle() == hd->hd_td.handle) {
+        httpd_resp_cache_drop_by_name(hd, uri);
+        return ESP_OK;
+    }
+
+    invalidate_work_t *work = calloc(1, sizeof(invalidate_work_t));
+    if (!work) {
+        return ESP_ERR_NO_MEM;
+    }
+    work->hd = hd;
+    if (uri) {
+        work->uri = strdup(uri);
+        if (!work->uri) {
+            free(work);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_err_t err = httpd_queue_work(handle, httpd_resp_cache_invalidate_cb, work);
+    if (err != ESP_OK) {
+        free(work->uri);
+        free(work);
+        return err;
+    }
+    return ESP_OK;
+}
+
+#endif /* CONFIG_HTTPD_RESP_CACHE */
@@ -692,6 +692,9 @@ static void init_req_aux(struct httpd_req_aux *ra, httpd_config_t *config)
     ra->resp_hdrs_count = 0;
 #if CONFIG_HTTPD_WS_SUPPORT
     ra->ws_handshake_detect = false;
+#endif
+#if CONFIG_HTTPD_RESP_CACHE
+    ra->cache_key = NULL;
 #endif
     memset(ra->resp_hdrs, 0, config->max_resp_headers * sizeof(struct resp_hdr));
 }
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -61,6 +61,9 @@ int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
         ESP_LOGD(TAG, LOG_FMT("error in send_fn"));
         return ret;
     }
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    httpd_resp_cache_capture(ra, buf, ret);
+#endif
     return ret;
 }
 
@@ -76,6 +79,9 @@ static esp_err_t httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
             return ESP_FAIL;
         }
         ESP_LOGD(TAG, LOG_FMT("sent = %d"), ret);
+#ifdef CONFIG_HTTPD_RESP_CACHE
+        httpd_resp_cache_capture(ra, buf, ret);
+#endif
         buf     += ret;
         buf_len -= ret;
     }
@@ -376,6 +382,9 @@ esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len
     if (httpd_send_all(r, "\r\n", strlen("\r\n")) != ESP_OK) {
         return ESP_ERR_HTTPD_RESP_SEND;
     }
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    ra->cache_last_chunk = (buf_len == 0);
+#endif
     esp_http_server_event_data evt_data = {
         .fd = ra->sd->fd,
         .data_len = buf_len,
@@ -618,6 +627,17 @@ esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out)
     struct httpd_req_aux *ra = r->aux;
     ra->sd->for_async_req = true;
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    // the response is completed asynchronously, so it is not cached: the capture
+    // buffers stay with the original request and the copy doesn't capture
+    httpd_resp_cache_abort(ra);
+    struct httpd_req_aux *async_ra = async->aux;
+    async_ra->cache_key = NULL;
+    async_ra->cache_buf = NULL;
+    async_ra->cache_len = 0;
+    async_ra->cache_size = 0;
+#endif
+
     *out = async;
 
     return ESP_OK;
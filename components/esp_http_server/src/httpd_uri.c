@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -172,6 +172,22 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
             } else {
                 hd->hd_calls[i]->supported_subprotocol = NULL;
             }
+#endif
+#ifdef CONFIG_HTTPD_RESP_CACHE
+            hd->hd_calls[i]->resp_cache = uri_handler->resp_cache;
+            if (uri_handler->resp_cache.key_hdrs) {
+                hd->hd_calls[i]->resp_cache.key_hdrs = strdup(uri_handler->resp_cache.key_hdrs);
+                if (hd->hd_calls[i]->resp_cache.key_hdrs == NULL) {
+                    /* Failed to allocate memory */
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+                    free((char *)hd->hd_calls[i]->supported_subprotocol);
+#endif
+                    free((char *)hd->hd_calls[i]->uri);
+                    free(hd->hd_calls[i]);
+                    hd->hd_calls[i] = NULL;
+                    return ESP_ERR_HTTPD_ALLOC_MEM;
+                }
+            }
 #endif
             ESP_LOGD(TAG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
             return ESP_OK;
@@ -198,6 +214,10 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
             (strcmp(hd->hd_calls[i]->uri, uri) == 0)) {  // Then match URI string
             ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, hd->hd_calls[i]->uri);
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+            httpd_resp_cache_drop(hd, hd->hd_calls[i]);
+            free((char*)hd->hd_calls[i]->resp_cache.key_hdrs);
+#endif
             free((char*)hd->hd_calls[i]->uri);
             free(hd->hd_calls[i]);
             hd->hd_calls[i] = NULL;
@@ -236,6 +256,10 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
         if (strcmp(hd->hd_calls[i]->uri, uri) == 0) {   // Match URI strings
             ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, uri);
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+            httpd_resp_cache_drop(hd, hd->hd_calls[i]);
+            free((char*)hd->hd_calls[i]->resp_cache.key_hdrs);
+#endif
             free((char*)hd->hd_calls[i]->uri);
             free(hd->hd_calls[i]);
             hd->hd_calls[i] = NULL;
@@ -267,6 +291,10 @@ void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
         }
         ESP_LOGD(TAG, LOG_FMT("[%d] removing %s"), i, hd->hd_calls[i]->uri);
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+        httpd_resp_cache_drop(hd, hd->hd_calls[i]);
+        free((char*)hd->hd_calls[i]->resp_cache.key_hdrs);
+#endif
         free((char*)hd->hd_calls[i]->uri);
         free(hd->hd_calls[i]);
         hd->hd_calls[i] = NULL;
@@ -325,8 +353,24 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     }
 #endif
 
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    /* Replay a cached response if there is one */
+    esp_err_t cache_ret = httpd_resp_cache_lookup(hd, uri);
+    if (cache_ret != ESP_ERR_NOT_FOUND) {
+        if (cache_ret != ESP_OK) {
+            ESP_LOGW(TAG, LOG_FMT("failed to send cached response"));
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+#endif
+
     /* Invoke handler */
-    if (uri->handler(req) != ESP_OK) {
+    esp_err_t handler_ret = uri->handler(req);
+#ifdef CONFIG_HTTPD_RESP_CACHE
+    httpd_resp_cache_store(hd, uri, handler_ret);
+#endif
+    if (handler_ret != ESP_OK) {
         /* Handler returns error, this socket should be closed */
         ESP_LOGW(TAG, LOG_FMT("uri handler execution failed"));
         return ESP_FAIL;
@@ -45,6 +45,12 @@ static const char *TAG="httpd_ws";
 #define HTTPD_WS_MASK_BIT       0x80U
 #define HTTPD_WS_LENGTH_BITS    0x7fU
 
+/*
+ * Server to client frames are never masked, so the header is at most
+ * 2 bytes of flags and length plus 8 bytes of extended length.
+ */
+#define HTTPD_WS_MAX_HEADER_LEN 10
+
 /*
  * The magic GUID string used for handshake
  * Please refer to RFC6455 Section 1.3 for more details.
@@ -372,16 +378,17 @@ esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame)
     return httpd_ws_send_frame_async(req->handle, httpd_req_to_sockfd(req), frame);
 }
 
-esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+/**
+ * @brief Encodes the header of an outgoing (unmasked) WebSocket frame
+ *
+ * @param[in]  frame      WebSocket frame to be sent
+ * @param[out] header_buf Buffer of at least HTTPD_WS_MAX_HEADER_LEN bytes
+ * @return Length of the encoded header
+ */
+static size_t httpd_ws_encode_header(const httpd_ws_frame_t *frame, uint8_t *header_buf)
 {
-    if (!frame) {
-        ESP_LOGW(TAG, LOG_FMT("Argument is invalid"));
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    /* Prepare Tx buffer - maximum length is 14, which includes 2 bytes header, 8 bytes length, 4 bytes mask key */
-    uint8_t tx_len = 0;
-    uint8_t header_buf[10] = {0 };
+    size_t tx_len = 0;
+    memset(header_buf, 0, HTTPD_WS_MAX_HEADER_LEN);
     /* Set the `FIN` bit by default if message is not fragmented. Else, set it as per the `final` field */
     header_buf[0] |= (!frame->fragmented) ? HTTPD_WS_FIN_BIT : (frame->final? HTTPD_WS_FIN_BIT: HTTPD_WS_CONTINUE);
     header_buf[0] |= frame->type; /* Type (opcode): 4 bits */
@@ -410,6 +417,20 @@ esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t
     /* WebSocket server does not required to mask response payload, so leave the MASK bit as 0. */
     header_buf[1] &= (~HTTPD_WS_MASK_BIT);
 
+    return tx_len;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t *frame)
+{
+    if (!frame) {
+        ESP_LOGW(TAG, LOG_FMT("Argument is invalid"));
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Prepare Tx buffer - maximum length is 10, which includes 2 bytes header and 8 bytes length */
+    uint8_t header_buf[HTTPD_WS_MAX_HEADER_LEN];
+    size_t tx_len = httpd_ws_encode_header(frame, header_buf);
+
     struct sock_db *sess = httpd_sess_get(hd, fd);
     if (!sess) {
         return ESP_ERR_INVALID_ARG;
@@ -600,4 +621,101 @@ esp_err_t httpd_ws_send_data_async(httpd_handle_t handle, int socket, httpd_ws_f
     return ESP_OK;
 }
 
+typedef struct {
+    httpd_handle_t handle;
+    httpd_ws_broadcast_filter_t filter;
+    void *filter_arg;
+    httpd_ws_broadcast_done_cb callback;
+    void *arg;
+    size_t len;
+    uint8_t data[];     /* Encoded header immediately followed by the payload */
+} broadcast_transfer_t;
+
+static esp_err_t httpd_ws_send_encoded(struct sock_db *sess, const uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        int ret = sess->send_fn(sess->handle, sess->fd, (const char *)buf, len, 0);
+        /* Nothing sent is a failure too, retrying would never end on a stalled socket */
+        if (ret <= 0) {
+            return ESP_FAIL;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return ESP_OK;
+}
+
+static void httpd_ws_broadcast_cb(void *arg)
+{
+    broadcast_transfer_t *trans = arg;
+    struct httpd_data *hd = (struct httpd_data *) trans->handle;
+    size_t sent = 0;
+    size_t failed = 0;
+
+    /* Single pass over the session table from the server task, every
+     * matching client gets the very same pre-encoded buffer */
+    for (int i = 0; i < hd->config.max_open_sockets; i++) {
+        struct sock_db *sess = &hd->hd_sd[i];
+        if (sess->fd == -1 || !sess->ws_handshake_done || sess->ws_close) {
+            continue;
+        }
+        if (trans->filter && !trans->filter(trans->handle, sess->fd, trans->filter_arg)) {
+            continue;
+        }
+        if (httpd_ws_send_encoded(sess, trans->data, trans->len) != ESP_OK) {
+            ESP_LOGW(TAG, LOG_FMT("Failed to send WS frame to fd %d"), sess->fd);
+            failed++;
+        } else {
+            sent++;
+        }
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("Broadcast %"NEWLIB_NANO_COMPAT_FORMAT" bytes to %"NEWLIB_NANO_COMPAT_FORMAT" clients (%"NEWLIB_NANO_COMPAT_FORMAT" failed)"),
+             NEWLIB_NANO_COMPAT_CAST(trans->len), NEWLIB_NANO_COMPAT_CAST(sent), NEWLIB_NANO_COMPAT_CAST(failed));
+
+    if (trans->callback) {
+        trans->callback(failed ? ESP_FAIL : ESP_OK, sent, trans->arg);
+    }
+
+    free(trans);
+}
+
+esp_err_t httpd_ws_broadcast(httpd_handle_t handle, httpd_ws_broadcast_filter_t filter, void *filter_arg,
+                             httpd_ws_frame_t *frame, httpd_ws_broadcast_done_cb callback, void *arg)
+{
+    if (!handle || !frame || (frame->len > 0 && frame->payload == NULL)) {
+        ESP_LOGW(TAG, LOG_FMT("Argument is invalid"));
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t header_buf[HTTPD_WS_MAX_HEADER_LEN];
+    size_t header_len = httpd_ws_encode_header(frame, header_buf);
+
+    /* Encode the frame once, header and payload in one contiguous buffer,
+     * so that each client costs a single send and no per-client allocation */
+    broadcast_transfer_t *transfer = malloc(sizeof(broadcast_transfer_t) + header_len + frame->len);
+    if (transfer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    transfer->handle = handle;
+    transfer->filter = filter;
+    transfer->filter_arg = filter_arg;
+    transfer->callback = callback;
+    transfer->arg = arg;
+    transfer->len = header_len + frame->len;
+    memcpy(transfer->data, header_buf, header_len);
+    if (frame->len > 0) {
+        memcpy(transfer->data + header_len, frame->payload, frame->len);
+    }
+
+    esp_err_t err = httpd_queue_work(handle, httpd_ws_broadcast_cb, transfer);
+    if (err != ESP_OK) {
+        free(transfer);
+        return err;
+    }
+
+    return ESP_OK;
+}
+
 #endif /* CONFIG_HTTPD_WS_SUPPORT */
@@ -50,6 +50,11 @@ static inline othread_t httpd_os_thread_handle(void)
     return xTaskGetCurrentTaskHandle();
 }
 
+static inline int64_t httpd_os_get_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <pthread.h>
+#include <time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,6 +51,13 @@ static inline othread_t httpd_os_thread_handle(void)
     return (othread_t)pthread_self();
 }
 
+static inline int64_t httpd_os_get_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 #ifdef __cplusplus
 }
 #endif
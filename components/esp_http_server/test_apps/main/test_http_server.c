@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2018-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -8,6 +8,8 @@
 #include <stdbool.h>
 #include <esp_system.h>
 #include <esp_http_server.h>
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
 
 #include "unity.h"
 #include "test_utils.h"
@@ -244,6 +246,235 @@ TEST_CASE("Max Allowed Sockets Test", "[HTTP SERVER]")
     TEST_ASSERT(httpd_start(&hd, &config) != ESP_OK);
 }
 
+/********************* Loopback client helpers *******************/
+
+static int test_client_connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+    struct timeval timeout = { .tv_sec = 2 };
+    TEST_ASSERT_EQUAL(0, setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+    return fd;
+}
+
+static void test_client_send(int fd, const char *data)
+{
+    TEST_ASSERT_EQUAL(strlen(data), send(fd, data, strlen(data), 0));
+}
+
+/* Receives into buf until it contains `end`, returns the received length */
+static int test_client_recv_until(int fd, char *buf, size_t size, const char *end)
+{
+    size_t len = 0;
+    buf[0] = '\0';
+    while (strstr(buf, end) == NULL) {
+        TEST_ASSERT_LESS_THAN(size - 1, len);
+        int ret = recv(fd, buf + len, size - 1 - len, 0);
+        TEST_ASSERT_GREATER_THAN(0, ret);
+        len += ret;
+        buf[len] = '\0';
+    }
+    return len;
+}
+
+/* Receives exactly len bytes */
+static void test_client_recv_len(int fd, uint8_t *buf, size_t len)
+{
+    while (len > 0) {
+        int ret = recv(fd, buf, len, 0);
+        TEST_ASSERT_GREATER_THAN(0, ret);
+        buf += ret;
+        len -= ret;
+    }
+}
+
+#if CONFIG_HTTPD_WS_SUPPORT
+static SemaphoreHandle_t s_broadcast_done;
+static esp_err_t s_broadcast_err;
+static size_t s_broadcast_clients;
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    // Only the handshake is expected, the clients don't send frames
+    return req->method == HTTP_GET ? ESP_OK : ESP_FAIL;
+}
+
+static void broadcast_done(esp_err_t err, size_t clients, void *arg)
+{
+    s_broadcast_err = err;
+    s_broadcast_clients = clients;
+    xSemaphoreGive(s_broadcast_done);
+}
+
+static bool broadcast_filter_none(httpd_handle_t hd, int fd, void *arg)
+{
+    return false;
+}
+
+static int ws_client_connect(uint16_t port)
+{
+    char buf[256];
+    int fd = test_client_connect(port);
+    test_client_send(fd, "GET /ws HTTP/1.1\r\n"
+                     "Host: 127.0.0.1\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                     "Sec-WebSocket-Version: 13\r\n\r\n");
+    test_client_recv_until(fd, buf, sizeof(buf), "\r\n\r\n");
+    TEST_ASSERT_NOT_NULL(strstr(buf, "101 Switching Protocols"));
+    return fd;
+}
+
+TEST_CASE("Websocket broadcast Test", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    httpd_uri_t ws = {
+        .uri = "/ws",
+        .method = HTTP_GET,
+        .handler = ws_handler,
+        .is_websocket = true,
+    };
+    TEST_ASSERT(httpd_register_uri_handler(hd, &ws) == ESP_OK);
+    s_broadcast_done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(s_broadcast_done);
+
+    int fds[2];
+    for (int i = 0; i < 2; i++) {
+        fds[i] = ws_client_connect(config.server_port);
+    }
+
+    /* Payload longer than 125 bytes, so that the 16 bit extended length is used */
+    uint8_t payload[200];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = i;
+    }
+    httpd_ws_frame_t frame = {
+        .type = HTTPD_WS_TYPE_BINARY,
+        .payload = payload,
+        .len = sizeof(payload),
+    };
+    TEST_ASSERT(httpd_ws_broadcast(hd, NULL, NULL, &frame, broadcast_done, NULL) == ESP_OK);
+    /* The payload is copied */
+    memset(payload, 0xff, sizeof(payload));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(s_broadcast_done, pdMS_TO_TICKS(2000)));
+    TEST_ASSERT_EQUAL(ESP_OK, s_broadcast_err);
+    TEST_ASSERT_EQUAL(2, s_broadcast_clients);
+
+    for (int i = 0; i < 2; i++) {
+        uint8_t rx[4 + sizeof(payload)];
+        test_client_recv_len(fds[i], rx, sizeof(rx));
+        TEST_ASSERT_EQUAL_HEX8(0x80 | HTTPD_WS_TYPE_BINARY, rx[0]);
+        TEST_ASSERT_EQUAL_HEX8(126, rx[1]);
+        TEST_ASSERT_EQUAL(sizeof(payload), (rx[2] << 8) | rx[3]);
+        for (size_t j = 0; j < sizeof(payload); j++) {
+            TEST_ASSERT_EQUAL_HEX8(j, rx[4 + j]);
+        }
+    }
+
+    /* Clients rejected by the filter don't receive the frame */
+    TEST_ASSERT(httpd_ws_broadcast(hd, broadcast_filter_none, NULL, &frame, broadcast_done, NULL) == ESP_OK);
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(s_broadcast_done, pdMS_TO_TICKS(2000)));
+    TEST_ASSERT_EQUAL(ESP_OK, s_broadcast_err);
+    TEST_ASSERT_EQUAL(0, s_broadcast_clients);
+
+    for (int i = 0; i < 2; i++) {
+        close(fds[i]);
+    }
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+    vSemaphoreDelete(s_broadcast_done);
+}
+#endif
+
+#if CONFIG_HTTPD_RESP_CACHE
+static int s_cached_calls;
+
+static esp_err_t cached_handler(httpd_req_t *req)
+{
+    s_cached_calls++;
+    return httpd_resp_sendstr(req, "cached body");
+}
+
+static esp_err_t async_cached_handler(httpd_req_t *req)
+{
+    s_cached_calls++;
+    /* Part of the response is sent before the request goes asynchronous */
+    TEST_ASSERT(httpd_resp_sendstr_chunk(req, "before async,") == ESP_OK);
+    httpd_req_t *async = NULL;
+    TEST_ASSERT(httpd_req_async_handler_begin(req, &async) == ESP_OK);
+    TEST_ASSERT(httpd_resp_sendstr_chunk(async, "after async") == ESP_OK);
+    TEST_ASSERT(httpd_resp_sendstr_chunk(async, NULL) == ESP_OK);
+    TEST_ASSERT(httpd_req_async_handler_complete(async) == ESP_OK);
+    return ESP_OK;
+}
+
+static void cache_test_get(int fd, const char *uri, const char *end)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf), "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", uri);
+    test_client_send(fd, buf);
+    test_client_recv_until(fd, buf, sizeof(buf), end);
+    TEST_ASSERT_NOT_NULL(strstr(buf, "200 OK"));
+}
+
+TEST_CASE("Response cache Test", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    TEST_ASSERT(httpd_start(&hd, &config) == ESP_OK);
+    httpd_uri_t uris[] = {
+        {
+            .uri = "/cached",
+            .method = HTTP_GET,
+            .handler = cached_handler,
+            .resp_cache = { .ttl_ms = 60000, .max_bytes = 1024 },
+        },
+        {
+            .uri = "/async",
+            .method = HTTP_GET,
+            .handler = async_cached_handler,
+            .resp_cache = { .ttl_ms = 60000, .max_bytes = 1024 },
+        },
+    };
+    for (size_t i = 0; i < sizeof(uris) / sizeof(uris[0]); i++) {
+        TEST_ASSERT(httpd_register_uri_handler(hd, &uris[i]) == ESP_OK);
+    }
+    int fd = test_client_connect(config.server_port);
+
+    /* The second request is replayed from the cache */
+    s_cached_calls = 0;
+    cache_test_get(fd, "/cached", "\r\n\r\ncached body");
+    cache_test_get(fd, "/cached", "\r\n\r\ncached body");
+    TEST_ASSERT_EQUAL(1, s_cached_calls);
+
+    /* The handler is invoked again once the entry is invalidated */
+    TEST_ASSERT(httpd_resp_cache_invalidate(hd, "/cached") == ESP_OK);
+    cache_test_get(fd, "/cached", "\r\n\r\ncached body");
+    TEST_ASSERT_EQUAL(2, s_cached_calls);
+
+    /* Responses completed asynchronously are never cached */
+    s_cached_calls = 0;
+    cache_test_get(fd, "/async", "after async\r\n0\r\n\r\n");
+    cache_test_get(fd, "/async", "after async\r\n0\r\n\r\n");
+    TEST_ASSERT_EQUAL(2, s_cached_calls);
+
+    close(fd);
+    TEST_ASSERT(httpd_stop(hd) == ESP_OK);
+}
+#endif
+
 void app_main(void)
 {
     unity_run_menu();
@@ -200,6 +200,8 @@ typedef struct esp_netif_inherent_config {
                                           A higher value of route_prio indicates
                                           a higher priority */
     bridgeif_config_t *bridge_info;  /*!< LwIP bridge configuration */
+    int rx_pbuf_pool_size;           /*!< Number of pooled RX pbuf wrappers (lwIP only), 0 to use
+                                          CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE, negative to disable the pool */
 } esp_netif_inherent_config_t;
 
 typedef struct esp_netif_config esp_netif_config_t;
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -34,9 +34,30 @@ typedef enum {
     L2TAP_S_INTF_DEVICE,
     L2TAP_G_INTF_DEVICE,
     L2TAP_S_DEVICE_DRV_HNDL,
-    L2TAP_G_DEVICE_DRV_HNDL
+    L2TAP_G_DEVICE_DRV_HNDL,
+    L2TAP_G_RX_BATCH,
+    L2TAP_S_RX_RELEASE,
+    L2TAP_S_TX_BATCH
 } l2tap_ioctl_opt_t;
 
+/**
+ * @brief Frame passed between the application and the L2 TAP without copying
+ *
+ */
+typedef struct {
+    void *buff; /*!< frame starting with the Ethernet header */
+    size_t len; /*!< length of the frame */
+} l2tap_frame_t;
+
+/**
+ * @brief Batch of frames, argument of L2TAP_G_RX_BATCH, L2TAP_S_RX_RELEASE and L2TAP_S_TX_BATCH ioctl options
+ *
+ */
+typedef struct {
+    l2tap_frame_t *frames;  /*!< array of frames */
+    size_t count;           /*!< input: number of entries of frames array, output: number of frames received or transmitted */
+} l2tap_frame_batch_t;
+
 /**
  * @brief Add L2 TAP virtual filesystem driver
  *
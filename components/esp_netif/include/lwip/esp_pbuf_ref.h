@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 #include "lwip/pbuf.h"
 #include "esp_netif.h"
 
@@ -17,13 +18,38 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Statistics of the pool of custom pbufs of an interface
+ */
+typedef struct {
+    uint32_t size;          /*!< Number of pbufs in the pool, 0 if the interface has no pool */
+    uint32_t allocated;     /*!< Pbufs taken from the pool */
+    uint32_t fallbacks;     /*!< Pbufs allocated from the lwIP heap because the pool was empty */
+    uint32_t exhausted;     /*!< Frames dropped because the pool was empty and the heap allocation failed */
+} esp_pbuf_pool_stats_t;
+
 /**
  * @brief Allocate custom pbuf containing pointer to a private l2-free function
  *
+ * The pbuf is taken from the pool of the interface (see rx_pbuf_pool_size of esp_netif_inherent_config_t
+ * and CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE)
+ * or allocated from the lwIP heap if the pool is empty or disabled.
+ *
  * @note pbuf_free() will deallocate this custom pbuf and call the driver assigned free function
  */
 struct pbuf* esp_pbuf_allocate(esp_netif_t *esp_netif, void *buffer, size_t len, void *l2_buff);
 
+/**
+ * @brief Get statistics of the pool of custom pbufs of an interface
+ *
+ * @param esp_netif esp-netif handle
+ * @param[out] stats statistics since the interface was created
+ * @return
+ *         - ESP_OK on success
+ *         - ESP_ERR_INVALID_ARG if esp_netif or stats is NULL
+ */
+esp_err_t esp_pbuf_pool_get_stats(esp_netif_t *esp_netif, esp_pbuf_pool_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
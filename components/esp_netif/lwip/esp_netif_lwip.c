@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2019-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2019-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -30,6 +30,8 @@
 #include "lwip/priv/tcpip_priv.h"
 #include "lwip/netif.h"
 #include "lwip/etharp.h"
+#include "lwip/ip.h"
+#include "netif/ethernet.h"
 #if CONFIG_ESP_NETIF_BRIDGE_EN
 #include "netif/bridgeif.h"
 #endif // CONFIG_ESP_NETIF_BRIDGE_EN
@@ -67,6 +69,15 @@
  */
 #define _RUN_IN_LWIP_TASK(function, netif, param) { return esp_netif_lwip_ipc_call(function, netif, (void *)(param)); }
 
+/**
+ * @brief Input function of lwip netif, batching frames to the tcpip thread if enabled
+ */
+#if CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
+#define ESP_NETIF_LWIP_INPUT_FN(esp_netif) ((esp_netif)->rx_batch ? esp_netif_rx_batch_input : tcpip_input)
+#else
+#define ESP_NETIF_LWIP_INPUT_FN(esp_netif) tcpip_input
+#endif
+
 /**
  * @brief macros to check netif related data to evaluate interface type
  */
@@ -146,8 +157,61 @@ static void netif_unset_mldv6_flag(struct netif *netif);
 
 static esp_err_t esp_netif_destroy_api(esp_netif_api_msg_t *msg);
 
+/**
+ * @brief Publishes the state read by esp_netif_get_ip_info() and esp_netif_is_netif_up()
+ *
+ * Called from the tcpip thread (or with the core lock held) whenever the state may have changed.
+ * The state is written to the slot which isn't published, so readers never wait for the writer,
+ * they only retry if the slot they copied has been reused by a later update meanwhile.
+ * state_seq is odd while an update is in progress, seq / 2 is the index of the published update.
+ */
+static void esp_netif_update_state(esp_netif_t *esp_netif)
+{
+    unsigned int seq = atomic_load_explicit(&esp_netif->state_seq, memory_order_relaxed);
+    esp_netif_state_t *state = &esp_netif->state[((seq >> 1) + 1) & 1];
+    struct netif *netif = esp_netif->lwip_netif;
+
+    atomic_store_explicit(&esp_netif->state_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    state->is_up = false;
+    if (netif != NULL) {
+        // ppp implementation uses netif_set_link_up/down to update link state
+        state->is_up = _IS_NETIF_ANY_POINT2POINT_TYPE(esp_netif) ? netif_is_link_up(netif) : netif_is_up(netif);
+    }
+#if CONFIG_LWIP_IPV4
+    if (netif != NULL && netif_is_up(netif)) {
+        ip4_addr_set(&state->ip_info.ip, ip_2_ip4(&netif->ip_addr));
+        ip4_addr_set(&state->ip_info.netmask, ip_2_ip4(&netif->netmask));
+        ip4_addr_set(&state->ip_info.gw, ip_2_ip4(&netif->gw));
+    } else {
+        memcpy(&state->ip_info, esp_netif->ip_info, sizeof(esp_netif_ip_info_t));
+    }
+#endif
+    atomic_store_explicit(&esp_netif->state_seq, seq + 2, memory_order_release);
+}
+
+static void esp_netif_read_state(esp_netif_t *esp_netif, esp_netif_state_t *state)
+{
+    unsigned int seq, now;
+    do {
+        seq = atomic_load_explicit(&esp_netif->state_seq, memory_order_acquire);
+        memcpy(state, &esp_netif->state[(seq >> 1) & 1], sizeof(esp_netif_state_t));
+        atomic_thread_fence(memory_order_acquire);
+        now = atomic_load_explicit(&esp_netif->state_seq, memory_order_relaxed);
+        // the copied slot is written again once the update after the next one starts
+    } while (now - (seq & ~1U) >= 3);
+}
+
 static void netif_callback_fn(struct netif* netif, netif_nsc_reason_t reason, const netif_ext_callback_args_t* args)
 {
+    // The callback is called for all lwip netifs, not only for those created by esp-netif.
+    // Update the state first, the handlers below post events and the event handlers may read it
+    for (esp_netif_t *esp_netif = esp_netif_next_unsafe(NULL); esp_netif != NULL; esp_netif = esp_netif_next_unsafe(esp_netif)) {
+        if (esp_netif->lwip_netif == netif) {
+            esp_netif_update_state(esp_netif);
+            break;
+        }
+    }
 #if LWIP_IPV4
     if (reason & DHCP_CB_CHANGE) {
         esp_netif_internal_dhcpc_cb(netif);
@@ -582,6 +646,188 @@ esp_err_t esp_netif_deinit(void)
     return ESP_ERR_INVALID_STATE;
 }
 
+#if CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
+#define RX_BATCH_SIZE CONFIG_ESP_NETIF_RX_BATCH_SIZE
+
+/**
+ * @brief Frames received by the driver which haven't been passed to the tcpip thread yet
+ *
+ * The first frame queued posts the preallocated message to the tcpip thread, the frames
+ * received until the message is processed are added to the same batch.
+ */
+struct esp_netif_rx_batch {
+    struct tcpip_callback_msg *msg;     // message scheduling esp_netif_rx_batch_process()
+    struct netif *netif;                // NULL once the interface has been destroyed
+    bool scheduled;                     // msg has been posted and the batch hasn't been processed yet
+    uint16_t head;
+    uint16_t count;
+    struct pbuf *frames[RX_BATCH_SIZE];
+};
+
+/**
+ * @brief Moves the queued frames to the frames array, called in a critical section
+ *
+ * @return number of frames moved
+ */
+static uint16_t esp_netif_rx_batch_take(struct esp_netif_rx_batch *batch, struct pbuf **frames)
+{
+    uint16_t count = batch->count;
+    for (uint16_t i = 0; i < count; i++) {
+        frames[i] = batch->frames[(batch->head + i) % RX_BATCH_SIZE];
+    }
+    batch->head = (batch->head + count) % RX_BATCH_SIZE;
+    batch->count = 0;
+    return count;
+}
+
+/**
+ * @brief Passes all queued frames to the stack, executed in the tcpip thread
+ */
+static void esp_netif_rx_batch_process(void *ctx)
+{
+    struct esp_netif_rx_batch *batch = ctx;
+    struct pbuf *frames[RX_BATCH_SIZE];
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    if (batch->netif == NULL) {
+        // The interface has been destroyed while the message was pending
+        SYS_ARCH_PROTECT(lev);
+        uint16_t count = esp_netif_rx_batch_take(batch, frames);
+        SYS_ARCH_UNPROTECT(lev);
+        for (uint16_t i = 0; i < count; i++) {
+            pbuf_free(frames[i]);
+        }
+        tcpip_callbackmsg_delete(batch->msg);
+        free(batch);
+        return;
+    }
+    while (true) {
+        SYS_ARCH_PROTECT(lev);
+        uint16_t count = esp_netif_rx_batch_take(batch, frames);
+        if (count == 0) {
+            batch->scheduled = false;
+        }
+        SYS_ARCH_UNPROTECT(lev);
+        if (count == 0) {
+            return;
+        }
+
+        for (uint16_t i = 0; i < count; i++) {
+            struct netif *netif = batch->netif;
+            err_t err;
+            // Same as tcpip_input(), but called from the tcpip thread directly
+#if LWIP_ETHERNET
+            if (netif->flags & (NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET)) {
+                err = ethernet_input(frames[i], netif);
+            } else
+#endif
+            {
+                err = ip_input(frames[i], netif);
+            }
+            if (err != ERR_OK) {
+                pbuf_free(frames[i]);
+            }
+        }
+
+        // Frames received in the meantime are processed after the other messages pending for the tcpip thread,
+        // only if the message can't be posted they're processed right away
+        SYS_ARCH_PROTECT(lev);
+        bool more = batch->count > 0;
+        if (!more) {
+            batch->scheduled = false;
+        }
+        SYS_ARCH_UNPROTECT(lev);
+        if (!more || tcpip_callbackmsg_trycallback(batch->msg) == ERR_OK) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Input function of lwip netif, queues the frame instead of posting it to the tcpip thread
+ */
+static err_t esp_netif_rx_batch_input(struct pbuf *p, struct netif *netif)
+{
+    esp_netif_t *esp_netif = lwip_get_esp_netif(netif);
+    if (esp_netif == NULL || esp_netif->rx_batch == NULL) {
+        return tcpip_input(p, netif);
+    }
+    struct esp_netif_rx_batch *batch = esp_netif->rx_batch;
+    bool schedule = false;
+    SYS_ARCH_DECL_PROTECT(lev);
+
+    SYS_ARCH_PROTECT(lev);
+    if (batch->count == RX_BATCH_SIZE) {
+        SYS_ARCH_UNPROTECT(lev);
+        return ERR_MEM;
+    }
+    batch->frames[(batch->head + batch->count) % RX_BATCH_SIZE] = p;
+    batch->count++;
+    if (!batch->scheduled) {
+        batch->scheduled = schedule = true;
+    }
+    SYS_ARCH_UNPROTECT(lev);
+
+    if (schedule && tcpip_callbackmsg_trycallback(batch->msg) != ERR_OK) {
+        // The tcpip mailbox is full: drop the batch. The frames queued after this one
+        // (while the batch was marked as scheduled) are freed here, this one by the caller.
+        struct pbuf *dropped[RX_BATCH_SIZE];
+        SYS_ARCH_PROTECT(lev);
+        uint16_t count = esp_netif_rx_batch_take(batch, dropped);
+        batch->scheduled = false;
+        SYS_ARCH_UNPROTECT(lev);
+        for (uint16_t i = 0; i < count; i++) {
+            if (dropped[i] != p) {
+                pbuf_free(dropped[i]);
+            }
+        }
+        return ERR_MEM;
+    }
+    return ERR_OK;
+}
+
+static struct esp_netif_rx_batch *esp_netif_rx_batch_create(esp_netif_t *esp_netif)
+{
+    struct esp_netif_rx_batch *batch = calloc(1, sizeof(struct esp_netif_rx_batch));
+    if (batch == NULL) {
+        return NULL;
+    }
+    batch->netif = esp_netif->lwip_netif;
+    batch->msg = tcpip_callbackmsg_new(esp_netif_rx_batch_process, batch);
+    if (batch->msg == NULL) {
+        free(batch);
+        return NULL;
+    }
+    return batch;
+}
+
+/**
+ * @brief Frees the queued frames and the batch, executed in the tcpip thread
+ */
+static void esp_netif_rx_batch_delete(struct esp_netif_rx_batch *batch)
+{
+    if (batch == NULL) {
+        return;
+    }
+    struct pbuf *frames[RX_BATCH_SIZE];
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    bool scheduled = batch->scheduled;
+    batch->netif = NULL;
+    // The frames are detached from the batch before it's released, the pbufs are freed outside
+    // of the critical section
+    uint16_t count = esp_netif_rx_batch_take(batch, frames);
+    SYS_ARCH_UNPROTECT(lev);
+    for (uint16_t i = 0; i < count; i++) {
+        pbuf_free(frames[i]);
+    }
+    if (!scheduled) {
+        tcpip_callbackmsg_delete(batch->msg);
+        free(batch);
+    } // otherwise freed by the pending esp_netif_rx_batch_process()
+}
+#endif // CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
+
 static esp_err_t esp_netif_init_configuration(esp_netif_t *esp_netif, const esp_netif_config_t *cfg)
 {
     // Basic esp_netif and lwip is a mandatory configuration and cannot be updated after esp_netif_new()
@@ -772,6 +1018,27 @@ static esp_err_t esp_netif_new_api(esp_netif_api_msg_t *msg)
         esp_netif_destroy_api(&to_destroy);
         return ESP_FAIL;
     }
+    esp_netif_update_state(esp_netif);
+    int rx_pbuf_pool_size = esp_netif_config->base->rx_pbuf_pool_size;
+    if (rx_pbuf_pool_size == 0) {
+        rx_pbuf_pool_size = CONFIG_ESP_NETIF_RX_PBUF_POOL_SIZE;
+    }
+    // PPP netifs pass received data to lwIP by copying, they don't use custom pbufs
+    if (rx_pbuf_pool_size > 0 && !(esp_netif->flags & ESP_NETIF_FLAG_IS_PPP)) {
+        esp_netif->rx_pbuf_pool = esp_pbuf_pool_create(rx_pbuf_pool_size);
+        if (esp_netif->rx_pbuf_pool == NULL) {
+            ESP_LOGW(TAG, "Failed to create RX pbuf pool, pbufs will be allocated from lwIP heap");
+        }
+    }
+#if CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
+    // Bridge receives frames through the input functions of its ports, PPP passes them to lwIP by itself
+    if (!(esp_netif->flags & (ESP_NETIF_FLAG_IS_PPP | ESP_NETIF_FLAG_IS_BRIDGE))) {
+        esp_netif->rx_batch = esp_netif_rx_batch_create(esp_netif);
+        if (esp_netif->rx_batch == NULL) {
+            ESP_LOGW(TAG, "Failed to create RX batch, frames will be posted to lwIP one by one");
+        }
+    }
+#endif
     lwip_set_esp_netif(lwip_netif, esp_netif);
 
     if (netif_callback.callback_fn == NULL ) {
@@ -898,7 +1165,7 @@ static esp_err_t esp_netif_lwip_add(esp_netif_t *esp_netif)
                             (struct ip4_addr*)&esp_netif->ip_info->netmask,
                             (struct ip4_addr*)&esp_netif->ip_info->gw,
 #endif
-                            esp_netif, esp_netif->lwip_init_fn, tcpip_input)) {
+                            esp_netif, esp_netif->lwip_init_fn, ESP_NETIF_LWIP_INPUT_FN(esp_netif))) {
             esp_netif_lwip_remove(esp_netif);
             return ESP_ERR_ESP_NETIF_IF_NOT_READY;
         }
@@ -938,6 +1205,10 @@ static esp_err_t esp_netif_destroy_api(esp_netif_api_msg_t *msg)
 #if ESP_DHCPS
     dhcps_delete(esp_netif->dhcps);
 #endif
+#if CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
+    esp_netif_rx_batch_delete(esp_netif->rx_batch);
+#endif
+    esp_pbuf_pool_delete(esp_netif->rx_pbuf_pool);
     free(esp_netif);
     return ESP_OK;
 }
@@ -984,6 +1255,7 @@ static esp_err_t esp_netif_reset_ip_info(esp_netif_t *esp_netif)
     ip4_addr_set_zero(&(esp_netif->ip_info->ip));
     ip4_addr_set_zero(&(esp_netif->ip_info->gw));
     ip4_addr_set_zero(&(esp_netif->ip_info->netmask));
+    esp_netif_update_state(esp_netif);
     return ESP_OK;
 }
 #endif
@@ -1725,16 +1997,13 @@ bool esp_netif_is_netif_up(esp_netif_t *esp_netif)
 {
     ESP_LOGV(TAG, "%s esp_netif:%p", __func__, esp_netif);
 
-    if (esp_netif != NULL && esp_netif->lwip_netif != NULL) {
-        if (_IS_NETIF_ANY_POINT2POINT_TYPE(esp_netif)) {
-            // ppp implementation uses netif_set_link_up/down to update link state
-            return netif_is_link_up(esp_netif->lwip_netif);
-        }
-        // esp-netif handlers and drivers take care to set_netif_up/down on link state update
-        return netif_is_up(esp_netif->lwip_netif);
-    } else {
+    if (esp_netif == NULL) {
         return false;
     }
+    // esp-netif handlers and drivers take care to set_netif_up/down on link state update
+    esp_netif_state_t state;
+    esp_netif_read_state(esp_netif, &state);
+    return state.is_up;
 }
 
 #if CONFIG_LWIP_IPV4
@@ -1757,17 +2026,10 @@ esp_err_t esp_netif_get_ip_info(esp_netif_t *esp_netif, esp_netif_ip_info_t *ip_
         return ESP_ERR_INVALID_ARG;
     }
 
-    struct netif *p_netif = esp_netif->lwip_netif;
-
-    if (p_netif != NULL && netif_is_up(p_netif)) {
-        ip4_addr_set(&ip_info->ip, ip_2_ip4(&p_netif->ip_addr));
-        ip4_addr_set(&ip_info->netmask, ip_2_ip4(&p_netif->netmask));
-        ip4_addr_set(&ip_info->gw, ip_2_ip4(&p_netif->gw));
-
-        return ESP_OK;
-    }
-
-    memcpy(ip_info, esp_netif->ip_info, sizeof(esp_netif_ip_info_t));
+    // Consistent copy of the addresses published by the tcpip thread, without calling it
+    esp_netif_state_t state;
+    esp_netif_read_state(esp_netif, &state);
+    memcpy(ip_info, &state.ip_info, sizeof(esp_netif_ip_info_t));
 
     return ESP_OK;
 }
@@ -1831,6 +2093,7 @@ static esp_err_t esp_netif_set_ip_info_api(esp_netif_api_msg_t *msg)
 
     if (p_netif != NULL && netif_is_up(p_netif)) {
         netif_set_addr(p_netif, (ip4_addr_t*)&ip_info->ip, (ip4_addr_t*)&ip_info->netmask, (ip4_addr_t*)&ip_info->gw);
+        esp_netif_update_state(esp_netif);
         if (ESP_NETIF_FLAG_EVENT_IP_MODIFIED & esp_netif->flags) {
             if (!(ip4_addr_isany_val(ip_info->ip) || ip4_addr_isany_val(ip_info->netmask) || ip4_addr_isany_val(ip_info->gw))) {
 
@@ -1852,6 +2115,8 @@ static esp_err_t esp_netif_set_ip_info_api(esp_netif_api_msg_t *msg)
 
             }
         }
+    } else {
+        esp_netif_update_state(esp_netif);
     }
 
     return ESP_OK;
@@ -1,11 +1,12 @@
 /*
- * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 #pragma once
 
+#include <stdatomic.h>
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
 #include "lwip/netif.h"
@@ -15,6 +16,8 @@
 #endif
 
 struct esp_netif_api_msg_s;
+struct esp_pbuf_pool;
+struct esp_netif_rx_batch;
 
 typedef int (*esp_netif_api_fn)(struct esp_netif_api_msg_s *msg);
 
@@ -66,6 +69,29 @@ typedef struct netif_related_data {
     enum netif_types netif_type;
 } netif_related_data_t;
 
+/**
+ * @brief Create the pool of custom pbufs used by esp_pbuf_allocate()
+ *
+ * @param size Number of pbufs in the pool
+ * @return pool handle, NULL if no free heap
+ */
+struct esp_pbuf_pool *esp_pbuf_pool_create(size_t size);
+
+/**
+ * @brief Delete the pool of custom pbufs
+ *
+ * @note All pbufs taken from the pool must have been freed
+ */
+void esp_pbuf_pool_delete(struct esp_pbuf_pool *pool);
+
+/**
+ * @brief Interface state returned by the getters without calling the tcpip thread
+ */
+typedef struct esp_netif_state {
+    esp_netif_ip_info_t ip_info;    // same as returned by esp_netif_get_ip_info()
+    bool is_up;                     // same as returned by esp_netif_is_netif_up()
+} esp_netif_state_t;
+
 /**
  * @brief Main esp-netif container with interface related information
  */
@@ -75,6 +101,10 @@ struct esp_netif_obj {
     esp_netif_ip_info_t* ip_info;
     esp_netif_ip_info_t* ip_info_old;
 
+    // state published by the tcpip thread for the lock-free getters, see esp_netif_update_state()
+    atomic_uint state_seq;
+    esp_netif_state_t state[2];
+
     // lwip netif related
     struct netif *lwip_netif;
     err_t (*lwip_init_fn)(struct netif*);
@@ -89,6 +119,8 @@ struct esp_netif_obj {
     esp_err_t (*driver_transmit)(void *h, void *buffer, size_t len);
     esp_err_t (*driver_transmit_wrap)(void *h, void *buffer, size_t len, void *pbuf);
     void (*driver_free_rx_buffer)(void *h, void* buffer);
+    struct esp_pbuf_pool *rx_pbuf_pool;     // pool of custom pbufs for received frames, NULL if disabled
+    struct esp_netif_rx_batch *rx_batch;    // frames waiting for the tcpip thread, NULL if batching is disabled
 
     // dhcp related
     esp_netif_dhcp_status_t dhcpc_status;
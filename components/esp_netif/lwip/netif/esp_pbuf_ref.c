@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -9,9 +9,19 @@
  * and the L2 free function esp_netif_free_rx_buffer()
  */
 
+#include <stdlib.h>
+#include <stdatomic.h>
 #include "lwip/mem.h"
 #include "lwip/esp_pbuf_ref.h"
 #include "esp_netif_net_stack.h"
+#include "esp_netif_lwip_internal.h"
+
+/* Index of the free list terminating entry */
+#define POOL_INDEX_NONE     0xFFFF
+#define POOL_INDEX_MASK     0xFFFF
+/* The upper half of the free list head is incremented on every change, so that a
+ * compare-and-swap doesn't succeed on a head which was popped and pushed back meanwhile */
+#define POOL_TAG_INCREMENT  0x10000
 
 /**
  * @brief Specific pbuf structure for pbufs allocated by ESP netif
@@ -22,8 +32,75 @@ typedef struct esp_custom_pbuf
     struct pbuf_custom p;
     esp_netif_t *esp_netif;
     void* l2_buf;
+    struct esp_pbuf_pool *pool;     /* pool owning this pbuf, NULL if allocated from the lwIP heap */
+    uint16_t next_free;             /* index of the next free pbuf in the pool */
 } esp_custom_pbuf_t;
 
+/**
+ * @brief Lock free pool of custom pbufs
+ *
+ * Pbufs are allocated in the driver RX context and freed in any task which
+ * holds the packet, the free list is a stack updated by compare-and-swap.
+ */
+typedef struct esp_pbuf_pool {
+    atomic_uint_fast32_t head;      /* tag in the upper half, index of the first free pbuf in the lower half */
+    atomic_uint allocated;
+    atomic_uint fallbacks;
+    atomic_uint exhausted;
+    uint16_t size;
+    esp_custom_pbuf_t pbufs[];
+} esp_pbuf_pool_t;
+
+struct esp_pbuf_pool *esp_pbuf_pool_create(size_t size)
+{
+    if (size == 0 || size >= POOL_INDEX_NONE) {
+        return NULL;
+    }
+    esp_pbuf_pool_t *pool = calloc(1, sizeof(esp_pbuf_pool_t) + size * sizeof(esp_custom_pbuf_t));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->size = size;
+    for (size_t i = 0; i < size; i++) {
+        pool->pbufs[i].pool = pool;
+        pool->pbufs[i].next_free = (i + 1 < size) ? i + 1 : POOL_INDEX_NONE;
+    }
+    atomic_init(&pool->head, 0);
+    return pool;
+}
+
+void esp_pbuf_pool_delete(struct esp_pbuf_pool *pool)
+{
+    free(pool);
+}
+
+static esp_custom_pbuf_t *esp_pbuf_pool_get(esp_pbuf_pool_t *pool)
+{
+    uint_fast32_t head = atomic_load(&pool->head);
+    uint_fast32_t new_head;
+    esp_custom_pbuf_t *esp_pbuf;
+    do {
+        uint16_t index = head & POOL_INDEX_MASK;
+        if (index == POOL_INDEX_NONE) {
+            return NULL;
+        }
+        esp_pbuf = &pool->pbufs[index];
+        new_head = ((head + POOL_TAG_INCREMENT) & ~POOL_INDEX_MASK) | esp_pbuf->next_free;
+    } while (!atomic_compare_exchange_weak(&pool->head, &head, new_head));
+    return esp_pbuf;
+}
+
+static void esp_pbuf_pool_put(esp_pbuf_pool_t *pool, esp_custom_pbuf_t *esp_pbuf)
+{
+    uint16_t index = esp_pbuf - pool->pbufs;
+    uint_fast32_t head = atomic_load(&pool->head);
+    uint_fast32_t new_head;
+    do {
+        esp_pbuf->next_free = head & POOL_INDEX_MASK;
+        new_head = ((head + POOL_TAG_INCREMENT) & ~POOL_INDEX_MASK) | index;
+    } while (!atomic_compare_exchange_weak(&pool->head, &head, new_head));
+}
+
 /**
  * @brief Free custom pbuf containing the L2 layer buffer allocated in the driver
  *
@@ -34,7 +111,11 @@ static void esp_pbuf_free(struct pbuf *pbuf)
 {
     esp_custom_pbuf_t* esp_pbuf = (esp_custom_pbuf_t*)pbuf;
     esp_netif_free_rx_buffer(esp_pbuf->esp_netif, esp_pbuf->l2_buf);
-    mem_free(pbuf);
+    if (esp_pbuf->pool) {
+        esp_pbuf_pool_put(esp_pbuf->pool, esp_pbuf);
+    } else {
+        mem_free(pbuf);
+    }
 }
 
 /**
@@ -48,18 +129,56 @@ static void esp_pbuf_free(struct pbuf *pbuf)
 struct pbuf* esp_pbuf_allocate(esp_netif_t *esp_netif, void *buffer, size_t len, void *l2_buff)
 {
     struct pbuf *p;
+    esp_pbuf_pool_t *pool = esp_netif->rx_pbuf_pool;
+    esp_custom_pbuf_t* esp_pbuf = NULL;
 
-    esp_custom_pbuf_t* esp_pbuf  = mem_malloc(sizeof(esp_custom_pbuf_t));
+    if (pool) {
+        esp_pbuf = esp_pbuf_pool_get(pool);
+        if (esp_pbuf) {
+            atomic_fetch_add_explicit(&pool->allocated, 1, memory_order_relaxed);
+        }
+    }
     if (esp_pbuf == NULL) {
-        return NULL;
+        esp_pbuf = mem_malloc(sizeof(esp_custom_pbuf_t));
+        if (esp_pbuf == NULL) {
+            if (pool) {
+                atomic_fetch_add_explicit(&pool->exhausted, 1, memory_order_relaxed);
+            }
+            return NULL;
+        }
+        if (pool) {
+            atomic_fetch_add_explicit(&pool->fallbacks, 1, memory_order_relaxed);
+        }
+        esp_pbuf->pool = NULL;
     }
     esp_pbuf->p.custom_free_function = esp_pbuf_free;
     esp_pbuf->esp_netif = esp_netif;
     esp_pbuf->l2_buf = l2_buff;
     p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &esp_pbuf->p, buffer, len);
     if (p == NULL) {
-        mem_free(esp_pbuf);
+        if (esp_pbuf->pool) {
+            esp_pbuf_pool_put(esp_pbuf->pool, esp_pbuf);
+        } else {
+            mem_free(esp_pbuf);
+        }
         return NULL;
     }
     return p;
 }
+
+esp_err_t esp_pbuf_pool_get_stats(esp_netif_t *esp_netif, esp_pbuf_pool_stats_t *stats)
+{
+    if (esp_netif == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_pbuf_pool_t *pool = esp_netif->rx_pbuf_pool;
+    if (pool == NULL) {
+        *stats = (esp_pbuf_pool_stats_t) { 0 };
+        return ESP_OK;
+    }
+    stats->size = pool->size;
+    stats->allocated = atomic_load_explicit(&pool->allocated, memory_order_relaxed);
+    stats->fallbacks = atomic_load_explicit(&pool->fallbacks, memory_order_relaxed);
+    stats->exhausted = atomic_load_explicit(&pool->exhausted, memory_order_relaxed);
+    return ESP_OK;
+}
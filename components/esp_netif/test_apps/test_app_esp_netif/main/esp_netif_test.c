@@ -5,6 +5,11 @@
  */
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "unity.h"
 #include "unity_fixture.h"
 #include "esp_netif.h"
@@ -17,6 +22,8 @@
 #include "test_utils.h"
 #include "memory_checks.h"
 #include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/esp_pbuf_ref.h"
 
 TEST_GROUP(esp_netif);
 
@@ -497,6 +504,230 @@ TEST(esp_netif, route_priority)
     }
 }
 
+#define TEST_POOL_SIZE          4
+#define TEST_POOL_TASK_ALLOCS   3
+#define TEST_POOL_ITERATIONS    1000
+
+static uint8_t s_test_frame[64];
+static atomic_int s_rx_buffers_freed;
+
+static void test_free_rx_buffer(void *h, void *buffer)
+{
+    atomic_fetch_add(&s_rx_buffers_freed, 1);
+}
+
+/* Creates an interface whose driver only counts the freed RX buffers */
+static esp_netif_t *test_create_rx_netif(const char *if_key, int rx_pbuf_pool_size)
+{
+    esp_netif_driver_ifconfig_t driver_config = { .handle = (void*)1, .transmit = dummy_transmit,
+                                                  .driver_free_rx_buffer = test_free_rx_buffer };
+    esp_netif_inherent_config_t base_netif_config = { .if_key = if_key, .rx_pbuf_pool_size = rx_pbuf_pool_size };
+    esp_netif_config_t cfg = { .base = &base_netif_config,
+                               .stack = ESP_NETIF_NETSTACK_DEFAULT_WIFI_STA,
+                               .driver = &driver_config };
+    esp_netif_t *netif = esp_netif_new(&cfg);
+    TEST_ASSERT_NOT_NULL(netif);
+    return netif;
+}
+
+typedef struct {
+    esp_netif_t *netif;
+    SemaphoreHandle_t done;
+    int failures;
+} test_pool_task_t;
+
+static void test_pool_task(void *arg)
+{
+    test_pool_task_t *task = arg;
+    for (int i = 0; i < TEST_POOL_ITERATIONS; i++) {
+        struct pbuf *p[TEST_POOL_TASK_ALLOCS];
+        for (int j = 0; j < TEST_POOL_TASK_ALLOCS; j++) {
+            p[j] = esp_pbuf_allocate(task->netif, s_test_frame, sizeof(s_test_frame), s_test_frame);
+            if (p[j] == NULL) {
+                task->failures++;
+            }
+        }
+        for (int j = 0; j < TEST_POOL_TASK_ALLOCS; j++) {
+            if (p[j]) {
+                pbuf_free(p[j]);
+            }
+        }
+    }
+    xSemaphoreGive(task->done);
+    vTaskDelete(NULL);
+}
+
+TEST(esp_netif, rx_pbuf_pool)
+{
+    test_case_uses_tcpip();
+    atomic_store(&s_rx_buffers_freed, 0);
+    esp_netif_t *netif = test_create_rx_netif("rx_pool", TEST_POOL_SIZE);
+    esp_pbuf_pool_stats_t stats;
+
+    // The pool is used first, the lwIP heap once it's exhausted
+    struct pbuf *p[TEST_POOL_SIZE + 1];
+    for (int i = 0; i < TEST_POOL_SIZE + 1; i++) {
+        p[i] = esp_pbuf_allocate(netif, s_test_frame, sizeof(s_test_frame), s_test_frame);
+        TEST_ASSERT_NOT_NULL(p[i]);
+    }
+    TEST_ESP_OK(esp_pbuf_pool_get_stats(netif, &stats));
+    TEST_ASSERT_EQUAL(TEST_POOL_SIZE, stats.size);
+    TEST_ASSERT_EQUAL(TEST_POOL_SIZE, stats.allocated);
+    TEST_ASSERT_EQUAL(1, stats.fallbacks);
+    TEST_ASSERT_EQUAL(0, stats.exhausted);
+    for (int i = 0; i < TEST_POOL_SIZE + 1; i++) {
+        pbuf_free(p[i]);
+    }
+    TEST_ASSERT_EQUAL(TEST_POOL_SIZE + 1, atomic_load(&s_rx_buffers_freed));
+
+    // Allocate and free from two tasks at the same time, on both cores if available
+    test_pool_task_t tasks[2] = { 0 };
+    for (int i = 0; i < 2; i++) {
+        tasks[i].netif = netif;
+        tasks[i].done = xSemaphoreCreateBinary();
+        TEST_ASSERT_NOT_NULL(tasks[i].done);
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(test_pool_task, "pool_task", 4096, &tasks[i], 5, NULL,
+                                                          i % portNUM_PROCESSORS));
+    }
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(tasks[i].done, pdMS_TO_TICKS(10000)));
+        vSemaphoreDelete(tasks[i].done);
+        TEST_ASSERT_EQUAL(0, tasks[i].failures);
+    }
+    const int total = TEST_POOL_SIZE + 1 + 2 * TEST_POOL_ITERATIONS * TEST_POOL_TASK_ALLOCS;
+    TEST_ESP_OK(esp_pbuf_pool_get_stats(netif, &stats));
+    printf("%d pbufs: %" PRIu32 " from the pool, %" PRIu32 " from the heap\n", total, stats.allocated, stats.fallbacks);
+    TEST_ASSERT_EQUAL(total, stats.allocated + stats.fallbacks);
+    TEST_ASSERT_EQUAL(total, atomic_load(&s_rx_buffers_freed));
+
+    // All pbufs are back in the pool
+    uint32_t fallbacks = stats.fallbacks;
+    for (int i = 0; i < TEST_POOL_SIZE; i++) {
+        p[i] = esp_pbuf_allocate(netif, s_test_frame, sizeof(s_test_frame), s_test_frame);
+        TEST_ASSERT_NOT_NULL(p[i]);
+        for (int j = 0; j < i; j++) {
+            TEST_ASSERT_NOT_EQUAL(p[j], p[i]);
+        }
+    }
+    TEST_ESP_OK(esp_pbuf_pool_get_stats(netif, &stats));
+    TEST_ASSERT_EQUAL(fallbacks, stats.fallbacks);
+    for (int i = 0; i < TEST_POOL_SIZE; i++) {
+        pbuf_free(p[i]);
+    }
+    esp_netif_destroy(netif);
+}
+#if CONFIG_LWIP_IPV4
+#define TEST_IP_INFO_UPDATES    2000
+#define TEST_IP_INFO_GW_XOR     0x5a5a5a5a
+
+typedef struct {
+    esp_netif_t *netif;
+    SemaphoreHandle_t done;
+    volatile bool stop;
+    int reads;
+    int torn;
+} test_ip_info_reader_t;
+
+/* Reads the ip info until stopped and counts the reads where netmask and gw don't belong to the ip */
+static void test_ip_info_reader_task(void *arg)
+{
+    test_ip_info_reader_t *reader = arg;
+    while (!reader->stop) {
+        esp_netif_ip_info_t ip_info;
+        esp_netif_get_ip_info(reader->netif, &ip_info);
+        if (ip_info.ip.addr != 0 &&
+            (ip_info.netmask.addr != ~ip_info.ip.addr || ip_info.gw.addr != (ip_info.ip.addr ^ TEST_IP_INFO_GW_XOR))) {
+            reader->torn++;
+        }
+        if ((++reader->reads & 0xff) == 0) {
+            taskYIELD();
+        }
+    }
+    xSemaphoreGive(reader->done);
+    vTaskDelete(NULL);
+}
+
+TEST(esp_netif, get_ip_info_while_updated)
+{
+    test_case_uses_tcpip();
+    esp_netif_driver_ifconfig_t driver_config = { .handle = (void*)1, .transmit = dummy_transmit };
+    esp_netif_inherent_config_t base_netif_config = { .if_key = "ip_info" };
+    esp_netif_config_t cfg = { .base = &base_netif_config,
+                               .stack = ESP_NETIF_NETSTACK_DEFAULT_WIFI_STA,
+                               .driver = &driver_config };
+    esp_netif_t *netif = esp_netif_new(&cfg);
+    TEST_ASSERT_NOT_NULL(netif);
+    // The lwIP netif is up, so the addresses are set with netif_set_addr() and published from the netif callback
+    esp_netif_action_start(netif, 0, 0, 0);
+
+    test_ip_info_reader_t reader = { .netif = netif, .done = xSemaphoreCreateBinary() };
+    TEST_ASSERT_NOT_NULL(reader.done);
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(test_ip_info_reader_task, "ip_info_reader", 4096, &reader,
+                                                      uxTaskPriorityGet(NULL), NULL, portNUM_PROCESSORS - 1));
+    for (uint32_t i = 1; i <= TEST_IP_INFO_UPDATES; i++) {
+        esp_netif_ip_info_t ip_info;
+        ip_info.ip.addr = esp_netif_htonl(0x0a000000 | i);
+        ip_info.netmask.addr = ~ip_info.ip.addr;
+        ip_info.gw.addr = ip_info.ip.addr ^ TEST_IP_INFO_GW_XOR;
+        TEST_ESP_OK(esp_netif_set_ip_info(netif, &ip_info));
+    }
+    reader.stop = true;
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(reader.done, pdMS_TO_TICKS(5000)));
+    vSemaphoreDelete(reader.done);
+    printf("%d reads during %d updates\n", reader.reads, TEST_IP_INFO_UPDATES);
+    TEST_ASSERT_GREATER_THAN(0, reader.reads);
+    TEST_ASSERT_EQUAL(0, reader.torn);
+
+    esp_netif_destroy(netif);
+}
+#endif // CONFIG_LWIP_IPV4
+
+#if CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
+#define TEST_BATCH_FRAMES   (4 * CONFIG_ESP_NETIF_RX_BATCH_SIZE)
+
+static void test_wait_rx_buffers_freed(int count)
+{
+    for (int i = 0; i < 100 && atomic_load(&s_rx_buffers_freed) < count; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(count, atomic_load(&s_rx_buffers_freed));
+}
+
+static esp_err_t test_rx_batch_destroy_with_frames(void *ctx)
+{
+    esp_netif_t *netif = ctx;
+    // The tcpip thread can't process the batch before the interface is destroyed,
+    // frames above the batch size are dropped
+    for (int i = 0; i < TEST_BATCH_FRAMES; i++) {
+        esp_netif_receive(netif, s_test_frame, sizeof(s_test_frame), s_test_frame);
+    }
+    esp_netif_destroy(netif);
+    return ESP_OK;
+}
+
+TEST(esp_netif, rx_batch)
+{
+    test_case_uses_tcpip();
+    // The frames are dropped by the stack, since they have no known ethertype
+    atomic_store(&s_rx_buffers_freed, 0);
+    esp_netif_t *netif = test_create_rx_netif("rx_batch", 0);
+    esp_netif_action_start(netif, 0, 0, 0);
+
+    // A burst from a task of higher priority than the tcpip thread is queued, or dropped
+    // once the queue is full, every frame is freed once
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    vTaskPrioritySet(NULL, configMAX_PRIORITIES - 1);
+    for (int i = 0; i < TEST_BATCH_FRAMES; i++) {
+        esp_netif_receive(netif, s_test_frame, sizeof(s_test_frame), s_test_frame);
+    }
+    vTaskPrioritySet(NULL, priority);
+    test_wait_rx_buffers_freed(TEST_BATCH_FRAMES);
+
+    // Frames still queued when the interface is destroyed are freed with it
+    TEST_ESP_OK(esp_netif_tcpip_exec(test_rx_batch_destroy_with_frames, netif));
+    test_wait_rx_buffers_freed(2 * TEST_BATCH_FRAMES);
+}
+#endif // CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
 
 TEST_GROUP_RUNNER(esp_netif)
 {
@@ -526,6 +757,13 @@ TEST_GROUP_RUNNER(esp_netif)
     RUN_TEST_CASE(esp_netif, dhcp_server_state_transitions_mesh)
 #endif
     RUN_TEST_CASE(esp_netif, route_priority)
+    RUN_TEST_CASE(esp_netif, rx_pbuf_pool)
+#if CONFIG_LWIP_IPV4
+    RUN_TEST_CASE(esp_netif, get_ip_info_while_updated)
+#endif
+#if CONFIG_ESP_NETIF_RX_BATCH_SIZE > 0
+    RUN_TEST_CASE(esp_netif, rx_batch)
+#endif
 }
 
 void app_main(void)
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -655,6 +655,94 @@ TEST_CASE("esp32 l2tap - write", "[ethernet]")
     ethernet_deinit(&eth_network_hndls);
 }
 
+/* ============================================================================= */
+/**
+ * @brief Verifies batched write and zero-copy batched read
+ *
+ */
+#define BATCH_FRAMES_NUM 4
+
+TEST_CASE("esp32 l2tap - batch read/write", "[ethernet]")
+{
+    test_vfs_eth_network_t eth_network_hndls;
+    int eth_tap_fd;
+
+    TEST_ASSERT_EQUAL(ESP_OK, esp_vfs_l2tap_intf_register(NULL));
+    ethernet_init(&eth_network_hndls);
+
+    eth_tap_fd = open("/dev/net/tap", 0);
+    TEST_ASSERT_NOT_EQUAL(-1, eth_tap_fd);
+    TEST_ASSERT_NOT_EQUAL(-1, ioctl(eth_tap_fd, L2TAP_S_INTF_DEVICE, "ETH_DEF"));
+    uint16_t eth_type_filter = ETH_FILTER_LE;
+    TEST_ASSERT_NOT_EQUAL(-1, ioctl(eth_tap_fd, L2TAP_S_RCV_FILTER, &eth_type_filter));
+
+    ESP_LOGI(TAG, "Verify batch of frames is sent and received in one call each...");
+    test_vfs_eth_tap_msg_t test_msgs[BATCH_FRAMES_NUM];
+    l2tap_frame_t tx_frames[BATCH_FRAMES_NUM];
+    for (int i = 0; i < BATCH_FRAMES_NUM; i++) {
+        test_msgs[i] = s_test_msg;
+        esp_eth_ioctl(eth_network_hndls.eth_handle, ETH_CMD_G_MAC_ADDR, &test_msgs[i].header.src.addr);
+        test_msgs[i].header.type = htons(ETH_FILTER_LE);
+        test_msgs[i].cnt = i;
+        tx_frames[i].buff = &test_msgs[i];
+        tx_frames[i].len = sizeof(test_msgs[i]);
+    }
+    l2tap_frame_batch_t tx_batch = {
+        .frames = tx_frames,
+        .count = BATCH_FRAMES_NUM
+    };
+    TEST_ASSERT_EQUAL(0, ioctl(eth_tap_fd, L2TAP_S_TX_BATCH, &tx_batch));
+    TEST_ASSERT_EQUAL(BATCH_FRAMES_NUM, tx_batch.count);
+
+    // frames may be received in more batches since the batch is returned once the first frame is received
+    l2tap_frame_t rx_frames[BATCH_FRAMES_NUM];
+    int rx_cnt = 0;
+    while (rx_cnt < BATCH_FRAMES_NUM) {
+        l2tap_frame_batch_t rx_batch = {
+            .frames = rx_frames,
+            .count = BATCH_FRAMES_NUM - rx_cnt
+        };
+        TEST_ASSERT_EQUAL(0, ioctl(eth_tap_fd, L2TAP_G_RX_BATCH, &rx_batch));
+        TEST_ASSERT_GREATER_THAN(0, rx_batch.count);
+        for (int i = 0; i < rx_batch.count; i++) {
+            TEST_ASSERT_EQUAL(sizeof(test_msgs[rx_cnt]), rx_frames[i].len);
+            TEST_ASSERT_EQUAL_UINT8_ARRAY(&test_msgs[rx_cnt], rx_frames[i].buff, rx_frames[i].len);
+            rx_cnt++;
+        }
+        TEST_ASSERT_EQUAL(0, ioctl(eth_tap_fd, L2TAP_S_RX_RELEASE, &rx_batch));
+    }
+
+    ESP_LOGI(TAG, "Verify non-blocking batch read when no frame is queued...");
+    TEST_ASSERT_EQUAL(0, fcntl(eth_tap_fd, F_SETFL, O_NONBLOCK));
+    l2tap_frame_batch_t rx_batch = {
+        .frames = rx_frames,
+        .count = BATCH_FRAMES_NUM
+    };
+    TEST_ASSERT_EQUAL(-1, ioctl(eth_tap_fd, L2TAP_G_RX_BATCH, &rx_batch));
+    TEST_ASSERT_EQUAL(EAGAIN, errno);
+
+    ESP_LOGI(TAG, "Verify batch write stops at frame with different Ethernet type...");
+    test_msgs[1].header.type = htons(ETH_FILTER_LE + 10);
+    tx_batch.count = BATCH_FRAMES_NUM;
+    TEST_ASSERT_EQUAL(0, ioctl(eth_tap_fd, L2TAP_S_TX_BATCH, &tx_batch));
+    TEST_ASSERT_EQUAL(1, tx_batch.count);
+    tx_batch.frames = &tx_frames[1];
+    tx_batch.count = BATCH_FRAMES_NUM - 1;
+    TEST_ASSERT_EQUAL(-1, ioctl(eth_tap_fd, L2TAP_S_TX_BATCH, &tx_batch));
+    TEST_ASSERT_EQUAL(EBADMSG, errno);
+
+    // release the frame sent by the partial batch
+    vTaskDelay(pdMS_TO_TICKS(100));
+    rx_batch.count = BATCH_FRAMES_NUM;
+    TEST_ASSERT_EQUAL(0, ioctl(eth_tap_fd, L2TAP_G_RX_BATCH, &rx_batch));
+    TEST_ASSERT_EQUAL(1, rx_batch.count);
+    TEST_ASSERT_EQUAL(0, ioctl(eth_tap_fd, L2TAP_S_RX_RELEASE, &rx_batch));
+
+    TEST_ASSERT_EQUAL(0, close(eth_tap_fd));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_vfs_l2tap_intf_unregister(NULL));
+    ethernet_deinit(&eth_network_hndls);
+}
+
 /* ============================================================================= */
 /**
  * @brief Verifies that concrurent access to shared resource (Ethernet) is correctly handled
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -49,11 +49,6 @@ typedef struct {
     void (*driver_free_rx_buffer)(l2tap_iodriver_handle io_handle, void* buffer);
 } l2tap_context_t;
 
-typedef struct {
-    void *buff;
-    size_t len;
-} frame_queue_entry_t;
-
 typedef struct {
     esp_vfs_select_sem_t select_sem;
     fd_set *readfds;
@@ -86,14 +81,14 @@ static void l2tap_select_notify(int fd, l2tap_select_notif_e select_notif);
 /* ================== Utils ====================== */
 static esp_err_t init_rx_queue(l2tap_context_t *l2tap_socket)
 {
-    l2tap_socket->rx_queue = xQueueCreate(RX_QUEUE_MAX_SIZE, sizeof(frame_queue_entry_t));
+    l2tap_socket->rx_queue = xQueueCreate(RX_QUEUE_MAX_SIZE, sizeof(l2tap_frame_t));
     ESP_RETURN_ON_FALSE(l2tap_socket->rx_queue, ESP_ERR_NO_MEM, TAG, "create work queue failed");
     return ESP_OK;
 }
 
 static esp_err_t push_rx_queue(l2tap_context_t *l2tap_socket, void *buff, size_t len)
 {
-    frame_queue_entry_t frame_info;
+    l2tap_frame_t frame_info;
 
     frame_info.buff = buff;
     frame_info.len = len;
@@ -111,7 +106,7 @@ static ssize_t pop_rx_queue(l2tap_context_t *l2tap_socket, void *buff, size_t le
         timeout = 0;
     }
 
-    frame_queue_entry_t frame_info;
+    l2tap_frame_t frame_info;
     if (xQueueReceive(l2tap_socket->rx_queue, &frame_info, timeout) == pdTRUE) {
         // empty queue was issued indicating the fd is going to be closed
         if (frame_info.len == 0) {
@@ -134,6 +129,38 @@ err:
     return -1;
 }
 
+static void release_rx_frames(l2tap_context_t *l2tap_socket, const l2tap_frame_t *frames, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        l2tap_socket->driver_free_rx_buffer(l2tap_socket->driver_handle, frames[i].buff);
+    }
+}
+
+// passes the driver buffers to the caller, which is responsible to release them
+static ssize_t pop_rx_queue_batch(l2tap_context_t *l2tap_socket, l2tap_frame_t *frames, size_t count)
+{
+    TickType_t timeout = portMAX_DELAY;
+    if (l2tap_socket->non_blocking) {
+        timeout = 0;
+    }
+
+    size_t received = 0;
+    // only the first frame is waited for, the rest of the batch are the frames queued meanwhile
+    while (received < count && xQueueReceive(l2tap_socket->rx_queue, &frames[received], timeout) == pdTRUE) {
+        // empty queue was issued indicating the fd is going to be closed
+        if (frames[received].len == 0) {
+            // indicate to "clean_task" that task waiting for queue was unblocked
+            push_rx_queue(l2tap_socket, NULL, 0);
+            release_rx_frames(l2tap_socket, frames, received);
+            return -1;
+        }
+        received++;
+        timeout = 0;
+    }
+
+    return received > 0 ? received : -1;
+}
+
 static bool rx_queue_empty(l2tap_context_t *l2tap_socket)
 {
     return (uxQueueMessagesWaiting(l2tap_socket->rx_queue) == 0);
@@ -141,7 +168,7 @@ static bool rx_queue_empty(l2tap_context_t *l2tap_socket)
 
 static void flush_rx_queue(l2tap_context_t *l2tap_socket)
 {
-    frame_queue_entry_t frame_info;
+    l2tap_frame_t frame_info;
     while (xQueueReceive(l2tap_socket->rx_queue, &frame_info, 0) == pdTRUE) {
         if (frame_info.len > 0) {
             free(frame_info.buff);
@@ -229,6 +256,23 @@ err:
     return INVALID_FD;
 }
 
+static int transmit_frame(l2tap_context_t *l2tap_socket, const void *data, size_t size)
+{
+    if (l2tap_socket->ethtype_filter > ETH_IEEE802_3_MAX_LEN &&
+            ((struct eth_hdr *)data)->type != htons(l2tap_socket->ethtype_filter)) {
+        // bad message
+        errno = EBADMSG;
+        return -1;
+    }
+
+    if (l2tap_socket->driver_transmit(l2tap_socket->driver_handle, (void *)data, size) != ESP_OK) {
+        // I/O error
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
 static ssize_t l2tap_write(int fd, const void *data, size_t size)
 {
     ssize_t ret = -1;
@@ -238,24 +282,13 @@ static ssize_t l2tap_write(int fd, const void *data, size_t size)
     }
 
     if (atomic_load(&s_l2tap_sockets[fd].state) == L2TAP_SOCK_STATE_OPENED) {
-        if (s_l2tap_sockets[fd].ethtype_filter > ETH_IEEE802_3_MAX_LEN &&
-                ((struct eth_hdr *)data)->type != htons(s_l2tap_sockets[fd].ethtype_filter)) {
-            // bad message
-            errno = EBADMSG;
-            goto err;
-        }
-
-        if (s_l2tap_sockets[fd].driver_transmit(s_l2tap_sockets[fd].driver_handle, (void *)data, size) == ESP_OK) {
+        if (transmit_frame(&s_l2tap_sockets[fd], data, size) == 0) {
             ret = size;
-        } else {
-            // I/O error
-            errno = EIO;
         }
     } else {
         // bad file desc
         errno = EBADF;
     }
-err:
     return ret;
 }
 
@@ -408,6 +441,61 @@ static int l2tap_ioctl(int fd, int cmd, va_list args)
         l2tap_iodriver_handle *get_driver_hdl = va_arg(args, l2tap_iodriver_handle*);
         *get_driver_hdl = s_l2tap_sockets[fd].driver_handle;
         break;
+    case L2TAP_G_RX_BATCH: ;
+        l2tap_frame_batch_t *rx_batch = va_arg(args, l2tap_frame_batch_t *);
+        if (atomic_load(&s_l2tap_sockets[fd].state) != L2TAP_SOCK_STATE_OPENED) {
+            // bad file desc
+            errno = EBADF;
+            goto err;
+        }
+        if (rx_batch == NULL || (rx_batch->frames == NULL && rx_batch->count > 0)) {
+            errno = EINVAL;
+            goto err;
+        }
+        if (rx_batch->count > 0) {
+            ssize_t received = pop_rx_queue_batch(&s_l2tap_sockets[fd], rx_batch->frames, rx_batch->count);
+            if (received < 0) {
+                errno = EAGAIN;
+                goto err;
+            }
+            rx_batch->count = received;
+        }
+        break;
+    case L2TAP_S_RX_RELEASE: ;
+        const l2tap_frame_batch_t *release_batch = va_arg(args, const l2tap_frame_batch_t *);
+        if (atomic_load(&s_l2tap_sockets[fd].state) != L2TAP_SOCK_STATE_OPENED) {
+            // bad file desc
+            errno = EBADF;
+            goto err;
+        }
+        if (release_batch == NULL || (release_batch->frames == NULL && release_batch->count > 0)) {
+            errno = EINVAL;
+            goto err;
+        }
+        release_rx_frames(&s_l2tap_sockets[fd], release_batch->frames, release_batch->count);
+        break;
+    case L2TAP_S_TX_BATCH: ;
+        l2tap_frame_batch_t *tx_batch = va_arg(args, l2tap_frame_batch_t *);
+        if (atomic_load(&s_l2tap_sockets[fd].state) != L2TAP_SOCK_STATE_OPENED) {
+            // bad file desc
+            errno = EBADF;
+            goto err;
+        }
+        if (tx_batch == NULL || (tx_batch->frames == NULL && tx_batch->count > 0)) {
+            errno = EINVAL;
+            goto err;
+        }
+        size_t sent = 0;
+        while (sent < tx_batch->count &&
+                transmit_frame(&s_l2tap_sockets[fd], tx_batch->frames[sent].buff, tx_batch->frames[sent].len) == 0) {
+            sent++;
+        }
+        // error is reported only when no frame was sent, the caller learns about the rest from the count
+        if (sent == 0 && tx_batch->count > 0) {
+            goto err;
+        }
+        tx_batch->count = sent;
+        break;
     default:
         // unsupported operation
         errno = ENOSYS;
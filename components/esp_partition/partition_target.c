@@ -9,6 +9,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <sys/lock.h>
+#include <sys/param.h>
 #include "sdkconfig.h"
 #include "esp_flash_partitions.h"
 #include "esp_attr.h"
@@ -23,6 +24,63 @@
 
 #define HASH_LEN 32 /* SHA-256 digest length */
 
+#if CONFIG_ESP_PARTITION_READ_MMAP
+/* MMU page of the main flash chip kept mapped for esp_partition_read */
+typedef struct {
+    const uint8_t *ptr;                 /* NULL if the window is not mapped */
+    size_t base;                        /* flash address of the page */
+    spi_flash_mmap_handle_t handle;
+    uint32_t last_use;
+} partition_read_window_t;
+
+static partition_read_window_t s_read_windows[CONFIG_ESP_PARTITION_READ_MMAP_WINDOWS];
+static uint32_t s_read_clock;
+static _lock_t s_read_lock;
+
+static esp_err_t partition_read_mmap(size_t src_addr, void *dst, size_t size)
+{
+    esp_err_t err = ESP_OK;
+    _lock_acquire(&s_read_lock);
+    while (size > 0) {
+        size_t base = src_addr & ~(CONFIG_MMU_PAGE_SIZE - 1);
+        size_t chunk = MIN(size, base + CONFIG_MMU_PAGE_SIZE - src_addr);
+        partition_read_window_t *win = NULL;
+        partition_read_window_t *lru = &s_read_windows[0];
+        for (int i = 0; i < CONFIG_ESP_PARTITION_READ_MMAP_WINDOWS; i++) {
+            partition_read_window_t *w = &s_read_windows[i];
+            if (w->ptr != NULL && w->base == base) {
+                win = w;
+                break;
+            }
+            if (lru->ptr != NULL && (w->ptr == NULL || (int32_t)(w->last_use - lru->last_use) < 0)) {
+                lru = w;
+            }
+        }
+        if (win == NULL) {
+            win = lru;
+            if (win->ptr != NULL) {
+                spi_flash_munmap(win->handle);
+                win->ptr = NULL;
+            }
+            const void *ptr;
+            err = spi_flash_mmap(base, CONFIG_MMU_PAGE_SIZE, SPI_FLASH_MMAP_DATA, &ptr, &win->handle);
+            if (err != ESP_OK) {
+                break;
+            }
+            win->ptr = ptr;
+            win->base = base;
+        }
+        win->last_use = ++s_read_clock;
+        memcpy(dst, win->ptr + (src_addr - base), chunk);
+        dst = (uint8_t *) dst + chunk;
+        src_addr += chunk;
+        size -= chunk;
+    }
+    _lock_release(&s_read_lock);
+    return err;
+}
+#endif // CONFIG_ESP_PARTITION_READ_MMAP
+
 esp_err_t esp_partition_read(const esp_partition_t *partition,
                              size_t src_offset, void *dst, size_t size)
 {
@@ -35,6 +93,12 @@ esp_err_t esp_partition_read(const esp_partition_t *partition,
     }
 
     if (!partition->encrypted) {
+#if CONFIG_ESP_PARTITION_READ_MMAP
+        // Reads through the cache are decrypted if flash encryption is enabled
+        if (partition->flash_chip == esp_flash_default_chip && !esp_flash_encryption_enabled()) {
+            return partition_read_mmap(partition->address + src_offset, dst, size);
+        }
+#endif
         return esp_flash_read(partition->flash_chip, dst, partition->address + src_offset, size);
     }
 
@@ -42,8 +106,10 @@ esp_err_t esp_partition_read(const esp_partition_t *partition,
     if (partition->flash_chip != esp_flash_default_chip) {
         return ESP_ERR_NOT_SUPPORTED;
     }
-
     /* Encrypted partitions need to be read via a cache mapping */
+#if CONFIG_ESP_PARTITION_READ_MMAP
+    return partition_read_mmap(partition->address + src_offset, dst, size);
+#else
     const void *buf;
     esp_partition_mmap_handle_t handle;
 
@@ -55,6 +121,7 @@ esp_err_t esp_partition_read(const esp_partition_t *partition,
     memcpy(dst, buf, size);
     esp_partition_munmap(handle);
     return ESP_OK;
+#endif // CONFIG_ESP_PARTITION_READ_MMAP
 #else
     return ESP_ERR_NOT_SUPPORTED;
 #endif // CONFIG_SPI_FLASH_ENABLE_ENCRYPTED_READ_WRITE
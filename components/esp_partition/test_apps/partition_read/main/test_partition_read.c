@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdint.h>
+#include "unity.h"
+#include "esp_partition.h"
+
+#define TEST_PAGE_SIZE  0x10000
+
+static const esp_partition_t *get_test_partition(void)
+{
+    const esp_partition_t *p = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "flash_test");
+    TEST_ASSERT_NOT_NULL(p);
+    return p;
+}
+
+TEST_CASE("Partition reads return data after write and erase", "[partition]")
+{
+    const esp_partition_t *p = get_test_partition();
+    // Record crossing a 64 KB boundary, read repeatedly so that it may be served from a cache
+    const size_t offset = TEST_PAGE_SIZE - 12;
+    uint32_t record[8];
+    uint32_t readback[8];
+
+    TEST_ESP_OK(esp_partition_erase_range(p, 0, 2 * TEST_PAGE_SIZE));
+    TEST_ESP_OK(esp_partition_read(p, offset, readback, sizeof(readback)));
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL_HEX32(0xffffffff, readback[i]);
+        record[i] = 0x12345600 + i;
+    }
+
+    TEST_ESP_OK(esp_partition_write(p, offset, record, sizeof(record)));
+    for (int n = 0; n < 3; n++) {
+        TEST_ESP_OK(esp_partition_read(p, offset, readback, sizeof(readback)));
+        TEST_ASSERT_EQUAL_HEX32_ARRAY(record, readback, 8);
+    }
+    TEST_ESP_OK(esp_partition_read(p, offset + 4, readback, 4));
+    TEST_ASSERT_EQUAL_HEX32(record[1], readback[0]);
+
+    TEST_ESP_OK(esp_partition_erase_range(p, TEST_PAGE_SIZE, p->erase_size));
+    TEST_ESP_OK(esp_partition_read(p, offset, readback, sizeof(readback)));
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(record, readback, 3);
+    for (int i = 3; i < 8; i++) {
+        TEST_ASSERT_EQUAL_HEX32(0xffffffff, readback[i]);
+    }
+}
+
+TEST_CASE("Partition reads from more pages than mapped windows", "[partition]")
+{
+    const esp_partition_t *p = get_test_partition();
+    const int pages = p->size / TEST_PAGE_SIZE;
+    TEST_ASSERT_GREATER_OR_EQUAL(4, pages);
+
+    // Tag the first word of every page, then read them back in an order which keeps remapping windows
+    TEST_ESP_OK(esp_partition_erase_range(p, 0, pages * TEST_PAGE_SIZE));
+    for (int i = 0; i < pages; i++) {
+        uint32_t tag = 0xa5000000 + i;
+        TEST_ESP_OK(esp_partition_write(p, i * TEST_PAGE_SIZE, &tag, sizeof(tag)));
+    }
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < pages; i++) {
+            int page = (round % 2) ? pages - 1 - i : i;
+            uint32_t tag = 0;
+            TEST_ESP_OK(esp_partition_read(p, page * TEST_PAGE_SIZE, &tag, sizeof(tag)));
+            TEST_ASSERT_EQUAL_HEX32(0xa5000000 + page, tag);
+        }
+    }
+
+    // Rewriting a page which may be mapped is visible to the next read
+    uint32_t tag = 0;
+    TEST_ESP_OK(esp_partition_erase_range(p, 0, p->erase_size));
+    TEST_ESP_OK(esp_partition_read(p, 0, &tag, sizeof(tag)));
+    TEST_ASSERT_EQUAL_HEX32(0xffffffff, tag);
+}
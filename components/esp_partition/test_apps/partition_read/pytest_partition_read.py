@@ -0,0 +1,20 @@
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+
+import pytest
+from pytest_embedded import Dut
+
+
+@pytest.mark.esp32
+@pytest.mark.esp32c3
+@pytest.mark.generic
+@pytest.mark.parametrize(
+    'config',
+    [
+        'default',
+        'read_mmap',
+    ],
+    indirect=True,
+)
+def test_partition_read(dut: Dut) -> None:
+    dut.run_all_single_board_cases(timeout=60)
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -10,12 +10,192 @@
 #include "sdmmc_cmd.h"
 #include "esp_log.h"
 #include "esp_compiler.h"
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_dma_utils.h"
+#endif
 
 static sdmmc_card_t* s_cards[FF_VOLUMES] = { NULL };
 static bool s_disk_status_check_en[FF_VOLUMES] = { };
 
 static const char* TAG = "diskio_sdmmc";
 
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+/*
+ * Sequential sector stream of a drive. The buffer holds either sectors read
+ * ahead of a sequential read (dirty == false) or consecutive sectors waiting
+ * to be written with one multi-block write (dirty == true).
+ */
+typedef struct {
+    uint8_t* buf;       /* DMA-capable buffer of 'capacity' sectors */
+    UINT capacity;      /* size of buf in sectors */
+    DWORD start;        /* first sector held in buf */
+    UINT count;         /* number of sectors held in buf, 0 if empty */
+    bool dirty;         /* buf holds sectors which have to be written */
+    DWORD next_read;    /* sector following the last read, for sequential read detection */
+} ff_sdmmc_batch_t;
+
+static ff_sdmmc_batch_t* s_batches[FF_VOLUMES] = { NULL };
+
+static ff_sdmmc_batch_t* ff_sdmmc_batch_create(const sdmmc_card_t* card)
+{
+    ff_sdmmc_batch_t* batch = calloc(1, sizeof(ff_sdmmc_batch_t));
+    if (batch == NULL) {
+        return NULL;
+    }
+    size_t actual_size = 0;
+    if (esp_dma_malloc(CONFIG_FATFS_SDMMC_BATCH_SECTORS * card->csd.sector_size, 0,
+                       (void**) &batch->buf, &actual_size) != ESP_OK) {
+        free(batch);
+        return NULL;
+    }
+    batch->capacity = CONFIG_FATFS_SDMMC_BATCH_SECTORS;
+    return batch;
+}
+
+static void ff_sdmmc_batch_delete(BYTE pdrv)
+{
+    if (s_batches[pdrv]) {
+        free(s_batches[pdrv]->buf);
+        free(s_batches[pdrv]);
+        s_batches[pdrv] = NULL;
+    }
+}
+
+static inline bool ff_sdmmc_batch_overlaps(const ff_sdmmc_batch_t* batch, DWORD sector, UINT count)
+{
+    return batch->count > 0 && sector < batch->start + batch->count && batch->start < sector + count;
+}
+
+static DRESULT ff_sdmmc_batch_flush(BYTE pdrv)
+{
+    ff_sdmmc_batch_t* batch = s_batches[pdrv];
+    if (batch == NULL || !batch->dirty) {
+        return RES_OK;
+    }
+    sdmmc_card_t* card = s_cards[pdrv];
+    if (batch->count > 1 && !card->is_mmc) {
+        /* The whole batch goes out as one multi block write, let the card pre-erase it.
+         * This is only a performance hint, so the write is attempted even if it fails. */
+        esp_err_t hint_err = sdmmc_set_write_pre_erase_count(card, batch->count);
+        if (hint_err != ESP_OK) {
+            ESP_LOGD(TAG, "sdmmc_set_write_pre_erase_count failed (0x%x)", hint_err);
+        }
+    }
+    esp_err_t err = sdmmc_write_sectors(card, batch->buf, batch->start, batch->count);
+    batch->dirty = false;
+    batch->count = 0;
+    if (unlikely(err != ESP_OK)) {
+        ESP_LOGE(TAG, "sdmmc_write_blocks failed (0x%x)", err);
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+/* Transfers the sectors directly, the batch buffer is used as bounce buffer if buff is not DMA-capable */
+static DRESULT ff_sdmmc_batch_transfer(BYTE pdrv, ff_sdmmc_batch_t* batch, BYTE* buff, DWORD sector, UINT count, bool write)
+{
+    sdmmc_card_t* card = s_cards[pdrv];
+    const size_t sector_size = card->csd.sector_size;
+    esp_err_t err = ESP_OK;
+    if (esp_dma_is_buffer_aligned(buff, count * sector_size, ESP_DMA_BUF_LOCATION_INTERNAL)) {
+        err = write ? sdmmc_write_sectors(card, buff, sector, count) : sdmmc_read_sectors(card, buff, sector, count);
+    } else {
+        if (ff_sdmmc_batch_flush(pdrv) != RES_OK) {
+            return RES_ERROR;
+        }
+        batch->count = 0;
+        for (UINT i = 0; i < count && err == ESP_OK; i += batch->capacity) {
+            UINT n = MIN(batch->capacity, count - i);
+            if (write) {
+                memcpy(batch->buf, buff + i * sector_size, n * sector_size);
+                err = sdmmc_write_sectors(card, batch->buf, sector + i, n);
+            } else {
+                err = sdmmc_read_sectors(card, batch->buf, sector + i, n);
+                memcpy(buff + i * sector_size, batch->buf, n * sector_size);
+            }
+        }
+    }
+    if (unlikely(err != ESP_OK)) {
+        ESP_LOGE(TAG, "%s failed (0x%x)", write ? "sdmmc_write_blocks" : "sdmmc_read_blocks", err);
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+static DRESULT ff_sdmmc_batch_read(BYTE pdrv, ff_sdmmc_batch_t* batch, BYTE* buff, DWORD sector, UINT count)
+{
+    sdmmc_card_t* card = s_cards[pdrv];
+    const size_t sector_size = card->csd.sector_size;
+    const bool sequential = (sector == batch->next_read);
+    batch->next_read = sector + count;
+
+    if (ff_sdmmc_batch_overlaps(batch, sector, count)) {
+        if (batch->dirty) {
+            if (ff_sdmmc_batch_flush(pdrv) != RES_OK) {
+                return RES_ERROR;
+            }
+        } else if (sector >= batch->start && sector + count <= batch->start + batch->count) {
+            memcpy(buff, batch->buf + (sector - batch->start) * sector_size, count * sector_size);
+            return RES_OK;
+        }
+    }
+
+    UINT ahead = MIN(batch->capacity, card->csd.capacity - sector);
+    if (!sequential || count >= batch->capacity || ahead < count) {
+        return ff_sdmmc_batch_transfer(pdrv, batch, buff, sector, count, false);
+    }
+
+    // Sequential stream of small reads, read ahead to the end of the buffer
+    if (ff_sdmmc_batch_flush(pdrv) != RES_OK) {
+        return RES_ERROR;
+    }
+    esp_err_t err = sdmmc_read_sectors(card, batch->buf, sector, ahead);
+    if (unlikely(err != ESP_OK)) {
+        batch->count = 0;
+        ESP_LOGE(TAG, "sdmmc_read_blocks failed (0x%x)", err);
+        return RES_ERROR;
+    }
+    batch->start = sector;
+    batch->count = ahead;
+    memcpy(buff, batch->buf, count * sector_size);
+    return RES_OK;
+}
+
+static DRESULT ff_sdmmc_batch_write(BYTE pdrv, ff_sdmmc_batch_t* batch, const BYTE* buff, DWORD sector, UINT count)
+{
+    const size_t sector_size = s_cards[pdrv]->csd.sector_size;
+    if (!batch->dirty && ff_sdmmc_batch_overlaps(batch, sector, count)) {
+        batch->count = 0; // read-ahead data is stale now
+    }
+
+    // Append to the collected sectors, or overwrite some of them (e.g. a FAT sector written again)
+    if (batch->dirty && sector >= batch->start && sector <= batch->start + batch->count &&
+            sector + count <= batch->start + batch->capacity) {
+        memcpy(batch->buf + (sector - batch->start) * sector_size, buff, count * sector_size);
+        batch->count = MAX(batch->count, sector - batch->start + count);
+    } else {
+        if (ff_sdmmc_batch_flush(pdrv) != RES_OK) {
+            return RES_ERROR;
+        }
+        if (count >= batch->capacity) {
+            return ff_sdmmc_batch_transfer(pdrv, batch, (BYTE*) buff, sector, count, true);
+        }
+        memcpy(batch->buf, buff, count * sector_size);
+        batch->start = sector;
+        batch->count = count;
+        batch->dirty = true;
+    }
+
+    if (batch->count == batch->capacity) {
+        return ff_sdmmc_batch_flush(pdrv);
+    }
+    return RES_OK;
+}
+#endif // CONFIG_FATFS_SDMMC_BATCH
+
 //Check if SD/MMC card is present
 static DSTATUS ff_sdmmc_card_available(BYTE pdrv)
 {
@@ -51,6 +231,11 @@ DRESULT ff_sdmmc_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
 {
     sdmmc_card_t* card = s_cards[pdrv];
     assert(card);
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+    if (s_batches[pdrv]) {
+        return ff_sdmmc_batch_read(pdrv, s_batches[pdrv], buff, sector, count);
+    }
+#endif
     esp_err_t err = sdmmc_read_sectors(card, buff, sector, count);
     if (unlikely(err != ESP_OK)) {
         ESP_LOGE(TAG, "sdmmc_read_blocks failed (0x%x)", err);
@@ -63,6 +248,11 @@ DRESULT ff_sdmmc_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
 {
     sdmmc_card_t* card = s_cards[pdrv];
     assert(card);
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+    if (s_batches[pdrv]) {
+        return ff_sdmmc_batch_write(pdrv, s_batches[pdrv], buff, sector, count);
+    }
+#endif
     esp_err_t err = sdmmc_write_sectors(card, buff, sector, count);
     if (unlikely(err != ESP_OK)) {
         ESP_LOGE(TAG, "sdmmc_write_blocks failed (0x%x)", err);
@@ -78,6 +268,14 @@ DRESULT ff_sdmmc_trim (BYTE pdrv, DWORD start_sector, DWORD sector_count)
     assert(card);
     sdmmc_erase_arg_t arg;
 
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+    if (s_batches[pdrv]) {
+        if (ff_sdmmc_batch_flush(pdrv) != RES_OK) {
+            return RES_ERROR;
+        }
+        s_batches[pdrv]->count = 0;
+    }
+#endif
     arg = sdmmc_can_discard(card) == ESP_OK ? SDMMC_DISCARD_ARG : SDMMC_ERASE_ARG;
     esp_err_t err = sdmmc_erase_sectors(card, start_sector, sector_count, arg);
     if (unlikely(err != ESP_OK)) {
@@ -94,7 +292,11 @@ DRESULT ff_sdmmc_ioctl (BYTE pdrv, BYTE cmd, void* buff)
     assert(card);
     switch(cmd) {
         case CTRL_SYNC:
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+            return ff_sdmmc_batch_flush(pdrv);
+#else
             return RES_OK;
+#endif
         case GET_SECTOR_COUNT:
             *((DWORD*) buff) = card->csd.capacity;
             return RES_OK;
@@ -129,11 +331,34 @@ void ff_diskio_register_sdmmc(BYTE pdrv, sdmmc_card_t* card)
         .write = &ff_sdmmc_write,
         .ioctl = &ff_sdmmc_ioctl
     };
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+    /* A batch left over from a card which wasn't cleared is dropped, the card may be gone */
+    ff_sdmmc_batch_delete(pdrv);
+    s_batches[pdrv] = ff_sdmmc_batch_create(card);
+    if (s_batches[pdrv] == NULL) {
+        ESP_LOGW(TAG, "failed to allocate batch buffer, pdrv=%i, sectors are accessed one command at a time", pdrv);
+    }
+#endif
     s_cards[pdrv] = card;
     s_disk_status_check_en[pdrv] = false;
     ff_diskio_register(pdrv, &sdmmc_impl);
 }
 
+void ff_diskio_clear_pdrv_sdmmc(const sdmmc_card_t* card)
+{
+    for (int i = 0; i < FF_VOLUMES; i++) {
+        if (card == s_cards[i]) {
+#ifdef CONFIG_FATFS_SDMMC_BATCH
+            if (ff_sdmmc_batch_flush(i) != RES_OK) {
+                ESP_LOGE(TAG, "writing batched sectors on unmount failed, pdrv=%i", i);
+            }
+            ff_sdmmc_batch_delete(i);
+#endif
+            s_cards[i] = NULL;
+        }
+    }
+}
+
 BYTE ff_diskio_get_pdrv_card(const sdmmc_card_t* card)
 {
     for (int i = 0; i < FF_VOLUMES; i++) {
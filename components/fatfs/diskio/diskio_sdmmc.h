@@ -37,6 +37,16 @@ void ff_diskio_register_sdmmc(unsigned char pdrv, sdmmc_card_t* card);
  */
 BYTE ff_diskio_get_pdrv_card(const sdmmc_card_t* card);
 
+/**
+ * @brief Release the driver number used by a card
+ *
+ * Writes any sectors still collected for the card (see CONFIG_FATFS_SDMMC_BATCH)
+ * and frees the associated resources. Call this after unregistering the diskio driver.
+ *
+ * @param card The card which is no longer used
+ */
+void ff_diskio_clear_pdrv_sdmmc(const sdmmc_card_t* card);
+
 #ifdef __cplusplus
 }
 #endif
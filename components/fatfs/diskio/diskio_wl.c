@@ -5,6 +5,8 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
+#include <sys/param.h>
 #include "diskio_impl.h"
 #include "ffconf.h"
 #include "ff.h"
@@ -12,6 +14,13 @@
 #include "diskio_wl.h"
 #include "wear_levelling.h"
 #include "esp_compiler.h"
+#include "esp_bit_defs.h"
+#include "sdkconfig.h"
+#ifdef CONFIG_FATFS_WL_WRITE_CACHE
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#endif
 
 static const char* TAG = "ff_diskio_spiflash";
 
@@ -19,6 +28,273 @@ wl_handle_t ff_wl_handles[FF_VOLUMES] = {
         [0 ... FF_VOLUMES - 1] = WL_INVALID_HANDLE
 };
 
+#ifdef CONFIG_FATFS_WL_WRITE_CACHE
+
+/* Cache lines cover one flash erase sector, so that all the FATFS sectors
+ * written to it are committed with a single erase */
+#define FF_WL_CACHE_BLOCK_SIZE  4096
+
+typedef struct {
+    DWORD block;                /* index of the cached block, FF_WL_CACHE_NO_BLOCK if unused */
+    uint32_t valid;             /* bit per sector, set if data holds the sector */
+    uint32_t dirty;             /* bit per sector, set if the sector isn't written back yet */
+    uint32_t last_use;
+    BYTE *data;
+} ff_wl_cache_line_t;
+
+typedef struct {
+    SemaphoreHandle_t mutex;
+    TickType_t dirty_since;     /* tick count when the cache became dirty */
+    wl_handle_t wl_handle;
+    size_t sector_size;
+    size_t sectors_per_block;
+    DWORD sector_count;
+    uint32_t use_counter;
+    ff_wl_cache_line_t lines[CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS];
+} ff_wl_cache_t;
+
+#define FF_WL_CACHE_NO_BLOCK    ((DWORD) -1)
+
+static ff_wl_cache_t *s_wl_cache[FF_VOLUMES];
+
+static esp_err_t ff_wl_write_through(wl_handle_t wl_handle, size_t addr, const void *src, size_t size);
+
+static DWORD ff_wl_cache_block_sectors(const ff_wl_cache_t *cache, DWORD block)
+{
+    DWORD first = block * cache->sectors_per_block;
+    return MIN(cache->sectors_per_block, cache->sector_count - first);
+}
+
+static esp_err_t ff_wl_cache_write_back(ff_wl_cache_t *cache, ff_wl_cache_line_t *line)
+{
+    if (line->dirty == 0) {
+        return ESP_OK;
+    }
+    DWORD first = line->block * cache->sectors_per_block;
+    DWORD nsect = ff_wl_cache_block_sectors(cache, line->block);
+
+    /* Fill in the sectors which were never read or written, then replace the whole block */
+    for (DWORD i = 0; i < nsect; i++) {
+        if (!(line->valid & BIT(i))) {
+            esp_err_t err = wl_read(cache->wl_handle, (first + i) * cache->sector_size,
+                                    line->data + i * cache->sector_size, cache->sector_size);
+            if (unlikely(err != ESP_OK)) {
+                ESP_LOGE(TAG, "wl_read failed (0x%x)", err);
+                return err;
+            }
+            line->valid |= BIT(i);
+        }
+    }
+    esp_err_t err = ff_wl_write_through(cache->wl_handle, first * cache->sector_size, line->data, nsect * cache->sector_size);
+    if (err == ESP_OK) {
+        line->dirty = 0;
+    }
+    return err;
+}
+
+static esp_err_t ff_wl_cache_flush(ff_wl_cache_t *cache)
+{
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS; i++) {
+        esp_err_t err = ff_wl_cache_write_back(cache, &cache->lines[i]);
+        if (err != ESP_OK) {
+            ret = err;
+        }
+    }
+    return ret;
+}
+
+static ff_wl_cache_line_t *ff_wl_cache_find(ff_wl_cache_t *cache, DWORD block)
+{
+    for (int i = 0; i < CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS; i++) {
+        if (cache->lines[i].block == block) {
+            return &cache->lines[i];
+        }
+    }
+    return NULL;
+}
+
+/* Returns the line holding the block, evicting the least recently used line if needed */
+static esp_err_t ff_wl_cache_get_line(ff_wl_cache_t *cache, DWORD block, ff_wl_cache_line_t **out_line)
+{
+    ff_wl_cache_line_t *line = ff_wl_cache_find(cache, block);
+    if (!line) {
+        line = &cache->lines[0];
+        for (int i = 0; i < CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS; i++) {
+            ff_wl_cache_line_t *candidate = &cache->lines[i];
+            if (candidate->block == FF_WL_CACHE_NO_BLOCK) {
+                line = candidate;
+                break;
+            }
+            if ((int32_t)(candidate->last_use - line->last_use) < 0) {
+                line = candidate;
+            }
+        }
+        esp_err_t err = ff_wl_cache_write_back(cache, line);
+        if (err != ESP_OK) {
+            return err;
+        }
+        line->block = block;
+        line->valid = 0;
+        line->dirty = 0;
+    }
+    line->last_use = ++cache->use_counter;
+    *out_line = line;
+    return ESP_OK;
+}
+
+static bool ff_wl_cache_is_dirty(const ff_wl_cache_t *cache)
+{
+    for (int i = 0; i < CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS; i++) {
+        if (cache->lines[i].dirty != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Write back data which has been dirty for longer than the configured delay.
+ * This is done by the next disk access rather than by a timer, so that flash
+ * erase and write never run in the context of a system task. */
+static void ff_wl_cache_flush_expired(ff_wl_cache_t *cache)
+{
+#if CONFIG_FATFS_WL_WRITE_CACHE_FLUSH_MS > 0
+    if (ff_wl_cache_is_dirty(cache) &&
+            xTaskGetTickCount() - cache->dirty_since >= pdMS_TO_TICKS(CONFIG_FATFS_WL_WRITE_CACHE_FLUSH_MS)) {
+        esp_err_t err = ff_wl_cache_flush(cache);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "write-back failed (0x%x)", err);
+        }
+    }
+#endif
+}
+
+static void ff_wl_cache_delete(ff_wl_cache_t *cache)
+{
+    if (cache->mutex) {
+        vSemaphoreDelete(cache->mutex);
+    }
+    for (int i = 0; i < CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS; i++) {
+        free(cache->lines[i].data);
+    }
+    free(cache);
+}
+
+static esp_err_t ff_wl_cache_create(wl_handle_t wl_handle, ff_wl_cache_t **out_cache)
+{
+    size_t sector_size = wl_sector_size(wl_handle);
+    if (sector_size == 0 || sector_size > FF_WL_CACHE_BLOCK_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    ff_wl_cache_t *cache = calloc(1, sizeof(ff_wl_cache_t));
+    if (!cache) {
+        return ESP_ERR_NO_MEM;
+    }
+    cache->wl_handle = wl_handle;
+    cache->sector_size = sector_size;
+    cache->sectors_per_block = FF_WL_CACHE_BLOCK_SIZE / sector_size;
+    cache->sector_count = wl_size(wl_handle) / sector_size;
+    cache->mutex = xSemaphoreCreateMutex();
+    if (!cache->mutex) {
+        goto fail;
+    }
+    for (int i = 0; i < CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS; i++) {
+        cache->lines[i].block = FF_WL_CACHE_NO_BLOCK;
+        cache->lines[i].data = malloc(cache->sectors_per_block * sector_size);
+        if (!cache->lines[i].data) {
+            goto fail;
+        }
+    }
+    *out_cache = cache;
+    return ESP_OK;
+
+fail:
+    ff_wl_cache_delete(cache);
+    return ESP_ERR_NO_MEM;
+}
+
+static DRESULT ff_wl_cache_read(ff_wl_cache_t *cache, BYTE *buff, DWORD sector, UINT count)
+{
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    ff_wl_cache_flush_expired(cache);
+
+    /* Read from flash unless every sector is in the cache, then overlay cached sectors */
+    bool all_cached = true;
+    for (UINT i = 0; i < count && all_cached; i++) {
+        ff_wl_cache_line_t *line = ff_wl_cache_find(cache, (sector + i) / cache->sectors_per_block);
+        all_cached = line && (line->valid & BIT((sector + i) % cache->sectors_per_block));
+    }
+    if (!all_cached) {
+        esp_err_t err = wl_read(cache->wl_handle, sector * cache->sector_size, buff, count * cache->sector_size);
+        if (unlikely(err != ESP_OK)) {
+            xSemaphoreGive(cache->mutex);
+            ESP_LOGE(TAG, "wl_read failed (0x%x)", err);
+            return RES_ERROR;
+        }
+    }
+    for (UINT i = 0; i < count; i++) {
+        DWORD s = sector + i;
+        ff_wl_cache_line_t *line = ff_wl_cache_find(cache, s / cache->sectors_per_block);
+        uint32_t bit = BIT(s % cache->sectors_per_block);
+        if (line && (line->valid & bit)) {
+            memcpy(buff + i * cache->sector_size, line->data + (s % cache->sectors_per_block) * cache->sector_size, cache->sector_size);
+        }
+    }
+
+    xSemaphoreGive(cache->mutex);
+    return RES_OK;
+}
+
+static DRESULT ff_wl_cache_write(ff_wl_cache_t *cache, const BYTE *buff, DWORD sector, UINT count)
+{
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    ff_wl_cache_flush_expired(cache);
+    bool was_dirty = ff_wl_cache_is_dirty(cache);
+
+    if (count >= cache->sectors_per_block * CONFIG_FATFS_WL_WRITE_CACHE_BLOCKS) {
+        /* Too large to be worth caching: write through and forget cached copies */
+        for (UINT i = 0; i < count; i++) {
+            ff_wl_cache_line_t *line = ff_wl_cache_find(cache, (sector + i) / cache->sectors_per_block);
+            if (line) {
+                uint32_t bit = BIT((sector + i) % cache->sectors_per_block);
+                line->valid &= ~bit;
+                line->dirty &= ~bit;
+            }
+        }
+        err = ff_wl_write_through(cache->wl_handle, sector * cache->sector_size, buff, count * cache->sector_size);
+    } else {
+        for (UINT i = 0; i < count; i++) {
+            DWORD s = sector + i;
+            ff_wl_cache_line_t *line;
+            err = ff_wl_cache_get_line(cache, s / cache->sectors_per_block, &line);
+            if (err != ESP_OK) {
+                break;
+            }
+            uint32_t idx = s % cache->sectors_per_block;
+            memcpy(line->data + idx * cache->sector_size, buff + i * cache->sector_size, cache->sector_size);
+            line->valid |= BIT(idx);
+            line->dirty |= BIT(idx);
+        }
+        if (!was_dirty) {
+            cache->dirty_since = xTaskGetTickCount();
+        }
+    }
+
+    xSemaphoreGive(cache->mutex);
+    return (err == ESP_OK) ? RES_OK : RES_ERROR;
+}
+
+static DRESULT ff_wl_cache_sync(ff_wl_cache_t *cache)
+{
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    esp_err_t err = ff_wl_cache_flush(cache);
+    xSemaphoreGive(cache->mutex);
+    return (err == ESP_OK) ? RES_OK : RES_ERROR;
+}
+
+#endif // CONFIG_FATFS_WL_WRITE_CACHE
+
 DSTATUS ff_wl_initialize (BYTE pdrv)
 {
     return 0;
@@ -34,6 +310,11 @@ DRESULT ff_wl_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
     ESP_LOGV(TAG, "ff_wl_read - pdrv=%i, sector=%i, count=%i", (unsigned int)pdrv, (unsigned int)sector, (unsigned int)count);
     wl_handle_t wl_handle = ff_wl_handles[pdrv];
     assert(wl_handle + 1);
+#ifdef CONFIG_FATFS_WL_WRITE_CACHE
+    if (s_wl_cache[pdrv]) {
+        return ff_wl_cache_read(s_wl_cache[pdrv], buff, sector, count);
+    }
+#endif
     esp_err_t err = wl_read(wl_handle, sector * wl_sector_size(wl_handle), buff, count * wl_sector_size(wl_handle));
     if (unlikely(err != ESP_OK)) {
         ESP_LOGE(TAG, "wl_read failed (0x%x)", err);
@@ -42,22 +323,33 @@ DRESULT ff_wl_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
     return RES_OK;
 }
 
-DRESULT ff_wl_write (BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+static esp_err_t ff_wl_write_through(wl_handle_t wl_handle, size_t addr, const void *src, size_t size)
 {
-    ESP_LOGV(TAG, "ff_wl_write - pdrv=%i, sector=%i, count=%i", (unsigned int)pdrv, (unsigned int)sector, (unsigned int)count);
-    wl_handle_t wl_handle = ff_wl_handles[pdrv];
-    assert(wl_handle + 1);
-    esp_err_t err = wl_erase_range(wl_handle, sector * wl_sector_size(wl_handle), count * wl_sector_size(wl_handle));
+    esp_err_t err = wl_erase_range(wl_handle, addr, size);
     if (unlikely(err != ESP_OK)) {
         ESP_LOGE(TAG, "wl_erase_range failed (0x%x)", err);
-        return RES_ERROR;
+        return err;
     }
-    err = wl_write(wl_handle, sector * wl_sector_size(wl_handle), buff, count * wl_sector_size(wl_handle));
+    err = wl_write(wl_handle, addr, src, size);
     if (unlikely(err != ESP_OK)) {
         ESP_LOGE(TAG, "wl_write failed (0x%x)", err);
-        return RES_ERROR;
+        return err;
     }
-    return RES_OK;
+    return ESP_OK;
+}
+
+DRESULT ff_wl_write (BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    ESP_LOGV(TAG, "ff_wl_write - pdrv=%i, sector=%i, count=%i", (unsigned int)pdrv, (unsigned int)sector, (unsigned int)count);
+    wl_handle_t wl_handle = ff_wl_handles[pdrv];
+    assert(wl_handle + 1);
+#ifdef CONFIG_FATFS_WL_WRITE_CACHE
+    if (s_wl_cache[pdrv]) {
+        return ff_wl_cache_write(s_wl_cache[pdrv], buff, sector, count);
+    }
+#endif
+    esp_err_t err = ff_wl_write_through(wl_handle, sector * wl_sector_size(wl_handle), buff, count * wl_sector_size(wl_handle));
+    return (err == ESP_OK) ? RES_OK : RES_ERROR;
 }
 
 DRESULT ff_wl_ioctl (BYTE pdrv, BYTE cmd, void *buff)
@@ -67,6 +359,11 @@ DRESULT ff_wl_ioctl (BYTE pdrv, BYTE cmd, void *buff)
     assert(wl_handle + 1);
     switch (cmd) {
     case CTRL_SYNC:
+#ifdef CONFIG_FATFS_WL_WRITE_CACHE
+        if (s_wl_cache[pdrv]) {
+            return ff_wl_cache_sync(s_wl_cache[pdrv]);
+        }
+#endif
         return RES_OK;
     case GET_SECTOR_COUNT:
         *((DWORD *) buff) = wl_size(wl_handle) / wl_sector_size(wl_handle);
@@ -93,6 +390,18 @@ esp_err_t ff_diskio_register_wl_partition(BYTE pdrv, wl_handle_t flash_handle)
         .write = &ff_wl_write,
         .ioctl = &ff_wl_ioctl
     };
+#ifdef CONFIG_FATFS_WL_WRITE_CACHE
+    if (s_wl_cache[pdrv]) {
+        /* Left over from a volume which wasn't cleared, its handle may not be valid anymore */
+        ff_wl_cache_delete(s_wl_cache[pdrv]);
+        s_wl_cache[pdrv] = NULL;
+    }
+    esp_err_t err = ff_wl_cache_create(flash_handle, &s_wl_cache[pdrv]);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "failed to create write-back cache (0x%x)", err);
+        return err;
+    }
+#endif
     ff_wl_handles[pdrv] = flash_handle;
     ff_diskio_register(pdrv, &wl_impl);
     return ESP_OK;
@@ -112,6 +421,15 @@ void ff_diskio_clear_pdrv_wl(wl_handle_t flash_handle)
 {
     for (int i = 0; i < FF_VOLUMES; i++) {
         if (flash_handle == ff_wl_handles[i]) {
+#ifdef CONFIG_FATFS_WL_WRITE_CACHE
+            if (s_wl_cache[i]) {
+                if (ff_wl_cache_sync(s_wl_cache[i]) != RES_OK) {
+                    ESP_LOGE(TAG, "write-back on unmount failed, pdrv=%i", i);
+                }
+                ff_wl_cache_delete(s_wl_cache[i]);
+                s_wl_cache[i] = NULL;
+            }
+#endif
             ff_wl_handles[i] = WL_INVALID_HANDLE;
         }
     }
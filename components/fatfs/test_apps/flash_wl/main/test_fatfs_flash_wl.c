@@ -24,6 +24,9 @@
 #include "esp_partition.h"
 #include "esp_memory_utils.h"
 #include "vfs_fat_internal.h"
+#include "diskio_impl.h"
+#include "diskio_wl.h"
+#include "diskio.h"
 
 void app_main(void)
 {
@@ -187,6 +190,31 @@ TEST_CASE("(WL) can lseek", "[fatfs][wear_levelling]")
     test_teardown();
 }
 
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+TEST_CASE("(WL) fast seek tables are cached and invalidated", "[fatfs][wear_levelling]")
+{
+    test_setup();
+    test_fatfs_fastseek_cache("/spiflash/replay.bin", "/spiflash/other.bin");
+    test_teardown();
+}
+#endif
+
+TEST_CASE("(WL) read-ahead and write-behind buffering", "[fatfs][wear_levelling]")
+{
+    esp_vfs_fat_mount_config_t mount_config = {
+        .format_if_mount_failed = true,
+        .max_files = 5,
+        .read_ahead_size = 1024,
+        .write_behind_size = 512,
+    };
+    TEST_ESP_OK(esp_vfs_fat_spiflash_mount_rw_wl("/spiflash", NULL, &mount_config, &s_test_wl_handle));
+    test_fatfs_buffered_rw("/spiflash/buffered.bin");
+    test_fatfs_lseek("/spiflash/seek.txt");
+    test_fatfs_overwrite_append("/spiflash/hello.txt");
+    test_fatfs_pwrite_file("/spiflash/pwrite.txt");
+    test_teardown();
+}
+
 TEST_CASE("(WL) can truncate", "[fatfs][wear_levelling]")
 {
     test_setup();
@@ -348,3 +376,72 @@ TEST_CASE("Size is correct after write when immediate fsync is enabled", "[fatfs
 }
 
 #endif // CONFIG_FATFS_IMMEDIATE_FSYNC
+
+#if CONFIG_FATFS_WL_WRITE_CACHE
+
+TEST_CASE("(WL) write-back cache defers flash writes until sync", "[fatfs][wear_levelling]")
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, NULL);
+    TEST_ASSERT_NOT_NULL(part);
+    wl_handle_t wl_handle;
+    TEST_ESP_OK(wl_mount(part, &wl_handle));
+    BYTE pdrv;
+    TEST_ESP_OK(ff_diskio_get_drive(&pdrv));
+    TEST_ESP_OK(ff_diskio_register_wl_partition(pdrv, wl_handle));
+
+    const size_t sector_size = wl_sector_size(wl_handle);
+    const LBA_t sector = 1;
+    BYTE *orig = malloc(sector_size);
+    BYTE *data = malloc(sector_size);
+    BYTE *check = malloc(sector_size);
+    TEST_ASSERT_NOT_NULL(orig);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_NOT_NULL(check);
+
+    TEST_ASSERT_EQUAL(RES_OK, disk_read(pdrv, orig, sector, 1));
+    for (size_t i = 0; i < sector_size; i++) {
+        data[i] = orig[i] ^ 0xa5;
+    }
+    TEST_ASSERT_EQUAL(RES_OK, disk_write(pdrv, data, sector, 1));
+
+    // Flash still holds the old data, reads are served from the cache
+    TEST_ESP_OK(wl_read(wl_handle, sector * sector_size, check, sector_size));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(orig, check, sector_size);
+    TEST_ASSERT_EQUAL(RES_OK, disk_read(pdrv, check, sector, 1));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(data, check, sector_size);
+
+    TEST_ASSERT_EQUAL(RES_OK, disk_ioctl(pdrv, CTRL_SYNC, NULL));
+    TEST_ESP_OK(wl_read(wl_handle, sector * sector_size, check, sector_size));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(data, check, sector_size);
+
+    // Restore the sector
+    TEST_ASSERT_EQUAL(RES_OK, disk_write(pdrv, orig, sector, 1));
+#if CONFIG_FATFS_WL_WRITE_CACHE_FLUSH_MS > 0
+    // Expired data is written back by the next access to the volume
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_FATFS_WL_WRITE_CACHE_FLUSH_MS) + 1);
+    TEST_ASSERT_EQUAL(RES_OK, disk_read(pdrv, check, sector + 1, 1));
+#else
+    TEST_ASSERT_EQUAL(RES_OK, disk_ioctl(pdrv, CTRL_SYNC, NULL));
+#endif
+    TEST_ESP_OK(wl_read(wl_handle, sector * sector_size, check, sector_size));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(orig, check, sector_size);
+
+    free(orig);
+    free(data);
+    free(check);
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    TEST_ESP_OK(wl_unmount(wl_handle));
+}
+
+TEST_CASE("(WL) write-back cache keeps data across remount", "[fatfs][wear_levelling]")
+{
+    test_setup();
+    test_fatfs_create_file_with_text("/spiflash/cached.txt", fatfs_test_hello_str);
+    test_teardown();
+    test_setup();
+    test_fatfs_read_file("/spiflash/cached.txt");
+    test_teardown();
+}
+
+#endif // CONFIG_FATFS_WL_WRITE_CACHE
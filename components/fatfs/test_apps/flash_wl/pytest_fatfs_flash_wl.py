@@ -1,4 +1,4 @@
-# SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+# SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: CC0-1.0
 
 import pytest
@@ -13,6 +13,8 @@ from pytest_embedded import Dut
         'default',
         'release',
         'fastseek',
+        'io_chunk',
+        'wl_cache',
     ]
 )
 def test_fatfs_flash_wl_generic(dut: Dut) -> None:
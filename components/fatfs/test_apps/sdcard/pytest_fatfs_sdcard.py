@@ -12,6 +12,7 @@ from pytest_embedded import Dut
     [
         'default',
         'release',
+        'batch',
     ]
 )
 def test_fatfs_sdcard_generic_sdmmc(dut: Dut) -> None:
@@ -30,6 +31,7 @@ def test_fatfs_sdcard_generic_sdmmc(dut: Dut) -> None:
     [
         'default',
         'release',
+        'batch',
     ]
 )
 def test_fatfs_sdcard_generic_sdspi(dut: Dut) -> None:
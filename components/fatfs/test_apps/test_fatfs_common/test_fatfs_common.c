@@ -13,6 +13,7 @@
 #include <sys/time.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
+#include <sys/param.h>
 #include <errno.h>
 #include <utime.h>
 #include "unity.h"
@@ -253,6 +254,168 @@ void test_fatfs_lseek(const char* filename)
 
 }
 
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+static void write_pattern_file(const char* filename, uint8_t seed, size_t size)
+{
+    uint8_t buf[128];
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    for (size_t pos = 0; pos < size; pos += sizeof(buf)) {
+        for (size_t i = 0; i < sizeof(buf); i++) {
+            buf[i] = (uint8_t) (seed + (pos + i) / 4);
+        }
+        TEST_ASSERT_EQUAL(sizeof(buf), write(fd, buf, sizeof(buf)));
+    }
+    TEST_ASSERT_EQUAL(0, close(fd));
+}
+
+static void check_pattern_at(int fd, uint8_t seed, off_t offset)
+{
+    uint8_t val;
+    TEST_ASSERT_EQUAL(offset, lseek(fd, offset, SEEK_SET));
+    TEST_ASSERT_EQUAL(1, read(fd, &val, 1));
+    TEST_ASSERT_EQUAL((uint8_t) (seed + offset / 4), val);
+}
+
+void test_fatfs_fastseek_cache(const char* filename, const char* other_filename)
+{
+    const size_t size = 64 * 1024;
+    const off_t offsets[] = { size - 1, 0, 3 * size / 4, 4097, size / 2 };
+
+    // Interleave two files so that their cluster chains are fragmented
+    int fd1 = open(filename, O_WRONLY | O_CREAT | O_TRUNC);
+    int fd2 = open(other_filename, O_WRONLY | O_CREAT | O_TRUNC);
+    TEST_ASSERT_NOT_EQUAL(-1, fd1);
+    TEST_ASSERT_NOT_EQUAL(-1, fd2);
+    const size_t chunk = 4096;
+    uint8_t* buf = malloc(chunk);
+    TEST_ASSERT_NOT_NULL(buf);
+    for (size_t pos = 0; pos < size; pos += chunk) {
+        for (size_t i = 0; i < chunk; i++) {
+            buf[i] = (uint8_t) (1 + (pos + i) / 4);
+        }
+        TEST_ASSERT_EQUAL(chunk, write(fd1, buf, chunk));
+        TEST_ASSERT_EQUAL(chunk, write(fd2, buf, chunk));
+    }
+    free(buf);
+    TEST_ASSERT_EQUAL(0, close(fd1));
+    TEST_ASSERT_EQUAL(0, close(fd2));
+
+    // The table is created by the first open, shared by the second descriptor and reused after close
+    for (int round = 0; round < 2; round++) {
+        fd1 = open(filename, O_RDONLY);
+        fd2 = open(filename, O_RDONLY);
+        TEST_ASSERT_NOT_EQUAL(-1, fd1);
+        TEST_ASSERT_NOT_EQUAL(-1, fd2);
+        for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+            check_pattern_at(fd1, 1, offsets[i]);
+            check_pattern_at(fd2, 1, offsets[sizeof(offsets) / sizeof(offsets[0]) - 1 - i]);
+        }
+        TEST_ASSERT_EQUAL(0, close(fd1));
+        TEST_ASSERT_EQUAL(0, close(fd2));
+    }
+
+    // After the file is removed and created again, its clusters may differ
+    TEST_ASSERT_EQUAL(0, unlink(other_filename));
+    TEST_ASSERT_EQUAL(0, unlink(filename));
+    write_pattern_file(other_filename, 5, 4096);
+    write_pattern_file(filename, 9, size);
+    fd1 = open(filename, O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd1);
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        check_pattern_at(fd1, 9, offsets[i]);
+    }
+    TEST_ASSERT_EQUAL(0, close(fd1));
+
+    // Same for a file truncated when opened
+    write_pattern_file(filename, 17, size);
+    fd1 = open(filename, O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd1);
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        check_pattern_at(fd1, 17, offsets[i]);
+    }
+    TEST_ASSERT_EQUAL(0, close(fd1));
+}
+#endif // CONFIG_FATFS_USE_FASTSEEK
+
+static void check_file_content(int fd, const uint8_t* expected, size_t size, size_t chunk)
+{
+    uint8_t buf[64];
+    TEST_ASSERT_EQUAL(0, lseek(fd, 0, SEEK_SET));
+    for (size_t pos = 0; pos < size; pos += chunk) {
+        size_t n = MIN(chunk, size - pos);
+        TEST_ASSERT_EQUAL(n, read(fd, buf, n));
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected + pos, buf, n);
+    }
+    TEST_ASSERT_EQUAL(0, read(fd, buf, chunk));
+}
+
+void test_fatfs_buffered_rw(const char* filename)
+{
+    const size_t chunk = 37;
+    const size_t size = 100 * chunk;
+    uint8_t* expected = malloc(size + 10);
+    TEST_ASSERT_NOT_NULL(expected);
+    for (size_t i = 0; i < size + 10; i++) {
+        expected[i] = (uint8_t) (i * 7);
+    }
+
+    // Small writes are collected, the size is up to date when queried through the descriptor
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    for (size_t pos = 0; pos < size; pos += chunk) {
+        TEST_ASSERT_EQUAL(chunk, write(fd, expected + pos, chunk));
+    }
+    struct stat st;
+    TEST_ASSERT_EQUAL(0, fstat(fd, &st));
+    TEST_ASSERT_EQUAL(size, st.st_size);
+
+    // Seeking within and outside of the read-ahead data
+    uint8_t buf[8];
+    TEST_ASSERT_EQUAL(10, lseek(fd, 10, SEEK_SET));
+    TEST_ASSERT_EQUAL(5, read(fd, buf, 5));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected + 10, buf, 5);
+    TEST_ASSERT_EQUAL(5, read(fd, buf, 5));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected + 15, buf, 5);
+    TEST_ASSERT_EQUAL(17, lseek(fd, -3, SEEK_CUR));
+    TEST_ASSERT_EQUAL(1, read(fd, buf, 1));
+    TEST_ASSERT_EQUAL(expected[17], buf[0]);
+    TEST_ASSERT_EQUAL(size - 2, lseek(fd, -2, SEEK_END));
+    TEST_ASSERT_EQUAL(2, read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected + size - 2, buf, 2);
+
+    // Writing after reading starts at the read position
+    TEST_ASSERT_EQUAL(200, lseek(fd, 200, SEEK_SET));
+    TEST_ASSERT_EQUAL(4, read(fd, buf, 4));
+    memcpy(expected + 204, "abc", 3);
+    TEST_ASSERT_EQUAL(3, write(fd, "abc", 3));
+    TEST_ASSERT_EQUAL(207, lseek(fd, 0, SEEK_CUR));
+
+    // pread/pwrite see and keep the buffered data
+    memcpy(expected + 100, "XYZ", 3);
+    TEST_ASSERT_EQUAL(3, pwrite(fd, "XYZ", 3, 100));
+    TEST_ASSERT_EQUAL(3, pread(fd, buf, 3, 204));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY("abc", buf, 3);
+    TEST_ASSERT_EQUAL(207, lseek(fd, 0, SEEK_CUR));
+
+    check_file_content(fd, expected, size, 7);
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    // O_APPEND writes are collected at the end of the file
+    fd = open(filename, O_WRONLY | O_APPEND);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    for (size_t pos = size; pos < size + 10; pos += 5) {
+        TEST_ASSERT_EQUAL(5, write(fd, expected + pos, 5));
+    }
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    fd = open(filename, O_RDONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    check_file_content(fd, expected, size + 10, 13);
+    TEST_ASSERT_EQUAL(0, close(fd));
+    free(expected);
+}
+
 void test_fatfs_truncate_file(const char* filename)
 {
     int read = 0;
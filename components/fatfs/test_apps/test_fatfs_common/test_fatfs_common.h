@@ -45,6 +45,10 @@ void test_fatfs_open_max_files(const char* filename_prefix, size_t files_count);
 
 void test_fatfs_lseek(const char* filename);
 
+void test_fatfs_fastseek_cache(const char* filename, const char* other_filename);
+
+void test_fatfs_buffered_rw(const char* filename);
+
 void test_fatfs_truncate_file(const char* path);
 
 void test_fatfs_ftruncate_file(const char* path);
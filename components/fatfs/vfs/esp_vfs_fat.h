@@ -41,6 +41,33 @@ extern "C" {
 esp_err_t esp_vfs_fat_register(const char* base_path, const char* fat_drive,
         size_t max_files, FATFS** out_fs);
 
+/**
+ * @brief Configuration structure for esp_vfs_fat_register_cfg
+ */
+typedef struct {
+    const char* base_path;      ///< Path prefix where FATFS should be registered
+    const char* fat_drive;      ///< FATFS drive specification; if only one drive is used, can be an empty string
+    size_t max_files;           ///< Maximum number of files which can be open at the same time
+    size_t read_ahead_size;     ///< Size of the per-file read-ahead buffer in bytes, 0 to disable (see esp_vfs_fat_mount_config_t)
+    size_t write_behind_size;   ///< Size of the per-file write-behind buffer in bytes, 0 to disable (see esp_vfs_fat_mount_config_t)
+} esp_vfs_fat_conf_t;
+
+/**
+ * @brief Register FATFS with VFS component
+ *
+ * Same as esp_vfs_fat_register, but takes the configuration as a structure,
+ * which additionally allows to enable per-file buffering.
+ *
+ * @param conf  pointer to the configuration structure
+ * @param[out] out_fs  pointer to FATFS structure which can be used for FATFS f_mount call is returned via this argument.
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if conf is NULL
+ *      - ESP_ERR_INVALID_STATE if esp_vfs_fat_register was already called
+ *      - ESP_ERR_NO_MEM if not enough memory or too many VFSes already registered
+ */
+esp_err_t esp_vfs_fat_register_cfg(const esp_vfs_fat_conf_t* conf, FATFS** out_fs);
+
 /**
  * @brief Un-register FATFS from VFS
  *
@@ -104,6 +131,27 @@ typedef struct {
      * may be different.
      */
     bool use_one_fat;
+    /**
+     * Size of the read-ahead buffer allocated for each file opened for
+     * reading, in bytes. Setting this field to 0 disables read-ahead.
+     *
+     * Once reads of a file are detected to be sequential, data is read from
+     * the disk in chunks of this size and small reads are served from the
+     * buffer without accessing FATFS. Using a multiple of the sector size
+     * gives the best results.
+     */
+    size_t read_ahead_size;
+    /**
+     * Size of the write-behind buffer allocated for each file opened for
+     * writing, in bytes. Setting this field to 0 disables write-behind.
+     *
+     * Consecutive small writes are collected in the buffer and passed to
+     * FATFS once it is full, or when the file is read, seeked, synchronized,
+     * truncated, stat-ed through its descriptor or closed. Errors of
+     * the deferred writes (such as a full disk) are reported by the call
+     * which writes the buffer out, e.g. fsync or close.
+     */
+    size_t write_behind_size;
 } esp_vfs_fat_mount_config_t;
 
 #define VFS_FAT_MOUNT_DEFAULT_CONFIG() \
@@ -113,6 +161,8 @@ typedef struct {
         .allocation_unit_size = 0, \
         .disk_status_check_enable = false, \
         .use_one_fat = false, \
+        .read_ahead_size = 0, \
+        .write_behind_size = 0, \
     }
 
 // Compatibility definition
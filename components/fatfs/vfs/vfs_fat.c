@@ -11,20 +11,65 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/lock.h>
+#include <sys/param.h>
+#include <stdatomic.h>
 #include "esp_vfs.h"
+#include "esp_vfs_fat.h"
 #include "esp_log.h"
 #include "ff.h"
 #include "diskio_impl.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* Per-file read-ahead/write-behind state. Data is buffered in one direction at a time:
+ * either buf holds data read ahead of the current position (dirty == false), or data
+ * written but not yet passed to f_write (dirty == true). */
+typedef struct {
+    uint8_t *buf;       /* buffer of MAX(read_ahead_size, write_behind_size) bytes, NULL if the file is not buffered */
+    FSIZE_t pos;        /* file offset of buf[0] */
+    size_t len;         /* number of valid (read-ahead) or pending (write-behind) bytes in buf */
+    size_t off;         /* read position within buf */
+    bool dirty;         /* buf holds data which still has to be written */
+    FSIZE_t next_read;  /* offset where the next read starts if the access is sequential */
+    size_t ra_size;     /* read-ahead size for this file, 0 if disabled */
+    size_t wb_size;     /* write-behind size for this file, 0 if disabled */
+} vfs_fat_file_buf_t;
+
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+/* Cluster link map table (CLMT) of a file. A table is shared by all descriptors of the file
+ * opened read-only and kept after they are closed, so that opening the file again doesn't
+ * walk the FAT chain. Unused tables are freed in least recently used order when the memory
+ * budget is exhausted, tables of files which may have changed are freed once unused. */
+typedef struct vfs_fat_clmt {
+    struct vfs_fat_clmt *next;
+    WORD fs_id;         /* mount ID of the volume when the table was created */
+    bool stale;         /* the file may have been changed, the table must not be reused */
+    DWORD sclust;       /* first cluster of the file */
+    FSIZE_t size;       /* size of the file */
+    size_t refs;        /* number of open files using the table */
+    uint32_t last_use;  /* value of the context's clmt_clock at the last use */
+    size_t alloc_size;  /* size of the allocation, accounted in the memory budget */
+    DWORD tbl[];        /* table passed to FATFS as FIL::cltbl */
+} vfs_fat_clmt_t;
+#endif // CONFIG_FATFS_USE_FASTSEEK
 
 typedef struct {
     char fat_drive[8];  /* FAT drive name */
     char base_path[ESP_VFS_PATH_MAX];   /* base path in VFS where partition is registered */
     size_t max_files;   /* max number of simultaneously open files; size of files[] array */
-    _lock_t lock;       /* guard for access to this structure */
+    _lock_t lock;       /* guard for the file table and the temporary path buffers */
+    _lock_t *file_locks;    /* per-file locks serializing data access to each of max_files entries */
     FATFS fs;           /* fatfs library FS structure */
     char tmp_path_buf[FILENAME_MAX+3];  /* temporary buffer used to prepend drive name to the path */
     char tmp_path_buf2[FILENAME_MAX+3]; /* as above; used in functions which take two path arguments */
     bool *o_append;  /* O_APPEND is stored here for each max_files entries (because O_APPEND is not compatible with FA_OPEN_APPEND) */
+    size_t read_ahead_size;     /* per-file read-ahead buffer size, 0 if disabled */
+    size_t write_behind_size;   /* per-file write-behind buffer size, 0 if disabled */
+    vfs_fat_file_buf_t *file_bufs;  /* array with max_files entries, NULL if buffering is disabled */
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    vfs_fat_clmt_t *clmts;  /* cached cluster link map tables, guarded by lock */
+    uint32_t clmt_clock;    /* incremented on each use of a table */
+#endif
     FIL files[0];   /* array with max_files entries; must be the final member of the structure */
 } vfs_fat_ctx_t;
 
@@ -87,6 +132,9 @@ static int vfs_fat_utime(void* ctx, const char *path, const struct utimbuf *time
 static int fresult_to_errno(FRESULT fr);
 
 static vfs_fat_ctx_t* s_fat_ctxs[FF_VOLUMES] = { NULL };
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+static atomic_size_t s_clmt_mem_used;   /* memory used by the tables of all volumes */
+#endif
 //backwards-compatibility with esp_vfs_fat_unregister()
 static vfs_fat_ctx_t* s_fat_ctx = NULL;
 
@@ -112,6 +160,23 @@ static size_t find_unused_context_index(void)
 
 esp_err_t esp_vfs_fat_register(const char* base_path, const char* fat_drive, size_t max_files, FATFS** out_fs)
 {
+    const esp_vfs_fat_conf_t conf = {
+        .base_path = base_path,
+        .fat_drive = fat_drive,
+        .max_files = max_files,
+    };
+    return esp_vfs_fat_register_cfg(&conf, out_fs);
+}
+
+esp_err_t esp_vfs_fat_register_cfg(const esp_vfs_fat_conf_t* conf, FATFS** out_fs)
+{
+    if (conf == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char* base_path = conf->base_path;
+    const char* fat_drive = conf->fat_drive;
+    size_t max_files = conf->max_files;
+
     size_t ctx = find_context_index_by_path(base_path);
     if (ctx < FF_VOLUMES) {
         return ESP_ERR_INVALID_STATE;
@@ -169,18 +234,41 @@ esp_err_t esp_vfs_fat_register(const char* base_path, const char* fat_drive, siz
         return ESP_ERR_NO_MEM;
     }
     memset(fat_ctx->o_append, 0, max_files * sizeof(bool));
+    fat_ctx->file_locks = ff_memalloc(max_files * sizeof(_lock_t));
+    if (fat_ctx->file_locks == NULL) {
+        free(fat_ctx->o_append);
+        free(fat_ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    if (conf->read_ahead_size > 0 || conf->write_behind_size > 0) {
+        fat_ctx->file_bufs = ff_memalloc(max_files * sizeof(vfs_fat_file_buf_t));
+        if (fat_ctx->file_bufs == NULL) {
+            free(fat_ctx->file_locks);
+            free(fat_ctx->o_append);
+            free(fat_ctx);
+            return ESP_ERR_NO_MEM;
+        }
+        memset(fat_ctx->file_bufs, 0, max_files * sizeof(vfs_fat_file_buf_t));
+        fat_ctx->read_ahead_size = conf->read_ahead_size;
+        fat_ctx->write_behind_size = conf->write_behind_size;
+    }
     fat_ctx->max_files = max_files;
     strlcpy(fat_ctx->fat_drive, fat_drive, sizeof(fat_ctx->fat_drive) - 1);
     strlcpy(fat_ctx->base_path, base_path, sizeof(fat_ctx->base_path) - 1);
 
     esp_err_t err = esp_vfs_register(base_path, &vfs, fat_ctx);
     if (err != ESP_OK) {
+        free(fat_ctx->file_bufs);
+        free(fat_ctx->file_locks);
         free(fat_ctx->o_append);
         free(fat_ctx);
         return err;
     }
 
     _lock_init(&fat_ctx->lock);
+    for (size_t i = 0; i < max_files; i++) {
+        _lock_init(&fat_ctx->file_locks[i]);
+    }
     s_fat_ctxs[ctx] = fat_ctx;
 
     //compatibility
@@ -202,7 +290,20 @@ esp_err_t esp_vfs_fat_unregister_path(const char* base_path)
     if (err != ESP_OK) {
         return err;
     }
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+    while (fat_ctx->clmts != NULL) {
+        vfs_fat_clmt_t* clmt = fat_ctx->clmts;
+        fat_ctx->clmts = clmt->next;
+        atomic_fetch_sub(&s_clmt_mem_used, clmt->alloc_size);
+        ff_memfree(clmt);
+    }
+#endif
     _lock_close(&fat_ctx->lock);
+    for (size_t i = 0; i < fat_ctx->max_files; i++) {
+        _lock_close(&fat_ctx->file_locks[i]);
+    }
+    free(fat_ctx->file_locks);
+    free(fat_ctx->file_bufs);
     free(fat_ctx->o_append);
     free(fat_ctx);
     s_fat_ctxs[ctx] = NULL;
@@ -305,9 +406,277 @@ static int fresult_to_errno(FRESULT fr)
     return ENOTSUP;
 }
 
+#ifdef CONFIG_FATFS_USE_FASTSEEK
+static bool clmt_mem_reserve(size_t size)
+{
+#if CONFIG_FATFS_FAST_SEEK_MEMORY_BUDGET > 0
+    size_t used = atomic_load(&s_clmt_mem_used);
+    do {
+        if (used + size > CONFIG_FATFS_FAST_SEEK_MEMORY_BUDGET) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&s_clmt_mem_used, &used, used + size));
+#else
+    atomic_fetch_add(&s_clmt_mem_used, size);
+#endif
+    return true;
+}
+
+static void clmt_free(vfs_fat_ctx_t* ctx, vfs_fat_clmt_t* clmt)
+{
+    for (vfs_fat_clmt_t** p = &ctx->clmts; *p != NULL; p = &(*p)->next) {
+        if (*p == clmt) {
+            *p = clmt->next;
+            break;
+        }
+    }
+    atomic_fetch_sub(&s_clmt_mem_used, clmt->alloc_size);
+    ff_memfree(clmt);
+}
+
+/* Frees the least recently used table of the volume which is not in use */
+static bool clmt_evict(vfs_fat_ctx_t* ctx)
+{
+    vfs_fat_clmt_t* lru = NULL;
+    for (vfs_fat_clmt_t* clmt = ctx->clmts; clmt != NULL; clmt = clmt->next) {
+        if (clmt->refs == 0 && (lru == NULL || (int32_t) (clmt->last_use - lru->last_use) < 0)) {
+            lru = clmt;
+        }
+    }
+    if (lru == NULL) {
+        return false;
+    }
+    clmt_free(ctx, lru);
+    return true;
+}
+
+static vfs_fat_clmt_t* clmt_alloc(vfs_fat_ctx_t* ctx, DWORD items)
+{
+    size_t size = sizeof(vfs_fat_clmt_t) + items * sizeof(DWORD);
+    while (!clmt_mem_reserve(size)) {
+        if (!clmt_evict(ctx)) {
+            return NULL;
+        }
+    }
+    vfs_fat_clmt_t* clmt = ff_memalloc(size);
+    if (clmt == NULL) {
+        atomic_fetch_sub(&s_clmt_mem_used, size);
+        return NULL;
+    }
+    memset(clmt, 0, sizeof(*clmt));
+    clmt->alloc_size = size;
+    clmt->tbl[0] = items;
+    return clmt;
+}
+
+/**
+ * @brief Enable fast seek for a file opened read-only
+ *
+ * Uses the cached table of the file or creates a new one. If the table can't be
+ * created, the file falls back to the normal seek.
+ * Call this function with ctx->lock acquired.
+ */
+static void clmt_attach(vfs_fat_ctx_t* ctx, FIL* file)
+{
+    if (f_size(file) == 0 || f_size(file) < CONFIG_FATFS_FAST_SEEK_MIN_FILE_SIZE) {
+        return;
+    }
+    vfs_fat_clmt_t* clmt = ctx->clmts;
+    while (clmt != NULL) {
+        vfs_fat_clmt_t* next = clmt->next;
+        if (clmt->fs_id != ctx->fs.id) {
+            clmt->stale = true;     // the volume was remounted or formatted
+        }
+        if (clmt->stale) {
+            if (clmt->refs == 0) {
+                clmt_free(ctx, clmt);
+            }
+        } else if (clmt->sclust == file->obj.sclust && clmt->size == f_size(file)) {
+            break;
+        }
+        clmt = next;
+    }
+
+    if (clmt == NULL) {
+        clmt = clmt_alloc(ctx, CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE);
+        file->cltbl = clmt ? clmt->tbl : NULL;
+        FRESULT res = clmt ? f_lseek(file, CREATE_LINKMAP) : FR_NOT_ENOUGH_CORE;
+        if (res == FR_NOT_ENOUGH_CORE && clmt != NULL) {
+            // The file is more fragmented, the required size has been stored in tbl[0]
+            DWORD items = clmt->tbl[0];
+            clmt_free(ctx, clmt);
+            clmt = clmt_alloc(ctx, items);
+            file->cltbl = clmt ? clmt->tbl : NULL;
+            res = clmt ? f_lseek(file, CREATE_LINKMAP) : FR_NOT_ENOUGH_CORE;
+        }
+        if (res != FR_OK) {
+            ESP_LOGD(TAG, "%s: fast-seek not activated reason code: %d", __func__, res);
+            file->cltbl = NULL;
+            if (clmt) {
+                clmt_free(ctx, clmt);
+            }
+            return;
+        }
+        clmt->fs_id = ctx->fs.id;
+        clmt->sclust = file->obj.sclust;
+        clmt->size = f_size(file);
+        clmt->next = ctx->clmts;
+        ctx->clmts = clmt;
+    }
+    clmt->refs++;
+    clmt->last_use = ++ctx->clmt_clock;
+    file->cltbl = clmt->tbl;
+}
+
+/* Called with ctx->lock acquired */
+static void clmt_release(vfs_fat_ctx_t* ctx, FIL* file)
+{
+    if (file->cltbl == NULL) {
+        return;
+    }
+    vfs_fat_clmt_t* clmt = (vfs_fat_clmt_t*) ((uint8_t*) file->cltbl - offsetof(vfs_fat_clmt_t, tbl));
+    file->cltbl = NULL;
+    if (--clmt->refs == 0 && clmt->stale) {
+        clmt_free(ctx, clmt);
+    }
+}
+
+/* Drops all tables of the volume after clusters may have been freed, called with ctx->lock acquired */
+static void clmt_invalidate(vfs_fat_ctx_t* ctx)
+{
+    vfs_fat_clmt_t* clmt = ctx->clmts;
+    while (clmt != NULL) {
+        vfs_fat_clmt_t* next = clmt->next;
+        clmt->stale = true;
+        if (clmt->refs == 0) {
+            clmt_free(ctx, clmt);
+        }
+        clmt = next;
+    }
+}
+#else
+static inline void clmt_release(vfs_fat_ctx_t* ctx, FIL* file) { }
+static inline void clmt_invalidate(vfs_fat_ctx_t* ctx) { }
+#endif // CONFIG_FATFS_USE_FASTSEEK
+
 static void file_cleanup(vfs_fat_ctx_t* ctx, int fd)
 {
+    clmt_release(ctx, &ctx->files[fd]);
     memset(&ctx->files[fd], 0, sizeof(FIL));
+    if (ctx->file_bufs) {
+        ff_memfree(ctx->file_bufs[fd].buf);
+        memset(&ctx->file_bufs[fd], 0, sizeof(vfs_fat_file_buf_t));
+    }
+}
+
+static inline vfs_fat_file_buf_t* file_buf_get(vfs_fat_ctx_t* ctx, int fd)
+{
+    if (ctx->file_bufs == NULL || ctx->file_bufs[fd].buf == NULL) {
+        return NULL;
+    }
+    return &ctx->file_bufs[fd];
+}
+
+/* Position of the file as seen by the application, taking buffered data into account */
+static FSIZE_t file_buf_tell(vfs_fat_ctx_t* ctx, int fd)
+{
+    vfs_fat_file_buf_t* fb = file_buf_get(ctx, fd);
+    if (fb == NULL || fb->len == 0) {
+        return f_tell(&ctx->files[fd]);
+    }
+    return fb->dirty ? fb->pos + fb->len : fb->pos + fb->off;
+}
+
+#if CONFIG_FATFS_VFS_IO_CHUNK_SIZE > 0
+/* FATFS holds the volume lock for the whole f_read/f_write call. Large requests are split,
+ * so that tasks accessing other files on the same volume wait for one chunk at most.
+ * Releasing the volume lock wakes a waiting task of higher priority right away, the yield
+ * lets a waiting task of the same priority take the lock. Tasks of lower priority still
+ * wait for the whole request. */
+static FRESULT vfs_fat_f_read(FIL* file, void* buf, size_t size, unsigned* out_read)
+{
+    FRESULT res = FR_OK;
+    *out_read = 0;
+    while (size > 0) {
+        unsigned chunk = MIN(size, CONFIG_FATFS_VFS_IO_CHUNK_SIZE);
+        unsigned read = 0;
+        res = f_read(file, (uint8_t*) buf + *out_read, chunk, &read);
+        *out_read += read;
+        size -= read;
+        if (res != FR_OK || read < chunk) {
+            break;
+        }
+        if (size > 0) {
+            taskYIELD();
+        }
+    }
+    return res;
+}
+
+static FRESULT vfs_fat_f_write(FIL* file, const void* buf, size_t size, unsigned* out_written)
+{
+    FRESULT res = FR_OK;
+    *out_written = 0;
+    while (size > 0) {
+        unsigned chunk = MIN(size, CONFIG_FATFS_VFS_IO_CHUNK_SIZE);
+        unsigned written = 0;
+        res = f_write(file, (const uint8_t*) buf + *out_written, chunk, &written);
+        *out_written += written;
+        size -= written;
+        if (res != FR_OK || written < chunk) {
+            break;
+        }
+        if (size > 0) {
+            taskYIELD();
+        }
+    }
+    return res;
+}
+#else
+#define vfs_fat_f_read f_read
+#define vfs_fat_f_write f_write
+#endif // CONFIG_FATFS_VFS_IO_CHUNK_SIZE > 0
+
+/**
+ * @brief Write out pending write-behind data and drop read-ahead data
+ *
+ * Afterwards the FATFS file pointer matches the position seen by the application.
+ * If writing fails, the pending data is discarded and the error is returned,
+ * so that it is reported by the operation which caused the write.
+ *
+ * @return 0 on success, errno value otherwise
+ */
+static int file_buf_sync(vfs_fat_ctx_t* ctx, int fd)
+{
+    vfs_fat_file_buf_t* fb = file_buf_get(ctx, fd);
+    if (fb == NULL) {
+        return 0;
+    }
+    FIL* file = &ctx->files[fd];
+    FRESULT res = FR_OK;
+    int err = 0;
+    if (fb->dirty && fb->len > 0) {
+        unsigned written = 0;
+        res = f_write(file, fb->buf, fb->len, &written);
+        if (res == FR_OK && written != fb->len) {
+            err = ENOSPC;
+        }
+#if CONFIG_FATFS_IMMEDIATE_FSYNC
+        if (res == FR_OK && written > 0) {
+            res = f_sync(file);
+        }
+#endif
+    } else if (!fb->dirty && fb->off < fb->len) {
+        res = f_lseek(file, fb->pos + fb->off);
+    }
+    if (res != FR_OK) {
+        ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
+        err = fresult_to_errno(res);
+    }
+    fb->len = 0;
+    fb->off = 0;
+    fb->dirty = false;
+    return err;
 }
 
 /**
@@ -352,36 +721,33 @@ static int vfs_fat_open(void* ctx, const char * path, int flags, int mode)
         return -1;
     }
 
+    if (fat_ctx->file_bufs) {
+        vfs_fat_file_buf_t* fb = &fat_ctx->file_bufs[fd];
+        fb->ra_size = (fat_mode_conv(flags) & FA_READ) ? fat_ctx->read_ahead_size : 0;
+        fb->wb_size = (fat_mode_conv(flags) & FA_WRITE) ? fat_ctx->write_behind_size : 0;
+        size_t buf_size = MAX(fb->ra_size, fb->wb_size);
+        if (buf_size > 0) {
+            fb->buf = ff_memalloc(buf_size);
+            if (fb->buf == NULL) {
+                f_close(&fat_ctx->files[fd]);
+                file_cleanup(fat_ctx, fd);
+                _lock_release(&fat_ctx->lock);
+                ESP_LOGE(TAG, "open: Failed to allocate read-ahead/write-behind buffer");
+                errno = ENOMEM;
+                return -1;
+            }
+        }
+    }
+
+    if (fat_mode_conv(flags) & FA_CREATE_ALWAYS) {
+        // The previous content of the file has been freed
+        clmt_invalidate(fat_ctx);
+    }
 #ifdef CONFIG_FATFS_USE_FASTSEEK
-    FIL* file = &fat_ctx->files[fd];
     //fast-seek is only allowed in read mode, since file cannot be expanded
     //to use it.
-    if(!(fat_mode_conv(flags) & (FA_WRITE))) {
-        DWORD *clmt_mem =  ff_memalloc(sizeof(DWORD) * CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE);
-        if (clmt_mem == NULL) {
-            f_close(file);
-            file_cleanup(fat_ctx, fd);
-            _lock_release(&fat_ctx->lock);
-            ESP_LOGE(TAG, "open: Failed to pre-allocate CLMT buffer for fast-seek");
-            errno = ENOMEM;
-            return -1;
-        }
-
-        file->cltbl = clmt_mem;
-        file->cltbl[0] = CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE;
-        res = f_lseek(file, CREATE_LINKMAP);
-        ESP_LOGD(TAG, "%s: fast-seek has: %s",
-                __func__,
-                (res == FR_OK) ? "activated" : "failed");
-        if(res != FR_OK) {
-            ESP_LOGW(TAG, "%s: fast-seek not activated reason code: %d",
-                    __func__, res);
-            //If linkmap creation fails, fallback to the non fast seek.
-            ff_memfree(file->cltbl);
-            file->cltbl = NULL;
-        }
-    } else {
-        file->cltbl = NULL;
+    if (!(fat_mode_conv(flags) & FA_WRITE)) {
+        clmt_attach(fat_ctx, &fat_ctx->files[fd]);
     }
 #endif
 
@@ -396,32 +762,83 @@ static int vfs_fat_open(void* ctx, const char * path, int flags, int mode)
     return fd;
 }
 
+/* Collects a write smaller than the write-behind buffer, called with ctx->lock acquired */
+static ssize_t vfs_fat_write_buffered(vfs_fat_ctx_t* fat_ctx, int fd, vfs_fat_file_buf_t* fb, const uint8_t* data, size_t size)
+{
+    FIL* file = &fat_ctx->files[fd];
+    size_t done = 0;
+    int err;
+    while (done < size) {
+        if (!fb->dirty) {
+            // Drop read-ahead data and start collecting at the current position
+            if ((err = file_buf_sync(fat_ctx, fd)) != 0) {
+                errno = err;
+                return -1;
+            }
+            if (fat_ctx->o_append[fd]) {
+                FRESULT res = f_lseek(file, f_size(file));
+                if (res != FR_OK) {
+                    ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
+                    errno = fresult_to_errno(res);
+                    return -1;
+                }
+            }
+            fb->pos = f_tell(file);
+            fb->dirty = true;
+        }
+        size_t n = MIN(size - done, fb->wb_size - fb->len);
+        memcpy(fb->buf + fb->len, data + done, n);
+        fb->len += n;
+        done += n;
+        if (fb->len == fb->wb_size && (err = file_buf_sync(fat_ctx, fd)) != 0) {
+            errno = err;
+            return -1;
+        }
+    }
+    return done;
+}
+
 static ssize_t vfs_fat_write(void* ctx, int fd, const void * data, size_t size)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
     FRESULT res;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
+    vfs_fat_file_buf_t* fb = file_buf_get(fat_ctx, fd);
+    if (fb) {
+        if (size < fb->wb_size) {
+            ssize_t ret = vfs_fat_write_buffered(fat_ctx, fd, fb, data, size);
+            _lock_release(&fat_ctx->file_locks[fd]);
+            return ret;
+        }
+        // Large writes go directly to FATFS, after the data collected so far
+        int err = file_buf_sync(fat_ctx, fd);
+        if (err != 0) {
+            errno = err;
+            _lock_release(&fat_ctx->file_locks[fd]);
+            return -1;
+        }
+    }
     if (fat_ctx->o_append[fd]) {
         if ((res = f_lseek(file, f_size(file))) != FR_OK) {
             ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
             errno = fresult_to_errno(res);
-            _lock_release(&fat_ctx->lock);
+            _lock_release(&fat_ctx->file_locks[fd]);
             return -1;
         }
     }
     unsigned written = 0;
-    res = f_write(file, data, size, &written);
+    res = vfs_fat_f_write(file, data, size, &written);
     if (((written == 0) && (size != 0)) && (res == 0)) {
         errno = ENOSPC;
-        _lock_release(&fat_ctx->lock);
+        _lock_release(&fat_ctx->file_locks[fd]);
         return -1;
     }
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
         if (written == 0) {
-            _lock_release(&fat_ctx->lock);
+            _lock_release(&fat_ctx->file_locks[fd]);
             return -1;
         }
     }
@@ -432,21 +849,85 @@ static ssize_t vfs_fat_write(void* ctx, int fd, const void * data, size_t size)
         if (res != FR_OK) {
             ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
             errno = fresult_to_errno(res);
-            _lock_release(&fat_ctx->lock);
+            _lock_release(&fat_ctx->file_locks[fd]);
             return -1;
         }
      }
 #endif
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return written;
 }
 
+static ssize_t vfs_fat_read_buffered(vfs_fat_ctx_t* fat_ctx, int fd, vfs_fat_file_buf_t* fb, uint8_t* dst, size_t size)
+{
+    FIL* file = &fat_ctx->files[fd];
+    int err;
+    if (fb->dirty && (err = file_buf_sync(fat_ctx, fd)) != 0) {
+        errno = err;
+        return -1;
+    }
+
+    bool sequential = (file_buf_tell(fat_ctx, fd) == fb->next_read);
+    size_t done = 0;
+    if (fb->off < fb->len) {
+        done = MIN(size, fb->len - fb->off);
+        memcpy(dst, fb->buf + fb->off, done);
+        fb->off += done;
+        sequential = true;
+    }
+
+    if (done < size) {
+        // Read-ahead data is used up, the FATFS file pointer is at the current position
+        size_t remaining = size - done;
+        unsigned read = 0;
+        FRESULT res;
+        fb->len = 0;
+        fb->off = 0;
+        if (!sequential || remaining >= fb->ra_size) {
+            res = vfs_fat_f_read(file, dst + done, remaining, &read);
+            done += read;
+        } else {
+            fb->pos = f_tell(file);
+            res = f_read(file, fb->buf, fb->ra_size, &read);
+            fb->len = read;
+            fb->off = MIN(remaining, read);
+            memcpy(dst + done, fb->buf, fb->off);
+            done += fb->off;
+        }
+        if (res != FR_OK) {
+            ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
+            errno = fresult_to_errno(res);
+            if (done == 0) {
+                return -1;
+            }
+        }
+    }
+    fb->next_read = file_buf_tell(fat_ctx, fd);
+    return done;
+}
+
 static ssize_t vfs_fat_read(void* ctx, int fd, void * dst, size_t size)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
+    vfs_fat_file_buf_t* fb = file_buf_get(fat_ctx, fd);
+    if (fb) {
+        // The buffer is shared with write and lseek on the same file
+        _lock_acquire(&fat_ctx->file_locks[fd]);
+        ssize_t ret = vfs_fat_read_buffered(fat_ctx, fd, fb, dst, size);
+        _lock_release(&fat_ctx->file_locks[fd]);
+        return ret;
+    }
     unsigned read = 0;
+#if CONFIG_FATFS_VFS_IO_CHUNK_SIZE > 0
+    // A single f_read is atomic under the volume lock, a split read must not interleave
+    // with other I/O on the same file between its chunks
+    _lock_acquire(&fat_ctx->file_locks[fd]);
+    FRESULT res = vfs_fat_f_read(file, dst, size, &read);
+    _lock_release(&fat_ctx->file_locks[fd]);
+#else
     FRESULT res = f_read(file, dst, size, &read);
+#endif
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
@@ -461,8 +942,13 @@ static ssize_t vfs_fat_pread(void *ctx, int fd, void *dst, size_t size, off_t of
 {
     ssize_t ret = -1;
     vfs_fat_ctx_t *fat_ctx = (vfs_fat_ctx_t *) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL *file = &fat_ctx->files[fd];
+    int err = file_buf_sync(fat_ctx, fd);
+    if (err != 0) {
+        errno = err;
+        goto pread_release;
+    }
     const off_t prev_pos = f_tell(file);
 
     FRESULT f_res = f_lseek(file, offset);
@@ -474,7 +960,7 @@ static ssize_t vfs_fat_pread(void *ctx, int fd, void *dst, size_t size, off_t of
     }
 
     unsigned read = 0;
-    f_res = f_read(file, dst, size, &read);
+    f_res = vfs_fat_f_read(file, dst, size, &read);
     if (f_res == FR_OK) {
         ret = read;
     } else {
@@ -493,7 +979,7 @@ static ssize_t vfs_fat_pread(void *ctx, int fd, void *dst, size_t size, off_t of
     }
 
 pread_release:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
@@ -501,8 +987,13 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
 {
     ssize_t ret = -1;
     vfs_fat_ctx_t *fat_ctx = (vfs_fat_ctx_t *) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL *file = &fat_ctx->files[fd];
+    int err = file_buf_sync(fat_ctx, fd);
+    if (err != 0) {
+        errno = err;
+        goto pwrite_release;
+    }
     const off_t prev_pos = f_tell(file);
 
     FRESULT f_res = f_lseek(file, offset);
@@ -514,10 +1005,10 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
     }
 
     unsigned wr = 0;
-    f_res = f_write(file, src, size, &wr);
+    f_res = vfs_fat_f_write(file, src, size, &wr);
     if (((wr == 0) && (size != 0)) && (f_res == 0)) {
         errno = ENOSPC;
-        return -1;
+        goto pwrite_release;
     }
     if (f_res == FR_OK) {
         ret = wr;
@@ -549,7 +1040,7 @@ static ssize_t vfs_fat_pwrite(void *ctx, int fd, const void *src, size_t size, o
 #endif
 
 pwrite_release:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
@@ -557,6 +1048,15 @@ static int vfs_fat_fsync(void* ctx, int fd)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
+    if (file_buf_get(fat_ctx, fd)) {
+        _lock_acquire(&fat_ctx->file_locks[fd]);
+        int err = file_buf_sync(fat_ctx, fd);
+        _lock_release(&fat_ctx->file_locks[fd]);
+        if (err != 0) {
+            errno = err;
+            return -1;
+        }
+    }
     FRESULT res = f_sync(file);
     int rc = 0;
     if (res != FR_OK) {
@@ -570,19 +1070,20 @@ static int vfs_fat_fsync(void* ctx, int fd)
 static int vfs_fat_close(void* ctx, int fd)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     FIL* file = &fat_ctx->files[fd];
-
-#ifdef CONFIG_FATFS_USE_FASTSEEK
-    ff_memfree(file->cltbl);
-    file->cltbl = NULL;
-#endif
-
+    int err = file_buf_sync(fat_ctx, fd);
     FRESULT res = f_close(file);
+    // The entry becomes free for vfs_fat_open here, the file lock is always taken first
+    _lock_acquire(&fat_ctx->lock);
     file_cleanup(fat_ctx, fd);
     _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     int rc = 0;
-    if (res != FR_OK) {
+    if (err != 0) {
+        errno = err;
+        rc = -1;
+    } else if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
         rc = -1;
@@ -590,15 +1091,23 @@ static int vfs_fat_close(void* ctx, int fd)
     return rc;
 }
 
-static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
+/* Called with the file lock held */
+static off_t file_lseek(vfs_fat_ctx_t* fat_ctx, int fd, off_t offset, int mode)
 {
-    vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
+    vfs_fat_file_buf_t* fb = file_buf_get(fat_ctx, fd);
+    if (fb && fb->dirty) {
+        int err = file_buf_sync(fat_ctx, fd);
+        if (err != 0) {
+            errno = err;
+            return -1;
+        }
+    }
     off_t new_pos;
     if (mode == SEEK_SET) {
         new_pos = offset;
     } else if (mode == SEEK_CUR) {
-        off_t cur_pos = f_tell(file);
+        off_t cur_pos = file_buf_tell(fat_ctx, fd);
         new_pos = cur_pos + offset;
     } else if (mode == SEEK_END) {
         off_t size = f_size(file);
@@ -613,6 +1122,15 @@ static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
 #else
     ESP_LOGD(TAG, "%s: offset=%ld, filesize:=%" PRIu32, __func__, new_pos, f_size(file));
 #endif
+    if (fb && fb->len > 0) {
+        // Seeking within the read-ahead data doesn't need to access the disk
+        if (new_pos >= (off_t) fb->pos && new_pos <= (off_t) (fb->pos + fb->len)) {
+            fb->off = new_pos - fb->pos;
+            return new_pos;
+        }
+        fb->len = 0;
+        fb->off = 0;
+    }
     FRESULT res = f_lseek(file, new_pos);
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
@@ -622,10 +1140,30 @@ static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
     return new_pos;
 }
 
+static off_t vfs_fat_lseek(void* ctx, int fd, off_t offset, int mode)
+{
+    vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
+    _lock_acquire(&fat_ctx->file_locks[fd]);
+    off_t ret = file_lseek(fat_ctx, fd, offset, mode);
+    _lock_release(&fat_ctx->file_locks[fd]);
+    return ret;
+}
+
 static int vfs_fat_fstat(void* ctx, int fd, struct stat * st)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
     FIL* file = &fat_ctx->files[fd];
+    vfs_fat_file_buf_t* fb = file_buf_get(fat_ctx, fd);
+    if (fb) {
+        // Pending write-behind data counts in the size
+        _lock_acquire(&fat_ctx->file_locks[fd]);
+        int err = fb->dirty ? file_buf_sync(fat_ctx, fd) : 0;
+        _lock_release(&fat_ctx->file_locks[fd]);
+        if (err != 0) {
+            errno = err;
+            return -1;
+        }
+    }
     memset(st, 0, sizeof(*st));
     st->st_size = f_size(file);
     st->st_mode = S_IRWXU | S_IRWXG | S_IRWXO | S_IFREG;
@@ -698,6 +1236,9 @@ static int vfs_fat_unlink(void* ctx, const char *path)
     _lock_acquire(&fat_ctx->lock);
     prepend_drive_to_path(fat_ctx, &path, NULL);
     FRESULT res = f_unlink(path);
+    if (res == FR_OK) {
+        clmt_invalidate(fat_ctx);
+    }
     _lock_release(&fat_ctx->lock);
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
@@ -1038,8 +1579,10 @@ static int vfs_fat_truncate(void* ctx, const char *path, off_t length)
     }
 
     res = f_truncate(file);
+    clmt_invalidate(fat_ctx);
 
     if (res != FR_OK) {
+        _lock_release(&fat_ctx->lock);
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
         errno = fresult_to_errno(res);
         ret = -1;
@@ -1088,7 +1631,7 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
         return ret;
     }
 
-    _lock_acquire(&fat_ctx->lock);
+    _lock_acquire(&fat_ctx->file_locks[fd]);
     file = &fat_ctx->files[fd];
     if (file == NULL) {
         ESP_LOGD(TAG, "ftruncate NULL file pointer");
@@ -1097,6 +1640,13 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
         goto out;
     }
 
+    int err = file_buf_sync(fat_ctx, fd);
+    if (err != 0) {
+        errno = err;
+        ret = -1;
+        goto out;
+    }
+
     long sz = f_size(file);
     if (sz < length) {
         ESP_LOGD(TAG, "ftruncate does not support extending size");
@@ -1114,6 +1664,9 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
     }
 
     res = f_truncate(file);
+    _lock_acquire(&fat_ctx->lock);
+    clmt_invalidate(fat_ctx);
+    _lock_release(&fat_ctx->lock);
 
     if (res != FR_OK) {
         ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
@@ -1132,7 +1685,7 @@ static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
 #endif
 
 out:
-    _lock_release(&fat_ctx->lock);
+    _lock_release(&fat_ctx->file_locks[fd]);
     return ret;
 }
 
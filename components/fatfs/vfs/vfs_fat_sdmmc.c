@@ -166,12 +166,19 @@ static esp_err_t mount_to_vfs_fat(const esp_vfs_fat_mount_config_t *mount_config
     char drv[3] = {(char)('0' + pdrv), ':', 0};
 
     // connect FATFS to VFS
-    err = esp_vfs_fat_register(base_path, drv, mount_config->max_files, &fs);
+    esp_vfs_fat_conf_t conf = {
+        .base_path = base_path,
+        .fat_drive = drv,
+        .max_files = mount_config->max_files,
+        .read_ahead_size = mount_config->read_ahead_size,
+        .write_behind_size = mount_config->write_behind_size,
+    };
+    err = esp_vfs_fat_register_cfg(&conf, &fs);
     *out_fs = fs;
     if (err == ESP_ERR_INVALID_STATE) {
         // it's okay, already registered with VFS
     } else if (err != ESP_OK) {
-        ESP_LOGD(TAG, "esp_vfs_fat_register failed 0x(%x)", err);
+        ESP_LOGD(TAG, "esp_vfs_fat_register_cfg failed 0x(%x)", err);
         goto fail;
     }
 
@@ -188,6 +195,7 @@ fail:
     }
     esp_vfs_fat_unregister_path(base_path);
     ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_sdmmc(card);
     return err;
 }
 
@@ -431,6 +439,7 @@ static esp_err_t unmount_card_core(const char *base_path, sdmmc_card_t *card)
     f_mount(0, drv, 0);
     // release SD driver
     ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_sdmmc(card);
 
     call_host_deinit(&card->host);
     free(card);
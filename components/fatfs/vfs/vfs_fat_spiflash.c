@@ -142,11 +142,18 @@ esp_err_t esp_vfs_fat_spiflash_mount_rw_wl(const char* base_path,
     ESP_GOTO_ON_ERROR(ff_diskio_register_wl_partition(pdrv, *wl_handle), fail, TAG, "ff_diskio_register_wl_partition failed pdrv=%i, error - 0x(%x)", pdrv, ret);
 
     FATFS *fs;
-    ret = esp_vfs_fat_register(base_path, drv, mount_config->max_files, &fs);
+    esp_vfs_fat_conf_t conf = {
+        .base_path = base_path,
+        .fat_drive = drv,
+        .max_files = mount_config->max_files,
+        .read_ahead_size = mount_config->read_ahead_size,
+        .write_behind_size = mount_config->write_behind_size,
+    };
+    ret = esp_vfs_fat_register_cfg(&conf, &fs);
     if (ret == ESP_ERR_INVALID_STATE) {
         // it's okay, already registered with VFS
     } else if (ret != ESP_OK) {
-        ESP_LOGD(TAG, "esp_vfs_fat_register failed 0x(%x)", ret);
+        ESP_LOGD(TAG, "esp_vfs_fat_register_cfg failed 0x(%x)", ret);
         goto fail;
     }
 
@@ -181,6 +188,7 @@ esp_err_t esp_vfs_fat_spiflash_mount_rw_wl(const char* base_path,
 fail:
     esp_vfs_fat_unregister_path(base_path);
     ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(*wl_handle);
     free(ctx);
     return ret;
 }
@@ -315,11 +323,18 @@ esp_err_t esp_vfs_fat_spiflash_mount_ro(const char* base_path,
     ESP_GOTO_ON_ERROR(ff_diskio_register_raw_partition(pdrv, data_partition), fail, TAG, "ff_diskio_register_raw_partition failed pdrv=%i, error - 0x(%x)", pdrv, ret);
 
     FATFS *fs;
-    ret = esp_vfs_fat_register(base_path, drv, mount_config->max_files, &fs);
+    esp_vfs_fat_conf_t conf = {
+        .base_path = base_path,
+        .fat_drive = drv,
+        .max_files = mount_config->max_files,
+        .read_ahead_size = mount_config->read_ahead_size,
+        .write_behind_size = mount_config->write_behind_size,
+    };
+    ret = esp_vfs_fat_register_cfg(&conf, &fs);
     if (ret == ESP_ERR_INVALID_STATE) {
         // it's okay, already registered with VFS
     } else if (ret != ESP_OK) {
-        ESP_LOGD(TAG, "esp_vfs_fat_register failed 0x(%x)", ret);
+        ESP_LOGD(TAG, "esp_vfs_fat_register_cfg failed 0x(%x)", ret);
         goto fail;
     }
 
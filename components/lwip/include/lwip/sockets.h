@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -12,6 +12,25 @@
 extern "C" {
 #endif
 
+#ifndef SOL_UDP
+#define SOL_UDP         IPPROTO_UDP
+#endif
+/** Control message of SOL_UDP level for sendmmsg(): splits the payload into datagrams of this size (uint16_t) */
+#define UDP_SEGMENT     103
+/** Maximum number of datagrams a message can be split into with UDP_SEGMENT */
+#define UDP_MAX_SEGMENTS 64
+/** recvmmsg() flag: block for the first message only */
+#define MSG_WAITFORONE  0x10000
+
+/** Message of sendmmsg() and recvmmsg() */
+struct mmsghdr {
+    struct msghdr msg_hdr;  /*!< Message */
+    unsigned int msg_len;   /*!< Number of bytes sent or received */
+};
+
+int lwip_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+int lwip_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timeval *timeout);
+
 static inline int accept(int s,struct sockaddr *addr,socklen_t *addrlen)
 { return lwip_accept(s,addr,addrlen); }
 static inline int bind(int s,const struct sockaddr *name, socklen_t namelen)
@@ -42,6 +61,10 @@ static inline ssize_t send(int s,const void *dataptr,size_t size,int flags)
 { return lwip_send(s,dataptr,size,flags); }
 static inline ssize_t sendmsg(int s,const struct msghdr *message,int flags)
 { return lwip_sendmsg(s,message,flags); }
+static inline int sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{ return lwip_sendmmsg(s, msgvec, vlen, flags); }
+static inline int recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timeval *timeout)
+{ return lwip_recvmmsg(s, msgvec, vlen, flags, timeout); }
 static inline ssize_t sendto(int s,const void *dataptr,size_t size,int flags,const struct sockaddr *to,socklen_t tolen)
 { return lwip_sendto(s,dataptr,size,flags,to,tolen); }
 static inline int socket(int domain,int type,int protocol)
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -11,6 +11,10 @@
 #include "lwip/tcp.h"
 #include "lwip/raw.h"
 #include "lwip/udp.h"
+#include "lwip/inet.h"
+#include "lwip/mem.h"
+#include <errno.h>
+#include <string.h>
 
 #define LWIP_SOCKOPT_CHECK_OPTLEN_CONN_PCB(sock, optlen, opttype) do { \
   if (((optlen) < sizeof(opttype)) || ((sock)->conn == NULL) || ((sock)->conn->pcb.tcp == NULL)) { *err=EINVAL; goto exit; } }while(0)
@@ -20,8 +24,13 @@
   if (NETCONNTYPE_GROUP(netconn_type((sock)->conn)) != netconntype) { *err=ENOPROTOOPT; goto exit; } } while(0)
 
 
+static bool sendmmsg_setsockopt_ext(struct lwip_sock* sock, int level, int optname, const void *optval, socklen_t optlen, int *err);
+
 bool lwip_setsockopt_impl_ext(struct lwip_sock* sock, int level, int optname, const void *optval, socklen_t optlen, int *err)
 {
+    if (sendmmsg_setsockopt_ext(sock, level, optname, optval, optlen, err)) {
+        return true;
+    }
 #if LWIP_IPV6
     if (level != IPPROTO_IPV6)
 #endif /* LWIP_IPV6 */
@@ -106,3 +115,348 @@ exit:
     return true;
 #endif /* LWIP_IPV6 */
 }
+
+/* Datagrams sent to the stack in one tcpip call by lwip_sendmmsg() */
+#define SENDMMSG_BATCH  UDP_MAX_SEGMENTS
+
+/* Internal option of IPPROTO_UDP level used by lwip_sendmmsg(): setsockopt() runs the
+ * setsockopt hook in the tcpip context with a reference to the socket held, so the batch
+ * is sent there and the netconn can't be freed by a concurrent close() meanwhile.
+ * The option value is a pointer to struct sendmmsg_call, only accepted while the call
+ * is pending in lwip_sendmmsg(). */
+#define UDP_SENDMMSG_BATCH  0x400
+
+struct sendmmsg_dgram {
+    struct pbuf *p;
+    ip_addr_t addr;
+    u16_t port;
+    u16_t len;              /* payload length, p->tot_len includes the headers once sent */
+    bool has_addr;
+    unsigned int msg;       /* index of the message in msgvec */
+};
+
+struct sendmmsg_call {
+    struct sendmmsg_call *next;     /* next pending call */
+    unsigned int count;     /* datagrams to send */
+    unsigned int sent;      /* datagrams sent by sendmmsg_send_batch() */
+    err_t err;              /* result of the last datagram sent */
+    struct sendmmsg_dgram dgrams[SENDMMSG_BATCH];
+};
+
+/* Calls passed to setsockopt() by lwip_sendmmsg() and not executed yet */
+static struct sendmmsg_call *s_sendmmsg_pending;
+
+static void sendmmsg_set_pending(struct sendmmsg_call *call)
+{
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    call->next = s_sendmmsg_pending;
+    s_sendmmsg_pending = call;
+    SYS_ARCH_UNPROTECT(lev);
+}
+
+/* Removes the call from the pending calls, returns false if it isn't pending */
+static bool sendmmsg_take_pending(const struct sendmmsg_call *call)
+{
+    bool found = false;
+    SYS_ARCH_DECL_PROTECT(lev);
+    SYS_ARCH_PROTECT(lev);
+    for (struct sendmmsg_call **prev = &s_sendmmsg_pending; *prev != NULL; prev = &(*prev)->next) {
+        if (*prev == call) {
+            *prev = call->next;
+            found = true;
+            break;
+        }
+    }
+    SYS_ARCH_UNPROTECT(lev);
+    return found;
+}
+
+/* Sends the batch of datagrams, executed in the tcpip context */
+static err_t sendmmsg_send_batch(struct netconn *conn, struct sendmmsg_call *msg)
+{
+    struct udp_pcb *pcb = conn->pcb.udp;
+    err_t err = ERR_OK;
+
+    msg->sent = 0;
+    if (pcb == NULL) {
+        return ERR_CONN;
+    }
+    for (; msg->sent < msg->count; msg->sent++) {
+        struct sendmmsg_dgram *dgram = &msg->dgrams[msg->sent];
+        if (dgram->has_addr) {
+            err = udp_sendto(pcb, dgram->p, &dgram->addr, dgram->port);
+        } else {
+            err = udp_send(pcb, dgram->p);
+        }
+        if (err != ERR_OK) {
+            break;
+        }
+    }
+    return err;
+}
+
+static bool sendmmsg_setsockopt_ext(struct lwip_sock* sock, int level, int optname, const void *optval, socklen_t optlen, int *err)
+{
+    if (level != IPPROTO_UDP || optname != UDP_SENDMMSG_BATCH) {
+        return false;
+    }
+    if (optlen != sizeof(struct sendmmsg_call *) || sock->conn == NULL) {
+        *err = EINVAL;
+        return true;
+    }
+    if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) != NETCONN_UDP) {
+        *err = ENOPROTOOPT;
+        return true;
+    }
+    struct sendmmsg_call *call = *(struct sendmmsg_call * const *)optval;
+    /* Anything else than a call of lwip_sendmmsg() is rejected before it's dereferenced */
+    if (!sendmmsg_take_pending(call)) {
+        *err = EINVAL;
+        return true;
+    }
+    call->err = sendmmsg_send_batch(sock->conn, call);
+    *err = 0;
+    return true;
+}
+
+static int sendmmsg_get_addr(const struct msghdr *msg, ip_addr_t *addr, u16_t *port)
+{
+#if LWIP_IPV4
+    if (msg->msg_namelen == sizeof(struct sockaddr_in) &&
+            ((const struct sockaddr *)msg->msg_name)->sa_family == AF_INET) {
+        const struct sockaddr_in *sin = msg->msg_name;
+        inet_addr_to_ip4addr(ip_2_ip4(addr), &sin->sin_addr);
+        IP_SET_TYPE_VAL(*addr, IPADDR_TYPE_V4);
+        *port = lwip_ntohs(sin->sin_port);
+        return 0;
+    }
+#endif /* LWIP_IPV4 */
+#if LWIP_IPV6
+    if (msg->msg_namelen == sizeof(struct sockaddr_in6) &&
+            ((const struct sockaddr *)msg->msg_name)->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *sin6 = msg->msg_name;
+        inet6_addr_to_ip6addr(ip_2_ip6(addr), &sin6->sin6_addr);
+        ip6_addr_set_zone(ip_2_ip6(addr), (u8_t)sin6->sin6_scope_id);
+        IP_SET_TYPE_VAL(*addr, IPADDR_TYPE_V6);
+#if LWIP_IPV4
+        /* Same as lwip_sendto(), dual-stack sockets send to IPv4 mapped addresses over IPv4 */
+        if (ip6_addr_isipv4mappedipv6(ip_2_ip6(addr))) {
+            unmap_ipv4_mapped_ipv6(ip_2_ip4(addr), ip_2_ip6(addr));
+            IP_SET_TYPE_VAL(*addr, IPADDR_TYPE_V4);
+        }
+#endif /* LWIP_IPV4 */
+        *port = lwip_ntohs(sin6->sin6_port);
+        return 0;
+    }
+#endif /* LWIP_IPV6 */
+    return EINVAL;
+}
+
+/* Size of the datagrams the message is split into, 0 if it's sent as one datagram */
+static u16_t sendmmsg_get_segment_size(const struct msghdr *msg)
+{
+    u16_t segment_size = 0;
+    if (msg->msg_control == NULL) {
+        return 0;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_SEGMENT &&
+                cmsg->cmsg_len >= CMSG_LEN(sizeof(u16_t))) {
+            memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(u16_t));
+        }
+    }
+    return segment_size;
+}
+
+/**
+ * Adds the datagrams of one message to the batch, the payload is copied to new pbufs.
+ * Returns 0 on success, ENOBUFS if the batch can't hold all datagrams, errno value otherwise.
+ */
+static int sendmmsg_add_msg(struct sendmmsg_call *call, const struct msghdr *msg, unsigned int index)
+{
+    size_t total = 0;
+    if (msg->msg_iov == NULL && msg->msg_iovlen > 0) {
+        return EFAULT;
+    }
+    for (int i = 0; i < msg->msg_iovlen; i++) {
+        if (msg->msg_iov[i].iov_base == NULL && msg->msg_iov[i].iov_len > 0) {
+            return EFAULT;
+        }
+        total += msg->msg_iov[i].iov_len;
+    }
+    u16_t segment_size = sendmmsg_get_segment_size(msg);
+    if (segment_size == 0 || segment_size >= total) {
+        if (total > 0xFFFF) {
+            return EMSGSIZE;
+        }
+        segment_size = total > 0 ? total : 1;
+    }
+    unsigned int segments = total > 0 ? (total + segment_size - 1) / segment_size : 1;
+    if (segments > UDP_MAX_SEGMENTS) {
+        return EINVAL;
+    }
+    if (segments > SENDMMSG_BATCH - call->count) {
+        return ENOBUFS;
+    }
+
+    ip_addr_t addr;
+    u16_t port = 0;
+    ip_addr_set_zero(&addr);
+    bool has_addr = msg->msg_name != NULL;
+    if (has_addr) {
+        int err = sendmmsg_get_addr(msg, &addr, &port);
+        if (err != 0) {
+            return err;
+        }
+    }
+
+    int iov = 0;
+    size_t iov_offset = 0;
+    size_t remaining = total;
+    for (unsigned int seg = 0; seg < segments; seg++) {
+        u16_t len = LWIP_MIN(remaining, segment_size);
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+        if (p == NULL) {
+            while (seg-- > 0) {
+                pbuf_free(call->dgrams[--call->count].p);
+            }
+            return ENOMEM;
+        }
+        /* PBUF_RAM pbufs are contiguous */
+        u8_t *dst = p->payload;
+        for (u16_t copied = 0; copied < len;) {
+            size_t chunk = LWIP_MIN(len - copied, msg->msg_iov[iov].iov_len - iov_offset);
+            memcpy(dst + copied, (const u8_t *)msg->msg_iov[iov].iov_base + iov_offset, chunk);
+            copied += chunk;
+            iov_offset += chunk;
+            if (iov_offset == msg->msg_iov[iov].iov_len) {
+                iov++;
+                iov_offset = 0;
+            }
+        }
+        remaining -= len;
+        struct sendmmsg_dgram *dgram = &call->dgrams[call->count++];
+        dgram->p = p;
+        dgram->addr = addr;
+        dgram->port = port;
+        dgram->len = len;
+        dgram->has_addr = has_addr;
+        dgram->msg = index;
+    }
+    return 0;
+}
+
+int lwip_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    int type;
+    socklen_t type_len = sizeof(type);
+    if (lwip_getsockopt(s, SOL_SOCKET, SO_TYPE, &type, &type_len) != 0) {
+        return -1;
+    }
+    if (msgvec == NULL && vlen > 0) {
+        errno = EFAULT;
+        return -1;
+    }
+    if (type != SOCK_DGRAM) {
+        /* Nothing to batch for streams and raw sockets, send the messages one by one */
+        for (unsigned int i = 0; i < vlen; i++) {
+            ssize_t ret = lwip_sendmsg(s, &msgvec[i].msg_hdr, flags);
+            if (ret < 0) {
+                return i > 0 ? (int)i : -1;
+            }
+            msgvec[i].msg_len = ret;
+        }
+        return vlen;
+    }
+
+    struct sendmmsg_call *call = mem_malloc(sizeof(struct sendmmsg_call));
+    if (call == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    unsigned int done = 0;  /* messages which have been sent completely */
+    int err = 0;
+    while (done < vlen && err == 0) {
+        /* Fill the batch with whole messages */
+        call->count = 0;
+        unsigned int next = done;
+        while (next < vlen) {
+            err = sendmmsg_add_msg(call, &msgvec[next].msg_hdr, next);
+            if (err != 0) {
+                break;
+            }
+            msgvec[next++].msg_len = 0;
+        }
+        if (err == ENOBUFS && call->count > 0) {
+            err = 0;    /* the message is sent in the next batch */
+        }
+        if (call->count == 0) {
+            break;
+        }
+
+        /* One tcpip call for the whole batch */
+        call->sent = 0;
+        call->err = ERR_OK;
+        sendmmsg_set_pending(call);
+        if (lwip_setsockopt(s, IPPROTO_UDP, UDP_SENDMMSG_BATCH, &call, sizeof(call)) != 0) {
+            err = errno;
+        }
+        /* Still pending if setsockopt() failed before running the hook */
+        sendmmsg_take_pending(call);
+        for (unsigned int i = 0; i < call->count; i++) {
+            if (i < call->sent) {
+                msgvec[call->dgrams[i].msg].msg_len += call->dgrams[i].len;
+            }
+            pbuf_free(call->dgrams[i].p);
+        }
+        if (call->sent < call->count) {
+            done = call->dgrams[call->sent].msg;
+            if (err == 0) {
+                err = err_to_errno(call->err != ERR_OK ? call->err : ERR_VAL);
+            }
+        } else {
+            done = next;
+        }
+    }
+    mem_free(call);
+
+    if (done == 0 && err != 0) {
+        errno = err;
+        return -1;
+    }
+    return done;
+}
+
+int lwip_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timeval *timeout)
+{
+    if (msgvec == NULL && vlen > 0) {
+        errno = EFAULT;
+        return -1;
+    }
+    u32_t start = sys_now();
+    u32_t timeout_ms = timeout ? timeout->tv_sec * 1000 + timeout->tv_usec / 1000 : 0;
+    int recv_flags = flags & ~MSG_WAITFORONE;
+    unsigned int i;
+
+    /* Received datagrams are queued in the netconn, no tcpip call is needed to take them */
+    for (i = 0; i < vlen; i++) {
+        ssize_t ret = lwip_recvmsg(s, &msgvec[i].msg_hdr, recv_flags);
+        if (ret < 0) {
+            if (i == 0) {
+                return -1;
+            }
+            /* Same as Linux, the error is reported by the next call */
+            break;
+        }
+        msgvec[i].msg_len = ret;
+        if (flags & MSG_WAITFORONE) {
+            recv_flags |= MSG_DONTWAIT;
+        }
+        if (timeout && (u32_t)(sys_now() - start) >= timeout_ms) {
+            i++;
+            break;
+        }
+    }
+    return i;
+}
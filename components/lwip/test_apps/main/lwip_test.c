@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -24,6 +24,7 @@
 #include "dhcpserver/dhcpserver.h"
 #include "dhcpserver/dhcpserver_options.h"
 #include "esp_sntp.h"
+#include "esp_timer.h"
 
 #define ETH_PING_END_BIT BIT(1)
 #define ETH_PING_DURATION_MS (5000)
@@ -311,6 +312,122 @@ TEST(lwip, sntp_client_time_2048)
     test_sntp_timestamps(2048, false); // NTP timestamp MSB is cleared for time after 2036
 }
 
+#define TEST_MMSG_SEGMENT_SIZE  500
+#define TEST_MMSG_BENCH_COUNT   256
+#define TEST_MMSG_BENCH_BATCH   8   // default number of packets the loopback interface can queue
+
+static int test_udp_socket_localhost(struct sockaddr_in *addr)
+{
+    socklen_t addr_len = sizeof(*addr);
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, sock);
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, bind(sock, (struct sockaddr *)addr, sizeof(*addr)));
+    TEST_ASSERT_EQUAL(0, getsockname(sock, (struct sockaddr *)addr, &addr_len));
+    struct timeval timeout = { .tv_sec = 1 };
+    TEST_ASSERT_EQUAL(0, setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+    return sock;
+}
+
+TEST(lwip, udp_sendmmsg_recvmmsg_localhost)
+{
+    test_case_uses_tcpip();
+    struct sockaddr_in rx_addr, tx_addr;
+    int rx_sock = test_udp_socket_localhost(&rx_addr);
+    int tx_sock = test_udp_socket_localhost(&tx_addr);
+
+    // Two plain datagrams and one buffer split into three datagrams by UDP_SEGMENT
+    static uint8_t payload[3 * TEST_MMSG_SEGMENT_SIZE];
+    for (int i = 0; i < sizeof(payload); i++) {
+        payload[i] = i;
+    }
+    union {
+        struct cmsghdr hdr;
+        uint8_t buf[CMSG_SPACE(sizeof(uint16_t))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    control.hdr.cmsg_level = SOL_UDP;
+    control.hdr.cmsg_type = UDP_SEGMENT;
+    control.hdr.cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segment_size = TEST_MMSG_SEGMENT_SIZE;
+    memcpy(CMSG_DATA(&control.hdr), &segment_size, sizeof(segment_size));
+
+    struct iovec tx_iov[3] = {
+        { .iov_base = payload, .iov_len = 10 },
+        { .iov_base = payload + 10, .iov_len = 20 },
+        { .iov_base = payload, .iov_len = sizeof(payload) },
+    };
+    struct mmsghdr tx_msgs[3] = { 0 };
+    for (int i = 0; i < 3; i++) {
+        tx_msgs[i].msg_hdr.msg_name = &rx_addr;
+        tx_msgs[i].msg_hdr.msg_namelen = sizeof(rx_addr);
+        tx_msgs[i].msg_hdr.msg_iov = &tx_iov[i];
+        tx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    tx_msgs[2].msg_hdr.msg_control = &control;
+    tx_msgs[2].msg_hdr.msg_controllen = sizeof(control);
+    TEST_ASSERT_EQUAL(3, sendmmsg(tx_sock, tx_msgs, 3, 0));
+    TEST_ASSERT_EQUAL(10, tx_msgs[0].msg_len);
+    TEST_ASSERT_EQUAL(20, tx_msgs[1].msg_len);
+    TEST_ASSERT_EQUAL(sizeof(payload), tx_msgs[2].msg_len);
+
+    const size_t expected_len[] = { 10, 20, TEST_MMSG_SEGMENT_SIZE, TEST_MMSG_SEGMENT_SIZE, TEST_MMSG_SEGMENT_SIZE };
+    const size_t expected_offset[] = { 0, 10, 0, TEST_MMSG_SEGMENT_SIZE, 2 * TEST_MMSG_SEGMENT_SIZE };
+    static uint8_t rx_buf[5][TEST_MMSG_SEGMENT_SIZE + 1];
+    struct iovec rx_iov[5];
+    struct mmsghdr rx_msgs[5] = { 0 };
+    for (int i = 0; i < 5; i++) {
+        rx_iov[i].iov_base = rx_buf[i];
+        rx_iov[i].iov_len = sizeof(rx_buf[i]);
+        rx_msgs[i].msg_hdr.msg_iov = &rx_iov[i];
+        rx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    // The datagrams are looped back by the tcpip thread, they may not be all queued yet
+    int received = 0;
+    while (received < 5) {
+        int ret = recvmmsg(rx_sock, rx_msgs + received, 5 - received, MSG_WAITFORONE, NULL);
+        TEST_ASSERT_GREATER_THAN(0, ret);
+        received += ret;
+    }
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(expected_len[i], rx_msgs[i].msg_len);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(payload + expected_offset[i], rx_buf[i], expected_len[i]);
+    }
+
+    // Segment size making more than UDP_MAX_SEGMENTS datagrams
+    segment_size = sizeof(payload) / (UDP_MAX_SEGMENTS + 1);
+    memcpy(CMSG_DATA(&control.hdr), &segment_size, sizeof(segment_size));
+    TEST_ASSERT_EQUAL(-1, sendmmsg(tx_sock, &tx_msgs[2], 1, 0));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+
+    // The internal option used by sendmmsg() doesn't accept pointers from the application
+    void *bogus = payload;
+    TEST_ASSERT_EQUAL(-1, setsockopt(tx_sock, IPPROTO_UDP, 0x400, &bogus, sizeof(bogus)));
+    TEST_ASSERT_EQUAL(EINVAL, errno);
+
+    // Compare the time to pass small datagrams to the stack, the receiver may drop some of them
+    struct mmsghdr bench_msgs[TEST_MMSG_BENCH_BATCH] = { 0 };
+    for (int i = 0; i < TEST_MMSG_BENCH_BATCH; i++) {
+        bench_msgs[i].msg_hdr = tx_msgs[0].msg_hdr;
+    }
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < TEST_MMSG_BENCH_COUNT; i++) {
+        TEST_ASSERT_EQUAL(10, sendto(tx_sock, payload, 10, 0, (struct sockaddr *)&rx_addr, sizeof(rx_addr)));
+    }
+    int64_t sendto_us = esp_timer_get_time() - start;
+    start = esp_timer_get_time();
+    for (int i = 0; i < TEST_MMSG_BENCH_COUNT / TEST_MMSG_BENCH_BATCH; i++) {
+        TEST_ASSERT_GREATER_THAN(0, sendmmsg(tx_sock, bench_msgs, TEST_MMSG_BENCH_BATCH, 0));
+    }
+    int64_t sendmmsg_us = esp_timer_get_time() - start;
+    printf("%d datagrams: sendto %" PRId64 " us, sendmmsg %" PRId64 " us\n", TEST_MMSG_BENCH_COUNT, sendto_us, sendmmsg_us);
+
+    close(tx_sock);
+    close(rx_sock);
+}
+
 TEST_GROUP_RUNNER(lwip)
 {
     RUN_TEST_CASE(lwip, localhost_ping_test)
@@ -318,6 +435,7 @@ TEST_GROUP_RUNNER(lwip)
     RUN_TEST_CASE(lwip, dhcp_server_start_stop_localhost)
     RUN_TEST_CASE(lwip, sntp_client_time_2015)
     RUN_TEST_CASE(lwip, sntp_client_time_2048)
+    RUN_TEST_CASE(lwip, udp_sendmmsg_recvmmsg_localhost)
 }
 
 void app_main(void)
@@ -1,10 +1,11 @@
 /*
- * SPDX-FileCopyrightText: 2018-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2018-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <string.h>
 #include <stdbool.h>
+#include <sys/lock.h>
 #include "esp_crt_bundle.h"
 #include "esp_log.h"
 
@@ -30,47 +31,157 @@ typedef struct crt_bundle_t {
 
 static crt_bundle_t s_crt_bundle;
 
-static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *pub_key_buf, size_t pub_key_len);
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE > 0
+/* Parsed public key of a recently used root certificate */
+typedef struct crt_key_cache_entry_t {
+    const uint8_t *crt;         /* bundle entry the key was parsed from, NULL if the entry is unused */
+    mbedtls_pk_context pk;
+    uint32_t last_used;
+    bool in_use;                /* a verification uses the key, the entry can't be shared nor reused until it's released */
+} crt_key_cache_entry_t;
 
+static crt_key_cache_entry_t s_key_cache[CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE];
+static uint32_t s_key_cache_clock;
+static _lock_t s_key_cache_lock;
+#endif
 
-static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *pub_key_buf, size_t pub_key_len)
-{
-    int ret = 0;
-    mbedtls_x509_crt parent;
-    const mbedtls_md_info_t *md_info;
-    unsigned char hash[MBEDTLS_MD_MAX_SIZE];
+static int esp_crt_check_signature(mbedtls_x509_crt *child, mbedtls_pk_context *parent_pk);
 
-    mbedtls_x509_crt_init(&parent);
 
-    if ( (ret = mbedtls_pk_parse_public_key(&parent.pk, pub_key_buf, pub_key_len) ) != 0) {
+static int esp_crt_parse_key(mbedtls_pk_context *pk, const uint8_t *pub_key_buf, size_t pub_key_len)
+{
+    int ret = mbedtls_pk_parse_public_key(pk, pub_key_buf, pub_key_len);
+    if (ret != 0) {
         ESP_LOGE(TAG, "PK parse failed with error %X", ret);
-        goto cleanup;
     }
+    return ret;
+}
 
+static int esp_crt_check_signature(mbedtls_x509_crt *child, mbedtls_pk_context *parent_pk)
+{
+    int ret = 0;
+    const mbedtls_md_info_t *md_info;
+    unsigned char hash[MBEDTLS_MD_MAX_SIZE];
 
     // Fast check to avoid expensive computations when not necessary
-    if (!mbedtls_pk_can_do(&parent.pk, child->MBEDTLS_PRIVATE(sig_pk))) {
+    if (!mbedtls_pk_can_do(parent_pk, child->MBEDTLS_PRIVATE(sig_pk))) {
         ESP_LOGE(TAG, "Simple compare failed");
-        ret = -1;
-        goto cleanup;
+        return -1;
     }
 
     md_info = mbedtls_md_info_from_type(child->MBEDTLS_PRIVATE(sig_md));
     if ( (ret = mbedtls_md( md_info, child->tbs.p, child->tbs.len, hash )) != 0 ) {
         ESP_LOGE(TAG, "Internal mbedTLS error %X", ret);
-        goto cleanup;
+        return ret;
     }
 
-    if ( (ret = mbedtls_pk_verify_ext( child->MBEDTLS_PRIVATE(sig_pk), child->MBEDTLS_PRIVATE(sig_opts), &parent.pk,
+    if ( (ret = mbedtls_pk_verify_ext( child->MBEDTLS_PRIVATE(sig_pk), child->MBEDTLS_PRIVATE(sig_opts), parent_pk,
                                        child->MBEDTLS_PRIVATE(sig_md), hash, mbedtls_md_get_size( md_info ),
                                        child->MBEDTLS_PRIVATE(sig).p, child->MBEDTLS_PRIVATE(sig).len )) != 0 ) {
 
         ESP_LOGE(TAG, "PK verify failed with error %X", ret);
-        goto cleanup;
     }
-cleanup:
-    mbedtls_x509_crt_free(&parent);
+    return ret;
+}
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE > 0
+/* Returns the cached key of the bundle entry, parsing it into the least recently used
+ * entry on a miss. The entry is used by one verification at a time, as mbedTLS updates
+ * the key context while verifying (e.g. the RSA modulus helpers are computed on first use).
+ * *out_entry is set to NULL if the key is used by another verification or all entries are in use. */
+static int esp_crt_key_cache_acquire(const uint8_t *crt, const uint8_t *pub_key_buf, size_t pub_key_len,
+                                     crt_key_cache_entry_t **out_entry)
+{
+    int ret = 0;
+    crt_key_cache_entry_t *entry = NULL;
+    crt_key_cache_entry_t *victim = NULL;
+
+    _lock_acquire(&s_key_cache_lock);
+    for (int i = 0; i < CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE; i++) {
+        crt_key_cache_entry_t *e = &s_key_cache[i];
+        if (e->crt == crt) {
+            entry = e;
+            break;
+        }
+        if (!e->in_use && (victim == NULL ||
+                          (victim->crt != NULL && (e->crt == NULL || e->last_used < victim->last_used)))) {
+            victim = e;
+        }
+    }
+
+    if (entry != NULL && entry->in_use) {
+        // the caller parses a private copy of the key
+        entry = NULL;
+    } else if (entry == NULL && victim != NULL) {
+        // Also releases the key of an entry dropped by esp_crt_key_cache_clear() while in use
+        mbedtls_pk_free(&victim->pk);
+        mbedtls_pk_init(&victim->pk);
+        victim->crt = NULL;
+        ret = esp_crt_parse_key(&victim->pk, pub_key_buf, pub_key_len);
+        if (ret == 0) {
+            victim->crt = crt;
+            entry = victim;
+        }
+    }
+
+    if (entry != NULL) {
+        entry->in_use = true;
+        entry->last_used = ++s_key_cache_clock;
+    }
+    _lock_release(&s_key_cache_lock);
+
+    *out_entry = entry;
+    return ret;
+}
+
+static void esp_crt_key_cache_release(crt_key_cache_entry_t *entry)
+{
+    _lock_acquire(&s_key_cache_lock);
+    entry->in_use = false;
+    _lock_release(&s_key_cache_lock);
+}
+
+/* Drops all keys, called when the bundle changes as the entries may be reused by the new bundle */
+static void esp_crt_key_cache_clear(void)
+{
+    _lock_acquire(&s_key_cache_lock);
+    for (int i = 0; i < CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE; i++) {
+        crt_key_cache_entry_t *e = &s_key_cache[i];
+        e->crt = NULL;
+        if (!e->in_use) {
+            mbedtls_pk_free(&e->pk);
+            mbedtls_pk_init(&e->pk);
+        }
+    }
+    _lock_release(&s_key_cache_lock);
+}
+#else
+#define esp_crt_key_cache_clear()
+#endif
 
+static int esp_crt_check_signature_with_bundle_key(mbedtls_x509_crt *child, const uint8_t *crt,
+                                                   const uint8_t *pub_key_buf, size_t pub_key_len)
+{
+    int ret;
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE > 0
+    crt_key_cache_entry_t *entry;
+    ret = esp_crt_key_cache_acquire(crt, pub_key_buf, pub_key_len, &entry);
+    if (ret != 0) {
+        return ret;
+    }
+    if (entry != NULL) {
+        ret = esp_crt_check_signature(child, &entry->pk);
+        esp_crt_key_cache_release(entry);
+        return ret;
+    }
+#endif
+    mbedtls_pk_context parent_pk;
+    mbedtls_pk_init(&parent_pk);
+    ret = esp_crt_parse_key(&parent_pk, pub_key_buf, pub_key_len);
+    if (ret == 0) {
+        ret = esp_crt_check_signature(child, &parent_pk);
+    }
+    mbedtls_pk_free(&parent_pk);
     return ret;
 }
 
@@ -129,7 +240,8 @@ int esp_crt_verify_callback(void *buf, mbedtls_x509_crt *crt, int depth, uint32_
     int ret = MBEDTLS_ERR_X509_FATAL_ERROR;
     if (crt_found) {
         size_t key_len = s_crt_bundle.crts[middle][2] << 8 | s_crt_bundle.crts[middle][3];
-        ret = esp_crt_check_signature(child, s_crt_bundle.crts[middle] + CRT_HEADER_OFFSET + name_len, key_len);
+        ret = esp_crt_check_signature_with_bundle_key(child, s_crt_bundle.crts[middle],
+                                                      s_crt_bundle.crts[middle] + CRT_HEADER_OFFSET + name_len, key_len);
     }
 
     if (ret == 0) {
@@ -193,6 +305,7 @@ static esp_err_t esp_crt_bundle_init(const uint8_t *x509_bundle, size_t bundle_s
     /* The previous crt bundle is only updated when initialization of the
      * current crt_bundle is successful */
     /* Free previous crt_bundle */
+    esp_crt_key_cache_clear();
     free(s_crt_bundle.crts);
     s_crt_bundle.num_certs = num_certs;
     s_crt_bundle.crts = crts;
@@ -228,6 +341,7 @@ esp_err_t esp_crt_bundle_attach(void *conf)
 
 void esp_crt_bundle_detach(mbedtls_ssl_config *conf)
 {
+    esp_crt_key_cache_clear();
     free(s_crt_bundle.crts);
     s_crt_bundle.crts = NULL;
     if (conf) {
@@ -6,7 +6,7 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  *
- * SPDX-FileContributor: 2019-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileContributor: 2019-2024 Espressif Systems (Shanghai) CO LTD
  */
 #include "esp_err.h"
 #include "esp_log.h"
@@ -439,6 +439,35 @@ TEST_CASE("custom certificate bundle - wrong signature", "[mbedtls]")
     esp_crt_bundle_detach(NULL);
 }
 
+TEST_CASE("custom certificate bundle - repeated verification", "[mbedtls]")
+{
+    /* Verifications with the same root certificate reuse its parsed key when
+       CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE is set, the result must not change */
+
+    mbedtls_x509_crt correct_crt, wrong_crt;
+    uint32_t flags = 0;
+
+    mbedtls_x509_crt_init( &correct_crt );
+    mbedtls_x509_crt_init( &wrong_crt );
+    TEST_ASSERT(mbedtls_x509_crt_parse(&correct_crt, correct_sig_crt_pem_start, correct_sig_crt_pem_end - correct_sig_crt_pem_start) == 0);
+    TEST_ASSERT(mbedtls_x509_crt_parse(&wrong_crt, wrong_sig_crt_pem_start, wrong_sig_crt_pem_end - wrong_sig_crt_pem_start) == 0);
+
+    esp_crt_bundle_attach(NULL);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT(mbedtls_x509_crt_verify(&correct_crt, NULL, NULL, NULL, &flags, esp_crt_verify_callback, NULL) == 0);
+        TEST_ASSERT(mbedtls_x509_crt_verify(&wrong_crt, NULL, NULL, NULL, &flags, esp_crt_verify_callback, NULL) != 0);
+    }
+    esp_crt_bundle_detach(NULL);
+
+    /* Detaching drops the cached keys, they are parsed again from the attached bundle */
+    esp_crt_bundle_attach(NULL);
+    TEST_ASSERT(mbedtls_x509_crt_verify(&correct_crt, NULL, NULL, NULL, &flags, esp_crt_verify_callback, NULL) == 0);
+    esp_crt_bundle_detach(NULL);
+
+    mbedtls_x509_crt_free(&correct_crt);
+    mbedtls_x509_crt_free(&wrong_crt);
+}
+
 TEST_CASE("custom certificate bundle init API - bound checking", "[mbedtls]")
 {
 
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -64,6 +64,24 @@ esp_err_t sdmmc_get_status(sdmmc_card_t* card);
 esp_err_t sdmmc_write_sectors(sdmmc_card_t* card, const void* src,
         size_t start_sector, size_t sector_count);
 
+/**
+ * Tell an SD card the number of sectors of the next multi sector write (ACMD23)
+ *
+ * The card may erase the sectors in advance, which can make the following
+ * write faster. The setting only applies to the next sdmmc_write_sectors call
+ * writing more than one sector, so it should be issued right before it.
+ *
+ * @param card  pointer to card information structure previously initialized
+ *              using sdmmc_card_init
+ * @param sector_count  number of sectors which will be written
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_NOT_SUPPORTED if the card is an MMC
+ *      - ESP_ERR_INVALID_ARG if sector_count is 0
+ *      - One of the error codes from SDMMC host controller
+ */
+esp_err_t sdmmc_set_write_pre_erase_count(sdmmc_card_t* card, size_t sector_count);
+
 /**
  * Read given number of sectors from the SD/MMC card
  *
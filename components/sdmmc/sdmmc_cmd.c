@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -360,6 +360,17 @@ esp_err_t sdmmc_send_cmd_set_bus_width(sdmmc_card_t* card, int width)
     return sdmmc_send_app_cmd(card, &cmd);
 }
 
+esp_err_t sdmmc_send_cmd_set_wr_blk_erase_count(sdmmc_card_t* card, size_t block_count)
+{
+    sdmmc_command_t cmd = {
+            .opcode = SD_APP_SET_WR_BLK_ERASE_COUNT,
+            .flags = SCF_RSP_R1 | SCF_CMD_AC,
+            .arg = block_count & 0x7fffff,  // 23-bit argument
+    };
+
+    return sdmmc_send_app_cmd(card, &cmd);
+}
+
 esp_err_t sdmmc_send_cmd_crc_on_off(sdmmc_card_t* card, bool crc_enable)
 {
     assert(host_is_spi(card) && "CRC_ON_OFF can only be used in SPI mode");
@@ -392,6 +403,31 @@ esp_err_t sdmmc_send_cmd_send_status(sdmmc_card_t* card, uint32_t* out_status)
     return ESP_OK;
 }
 
+/* Allocates a DMA-capable buffer for up to SDMMC_BOUNCE_BUFFER_MAX_BLOCKS blocks,
+ * falling back to smaller sizes (down to a single block) if memory is short */
+static esp_err_t sdmmc_alloc_bounce_buffer(size_t block_size, size_t block_count,
+        void** out_buf, size_t* out_actual_size, size_t* out_blocks)
+{
+    size_t blocks = MIN(block_count, SDMMC_BOUNCE_BUFFER_MAX_BLOCKS);
+    esp_err_t err;
+    while ((err = esp_dma_malloc(blocks * block_size, 0, out_buf, out_actual_size)) != ESP_OK && blocks > 1) {
+        blocks /= 2;
+    }
+    *out_blocks = blocks;
+    return err;
+}
+
+esp_err_t sdmmc_set_write_pre_erase_count(sdmmc_card_t* card, size_t block_count)
+{
+    if (card->is_mmc) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (block_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return sdmmc_send_cmd_set_wr_blk_erase_count(card, block_count);
+}
+
 esp_err_t sdmmc_write_sectors(sdmmc_card_t* card, const void* src,
         size_t start_block, size_t block_count)
 {
@@ -405,20 +441,21 @@ esp_err_t sdmmc_write_sectors(sdmmc_card_t* card, const void* src,
         err = sdmmc_write_sectors_dma(card, src, start_block, block_count, block_size * block_count);
     } else {
         // SDMMC peripheral needs DMA-capable buffers. Split the write into
-        // separate single block writes, if needed, and allocate a temporary
-        // DMA-capable buffer.
+        // multi block writes of the size of a temporary DMA-capable buffer.
         void *tmp_buf = NULL;
         size_t actual_size = 0;
-        err = esp_dma_malloc(block_size, 0, &tmp_buf, &actual_size);
+        size_t tmp_blocks = 0;
+        err = sdmmc_alloc_bounce_buffer(block_size, block_count, &tmp_buf, &actual_size, &tmp_blocks);
         if (err != ESP_OK) {
             return err;
         }
 
         const uint8_t* cur_src = (const uint8_t*) src;
-        for (size_t i = 0; i < block_count; ++i) {
-            memcpy(tmp_buf, cur_src, block_size);
-            cur_src += block_size;
-            err = sdmmc_write_sectors_dma(card, tmp_buf, start_block + i, 1, actual_size);
+        for (size_t i = 0; i < block_count; i += tmp_blocks) {
+            size_t n = MIN(tmp_blocks, block_count - i);
+            memcpy(tmp_buf, cur_src, n * block_size);
+            cur_src += n * block_size;
+            err = sdmmc_write_sectors_dma(card, tmp_buf, start_block + i, n, actual_size);
             if (err != ESP_OK) {
                 ESP_LOGD(TAG, "%s: error 0x%x writing block %d+%d",
                         __func__, err, start_block, i);
@@ -523,24 +560,25 @@ esp_err_t sdmmc_read_sectors(sdmmc_card_t* card, void* dst,
         err = sdmmc_read_sectors_dma(card, dst, start_block, block_count, block_size * block_count);
     } else {
         // SDMMC peripheral needs DMA-capable buffers. Split the read into
-        // separate single block reads, if needed, and allocate a temporary
-        // DMA-capable buffer.
+        // multi block reads of the size of a temporary DMA-capable buffer.
         void *tmp_buf = NULL;
         size_t actual_size = 0;
-        err = esp_dma_malloc(block_size, 0, &tmp_buf, &actual_size);
+        size_t tmp_blocks = 0;
+        err = sdmmc_alloc_bounce_buffer(block_size, block_count, &tmp_buf, &actual_size, &tmp_blocks);
         if (err != ESP_OK) {
             return err;
         }
         uint8_t* cur_dst = (uint8_t*) dst;
-        for (size_t i = 0; i < block_count; ++i) {
-            err = sdmmc_read_sectors_dma(card, tmp_buf, start_block + i, 1, actual_size);
+        for (size_t i = 0; i < block_count; i += tmp_blocks) {
+            size_t n = MIN(tmp_blocks, block_count - i);
+            err = sdmmc_read_sectors_dma(card, tmp_buf, start_block + i, n, actual_size);
             if (err != ESP_OK) {
                 ESP_LOGD(TAG, "%s: error 0x%x writing block %d+%d",
                         __func__, err, start_block, i);
                 break;
             }
-            memcpy(cur_dst, tmp_buf, block_size);
-            cur_dst += block_size;
+            memcpy(cur_dst, tmp_buf, n * block_size);
+            cur_dst += n * block_size;
         }
         free(tmp_buf);
     }
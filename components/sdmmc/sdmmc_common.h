@@ -51,6 +51,10 @@
 #define SDMMC_SEND_OP_COND_MAX_RETRIES  100
 #define SDMMC_SEND_OP_COND_MAX_ERRORS   3
 
+/* Maximum number of blocks transferred through one bounce buffer when the
+ * caller's buffer is not DMA capable */
+#define SDMMC_BOUNCE_BUFFER_MAX_BLOCKS  16
+
 /* supported arguments for erase command 38 */
 #define SDMMC_SD_ERASE_ARG      0
 #define SDMMC_SD_DISCARD_ARG    1
@@ -77,6 +81,7 @@ esp_err_t sdmmc_send_cmd_send_scr(sdmmc_card_t* card, sdmmc_scr_t *out_scr);
 esp_err_t sdmmc_send_cmd_set_bus_width(sdmmc_card_t* card, int width);
 esp_err_t sdmmc_send_cmd_send_status(sdmmc_card_t* card, uint32_t* out_status);
 esp_err_t sdmmc_send_cmd_crc_on_off(sdmmc_card_t* card, bool crc_enable);
+esp_err_t sdmmc_send_cmd_set_wr_blk_erase_count(sdmmc_card_t* card, size_t block_count);
 
 /* Higher level functions */
 esp_err_t sdmmc_enable_hs_mode(sdmmc_card_t* card);
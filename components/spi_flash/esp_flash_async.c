@@ -0,0 +1,220 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_flash_async.h"
+
+/* Sector size of the flash, esp_flash_erase_region() requires this alignment */
+#define FLASH_ASYNC_SECTOR_SIZE     4096
+
+#define FLASH_ASYNC_IDLE_BIT        BIT0
+#define FLASH_ASYNC_STOPPED_BIT     BIT1
+
+typedef enum {
+    FLASH_ASYNC_OP_ERASE,
+    FLASH_ASYNC_OP_WRITE,
+    FLASH_ASYNC_OP_STOP,
+} flash_async_op_type_t;
+
+typedef struct {
+    flash_async_op_type_t type;
+    esp_flash_t *chip;
+    const uint8_t *buffer;
+    uint32_t address;
+    uint32_t length;
+    esp_flash_async_done_cb_t cb;
+    void *arg;
+} flash_async_op_t;
+
+typedef struct {
+    esp_flash_async_config_t config;
+    QueueHandle_t queue;
+    SemaphoreHandle_t lock;     /* guards pending */
+    EventGroupHandle_t events;
+    size_t pending;             /* submitted operations which haven't completed yet */
+} flash_async_ctx_t;
+
+static const char *TAG = "flash_async";
+
+static flash_async_ctx_t *s_ctx;
+
+static esp_err_t flash_async_run(const flash_async_op_t *op)
+{
+    esp_err_t err = ESP_OK;
+    uint32_t done = 0;
+    while (err == ESP_OK && done < op->length) {
+        uint32_t chunk;
+        if (op->type == FLASH_ASYNC_OP_ERASE) {
+            chunk = MIN(op->length - done, s_ctx->config.erase_chunk_size);
+            err = esp_flash_erase_region(op->chip, op->address + done, chunk);
+        } else {
+            chunk = MIN(op->length - done, s_ctx->config.write_chunk_size);
+            err = esp_flash_write(op->chip, op->buffer + done, op->address + done, chunk);
+        }
+        done += chunk;
+        // The flash is released between the chunks, let other tasks of the same priority use it.
+        // Tasks of higher priority have already preempted this task when they became ready.
+        taskYIELD();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "%s at 0x%" PRIx32 " failed (0x%x)",
+                 op->type == FLASH_ASYNC_OP_ERASE ? "erase" : "write", op->address + done, err);
+    }
+    return err;
+}
+
+static void flash_async_task(void *arg)
+{
+    flash_async_op_t op;
+    while (xQueueReceive(s_ctx->queue, &op, portMAX_DELAY) == pdTRUE) {
+        if (op.type == FLASH_ASYNC_OP_STOP) {
+            break;
+        }
+        esp_err_t err = flash_async_run(&op);
+        if (op.cb) {
+            op.cb(err, op.arg);
+        }
+        xSemaphoreTake(s_ctx->lock, portMAX_DELAY);
+        if (--s_ctx->pending == 0) {
+            xEventGroupSetBits(s_ctx->events, FLASH_ASYNC_IDLE_BIT);
+        }
+        xSemaphoreGive(s_ctx->lock);
+    }
+    xEventGroupSetBits(s_ctx->events, FLASH_ASYNC_STOPPED_BIT);
+    vTaskDelete(NULL);
+}
+
+static void flash_async_free(flash_async_ctx_t *ctx)
+{
+    if (ctx->queue) {
+        vQueueDelete(ctx->queue);
+    }
+    if (ctx->lock) {
+        vSemaphoreDelete(ctx->lock);
+    }
+    if (ctx->events) {
+        vEventGroupDelete(ctx->events);
+    }
+    free(ctx);
+}
+
+esp_err_t esp_flash_async_init(const esp_flash_async_config_t *config)
+{
+    if (config == NULL || config->queue_size == 0 || config->write_chunk_size == 0 ||
+            config->erase_chunk_size == 0 || config->erase_chunk_size % FLASH_ASYNC_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_ctx != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    flash_async_ctx_t *ctx = calloc(1, sizeof(flash_async_ctx_t));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->config = *config;
+    // One more entry for the stop request, so that esp_flash_async_deinit() never has to wait for space
+    ctx->queue = xQueueCreate(config->queue_size + 1, sizeof(flash_async_op_t));
+    ctx->lock = xSemaphoreCreateMutex();
+    ctx->events = xEventGroupCreate();
+    if (ctx->queue == NULL || ctx->lock == NULL || ctx->events == NULL) {
+        flash_async_free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(ctx->events, FLASH_ASYNC_IDLE_BIT);
+
+    s_ctx = ctx;
+    if (xTaskCreatePinnedToCore(flash_async_task, "flash_async", config->task_stack_size, NULL,
+                                config->task_priority, NULL, config->task_core_id) != pdPASS) {
+        s_ctx = NULL;
+        flash_async_free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_flash_async_deinit(void)
+{
+    if (s_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const flash_async_op_t stop = { .type = FLASH_ASYNC_OP_STOP };
+    xQueueSend(s_ctx->queue, &stop, portMAX_DELAY);
+    xEventGroupWaitBits(s_ctx->events, FLASH_ASYNC_STOPPED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    flash_async_ctx_t *ctx = s_ctx;
+    s_ctx = NULL;
+    flash_async_free(ctx);
+    return ESP_OK;
+}
+
+static esp_err_t flash_async_submit(const flash_async_op_t *op)
+{
+    if (s_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_ctx->lock, portMAX_DELAY);
+    // The queue has one entry more than allowed, it is reserved for the stop request
+    if (s_ctx->pending >= s_ctx->config.queue_size || xQueueSend(s_ctx->queue, op, 0) != pdTRUE) {
+        err = ESP_ERR_NO_MEM;
+    } else if (s_ctx->pending++ == 0) {
+        xEventGroupClearBits(s_ctx->events, FLASH_ASYNC_IDLE_BIT);
+    }
+    xSemaphoreGive(s_ctx->lock);
+    return err;
+}
+
+esp_err_t esp_flash_async_erase_region(esp_flash_t *chip, uint32_t start, uint32_t len,
+                                       esp_flash_async_done_cb_t cb, void *arg)
+{
+    if (start % FLASH_ASYNC_SECTOR_SIZE != 0 || len % FLASH_ASYNC_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const flash_async_op_t op = {
+        .type = FLASH_ASYNC_OP_ERASE,
+        .chip = chip,
+        .address = start,
+        .length = len,
+        .cb = cb,
+        .arg = arg,
+    };
+    return flash_async_submit(&op);
+}
+
+esp_err_t esp_flash_async_write(esp_flash_t *chip, const void *buffer, uint32_t address, uint32_t length,
+                                esp_flash_async_done_cb_t cb, void *arg)
+{
+    if (buffer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const flash_async_op_t op = {
+        .type = FLASH_ASYNC_OP_WRITE,
+        .chip = chip,
+        .buffer = buffer,
+        .address = address,
+        .length = length,
+        .cb = cb,
+        .arg = arg,
+    };
+    return flash_async_submit(&op);
+}
+
+esp_err_t esp_flash_async_wait_idle(TickType_t timeout)
+{
+    if (s_ctx == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_ctx->events, FLASH_ASYNC_IDLE_BIT, pdFALSE, pdTRUE, timeout);
+    return (bits & FLASH_ASYNC_IDLE_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
@@ -0,0 +1,134 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_flash.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Completion callback of an asynchronous flash operation
+ *
+ * Called from the context of the flash worker task. The callback must not block
+ * for a long time and must not wait for other asynchronous operations.
+ *
+ * @param result ESP_OK if the operation succeeded, error code of the failed erase/write call otherwise
+ * @param arg    User argument passed when the operation was submitted
+ */
+typedef void (*esp_flash_async_done_cb_t)(esp_err_t result, void *arg);
+
+/**
+ * @brief Configuration of the asynchronous flash operation queue
+ */
+typedef struct {
+    size_t queue_size;          /*!< Maximum number of pending operations */
+    uint32_t task_priority;     /*!< Priority of the worker task. Tasks of higher priority preempt it between chunks */
+    uint32_t task_stack_size;   /*!< Stack size of the worker task, the callbacks run on this stack */
+    int task_core_id;           /*!< Core the worker task is pinned to, or tskNO_AFFINITY */
+    uint32_t erase_chunk_size;  /*!< Erases are split into erase calls of this size, multiple of the sector size */
+    uint32_t write_chunk_size;  /*!< Writes are split into write calls of this size */
+} esp_flash_async_config_t;
+
+#define ESP_FLASH_ASYNC_CONFIG_DEFAULT() (esp_flash_async_config_t) { \
+    .queue_size = 8, \
+    .task_priority = 1, \
+    .task_stack_size = 3072, \
+    .task_core_id = tskNO_AFFINITY, \
+    .erase_chunk_size = 4096, \
+    .write_chunk_size = 1024, \
+}
+
+/**
+ * @brief Start the asynchronous flash operation queue
+ *
+ * Creates the worker task which executes submitted operations in submission order.
+ *
+ * @param config Configuration, see ESP_FLASH_ASYNC_CONFIG_DEFAULT()
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the configuration is invalid
+ *      - ESP_ERR_INVALID_STATE if the queue has already been started
+ *      - ESP_ERR_NO_MEM if the queue or the task can't be created
+ */
+esp_err_t esp_flash_async_init(const esp_flash_async_config_t *config);
+
+/**
+ * @brief Stop the asynchronous flash operation queue
+ *
+ * Waits until all pending operations are completed and deletes the worker task.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_STATE if the queue hasn't been started
+ */
+esp_err_t esp_flash_async_deinit(void);
+
+/**
+ * @brief Submit an erase of a flash region
+ *
+ * The region is erased by several calls of esp_flash_erase_region(), each of
+ * config->erase_chunk_size bytes at most. Between the calls, other tasks can access
+ * the flash, e.g. read it with esp_flash_read() or run code from it.
+ *
+ * @param chip  Flash chip, NULL for the default chip
+ * @param start Address to start erasing, must be aligned to the sector size
+ * @param len   Length of the region, must be a multiple of the sector size
+ * @param cb    Callback called when the operation is completed, may be NULL
+ * @param arg   Argument of the callback
+ * @return
+ *      - ESP_OK if the operation has been queued
+ *      - ESP_ERR_INVALID_ARG if the region is not aligned to the sector size
+ *      - ESP_ERR_INVALID_STATE if the queue hasn't been started
+ *      - ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t esp_flash_async_erase_region(esp_flash_t *chip, uint32_t start, uint32_t len,
+                                       esp_flash_async_done_cb_t cb, void *arg);
+
+/**
+ * @brief Submit a write to flash
+ *
+ * The data is written by several calls of esp_flash_write(), each of
+ * config->write_chunk_size bytes at most.
+ *
+ * @note The data is not copied, the buffer must stay valid until the callback is called.
+ * @note Until the callback is called, reads of the region may return the previous content.
+ *
+ * @param chip    Flash chip, NULL for the default chip
+ * @param buffer  Data to write
+ * @param address Address to write to
+ * @param length  Length of the data in bytes
+ * @param cb      Callback called when the operation is completed, may be NULL
+ * @param arg     Argument of the callback
+ * @return
+ *      - ESP_OK if the operation has been queued
+ *      - ESP_ERR_INVALID_ARG if buffer is NULL
+ *      - ESP_ERR_INVALID_STATE if the queue hasn't been started
+ *      - ESP_ERR_NO_MEM if the queue is full
+ */
+esp_err_t esp_flash_async_write(esp_flash_t *chip, const void *buffer, uint32_t address, uint32_t length,
+                                esp_flash_async_done_cb_t cb, void *arg);
+
+/**
+ * @brief Wait until all submitted operations are completed
+ *
+ * @param timeout Maximum time to wait
+ * @return
+ *      - ESP_OK if no operation is pending
+ *      - ESP_ERR_TIMEOUT if operations are still pending after the timeout
+ *      - ESP_ERR_INVALID_STATE if the queue hasn't been started
+ */
+esp_err_t esp_flash_async_wait_idle(TickType_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,13 +1,144 @@
 /*
- * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2023-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_flash.h"
 
+/*
+ * RAM backed emulation of the main flash chip, so that code built on top of esp_flash
+ * can be run and benchmarked on the host. Follows the NOR flash semantics: writes can
+ * only clear bits, erases set whole sectors to 0xFF.
+ *
+ * With CONFIG_SPI_FLASH_LINUX_TIMING, erase and program operations keep the caller busy
+ * for the typical time of the chip. Unless CONFIG_SPI_FLASH_LINUX_EMULATE_SUSPEND is set,
+ * the scheduler is suspended meanwhile, like the cache is disabled on the target while
+ * the chip is busy and no other task can run from flash or access it.
+ */
+
+#define EMULATED_SECTOR_SIZE    4096
+#define EMULATED_PAGE_SIZE      256
+
+static uint8_t *s_flash;
+
+static uint8_t *emulated_flash(void)
+{
+    if (s_flash == NULL) {
+        s_flash = malloc(CONFIG_SPI_FLASH_LINUX_SIZE);
+        if (s_flash != NULL) {
+            memset(s_flash, 0xFF, CONFIG_SPI_FLASH_LINUX_SIZE);
+        }
+    }
+    return s_flash;
+}
+
+static esp_err_t check_range(uint32_t address, uint32_t length)
+{
+    if (address > CONFIG_SPI_FLASH_LINUX_SIZE || length > CONFIG_SPI_FLASH_LINUX_SIZE - address) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return emulated_flash() ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+#if CONFIG_SPI_FLASH_LINUX_TIMING
+static int64_t time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void emulate_busy(uint32_t us)
+{
+#if !CONFIG_SPI_FLASH_LINUX_EMULATE_SUSPEND
+    vTaskSuspendAll();
+#endif
+    const int64_t end = time_us() + us;
+    while (time_us() < end) {
+    }
+#if !CONFIG_SPI_FLASH_LINUX_EMULATE_SUSPEND
+    xTaskResumeAll();
+#endif
+}
+#else
+#define emulate_busy(us)    do {} while (0)
+#endif
+
 esp_err_t esp_flash_get_size(esp_flash_t *chip, uint32_t *out_size)
 {
     (void)chip;
     *out_size = UINT32_MAX;
     return ESP_OK;
 }
+
+esp_err_t esp_flash_read(esp_flash_t *chip, void *buffer, uint32_t address, uint32_t length)
+{
+    (void)chip;
+    if (buffer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = check_range(address, length);
+    if (err == ESP_OK) {
+        memcpy(buffer, s_flash + address, length);
+    }
+    return err;
+}
+
+esp_err_t esp_flash_write(esp_flash_t *chip, const void *buffer, uint32_t address, uint32_t length)
+{
+    (void)chip;
+    if (buffer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = check_range(address, length);
+    if (err != ESP_OK) {
+        return err;
+    }
+    const uint8_t *src = buffer;
+    while (length > 0) {
+        // Program commands can't cross page boundaries
+        uint32_t page_len = MIN(length, EMULATED_PAGE_SIZE - address % EMULATED_PAGE_SIZE);
+        emulate_busy(CONFIG_SPI_FLASH_LINUX_PAGE_PROGRAM_US);
+        for (uint32_t i = 0; i < page_len; i++) {
+            s_flash[address + i] &= src[i];
+        }
+        address += page_len;
+        src += page_len;
+        length -= page_len;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_flash_erase_region(esp_flash_t *chip, uint32_t start, uint32_t len)
+{
+    (void)chip;
+    if (start % EMULATED_SECTOR_SIZE != 0 || len % EMULATED_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = check_range(start, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+#if CONFIG_SPI_FLASH_LINUX_TIMING && CONFIG_SPI_FLASH_YIELD_DURING_ERASE
+    int64_t last_yield = time_us();
+#endif
+    for (uint32_t offset = 0; offset < len; offset += EMULATED_SECTOR_SIZE) {
+        emulate_busy(CONFIG_SPI_FLASH_LINUX_SECTOR_ERASE_US);
+        memset(s_flash + start + offset, 0xFF, EMULATED_SECTOR_SIZE);
+#if CONFIG_SPI_FLASH_LINUX_TIMING && CONFIG_SPI_FLASH_YIELD_DURING_ERASE
+        // Same as the target driver, give the CPU to other tasks between erase commands
+        if (time_us() - last_yield >= CONFIG_SPI_FLASH_ERASE_YIELD_DURATION_MS * 1000) {
+            vTaskDelay(CONFIG_SPI_FLASH_ERASE_YIELD_TICKS);
+            last_yield = time_us();
+        }
+#endif
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,172 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_flash.h"
+#include "esp_flash_async.h"
+#include "sdkconfig.h"
+
+#define TEST_REGION_START   0x100000
+#define TEST_REGION_SIZE    (16 * 4096)
+#define READER_PRIORITY     10
+
+/* Records the completion order, or -1 if the operation failed */
+static void record_done(esp_err_t result, void *arg)
+{
+    static int s_count;
+    *(int *) arg = (result == ESP_OK) ? ++s_count : -1;
+}
+
+TEST_CASE("async erase and write are executed in order", "[esp_flash_async]")
+{
+    static uint8_t data[10000];
+    static uint8_t readback[sizeof(data)];
+    for (int i = 0; i < sizeof(data); i++) {
+        data[i] = i * 7;
+    }
+    esp_flash_async_config_t config = ESP_FLASH_ASYNC_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_flash_async_init(&config));
+
+    int erase_order = 0, write_order = 0;
+    TEST_ESP_OK(esp_flash_write(NULL, data, TEST_REGION_START, 256)); // dirty the region first
+    TEST_ESP_OK(esp_flash_async_erase_region(NULL, TEST_REGION_START, 4 * 4096, record_done, &erase_order));
+    TEST_ESP_OK(esp_flash_async_write(NULL, data, TEST_REGION_START + 1, sizeof(data), record_done, &write_order));
+    TEST_ESP_OK(esp_flash_async_wait_idle(portMAX_DELAY));
+
+    TEST_ASSERT_GREATER_THAN(0, erase_order);
+    TEST_ASSERT_EQUAL(erase_order + 1, write_order);
+    TEST_ESP_OK(esp_flash_read(NULL, readback, TEST_REGION_START + 1, sizeof(data)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(data, readback, sizeof(data));
+    TEST_ESP_OK(esp_flash_read(NULL, readback, TEST_REGION_START, 1));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, readback[0]);
+
+    TEST_ESP_OK(esp_flash_async_deinit());
+}
+
+static void block_done(esp_err_t result, void *arg)
+{
+    xSemaphoreTake((SemaphoreHandle_t) arg, portMAX_DELAY);
+}
+
+TEST_CASE("async queue rejects invalid and excess operations", "[esp_flash_async]")
+{
+    esp_flash_async_config_t config = ESP_FLASH_ASYNC_CONFIG_DEFAULT();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_flash_async_erase_region(NULL, TEST_REGION_START, 4096, NULL, NULL));
+    config.erase_chunk_size = 1000;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_flash_async_init(&config));
+
+    config = ESP_FLASH_ASYNC_CONFIG_DEFAULT();
+    config.queue_size = 2;
+    TEST_ESP_OK(esp_flash_async_init(&config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_flash_async_init(&config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_flash_async_erase_region(NULL, TEST_REGION_START + 1, 4096, NULL, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_flash_async_erase_region(NULL, TEST_REGION_START, 100, NULL, NULL));
+
+    // The first operation stays pending until its callback is released
+    SemaphoreHandle_t release = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(release);
+    TEST_ESP_OK(esp_flash_async_erase_region(NULL, TEST_REGION_START, 4096, block_done, release));
+    TEST_ESP_OK(esp_flash_async_erase_region(NULL, TEST_REGION_START, 4096, NULL, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, esp_flash_async_erase_region(NULL, TEST_REGION_START, 4096, NULL, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, esp_flash_async_wait_idle(pdMS_TO_TICKS(100)));
+
+    xSemaphoreGive(release);
+    TEST_ESP_OK(esp_flash_async_wait_idle(portMAX_DELAY));
+    TEST_ESP_OK(esp_flash_async_deinit());
+    vSemaphoreDelete(release);
+}
+
+#if CONFIG_SPI_FLASH_LINUX_TIMING
+
+static volatile bool s_reader_stop;
+static int64_t s_reader_max_us;
+static esp_err_t s_reader_err;
+
+static int64_t time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Wakes up every tick and reads the flash, records how late the read completes */
+static void reader_task(void *arg)
+{
+    uint8_t buf[64];
+    while (!s_reader_stop) {
+        int64_t start = time_us();
+        vTaskDelay(1);
+        esp_err_t err = esp_flash_read(NULL, buf, 0, sizeof(buf));
+        if (err != ESP_OK) {
+            s_reader_err = err;
+        }
+        int64_t latency = time_us() - start - portTICK_PERIOD_MS * 1000;
+        if (latency > s_reader_max_us) {
+            s_reader_max_us = latency;
+        }
+    }
+    xSemaphoreGive((SemaphoreHandle_t) arg);
+    vTaskDelete(NULL);
+}
+
+static int64_t measure_erase_latency(bool async)
+{
+    SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(done);
+    s_reader_stop = false;
+    s_reader_max_us = 0;
+    s_reader_err = ESP_OK;
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(reader_task, "reader", 4096, done, READER_PRIORITY, NULL));
+
+    int64_t start = time_us();
+    if (async) {
+        TEST_ESP_OK(esp_flash_async_erase_region(NULL, TEST_REGION_START, TEST_REGION_SIZE, NULL, NULL));
+        TEST_ESP_OK(esp_flash_async_wait_idle(portMAX_DELAY));
+    } else {
+        TEST_ESP_OK(esp_flash_erase_region(NULL, TEST_REGION_START, TEST_REGION_SIZE));
+    }
+    int64_t duration = time_us() - start;
+
+    s_reader_stop = true;
+    xSemaphoreTake(done, portMAX_DELAY);
+    vSemaphoreDelete(done);
+    TEST_ESP_OK(s_reader_err);
+    printf("%s erase of %d KB: %" PRId64 " ms, max read latency %" PRId64 " us\n",
+           async ? "async" : "sync", TEST_REGION_SIZE / 1024, duration / 1000, s_reader_max_us);
+    return s_reader_max_us;
+}
+
+TEST_CASE("read latency during sync and async erase", "[esp_flash_async][latency]")
+{
+    esp_flash_async_config_t config = ESP_FLASH_ASYNC_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_flash_async_init(&config));
+
+    measure_erase_latency(false);
+    int64_t async_latency = measure_erase_latency(true);
+#if CONFIG_SPI_FLASH_LINUX_EMULATE_SUSPEND
+    // Reads are served while the emulated chip is busy
+    TEST_ASSERT_LESS_THAN(CONFIG_SPI_FLASH_LINUX_SECTOR_ERASE_US, async_latency);
+#else
+    // Reads have to wait for one erase command at most
+    TEST_ASSERT_LESS_THAN(2 * CONFIG_SPI_FLASH_LINUX_SECTOR_ERASE_US, async_latency);
+#endif
+
+    TEST_ESP_OK(esp_flash_async_deinit());
+}
+
+#endif // CONFIG_SPI_FLASH_LINUX_TIMING
+
+void app_main(void)
+{
+    printf("Running esp_flash_async linux host test app");
+    unity_run_menu();
+}
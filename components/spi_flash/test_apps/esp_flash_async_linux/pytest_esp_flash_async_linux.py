@@ -0,0 +1,16 @@
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+import pytest
+from pytest_embedded import Dut
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+@pytest.mark.parametrize('config', [
+    'default',
+    'suspend',
+], indirect=True)
+def test_esp_flash_async_linux(dut: Dut) -> None:
+    dut.expect_exact('Press ENTER to see the list of tests')
+    dut.write('![ignore]')
+    dut.expect_unity_test_output(timeout=120)
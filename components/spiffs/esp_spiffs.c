@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -96,9 +96,11 @@ static void esp_spiffs_free(esp_spiffs_t ** efs)
         free(e->fs);
     }
     vSemaphoreDelete(e->lock);
+    _lock_close(&e->stats_lock);
     free(e->fds);
     free(e->cache);
     free(e->work);
+    free(e->name_index);
     free(e);
 }
 
@@ -145,6 +147,14 @@ static esp_err_t esp_spiffs_init(const esp_vfs_spiffs_conf_t* conf)
         return ESP_ERR_INVALID_STATE;
     }
 
+#if SPIFFS_CACHE
+    /* SPIFFS tracks the cache pages in a 32-bit map */
+    if (conf->cache_pages > 32) {
+        ESP_LOGE(TAG, "cache_pages can be 32 at most");
+        return ESP_ERR_INVALID_ARG;
+    }
+#endif
+
     uint32_t flash_page_size = g_rom_flashchip.page_size;
     uint32_t log_page_size = CONFIG_SPIFFS_PAGE_SIZE;
     if (log_page_size % flash_page_size != 0) {
@@ -236,7 +246,8 @@ static esp_err_t esp_spiffs_init(const esp_vfs_spiffs_conf_t* conf)
     }
 
 #if SPIFFS_CACHE
-    efs->cache_sz = sizeof(spiffs_cache) + conf->max_files * (sizeof(spiffs_cache_page)
+    const size_t cache_pages = conf->cache_pages ? conf->cache_pages : conf->max_files;
+    efs->cache_sz = sizeof(spiffs_cache) + cache_pages * (sizeof(spiffs_cache_page)
                           + efs->cfg.log_page_size);
     efs->cache = calloc(efs->cache_sz, 1);
     if (efs->cache == NULL) {
@@ -246,6 +257,16 @@ static esp_err_t esp_spiffs_init(const esp_vfs_spiffs_conf_t* conf)
     }
 #endif
 
+    if (conf->name_index_size) {
+        efs->name_index = calloc(conf->name_index_size, sizeof(esp_spiffs_name_entry_t));
+        if (efs->name_index == NULL) {
+            ESP_LOGE(TAG, "name index could not be allocated");
+            esp_spiffs_free(&efs);
+            return ESP_ERR_NO_MEM;
+        }
+        efs->name_index_sz = conf->name_index_size;
+    }
+
     const uint32_t work_sz = efs->cfg.log_page_size * 2;
     efs->work = calloc(work_sz, 1);
     if (efs->work == NULL) {
@@ -309,6 +330,49 @@ esp_err_t esp_spiffs_info(const char* partition_label, size_t *total_bytes, size
     return ESP_OK;
 }
 
+esp_err_t esp_spiffs_get_stats(const char* partition_label, esp_spiffs_stats_t *stats)
+{
+    int index;
+    if (stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (esp_spiffs_by_label(partition_label, &index) != ESP_OK) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_spiffs_t * efs = _efs[index];
+    _lock_acquire(&efs->stats_lock);
+    *stats = efs->stats;
+    _lock_release(&efs->stats_lock);
+#if SPIFFS_CACHE && SPIFFS_CACHE_STATS
+    stats->cache_hits = efs->fs->cache_hits;
+    stats->cache_misses = efs->fs->cache_misses;
+#endif
+#if SPIFFS_GC_STATS
+    stats->gc_runs = efs->fs->stats_gc_runs;
+#endif
+    return ESP_OK;
+}
+
+esp_err_t esp_spiffs_reset_stats(const char* partition_label)
+{
+    int index;
+    if (esp_spiffs_by_label(partition_label, &index) != ESP_OK) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_spiffs_t * efs = _efs[index];
+    _lock_acquire(&efs->stats_lock);
+    memset(&efs->stats, 0, sizeof(efs->stats));
+    _lock_release(&efs->stats_lock);
+#if SPIFFS_CACHE && SPIFFS_CACHE_STATS
+    efs->fs->cache_hits = 0;
+    efs->fs->cache_misses = 0;
+#endif
+#if SPIFFS_GC_STATS
+    efs->fs->stats_gc_runs = 0;
+#endif
+    return ESP_OK;
+}
+
 esp_err_t esp_spiffs_check(const char* partition_label)
 {
     int index;
@@ -367,6 +431,11 @@ esp_err_t esp_spiffs_format(const char* partition_label)
     }
 
     if (partition_was_mounted) {
+        if (_efs[index]->name_index) {
+            _lock_acquire(&_efs[index]->stats_lock);
+            memset(_efs[index]->name_index, 0, _efs[index]->name_index_sz * sizeof(esp_spiffs_name_entry_t));
+            _lock_release(&_efs[index]->stats_lock);
+        }
         res = SPIFFS_mount(_efs[index]->fs, &_efs[index]->cfg, _efs[index]->work,
                             _efs[index]->fds, _efs[index]->fds_sz, _efs[index]->cache,
                             _efs[index]->cache_sz, spiffs_api_check);
@@ -532,12 +601,113 @@ static int spiffs_mode_conv(int m)
     return res;
 }
 
+static void vfs_spiffs_count(esp_spiffs_t *efs, uint32_t *counter)
+{
+    _lock_acquire(&efs->stats_lock);
+    (*counter)++;
+    _lock_release(&efs->stats_lock);
+}
+
+static uint32_t vfs_spiffs_name_hash(const char *name)
+{
+    /* FNV-1a */
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (uint8_t) *name++) * 16777619u;
+    }
+    return hash;
+}
+
+/* Remember the object index header page of a file, pix 0 forgets the file */
+static void vfs_spiffs_index_set(esp_spiffs_t *efs, const char *name, spiffs_page_ix pix)
+{
+    if (efs->name_index == NULL) {
+        return;
+    }
+    uint32_t hash = vfs_spiffs_name_hash(name);
+    esp_spiffs_name_entry_t *entry = &efs->name_index[hash % efs->name_index_sz];
+    _lock_acquire(&efs->stats_lock);
+    if (pix != 0) {
+        entry->name_hash = hash;
+        entry->pix = pix;
+    } else if (entry->name_hash == hash) {
+        entry->pix = 0;
+    }
+    _lock_release(&efs->stats_lock);
+}
+
+static void vfs_spiffs_index_set_fd(esp_spiffs_t *efs, spiffs_file fd)
+{
+    spiffs_stat s;
+    if (efs->name_index == NULL) {
+        return;
+    }
+    if (SPIFFS_fstat(efs->fs, fd, &s) == SPIFFS_OK) {
+        vfs_spiffs_index_set(efs, (const char *) s.name, s.pix);
+    } else {
+        SPIFFS_clearerr(efs->fs);
+    }
+}
+
+/* Open an existing file through the name index. Returns a negative value if the file
+ * is not in the index, the caller has to fall back to the lookup by name then.
+ */
+static spiffs_file vfs_spiffs_open_indexed(esp_spiffs_t *efs, const char *path, spiffs_flags flags, spiffs_stat *s)
+{
+    uint32_t hash = vfs_spiffs_name_hash(path);
+    esp_spiffs_name_entry_t *entry = &efs->name_index[hash % efs->name_index_sz];
+    spiffs_page_ix pix = 0;
+    _lock_acquire(&efs->stats_lock);
+    if (entry->name_hash == hash) {
+        pix = entry->pix;
+    }
+    _lock_release(&efs->stats_lock);
+
+    if (pix != 0) {
+        /* The page is validated by SPIFFS, but it may have been moved by GC or by an update
+         * of the file and now hold the index header of another file.
+         */
+        spiffs_file fd = SPIFFS_open_by_page(efs->fs, pix, flags & ~SPIFFS_O_TRUNC, 0);
+        if (fd >= 0) {
+            if (SPIFFS_fstat(efs->fs, fd, s) == SPIFFS_OK && strcmp((const char *) s->name, path) == 0) {
+                /* Truncate only once the page is known to hold the requested file */
+                if (!(flags & SPIFFS_O_TRUNC) || SPIFFS_ftruncate(efs->fs, fd, 0) == SPIFFS_OK) {
+                    vfs_spiffs_count(efs, &efs->stats.name_index_hits);
+                    return fd;
+                }
+            }
+            (void) SPIFFS_close(efs->fs, fd);
+        }
+        SPIFFS_clearerr(efs->fs);
+    }
+    vfs_spiffs_count(efs, &efs->stats.name_index_misses);
+    return -1;
+}
+
+/* Open a file through the name index if possible, by name otherwise */
+static spiffs_file vfs_spiffs_open_file(esp_spiffs_t *efs, const char *path, spiffs_flags flags, spiffs_mode mode)
+{
+    spiffs_file fd = -1;
+    if (efs->name_index && !(flags & SPIFFS_O_CREAT)) {
+        spiffs_stat s;
+        fd = vfs_spiffs_open_indexed(efs, path, flags, &s);
+    }
+    if (fd < 0) {
+        vfs_spiffs_count(efs, &efs->stats.lookup_scans);
+        fd = SPIFFS_open(efs->fs, path, flags, mode);
+        if (fd >= 0) {
+            vfs_spiffs_index_set_fd(efs, fd);
+        }
+    }
+    return fd;
+}
+
 static int vfs_spiffs_open(void* ctx, const char * path, int flags, int mode)
 {
     assert(path);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
     int spiffs_flags = spiffs_mode_conv(flags);
-    int fd = SPIFFS_open(efs->fs, path, spiffs_flags, mode);
+    int fd = vfs_spiffs_open_file(efs, path, spiffs_flags, mode);
     if (fd < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
@@ -576,6 +746,8 @@ static ssize_t vfs_spiffs_read(void* ctx, int fd, void * dst, size_t size)
 static int vfs_spiffs_close(void* ctx, int fd)
 {
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
+    // Writes move the object index header, remember where it ended up
+    vfs_spiffs_index_set_fd(efs, fd);
     int res = SPIFFS_close(efs->fs, fd);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
@@ -625,11 +797,23 @@ static int vfs_spiffs_stat(void* ctx, const char * path, struct stat * st)
     assert(st);
     spiffs_stat s;
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    off_t res = SPIFFS_stat(efs->fs, path, &s);
+    off_t res = -1;
+    if (efs->name_index) {
+        spiffs_file fd = vfs_spiffs_open_indexed(efs, path, SPIFFS_O_RDONLY, &s);
+        if (fd >= 0) {
+            (void) SPIFFS_close(efs->fs, fd);
+            res = SPIFFS_OK;
+        }
+    }
     if (res < 0) {
-        errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
-        SPIFFS_clearerr(efs->fs);
-        return -1;
+        vfs_spiffs_count(efs, &efs->stats.lookup_scans);
+        res = SPIFFS_stat(efs->fs, path, &s);
+        if (res < 0) {
+            errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
+            SPIFFS_clearerr(efs->fs);
+            return -1;
+        }
+        vfs_spiffs_index_set(efs, path, s.pix);
     }
     memset(st, 0, sizeof(*st));
     st->st_size = s.size;
@@ -646,12 +830,15 @@ static int vfs_spiffs_rename(void* ctx, const char *src, const char *dst)
     assert(src);
     assert(dst);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
+    vfs_spiffs_count(efs, &efs->stats.lookup_scans);
     int res = SPIFFS_rename(efs->fs, src, dst);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
         return -1;
     }
+    vfs_spiffs_index_set(efs, src, 0);
+    vfs_spiffs_index_set(efs, dst, 0);
     return res;
 }
 
@@ -659,12 +846,14 @@ static int vfs_spiffs_unlink(void* ctx, const char *path)
 {
     assert(path);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
+    vfs_spiffs_count(efs, &efs->stats.lookup_scans);
     int res = SPIFFS_remove(efs->fs, path);
     if (res < 0) {
         errno = spiffs_res_to_errno(SPIFFS_errno(efs->fs));
         SPIFFS_clearerr(efs->fs);
         return -1;
     }
+    vfs_spiffs_index_set(efs, path, 0);
     return res;
 }
 
@@ -808,7 +997,7 @@ static int vfs_spiffs_truncate(void* ctx, const char *path, off_t length)
 {
     assert(path);
     esp_spiffs_t * efs = (esp_spiffs_t *)ctx;
-    int fd = SPIFFS_open(efs->fs, path, SPIFFS_WRONLY, 0);
+    int fd = vfs_spiffs_open_file(efs, path, SPIFFS_WRONLY, 0);
     if (fd < 0) {
         goto err;
     }
@@ -819,6 +1008,7 @@ static int vfs_spiffs_truncate(void* ctx, const char *path, off_t length)
         goto err;
     }
 
+    vfs_spiffs_index_set_fd(efs, fd);
     res = SPIFFS_close(efs->fs, fd);
     if (res < 0) {
        goto err;
@@ -882,6 +1072,7 @@ static int vfs_spiffs_utime(void *ctx, const char *path, const struct utimbuf *t
         t = (spiffs_time_t)time(NULL);
     }
 
+    vfs_spiffs_count(efs, &efs->stats.lookup_scans);
     int ret = vfs_spiffs_update_mtime_value(efs->fs, path, t);
 
     if (ret != SPIFFS_OK) {
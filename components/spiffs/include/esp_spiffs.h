@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -22,8 +22,26 @@ typedef struct {
         const char* partition_label;    /*!< Optional, label of SPIFFS partition to use. If set to NULL, first partition with subtype=spiffs will be used. */
         size_t max_files;               /*!< Maximum files that could be open at the same time. */
         bool format_if_mount_failed;    /*!< If true, it will format the file system if it fails to mount. */
+        size_t cache_pages;             /*!< Optional, number of logical pages held in the RAM page cache (at most 32).
+                                             If set to 0, max_files pages are used. Requires CONFIG_SPIFFS_CACHE. */
+        size_t name_index_size;         /*!< Optional, number of entries of the RAM index which maps file names to the
+                                             location of their object index header, so that open() and stat() of
+                                             recently used files don't scan the object lookup pages. 8 bytes per entry.
+                                             If set to 0, the index is disabled. */
 } esp_vfs_spiffs_conf_t;
 
+/**
+ * @brief Lookup and cache statistics of a mounted SPIFFS partition
+ */
+typedef struct {
+        uint32_t cache_hits;            /*!< Page cache hits, only counted with CONFIG_SPIFFS_CACHE_STATS */
+        uint32_t cache_misses;          /*!< Page cache misses, only counted with CONFIG_SPIFFS_CACHE_STATS */
+        uint32_t name_index_hits;       /*!< Files opened or stat'ed through the name index */
+        uint32_t name_index_misses;     /*!< Files not found in the name index, or whose entry was outdated */
+        uint32_t lookup_scans;          /*!< Operations which searched a file by name in the object lookup pages */
+        uint32_t gc_runs;               /*!< Garbage collection runs, only counted with CONFIG_SPIFFS_GC_STATS */
+} esp_spiffs_stats_t;
+
 /**
  * Register and mount SPIFFS to VFS with given path prefix.
  *
@@ -31,6 +49,7 @@ typedef struct {
  *
  * @return
  *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_ARG     if cache_pages is larger than 32
  *          - ESP_ERR_NO_MEM          if objects could not be allocated
  *          - ESP_ERR_INVALID_STATE   if already mounted or partition is encrypted
  *          - ESP_ERR_NOT_FOUND       if partition for SPIFFS was not found
@@ -84,6 +103,30 @@ esp_err_t esp_spiffs_format(const char* partition_label);
  */
 esp_err_t esp_spiffs_info(const char* partition_label, size_t *total_bytes, size_t *used_bytes);
 
+/**
+ * Get lookup and cache statistics of SPIFFS
+ *
+ * @param partition_label           Same label as passed to esp_vfs_spiffs_register
+ * @param[out] stats                Statistics since the partition was mounted or the statistics were reset
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_ARG     if stats is NULL
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_spiffs_get_stats(const char* partition_label, esp_spiffs_stats_t *stats);
+
+/**
+ * Reset lookup and cache statistics of SPIFFS
+ *
+ * @param partition_label           Same label as passed to esp_vfs_spiffs_register
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_spiffs_reset_stats(const char* partition_label);
+
 /**
  * Check integrity of SPIFFS
  *
@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -11,7 +11,9 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include <sys/lock.h>
 #include "spiffs.h"
+#include "esp_spiffs.h"
 #include "esp_compiler.h"
 
 #ifdef __cplusplus
@@ -20,6 +22,14 @@ extern "C" {
 
 #define ESP_SPIFFS_PATH_MAX 15
 
+/**
+ * @brief Entry of the name index, maps the hash of a file name to its object index header
+ */
+typedef struct {
+    uint32_t name_hash;                     /*!< Hash of the file name */
+    spiffs_page_ix pix;                     /*!< Page of the object index header, 0 if the entry is unused */
+} esp_spiffs_name_entry_t;
+
 /**
  * @brief SPIFFS definition structure
  */
@@ -35,6 +45,10 @@ typedef struct {
     uint32_t fds_sz;                        /*!< File Descriptor Buffer Length */
     uint8_t *cache;                         /*!< Cache Buffer */
     uint32_t cache_sz;                      /*!< Cache Buffer Length */
+    esp_spiffs_name_entry_t *name_index;    /*!< Name index, NULL if disabled */
+    uint32_t name_index_sz;                 /*!< Number of name index entries */
+    _lock_t stats_lock;                     /*!< Protects name_index and stats */
+    esp_spiffs_stats_t stats;               /*!< Lookup statistics, page cache and GC counters are kept by SPIFFS */
 } esp_spiffs_t;
 
 s32_t spiffs_api_read(spiffs *fs, uint32_t addr, uint32_t size, uint8_t *dst);
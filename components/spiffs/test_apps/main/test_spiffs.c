@@ -1,11 +1,12 @@
 /*
- * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 #include "sdkconfig.h"
 #include <stdio.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -696,6 +697,77 @@ TEST_CASE("rename moves a file", "[spiffs]")
     test_teardown();
 }
 
+TEST_CASE("name index serves open and stat of known files", "[spiffs]")
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = "/spiffs",
+        .partition_label = spiffs_test_partition_label,
+        .max_files = 5,
+        .format_if_mount_failed = true,
+        .cache_pages = 33,
+        .name_index_size = 32,
+    };
+#if CONFIG_SPIFFS_CACHE
+    TEST_ESP_ERR(ESP_ERR_INVALID_ARG, esp_vfs_spiffs_register(&conf));
+#endif
+    conf.cache_pages = 8;
+    TEST_ESP_OK(esp_vfs_spiffs_register(&conf));
+
+    const int files_count = 8;
+    char name[32];
+    char text[32];
+    for (int i = 0; i < files_count; i++) {
+        snprintf(name, sizeof(name), "/spiffs/idx%d.txt", i);
+        snprintf(text, sizeof(text), "file %d\n", i);
+        test_spiffs_create_file_with_text(name, text);
+    }
+
+    // Every file was recorded on close, the lookups only scan on hash collisions
+    TEST_ESP_OK(esp_spiffs_reset_stats(spiffs_test_partition_label));
+    struct stat st;
+    for (int i = 0; i < files_count; i++) {
+        snprintf(name, sizeof(name), "/spiffs/idx%d.txt", i);
+        snprintf(text, sizeof(text), "file %d\n", i);
+        TEST_ASSERT_EQUAL(0, stat(name, &st));
+        TEST_ASSERT_EQUAL(strlen(text), st.st_size);
+        char buf[32] = { 0 };
+        FILE* f = fopen(name, "r");
+        TEST_ASSERT_NOT_NULL(f);
+        TEST_ASSERT_NOT_NULL(fgets(buf, sizeof(buf), f));
+        TEST_ASSERT_EQUAL(0, fclose(f));
+        TEST_ASSERT_EQUAL_STRING(text, buf);
+    }
+    esp_spiffs_stats_t stats;
+    TEST_ESP_ERR(ESP_ERR_INVALID_ARG, esp_spiffs_get_stats(spiffs_test_partition_label, NULL));
+    TEST_ESP_OK(esp_spiffs_get_stats(spiffs_test_partition_label, &stats));
+    printf("name index hits: %" PRIu32 ", misses: %" PRIu32 ", lookup scans: %" PRIu32 "\n",
+           stats.name_index_hits, stats.name_index_misses, stats.lookup_scans);
+    TEST_ASSERT_EQUAL(2 * files_count, stats.name_index_hits + stats.name_index_misses);
+    TEST_ASSERT_GREATER_THAN(0, stats.name_index_hits);
+    TEST_ASSERT_EQUAL(stats.name_index_misses, stats.lookup_scans);
+
+    // Removed and renamed files must not be found through outdated entries
+    TEST_ASSERT_EQUAL(0, unlink("/spiffs/idx0.txt"));
+    TEST_ASSERT_EQUAL(-1, stat("/spiffs/idx0.txt", &st));
+    TEST_ASSERT_NULL(fopen("/spiffs/idx0.txt", "r"));
+    // A new file may reuse the pages of the removed one, it must not be modified through the stale entry
+    test_spiffs_create_file_with_text("/spiffs/reuse.txt", "reused pages\n");
+    TEST_ASSERT_EQUAL(-1, truncate("/spiffs/idx0.txt", 0));
+    TEST_ASSERT_EQUAL(0, stat("/spiffs/reuse.txt", &st));
+    TEST_ASSERT_EQUAL(strlen("reused pages\n"), st.st_size);
+    TEST_ASSERT_EQUAL(0, truncate("/spiffs/idx2.txt", 2));
+    TEST_ASSERT_EQUAL(0, stat("/spiffs/idx2.txt", &st));
+    TEST_ASSERT_EQUAL(2, st.st_size);
+    TEST_ASSERT_EQUAL(0, rename("/spiffs/idx1.txt", "/spiffs/moved.txt"));
+    TEST_ASSERT_EQUAL(-1, stat("/spiffs/idx1.txt", &st));
+    TEST_ASSERT_EQUAL(0, stat("/spiffs/moved.txt", &st));
+    TEST_ASSERT_EQUAL(strlen("file 1\n"), st.st_size);
+
+    TEST_ESP_OK(esp_spiffs_format(spiffs_test_partition_label));
+    TEST_ASSERT_NULL(fopen("/spiffs/idx2.txt", "r"));
+    TEST_ESP_OK(esp_vfs_spiffs_unregister(spiffs_test_partition_label));
+}
+
 TEST_CASE("truncate a file", "[spiffs]")
 {
     test_setup();
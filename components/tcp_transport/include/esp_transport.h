@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2015-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -233,6 +233,20 @@ int esp_transport_write(esp_transport_handle_t t, const char *buffer, int len, i
  */
 int esp_transport_poll_write(esp_transport_handle_t t, int timeout_ms);
 
+/**
+ * @brief      Get the socket of the transport
+ *
+ * The socket can be used to wait for several transports in a single select() call,
+ * it must not be read, written or closed directly.
+ *
+ * @param[in]  t     The transport handle
+ *
+ * @return
+ *     - Socket file descriptor
+ *     - (-1) if the transport is not connected or has no socket
+ */
+int esp_transport_get_socket(esp_transport_handle_t t);
+
 /**
  * @brief      Transport close
  *
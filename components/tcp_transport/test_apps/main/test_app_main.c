@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2023-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
@@ -10,6 +10,7 @@ static void run_all_tests(void)
 {
     RUN_TEST_GROUP(transport_basic);
     RUN_TEST_GROUP(transport_connect);
+    RUN_TEST_GROUP(transport_ws);
 }
 
 void app_main(void)
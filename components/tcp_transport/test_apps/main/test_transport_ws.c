@@ -0,0 +1,238 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity_fixture.h"
+#include "memory_checks.h"
+
+#include "esp_transport.h"
+#include "esp_transport_ws.h"
+#include "esp_tls_crypto.h"
+#include "sdkconfig.h"
+
+#define WS_OPCODE_BINARY_FIN    (WS_TRANSPORT_OPCODES_BINARY | WS_TRANSPORT_OPCODES_FIN)
+
+/* Parent transport which answers the upgrade request and records the frames written after it */
+static struct {
+    char *out;
+    size_t out_len;
+    size_t out_size;
+    int writes;
+    int max_write;
+    char response[192];
+    size_t response_len;
+    size_t response_pos;
+} s_mock;
+
+static int mock_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    return 0;
+}
+
+static int mock_poll(esp_transport_handle_t t, int timeout_ms)
+{
+    return 1;
+}
+
+static int mock_close(esp_transport_handle_t t)
+{
+    return 0;
+}
+
+static int mock_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    int n = s_mock.response_len - s_mock.response_pos;
+    if (n > len) {
+        n = len;
+    }
+    memcpy(buffer, s_mock.response + s_mock.response_pos, n);
+    s_mock.response_pos += n;
+    return n > 0 ? n : -1;
+}
+
+static void mock_prepare_upgrade_response(void)
+{
+    const char *key = strstr(s_mock.out, "Sec-WebSocket-Key: ");
+    TEST_ASSERT_NOT_NULL(key);
+    key += strlen("Sec-WebSocket-Key: ");
+    const char *key_end = strstr(key, "\r\n");
+    TEST_ASSERT_NOT_NULL(key_end);
+
+    char accept_text[80];
+    snprintf(accept_text, sizeof(accept_text), "%.*s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", (int)(key_end - key), key);
+    unsigned char sha1[20];
+    unsigned char accept_key[33] = { 0 };
+    size_t accept_len = 0;
+    esp_crypto_sha1((const unsigned char *)accept_text, strlen(accept_text), sha1);
+    esp_crypto_base64_encode(accept_key, sizeof(accept_key) - 1, &accept_len, sha1, sizeof(sha1));
+    s_mock.response_len = snprintf(s_mock.response, sizeof(s_mock.response),
+                                   "HTTP/1.1 101 Switching Protocols\r\n"
+                                   "Upgrade: websocket\r\n"
+                                   "Connection: Upgrade\r\n"
+                                   "Sec-WebSocket-Accept: %s\r\n\r\n", accept_key);
+    s_mock.response_pos = 0;
+    // Only the frames written after the upgrade are checked
+    s_mock.out_len = 0;
+    s_mock.writes = 0;
+    s_mock.max_write = 0;
+}
+
+static int mock_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    if (s_mock.out_len + len + 1 > s_mock.out_size) {
+        size_t size = s_mock.out_len + len + 1;
+        char *out = realloc(s_mock.out, size);
+        TEST_ASSERT_NOT_NULL(out);
+        s_mock.out = out;
+        s_mock.out_size = size;
+    }
+    memcpy(s_mock.out + s_mock.out_len, buffer, len);
+    s_mock.out_len += len;
+    s_mock.out[s_mock.out_len] = '\0';
+    s_mock.writes++;
+    if (len > s_mock.max_write) {
+        s_mock.max_write = len;
+    }
+    if (s_mock.response_len == 0 && strstr(s_mock.out, "\r\n\r\n") != NULL) {
+        mock_prepare_upgrade_response();
+    }
+    return len;
+}
+
+static esp_transport_handle_t test_ws_connect(esp_transport_handle_t *out_parent)
+{
+    memset(&s_mock, 0, sizeof(s_mock));
+    esp_transport_handle_t parent = esp_transport_init();
+    TEST_ASSERT_NOT_NULL(parent);
+    esp_transport_set_func(parent, mock_connect, mock_read, mock_write, mock_close, mock_poll, mock_poll, NULL);
+    esp_transport_handle_t ws = esp_transport_ws_init(parent);
+    TEST_ASSERT_NOT_NULL(ws);
+    TEST_ASSERT_EQUAL(0, esp_transport_connect(ws, "localhost", 80, 1000));
+    TEST_ASSERT_EQUAL(101, esp_transport_ws_get_upgrade_request_status(ws));
+    *out_parent = parent;
+    return ws;
+}
+
+static void test_ws_cleanup(esp_transport_handle_t ws, esp_transport_handle_t parent)
+{
+    esp_transport_close(ws);
+    esp_transport_destroy(ws);
+    esp_transport_destroy(parent);
+    free(s_mock.out);
+    memset(&s_mock, 0, sizeof(s_mock));
+}
+
+/* Checks the recorded frame: header, length encoding, mask key and the unmasked payload */
+static void test_ws_check_frame(const char *payload, size_t len, size_t expected_header_len)
+{
+    const uint8_t *frame = (const uint8_t *)s_mock.out;
+    TEST_ASSERT_EQUAL(expected_header_len + len, s_mock.out_len);
+    TEST_ASSERT_EQUAL_HEX8(WS_OPCODE_BINARY_FIN, frame[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x80, frame[1] & 0x80);
+
+    size_t header_len = 2;
+    uint64_t frame_len = frame[1] & 0x7f;
+    if (frame_len == 126) {
+        frame_len = (frame[2] << 8) | frame[3];
+        header_len += 2;
+    } else if (frame_len == 127) {
+        frame_len = 0;
+        for (int i = 0; i < 8; i++) {
+            frame_len = (frame_len << 8) | frame[2 + i];
+        }
+        header_len += 8;
+    }
+    const uint8_t *mask = frame + header_len;
+    header_len += 4;
+    TEST_ASSERT_EQUAL(expected_header_len, header_len);
+    TEST_ASSERT_EQUAL(len, frame_len);
+
+    for (size_t i = 0; i < len; i++) {
+        if ((uint8_t)(frame[header_len + i] ^ mask[i % 4]) != (uint8_t)payload[i]) {
+            TEST_FAIL_MESSAGE("Payload doesn't match after unmasking");
+        }
+    }
+}
+
+static void test_ws_send_and_check(esp_transport_handle_t ws, const char *payload, size_t len, size_t expected_header_len)
+{
+    s_mock.out_len = 0;
+    s_mock.writes = 0;
+    s_mock.max_write = 0;
+    TEST_ASSERT_EQUAL(len, esp_transport_ws_send_raw(ws, WS_OPCODE_BINARY_FIN, payload, len, 1000));
+    test_ws_check_frame(payload, len, expected_header_len);
+}
+
+TEST_GROUP(transport_ws);
+
+TEST_SETUP(transport_ws)
+{
+    test_utils_record_free_mem();
+    TEST_ESP_OK(test_utils_set_leak_level(0, ESP_LEAK_TYPE_CRITICAL, ESP_COMP_LEAK_GENERAL));
+}
+
+TEST_TEAR_DOWN(transport_ws)
+{
+    test_utils_finish_and_evaluate_leaks(test_utils_get_leak_level(ESP_LEAK_TYPE_WARNING, ESP_COMP_LEAK_ALL),
+                                         test_utils_get_leak_level(ESP_LEAK_TYPE_CRITICAL, ESP_COMP_LEAK_ALL));
+}
+
+TEST(transport_ws, ws_write_length_encodings_and_mask)
+{
+    const size_t max_len = 65536 + 3;
+    // One extra byte to pass unaligned payloads
+    char *data = malloc(max_len + 1);
+    TEST_ASSERT_NOT_NULL(data);
+    for (size_t i = 0; i < max_len + 1; i++) {
+        data[i] = (char)(i * 7 + (i >> 8));
+    }
+    esp_transport_handle_t parent;
+    esp_transport_handle_t ws = test_ws_connect(&parent);
+
+    // 7-bit length
+    test_ws_send_and_check(ws, data, 0, 6);
+    test_ws_send_and_check(ws, data, 5, 6);
+    test_ws_send_and_check(ws, data + 1, 125, 6);
+    // 16-bit length
+    test_ws_send_and_check(ws, data, 126, 8);
+    test_ws_send_and_check(ws, data + 1, 1023, 8);
+    test_ws_send_and_check(ws, data, 65535, 8);
+    // 64-bit length, with an unaligned source and a tail shorter than a mask word
+    test_ws_send_and_check(ws, data + 1, 65536 + 3, 14);
+
+    test_ws_cleanup(ws, parent);
+    free(data);
+}
+
+TEST(transport_ws, ws_write_long_frames_in_large_chunks)
+{
+    const size_t len = 3 * CONFIG_WS_BUFFER_SIZE + 1;
+    char *data = malloc(len);
+    TEST_ASSERT_NOT_NULL(data);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (char)(i ^ (i >> 8));
+    }
+    esp_transport_handle_t parent;
+    esp_transport_handle_t ws = test_ws_connect(&parent);
+
+    test_ws_send_and_check(ws, data, len, 8);
+    printf("%u bytes written in %d writes of up to %d bytes\n", (unsigned)len, s_mock.writes, s_mock.max_write);
+    if (CONFIG_WS_TX_SCRATCH_SIZE > CONFIG_WS_BUFFER_SIZE) {
+        // Chunks are not limited by the transport buffer
+        TEST_ASSERT_GREATER_THAN(CONFIG_WS_BUFFER_SIZE, s_mock.max_write);
+        TEST_ASSERT_LESS_OR_EQUAL(CONFIG_WS_TX_SCRATCH_SIZE, s_mock.max_write);
+    }
+
+    test_ws_cleanup(ws, parent);
+    free(data);
+}
+
+TEST_GROUP_RUNNER(transport_ws)
+{
+    RUN_TEST_CASE(transport_ws, ws_write_length_encodings_and_mask);
+    RUN_TEST_CASE(transport_ws, ws_write_long_frames_in_large_chunks);
+}
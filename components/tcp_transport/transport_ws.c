@@ -1,13 +1,15 @@
 /*
- * SPDX-FileCopyrightText: 2015-2021 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <sys/param.h>
 #include <sys/random.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -40,6 +42,16 @@ static const char *TAG = "transport_ws";
 #define WS_RESPONSE_OK              101
 #define WS_TRANSPORT_MAX_CONTROL_FRAME_BUFFER_LEN 125
 
+// Frames are written from the transport buffer, the payload is placed after the space reserved for the header
+#define WS_TX_PAYLOAD_OFFSET        MAX_WEBSOCKET_HEADER_SIZE
+#define WS_TX_CHUNK_SIZE            ((WS_BUFFER_SIZE - WS_TX_PAYLOAD_OFFSET) & ~3)
+// Long payloads are written in chunks of the scratch buffer instead, to produce fewer and fuller TLS records
+#define WS_TX_SCRATCH_CHUNK_SIZE    ((CONFIG_WS_TX_SCRATCH_SIZE - WS_TX_PAYLOAD_OFFSET) & ~3)
+
+_Static_assert(WS_TX_CHUNK_SIZE > 0, "Websocket transport buffer is too small");
+
+typedef uint32_t __attribute__((__may_alias__)) ws_mask_word_t;
+
 
 typedef struct {
     uint8_t opcode;
@@ -101,6 +113,40 @@ static esp_transport_handle_t ws_get_payload_transport_handle(esp_transport_hand
     return ws->parent;
 }
 
+/**
+ * @brief Applies the mask key to a part of the payload
+ *
+ * Masks 32 bits at a time once the buffer is word aligned.
+ *
+ * @param buffer    Part of the payload to be masked in place
+ * @param len       Length of the buffer
+ * @param mask_key  Mask key of the frame
+ * @param offset    Position of the buffer within the payload
+ */
+static void ws_mask_payload(char *buffer, size_t len, const char *mask_key, size_t offset)
+{
+    size_t i = 0;
+    for (; i < len && ((uintptr_t)(buffer + i) & 3) != 0; i++) {
+        buffer[i] ^= mask_key[(offset + i) % 4];
+    }
+    if (len - i >= 4) {
+        // mask key rotated to start at the first aligned byte
+        char rotated_key[4];
+        for (int k = 0; k < 4; k++) {
+            rotated_key[k] = mask_key[(offset + i + k) % 4];
+        }
+        uint32_t mask_word;
+        memcpy(&mask_word, rotated_key, sizeof(mask_word));
+        ws_mask_word_t *words = (ws_mask_word_t *)(buffer + i);
+        for (; len - i >= 4; i += 4) {
+            *words++ ^= mask_word;
+        }
+    }
+    for (; i < len; i++) {
+        buffer[i] ^= mask_key[(offset + i) % 4];
+    }
+}
+
 static char *trimwhitespace(const char *str)
 {
     char *end;
@@ -298,13 +344,26 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
     return 0;
 }
 
+static int ws_write_all(esp_transport_handle_t parent, const char *buffer, int len, int timeout_ms)
+{
+    int written = 0;
+    while (written < len) {
+        int ret = esp_transport_write(parent, buffer + written, len - written, timeout_ms);
+        if (ret <= 0) {
+            return -1;
+        }
+        written += ret;
+    }
+    return written;
+}
+
 static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const char *b, int len, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
-    char *buffer = (char *)b;
     char ws_header[MAX_WEBSOCKET_HEADER_SIZE];
-    char *mask;
-    int header_len = 0, i;
+    char *mask = NULL;
+    int header_len = 0;
+    uint64_t payload_len = len;
 
     int poll_write;
     if ((poll_write = esp_transport_poll_write(ws->parent, timeout_ms)) <= 0) {
@@ -313,23 +372,17 @@ static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const
     }
     ws_header[header_len++] = opcode;
 
-    if (len <= 125) {
-        ws_header[header_len++] = (uint8_t)(len | mask_flag);
-    } else if (len < 65536) {
+    if (payload_len <= 125) {
+        ws_header[header_len++] = (uint8_t)(payload_len | mask_flag);
+    } else if (payload_len < 65536) {
         ws_header[header_len++] = WS_SIZE16 | mask_flag;
-        ws_header[header_len++] = (uint8_t)(len >> 8);
-        ws_header[header_len++] = (uint8_t)(len & 0xFF);
+        ws_header[header_len++] = (uint8_t)(payload_len >> 8);
+        ws_header[header_len++] = (uint8_t)(payload_len & 0xFF);
     } else {
         ws_header[header_len++] = WS_SIZE64 | mask_flag;
-        /* Support maximum 4 bytes length */
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 56) & 0xFF);
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 48) & 0xFF);
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 40) & 0xFF);
-        ws_header[header_len++] = 0; //(uint8_t)((len >> 32) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 24) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 16) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 8) & 0xFF);
-        ws_header[header_len++] = (uint8_t)((len >> 0) & 0xFF);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            ws_header[header_len++] = (uint8_t)((payload_len >> shift) & 0xFF);
+        }
     }
 
     if (mask_flag) {
@@ -340,28 +393,57 @@ static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const
             return -1;
         }
         header_len += 4;
-
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
-        }
     }
 
-    if (esp_transport_write(ws->parent, ws_header, header_len, timeout_ms) != header_len) {
-        ESP_LOGE(TAG, "Error write header");
-        return -1;
+    char *tx_buffer = ws->buffer;
+    int chunk_size = WS_TX_CHUNK_SIZE;
+    if (len > WS_TX_CHUNK_SIZE && WS_TX_SCRATCH_CHUNK_SIZE > WS_TX_CHUNK_SIZE) {
+        int scratch_chunk_size = MIN((len + 3) & ~3, WS_TX_SCRATCH_CHUNK_SIZE);
+        char *scratch = malloc(WS_TX_PAYLOAD_OFFSET + scratch_chunk_size);
+        if (scratch) {
+            tx_buffer = scratch;
+            chunk_size = scratch_chunk_size;
+        } else {
+            ESP_LOGD(TAG, "Cannot allocate scratch buffer, writing in chunks of %d", WS_TX_CHUNK_SIZE);
+        }
     }
-    if (len == 0) {
-        return 0;
+    if (tx_buffer == NULL) {
+        // the transport buffer was freed after connect (CONFIG_WS_DYNAMIC_BUFFER)
+        tx_buffer = malloc(WS_BUFFER_SIZE);
+        if (tx_buffer == NULL) {
+            ESP_LOGE(TAG, "Cannot allocate buffer for write, need-%d", WS_BUFFER_SIZE);
+            return -1;
+        }
     }
 
-    int ret = esp_transport_write(ws->parent, buffer, len, timeout_ms);
-    // in case of masked transport we have to revert back to the original data, as ws layer
-    // does not create its own copy of data to be sent
-    if (mask_flag) {
-        mask = &ws_header[header_len - 4];
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
+    // The payload is masked in a copy, so that the user data are not modified and could be in read-only memory.
+    // The header is placed right before the payload to write both at once, the payload is split into chunks
+    // whose size is a multiple of 4, so each chunk starts at the first byte of the mask key.
+    int ret = -1;
+    char *payload = tx_buffer + WS_TX_PAYLOAD_OFFSET;
+    char *frame = payload - header_len;
+    memcpy(frame, ws_header, header_len);
+    int sent = 0;
+    do {
+        int chunk_len = MIN(len - sent, chunk_size);
+        if (chunk_len > 0) {
+            memcpy(payload, b + sent, chunk_len);
+            if (mask_flag) {
+                ws_mask_payload(payload, chunk_len, mask, 0);
+            }
+        }
+        if (ws_write_all(ws->parent, frame, payload + chunk_len - frame, timeout_ms) < 0) {
+            ESP_LOGE(TAG, "Error write frame");
+            goto exit;
         }
+        sent += chunk_len;
+        frame = payload;
+    } while (sent < len);
+    ret = len;
+
+exit:
+    if (tx_buffer != ws->buffer) {
+        free(tx_buffer);
     }
     return ret;
 }
@@ -410,11 +492,11 @@ static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int
         ESP_LOGE(TAG, "Error read data");
         return rlen;
     }
-    ws->frame_state.bytes_remaining -= rlen;
-
-    for (int i = 0; i < bytes_to_read; i++) {
-        buffer[i] = (buffer[i] ^ ws->frame_state.mask_key[i % 4]);
+    if (rlen > 0) {
+        ws_mask_payload(buffer, rlen, ws->frame_state.mask_key,
+                        ws->frame_state.payload_len - ws->frame_state.bytes_remaining);
     }
+    ws->frame_state.bytes_remaining -= rlen;
     return rlen;
 }
 
@@ -455,7 +537,7 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
             ESP_LOGE(TAG, "Error read data");
             return rlen;
         }
-        payload_len = data_ptr[0] << 8 | data_ptr[1];
+        payload_len = (uint8_t)data_ptr[0] << 8 | (uint8_t)data_ptr[1];
     } else if (payload_len == 127) {
         // headerLen += 8;
         header = 8;
@@ -464,12 +546,15 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
             return rlen;
         }
 
-        if (data_ptr[0] != 0 || data_ptr[1] != 0 || data_ptr[2] != 0 || data_ptr[3] != 0) {
-            // really too big!
-            payload_len = 0xFFFFFFFF;
-        } else {
-            payload_len = data_ptr[4] << 24 | data_ptr[5] << 16 | data_ptr[6] << 8 | data_ptr[7];
+        uint64_t payload_len64 = 0;
+        for (int i = 0; i < header; i++) {
+            payload_len64 = (payload_len64 << 8) | (uint8_t)data_ptr[i];
+        }
+        if (payload_len64 > INT_MAX) {
+            ESP_LOGE(TAG, "Frame payload too long: %llu", (unsigned long long)payload_len64);
+            return -1;
         }
+        payload_len = (int)payload_len64;
     }
 
     if (mask) {
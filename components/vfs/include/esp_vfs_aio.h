@@ -0,0 +1,188 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Asynchronous I/O context (submission and completion queue with its worker tasks)
+ */
+typedef struct esp_vfs_aio_ctx *esp_vfs_aio_handle_t;
+
+/**
+ * @brief Operations which can be submitted to an asynchronous I/O context
+ */
+typedef enum {
+    ESP_VFS_AIO_OP_OPEN,    /*!< open(path, flags, mode), result is the new file descriptor */
+    ESP_VFS_AIO_OP_CLOSE,   /*!< close(fd) */
+    ESP_VFS_AIO_OP_READ,    /*!< read(fd, buf, len) */
+    ESP_VFS_AIO_OP_WRITE,   /*!< write(fd, buf, len) */
+    ESP_VFS_AIO_OP_PREAD,   /*!< pread(fd, buf, len, offset) */
+    ESP_VFS_AIO_OP_PWRITE,  /*!< pwrite(fd, buf, len, offset) */
+    ESP_VFS_AIO_OP_FSYNC,   /*!< fsync(fd) */
+} esp_vfs_aio_op_t;
+
+/**
+ * @brief Submission queue entry
+ *
+ * Buffers and the path are not copied, they must stay valid until the completion is received.
+ */
+typedef struct {
+    esp_vfs_aio_op_t op;    /*!< Operation to perform */
+    int fd;                 /*!< File descriptor (all operations except ESP_VFS_AIO_OP_OPEN) */
+    void *buf;              /*!< Data buffer (read and write operations) */
+    size_t len;             /*!< Length of data (read and write operations) */
+    off_t offset;           /*!< File offset (ESP_VFS_AIO_OP_PREAD and ESP_VFS_AIO_OP_PWRITE) */
+    const char *path;       /*!< File path (ESP_VFS_AIO_OP_OPEN) */
+    int flags;              /*!< Open flags (ESP_VFS_AIO_OP_OPEN) */
+    int mode;               /*!< Open mode (ESP_VFS_AIO_OP_OPEN) */
+    void *user_data;        /*!< Opaque pointer returned in the completion */
+} esp_vfs_aio_request_t;
+
+/**
+ * @brief Completion queue entry
+ */
+typedef struct {
+    esp_vfs_aio_op_t op;    /*!< Operation which has completed */
+    void *user_data;        /*!< user_data of the request */
+    ssize_t result;         /*!< Return value of the operation, -1 on error */
+    int error;              /*!< errno value if result is -1, 0 otherwise */
+} esp_vfs_aio_completion_t;
+
+/**
+ * @brief Callback receiving the completions which were not retrieved when the context is deleted
+ *
+ * @param completion Completion, the requests cancelled by esp_vfs_aio_delete() have error set to ECANCELED
+ * @param arg        discard_cb_arg of the configuration
+ */
+typedef void (*esp_vfs_aio_discard_cb_t)(const esp_vfs_aio_completion_t *completion, void *arg);
+
+/**
+ * @brief Asynchronous I/O context configuration
+ */
+typedef struct {
+    size_t queue_size;          /*!< Max number of requests waiting for a worker */
+    size_t worker_count;        /*!< Number of worker tasks executing the requests */
+    size_t worker_stack_size;   /*!< Stack size of each worker task */
+    UBaseType_t worker_priority;    /*!< Priority of the worker tasks */
+    BaseType_t worker_core_id;  /*!< Core to pin the workers to, tskNO_AFFINITY for any core */
+    bool use_eventfd;           /*!< Create an eventfd signalled on each completion, see esp_vfs_aio_get_eventfd() */
+    esp_vfs_aio_discard_cb_t discard_cb;    /*!< Called by esp_vfs_aio_delete() for each completion not retrieved, may be NULL */
+    void *discard_cb_arg;       /*!< Argument of discard_cb */
+} esp_vfs_aio_config_t;
+
+#define ESP_VFS_AIO_CONFIG_DEFAULT() (esp_vfs_aio_config_t) { \
+    .queue_size = 8, \
+    .worker_count = 1, \
+    .worker_stack_size = 4096, \
+    .worker_priority = 5, \
+    .worker_core_id = tskNO_AFFINITY, \
+    .use_eventfd = false, \
+    .discard_cb = NULL, \
+    .discard_cb_arg = NULL, \
+}
+
+/**
+ * @brief Create an asynchronous I/O context
+ *
+ * Requests submitted to the context are executed by its worker tasks through
+ * the regular VFS functions, so any registered filesystem or device driver
+ * (FAT, SPIFFS, UART, ...) can be used. Creating one context per storage
+ * device lets operations on different devices overlap.
+ *
+ * @note With a single worker, requests are executed in the order of submission.
+ *       With several workers, requests may complete in any order, including
+ *       requests on the same file descriptor.
+ *
+ * @note The eventfd VFS has to be registered (see esp_vfs_eventfd_register())
+ *       if config->use_eventfd is set.
+ *
+ * @param config      Configuration
+ * @param[out] handle Created context
+ *
+ * @return  ESP_OK if successful,
+ *          ESP_ERR_INVALID_ARG if the configuration is invalid,
+ *          ESP_ERR_NO_MEM if out of memory,
+ *          ESP_FAIL if the eventfd could not be created
+ */
+esp_err_t esp_vfs_aio_create(const esp_vfs_aio_config_t *config, esp_vfs_aio_handle_t *handle);
+
+/**
+ * @brief Delete an asynchronous I/O context
+ *
+ * Requests still waiting in the submission queue are cancelled, requests being
+ * executed by the workers complete. The completions which were not retrieved,
+ * including the cancelled requests (with error set to ECANCELED), are passed to
+ * config->discard_cb before the context is freed, so that the buffers of the
+ * requests can be released.
+ *
+ * @note The context must not be used by other tasks during and after this call.
+ *
+ * @param handle Context
+ *
+ * @return ESP_OK if successful, ESP_ERR_INVALID_ARG if handle is NULL
+ */
+esp_err_t esp_vfs_aio_delete(esp_vfs_aio_handle_t handle);
+
+/**
+ * @brief Submit a request
+ *
+ * @param handle        Context
+ * @param request       Request, copied into the submission queue
+ * @param ticks_to_wait Time to wait for space in the submission queue
+ *
+ * @return  ESP_OK if submitted,
+ *          ESP_ERR_INVALID_ARG if an argument is invalid,
+ *          ESP_ERR_TIMEOUT if the submission queue stayed full
+ */
+esp_err_t esp_vfs_aio_submit(esp_vfs_aio_handle_t handle, const esp_vfs_aio_request_t *request, TickType_t ticks_to_wait);
+
+/**
+ * @brief Retrieve completions
+ *
+ * Waits up to ticks_to_wait for the first completion, then returns
+ * all further completions which are already available (up to max_count).
+ *
+ * @note Workers block when the completion queue is full, so completions
+ *       have to be retrieved regularly.
+ *
+ * @param handle        Context
+ * @param[out] completions  Array receiving the completions
+ * @param max_count     Size of the completions array
+ * @param[out] count    Number of completions stored
+ * @param ticks_to_wait Time to wait for the first completion
+ *
+ * @return  ESP_OK if at least one completion was retrieved,
+ *          ESP_ERR_INVALID_ARG if an argument is invalid,
+ *          ESP_ERR_TIMEOUT if no completion is available
+ */
+esp_err_t esp_vfs_aio_get_completions(esp_vfs_aio_handle_t handle, esp_vfs_aio_completion_t *completions,
+                                      size_t max_count, size_t *count, TickType_t ticks_to_wait);
+
+/**
+ * @brief Get the eventfd signalled on completions
+ *
+ * The eventfd becomes readable in select() when completions are available. Its
+ * counter is incremented for each completion; reading it resets the counter.
+ *
+ * @param handle Context
+ *
+ * @return The file descriptor, or -1 if the context was created without use_eventfd
+ */
+int esp_vfs_aio_get_eventfd(esp_vfs_aio_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
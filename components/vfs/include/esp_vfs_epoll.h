@@ -0,0 +1,123 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EPOLLIN         0x001       /*!< The file descriptor is readable */
+#define EPOLLPRI        0x002       /*!< Accepted for compatibility, reported as EPOLLIN */
+#define EPOLLOUT        0x004       /*!< The file descriptor is writable */
+#define EPOLLERR        0x008       /*!< Error condition, always reported */
+#define EPOLLHUP        0x010       /*!< Accepted for compatibility, hang-ups are reported as EPOLLERR */
+#define EPOLLONESHOT    (1U << 30)  /*!< Disable the file descriptor after one event, re-arm with EPOLL_CTL_MOD */
+
+#define EPOLL_CTL_ADD   1           /*!< Add a file descriptor to the interest set */
+#define EPOLL_CTL_DEL   2           /*!< Remove a file descriptor from the interest set */
+#define EPOLL_CTL_MOD   3           /*!< Change the events of a file descriptor */
+
+/**
+ * @brief User data returned with an event
+ */
+typedef union epoll_data {
+    void *ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+/**
+ * @brief Event registered with epoll_ctl() and returned by epoll_wait()
+ */
+struct epoll_event {
+    uint32_t events;        /*!< Bit mask of EPOLL* flags */
+    epoll_data_t data;      /*!< User data */
+};
+
+/**
+ * @brief Epoll vfs initialization settings
+ */
+typedef struct {
+    size_t max_fds;     /*!< The maximum number of epoll instances */
+} esp_vfs_epoll_config_t;
+
+#define ESP_VFS_EPOLL_CONFIG_DEFAULT() (esp_vfs_epoll_config_t) { \
+      .max_fds = 2, \
+}
+
+/**
+ * @brief  Registers the epoll vfs.
+ *
+ * @return  ESP_OK if successful, ESP_ERR_NO_MEM if too many VFSes are
+ *          registered, ESP_ERR_INVALID_STATE if already registered.
+ */
+esp_err_t esp_vfs_epoll_register(const esp_vfs_epoll_config_t *config);
+
+/**
+ * @brief  Unregisters the epoll vfs.
+ *
+ * @return ESP_OK if successful, ESP_ERR_INVALID_STATE if the epoll vfs
+ *         hasn't been registered
+ */
+esp_err_t esp_vfs_epoll_unregister(void);
+
+/**
+ * @brief Creates an epoll instance.
+ *
+ * The behavior is the same as man(2) epoll_create except for:
+ *  - esp_vfs_epoll_register() has to be called before calling epoll_create().
+ *  - Only level-triggered notification is supported, EPOLLET is rejected.
+ *  - Readiness is evaluated with the select() support of the VFS drivers, so any
+ *    file descriptor usable in select() (sockets, UART, eventfd, USB Serial/JTAG, ...)
+ *    can be added. Each epoll_wait() call is a select() call on the interest set, the
+ *    drivers don't keep the readiness of the file descriptors between calls.
+ *  - Changes done by epoll_ctl() while another task waits in epoll_wait() on the same
+ *    instance take effect with the next epoll_wait() call.
+ *
+ * @param size Ignored, must be greater than zero
+ * @return The file descriptor if successful, -1 if error happens.
+ */
+int epoll_create(int size);
+
+/**
+ * @brief Same as epoll_create(), flags must be 0.
+ */
+int epoll_create1(int flags);
+
+/**
+ * @brief Adds, modifies or removes a file descriptor in the interest set of an epoll instance.
+ *
+ * The interest set persists across epoll_wait() calls.
+ *
+ * @return 0 if successful, -1 and errno set otherwise
+ */
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+
+/**
+ * @brief Waits for events on an epoll instance.
+ *
+ * Only ready file descriptors are reported. When more file descriptors are ready
+ * than maxevents, the following call starts reporting with the next ones, so that
+ * all ready file descriptors are served in turn.
+ *
+ * @param epfd      Epoll instance
+ * @param events    Array receiving the events
+ * @param maxevents Size of the events array
+ * @param timeout   Timeout in milliseconds, -1 to wait forever
+ * @return Number of events, 0 on timeout, -1 and errno set on error
+ */
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,162 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include "freertos/FreeRTOS.h"
+#include "unity.h"
+#include "esp_vfs.h"
+#include "esp_vfs_aio.h"
+#include "esp_vfs_eventfd.h"
+
+TEST_CASE("vfs aio write and read complete in order", "[vfs][aio]")
+{
+    esp_vfs_eventfd_config_t efd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&efd_config));
+
+    /* An eventfd serves as the target "device" of the requests */
+    int fd = eventfd(0, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+
+    esp_vfs_aio_config_t config = ESP_VFS_AIO_CONFIG_DEFAULT();
+    config.use_eventfd = true;
+    esp_vfs_aio_handle_t aio = NULL;
+    TEST_ESP_OK(esp_vfs_aio_create(&config, &aio));
+    int notify_fd = esp_vfs_aio_get_eventfd(aio);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, notify_fd);
+
+    uint64_t wval = 42;
+    uint64_t rval = 0;
+    esp_vfs_aio_request_t write_req = {
+        .op = ESP_VFS_AIO_OP_WRITE,
+        .fd = fd,
+        .buf = &wval,
+        .len = sizeof(wval),
+        .user_data = &wval,
+    };
+    esp_vfs_aio_request_t read_req = {
+        .op = ESP_VFS_AIO_OP_READ,
+        .fd = fd,
+        .buf = &rval,
+        .len = sizeof(rval),
+        .user_data = &rval,
+    };
+    TEST_ESP_OK(esp_vfs_aio_submit(aio, &write_req, portMAX_DELAY));
+    TEST_ESP_OK(esp_vfs_aio_submit(aio, &read_req, portMAX_DELAY));
+
+    esp_vfs_aio_completion_t completions[2];
+    size_t received = 0;
+    while (received < 2) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(notify_fd, &rfds);
+        struct timeval timeout = { .tv_sec = 1 };
+        TEST_ASSERT_EQUAL(1, select(notify_fd + 1, &rfds, NULL, NULL, &timeout));
+        uint64_t ready = 0;
+        TEST_ASSERT_EQUAL(sizeof(ready), read(notify_fd, &ready, sizeof(ready)));
+        TEST_ASSERT_GREATER_THAN(0, ready);
+
+        size_t count = 0;
+        TEST_ESP_OK(esp_vfs_aio_get_completions(aio, &completions[received], 2 - received, &count, 0));
+        received += count;
+    }
+
+    TEST_ASSERT_EQUAL(ESP_VFS_AIO_OP_WRITE, completions[0].op);
+    TEST_ASSERT_EQUAL_PTR(&wval, completions[0].user_data);
+    TEST_ASSERT_EQUAL(sizeof(wval), completions[0].result);
+    TEST_ASSERT_EQUAL(ESP_VFS_AIO_OP_READ, completions[1].op);
+    TEST_ASSERT_EQUAL_PTR(&rval, completions[1].user_data);
+    TEST_ASSERT_EQUAL(sizeof(rval), completions[1].result);
+    TEST_ASSERT_EQUAL(wval, rval);
+
+    size_t count = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, esp_vfs_aio_get_completions(aio, completions, 2, &count, 0));
+    TEST_ASSERT_EQUAL(0, count);
+
+    TEST_ESP_OK(esp_vfs_aio_delete(aio));
+    TEST_ASSERT_EQUAL(0, close(fd));
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+}
+
+TEST_CASE("vfs aio reports errors", "[vfs][aio]")
+{
+    esp_vfs_aio_config_t config = ESP_VFS_AIO_CONFIG_DEFAULT();
+    esp_vfs_aio_handle_t aio = NULL;
+    TEST_ESP_OK(esp_vfs_aio_create(&config, &aio));
+    TEST_ASSERT_EQUAL(-1, esp_vfs_aio_get_eventfd(aio));
+
+    esp_vfs_aio_request_t req = {
+        .op = ESP_VFS_AIO_OP_OPEN,
+        .path = "/nonexistent/file",
+        .flags = O_RDONLY,
+    };
+    TEST_ESP_OK(esp_vfs_aio_submit(aio, &req, portMAX_DELAY));
+
+    esp_vfs_aio_completion_t completion;
+    size_t count = 0;
+    TEST_ESP_OK(esp_vfs_aio_get_completions(aio, &completion, 1, &count, pdMS_TO_TICKS(1000)));
+    TEST_ASSERT_EQUAL(1, count);
+    TEST_ASSERT_EQUAL(-1, completion.result);
+    TEST_ASSERT_NOT_EQUAL(0, completion.error);
+
+    TEST_ESP_OK(esp_vfs_aio_delete(aio));
+}
+
+typedef struct {
+    size_t completed;
+    size_t cancelled;
+} aio_discard_stats_t;
+
+static void aio_count_discarded(const esp_vfs_aio_completion_t *completion, void *arg)
+{
+    aio_discard_stats_t *stats = arg;
+    if (completion->result == -1 && completion->error == ECANCELED) {
+        stats->cancelled++;
+    } else {
+        stats->completed++;
+    }
+}
+
+TEST_CASE("vfs aio delete with full submission and completion queues", "[vfs][aio]")
+{
+    esp_vfs_eventfd_config_t efd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&efd_config));
+    int fd = eventfd(0, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+
+    aio_discard_stats_t stats = { 0 };
+    esp_vfs_aio_config_t config = ESP_VFS_AIO_CONFIG_DEFAULT();
+    config.queue_size = 2;
+    config.discard_cb = aio_count_discarded;
+    config.discard_cb_arg = &stats;
+    esp_vfs_aio_handle_t aio = NULL;
+    TEST_ESP_OK(esp_vfs_aio_create(&config, &aio));
+
+    /* Nothing retrieves the completions: the completion queue fills up, then the worker
+     * blocks with a finished request and the submission queue fills up as well */
+    uint64_t one = 1;
+    esp_vfs_aio_request_t req = {
+        .op = ESP_VFS_AIO_OP_WRITE,
+        .fd = fd,
+        .buf = &one,
+        .len = sizeof(one),
+    };
+    size_t submitted = 0;
+    while (esp_vfs_aio_submit(aio, &req, pdMS_TO_TICKS(100)) == ESP_OK) {
+        submitted++;
+        TEST_ASSERT_LESS_THAN(100, submitted);
+    }
+    TEST_ASSERT_EQUAL(2 * (config.queue_size + config.worker_count), submitted);
+
+    TEST_ESP_OK(esp_vfs_aio_delete(aio));
+    TEST_ASSERT_EQUAL(config.queue_size, stats.cancelled);
+    TEST_ASSERT_EQUAL(submitted - config.queue_size, stats.completed);
+
+    TEST_ASSERT_EQUAL(0, close(fd));
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+}
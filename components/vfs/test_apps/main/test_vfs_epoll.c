@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include "unity.h"
+#include "esp_vfs.h"
+#include "esp_vfs_epoll.h"
+#include "esp_vfs_eventfd.h"
+
+TEST_CASE("epoll reports only ready file descriptors", "[vfs][epoll]")
+{
+    esp_vfs_eventfd_config_t efd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&efd_config));
+    esp_vfs_epoll_config_t config = ESP_VFS_EPOLL_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_epoll_register(&config));
+
+    int epfd = epoll_create1(0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, epfd);
+    int fd1 = eventfd(0, 0);
+    int fd2 = eventfd(0, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd1);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd2);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = 1 };
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fd1, &ev));
+    TEST_ASSERT_EQUAL(-1, epoll_ctl(epfd, EPOLL_CTL_ADD, fd1, &ev));
+    TEST_ASSERT_EQUAL(EEXIST, errno);
+    ev.data.u32 = 2;
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fd2, &ev));
+
+    struct epoll_event events[4];
+    TEST_ASSERT_EQUAL(0, epoll_wait(epfd, events, 4, 10));
+
+    uint64_t val = 1;
+    TEST_ASSERT_EQUAL(sizeof(val), write(fd2, &val, sizeof(val)));
+    TEST_ASSERT_EQUAL(1, epoll_wait(epfd, events, 4, 10));
+    TEST_ASSERT_EQUAL(2, events[0].data.u32);
+    TEST_ASSERT_TRUE(events[0].events & EPOLLIN);
+
+    // Level-triggered: still reported until read
+    TEST_ASSERT_EQUAL(1, epoll_wait(epfd, events, 4, 10));
+    TEST_ASSERT_EQUAL(sizeof(val), read(fd2, &val, sizeof(val)));
+    TEST_ASSERT_EQUAL(0, epoll_wait(epfd, events, 4, 10));
+
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_DEL, fd2, NULL));
+    TEST_ASSERT_EQUAL(-1, epoll_ctl(epfd, EPOLL_CTL_DEL, fd2, NULL));
+    TEST_ASSERT_EQUAL(ENOENT, errno);
+    TEST_ASSERT_EQUAL(sizeof(val), write(fd2, &val, sizeof(val)));
+    TEST_ASSERT_EQUAL(0, epoll_wait(epfd, events, 4, 10));
+
+    TEST_ASSERT_EQUAL(0, close(fd1));
+    TEST_ASSERT_EQUAL(0, close(fd2));
+    TEST_ASSERT_EQUAL(0, close(epfd));
+    TEST_ESP_OK(esp_vfs_epoll_unregister());
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+}
+
+TEST_CASE("epoll oneshot and round-robin reporting", "[vfs][epoll]")
+{
+    esp_vfs_eventfd_config_t efd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&efd_config));
+    esp_vfs_epoll_config_t config = ESP_VFS_EPOLL_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_epoll_register(&config));
+
+    int epfd = epoll_create(1);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, epfd);
+    int fd1 = eventfd(1, 0);
+    int fd2 = eventfd(1, 0);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd1 };
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fd1, &ev));
+    ev.data.fd = fd2;
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fd2, &ev));
+
+    // Both are ready, a single slot is served to each in turn
+    struct epoll_event events[1];
+    TEST_ASSERT_EQUAL(1, epoll_wait(epfd, events, 1, 10));
+    int first = events[0].data.fd;
+    TEST_ASSERT_EQUAL(1, epoll_wait(epfd, events, 1, 10));
+    TEST_ASSERT_NOT_EQUAL(first, events[0].data.fd);
+
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = fd1;
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_MOD, fd1, &ev));
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_DEL, fd2, NULL));
+    TEST_ASSERT_EQUAL(1, epoll_wait(epfd, events, 1, 10));
+    TEST_ASSERT_EQUAL(0, epoll_wait(epfd, events, 1, 10));
+    TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_MOD, fd1, &ev));
+    TEST_ASSERT_EQUAL(1, epoll_wait(epfd, events, 1, 10));
+
+    TEST_ASSERT_EQUAL(0, close(fd1));
+    TEST_ASSERT_EQUAL(0, close(fd2));
+    TEST_ASSERT_EQUAL(0, close(epfd));
+    TEST_ESP_OK(esp_vfs_epoll_unregister());
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+}
+
+TEST_CASE("epoll reports all ready file descriptors at once", "[vfs][epoll]")
+{
+    esp_vfs_eventfd_config_t efd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_eventfd_register(&efd_config));
+    esp_vfs_epoll_config_t config = ESP_VFS_EPOLL_CONFIG_DEFAULT();
+    TEST_ESP_OK(esp_vfs_epoll_register(&config));
+
+    int epfd = epoll_create1(0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, epfd);
+    int fds[4];
+    for (int i = 0; i < 4; i++) {
+        fds[i] = eventfd(1, 0);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, fds[i]);
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+        TEST_ASSERT_EQUAL(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev));
+    }
+
+    // Every ready descriptor is reported exactly once
+    struct epoll_event events[6];
+    for (int round = 0; round < 2; round++) {
+        TEST_ASSERT_EQUAL(4, epoll_wait(epfd, events, 6, 10));
+        uint32_t seen = 0;
+        for (int i = 0; i < 4; i++) {
+            TEST_ASSERT_TRUE(events[i].events & EPOLLIN);
+            TEST_ASSERT_LESS_THAN(4, events[i].data.u32);
+            seen |= 1 << events[i].data.u32;
+        }
+        TEST_ASSERT_EQUAL_HEX32(0xf, seen);
+    }
+
+    // With fewer slots, consecutive calls continue after the last reported descriptor
+    uint32_t seen = 0;
+    TEST_ASSERT_EQUAL(3, epoll_wait(epfd, events, 3, 10));
+    for (int i = 0; i < 3; i++) {
+        seen |= 1 << events[i].data.u32;
+    }
+    TEST_ASSERT_EQUAL(3, epoll_wait(epfd, events, 3, 10));
+    TEST_ASSERT_FALSE(seen & (1 << events[0].data.u32));
+
+    // A descriptor closed while registered doesn't fail the wait
+    TEST_ASSERT_EQUAL(0, close(fds[3]));
+    TEST_ASSERT_EQUAL(3, epoll_wait(epfd, events, 6, 10));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_NOT_EQUAL(3, events[i].data.u32);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(0, close(fds[i]));
+    }
+    TEST_ASSERT_EQUAL(0, close(epfd));
+    TEST_ESP_OK(esp_vfs_epoll_unregister());
+    TEST_ESP_OK(esp_vfs_eventfd_unregister());
+}
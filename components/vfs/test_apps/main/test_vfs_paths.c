@@ -238,6 +238,53 @@ TEST_CASE("vfs unregisters correct nested mount point", "[vfs]")
     TEST_ESP_OK( esp_vfs_unregister("/foo/bar") );
 }
 
+TEST_CASE("vfs picks longest matching prefix regardless of registration order", "[vfs]")
+{
+    dummy_vfs_t inst_dev = {
+        .match_path = "/uartx",
+        .called = false
+    };
+    esp_vfs_t desc_dev = DUMMY_VFS();
+    dummy_vfs_t inst_uart = {
+        .match_path = "/0",
+        .called = false
+    };
+    esp_vfs_t desc_uart = DUMMY_VFS();
+    dummy_vfs_t inst_uart_dup = {
+        .match_path = "/0",
+        .called = false
+    };
+    esp_vfs_t desc_uart_dup = DUMMY_VFS();
+    dummy_vfs_t inst_data = {
+        .match_path = "/dev/uart/0",
+        .called = false
+    };
+    esp_vfs_t desc_data = DUMMY_VFS();
+
+    TEST_ESP_OK( esp_vfs_register("/dev/uart", &desc_uart, &inst_uart) );
+    TEST_ESP_OK( esp_vfs_register("/data", &desc_data, &inst_data) );
+    TEST_ESP_OK( esp_vfs_register("/dev", &desc_dev, &inst_dev) );
+    /* the same prefix registered twice resolves to the first registration */
+    TEST_ESP_OK( esp_vfs_register("/dev/uart", &desc_uart_dup, &inst_uart_dup) );
+
+    test_opened(&inst_uart, "/dev/uart/0");
+    test_not_called(&inst_uart_dup, "/dev/uart/0");
+    test_opened(&inst_dev, "/dev/uartx");
+    test_not_called(&inst_uart, "/dev/uartx");
+    test_opened(&inst_data, "/data/dev/uart/0");
+    test_not_called(&inst_data, "/data1/dev/uart/0");
+
+    /* unregistering removes the first registration, the duplicate takes over */
+    TEST_ESP_OK( esp_vfs_unregister("/dev/uart") );
+    test_opened(&inst_uart_dup, "/dev/uart/0");
+    TEST_ESP_OK( esp_vfs_unregister("/dev/uart") );
+    inst_dev.match_path = "/uart/0";
+    test_opened(&inst_dev, "/dev/uart/0");
+
+    TEST_ESP_OK( esp_vfs_unregister("/dev") );
+    TEST_ESP_OK( esp_vfs_unregister("/data") );
+}
+
 
 void test_vfs_register(const char* prefix, bool expect_success, int line)
 {
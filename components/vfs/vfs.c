@@ -72,9 +72,74 @@ typedef struct {
 static vfs_entry_t* s_vfs[VFS_MAX_COUNT] = { 0 };
 static size_t s_vfs_count = 0;
 
+/* VFS entries which have a path prefix, sorted by the prefix (entries with equal
+ * prefixes are sorted by index). Resolving a path takes one binary search per
+ * path component instead of scanning all the registered VFS entries. */
+static vfs_entry_t* s_vfs_sorted[VFS_MAX_COUNT] = { 0 };
+static size_t s_vfs_sorted_count = 0;
+
 static fd_table_t s_fd_table[MAX_FDS] = { [0 ... MAX_FDS-1] = FD_TABLE_ENTRY_UNUSED };
 static _lock_t s_fd_table_lock;
 
+static int vfs_prefix_cmp(const vfs_entry_t *vfs, const char *prefix, size_t len)
+{
+    int ret = memcmp(vfs->path_prefix, prefix, MIN(vfs->path_prefix_len, len));
+    if (ret == 0) {
+        ret = (vfs->path_prefix_len > len) - (vfs->path_prefix_len < len);
+    }
+    return ret;
+}
+
+/* Index of the first entry in s_vfs_sorted whose prefix is not less than the given one */
+static size_t vfs_sorted_lower_bound(const char *prefix, size_t len)
+{
+    size_t lo = 0;
+    size_t hi = s_vfs_sorted_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (vfs_prefix_cmp(s_vfs_sorted[mid], prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static vfs_entry_t *vfs_sorted_find(const char *prefix, size_t len)
+{
+    size_t i = vfs_sorted_lower_bound(prefix, len);
+    if (i < s_vfs_sorted_count && vfs_prefix_cmp(s_vfs_sorted[i], prefix, len) == 0) {
+        return s_vfs_sorted[i];
+    }
+    return NULL;
+}
+
+static void vfs_sorted_insert(vfs_entry_t *entry)
+{
+    size_t i = vfs_sorted_lower_bound(entry->path_prefix, entry->path_prefix_len);
+    // keep the entry with the lowest index first if the same prefix is registered again
+    while (i < s_vfs_sorted_count &&
+            vfs_prefix_cmp(s_vfs_sorted[i], entry->path_prefix, entry->path_prefix_len) == 0 &&
+            s_vfs_sorted[i]->offset < entry->offset) {
+        ++i;
+    }
+    memmove(&s_vfs_sorted[i + 1], &s_vfs_sorted[i], (s_vfs_sorted_count - i) * sizeof(s_vfs_sorted[0]));
+    s_vfs_sorted[i] = entry;
+    ++s_vfs_sorted_count;
+}
+
+static void vfs_sorted_remove(const vfs_entry_t *entry)
+{
+    for (size_t i = 0; i < s_vfs_sorted_count; ++i) {
+        if (s_vfs_sorted[i] == entry) {
+            --s_vfs_sorted_count;
+            memmove(&s_vfs_sorted[i], &s_vfs_sorted[i + 1], (s_vfs_sorted_count - i) * sizeof(s_vfs_sorted[0]));
+            return;
+        }
+    }
+}
+
 esp_err_t esp_vfs_register_common(const char* base_path, size_t len, const esp_vfs_t* vfs, void* ctx, int *vfs_index)
 {
     if (len != LEN_PATH_PREFIX_IGNORED) {
@@ -115,6 +180,10 @@ esp_err_t esp_vfs_register_common(const char* base_path, size_t len, const esp_v
     entry->ctx = ctx;
     entry->offset = index;
 
+    if (len != LEN_PATH_PREFIX_IGNORED) {
+        vfs_sorted_insert(entry);
+    }
+
     if (vfs_index) {
         *vfs_index = index;
     }
@@ -180,6 +249,9 @@ esp_err_t esp_vfs_unregister_with_id(esp_vfs_id_t vfs_id)
         return ESP_ERR_INVALID_ARG;
     }
     vfs_entry_t* vfs = s_vfs[vfs_id];
+    if (vfs->path_prefix_len != LEN_PATH_PREFIX_IGNORED) {
+        vfs_sorted_remove(vfs);
+    }
     free(vfs);
     s_vfs[vfs_id] = NULL;
 
@@ -197,18 +269,11 @@ esp_err_t esp_vfs_unregister_with_id(esp_vfs_id_t vfs_id)
 
 esp_err_t esp_vfs_unregister(const char* base_path)
 {
-    const size_t base_path_len = strlen(base_path);
-    for (size_t i = 0; i < s_vfs_count; ++i) {
-        vfs_entry_t* vfs = s_vfs[i];
-        if (vfs == NULL) {
-            continue;
-        }
-        if (base_path_len == vfs->path_prefix_len &&
-                memcmp(base_path, vfs->path_prefix, vfs->path_prefix_len) == 0) {
-            return esp_vfs_unregister_with_id(i);
-        }
+    const vfs_entry_t* vfs = vfs_sorted_find(base_path, strlen(base_path));
+    if (vfs == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
-    return ESP_ERR_INVALID_STATE;
+    return esp_vfs_unregister_with_id(vfs->offset);
 }
 
 esp_err_t esp_vfs_register_fd(esp_vfs_id_t vfs_id, int *fd)
@@ -278,19 +343,12 @@ esp_err_t esp_vfs_unregister_fd(esp_vfs_id_t vfs_id, int fd)
  */
 esp_err_t esp_vfs_set_readonly_flag(const char* base_path)
 {
-    const size_t base_path_len = strlen(base_path);
-    for (size_t i = 0; i < s_vfs_count; ++i) {
-        vfs_entry_t* vfs = s_vfs[i];
-        if (vfs == NULL) {
-            continue;
-        }
-        if (base_path_len == vfs->path_prefix_len &&
-                memcmp(base_path, vfs->path_prefix, vfs->path_prefix_len) == 0) {
-            vfs->vfs.flags |= ESP_VFS_FLAG_READONLY_FS;
-            return ESP_OK;
-        }
+    vfs_entry_t* vfs = vfs_sorted_find(base_path, strlen(base_path));
+    if (vfs == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
-    return ESP_ERR_INVALID_STATE;
+    vfs->vfs.flags |= ESP_VFS_FLAG_READONLY_FS;
+    return ESP_OK;
 }
 
 const vfs_entry_t *get_vfs_for_index(int index)
@@ -331,7 +389,7 @@ static inline int get_local_fd(const vfs_entry_t *vfs, int fd)
 static const char* translate_path(const vfs_entry_t* vfs, const char* src_path)
 {
     assert(strncmp(src_path, vfs->path_prefix, vfs->path_prefix_len) == 0);
-    if (strlen(src_path) == vfs->path_prefix_len) {
+    if (src_path[vfs->path_prefix_len] == '\0') {
         // special case when src_path matches the path prefix exactly
         return "/";
     }
@@ -340,42 +398,24 @@ static const char* translate_path(const vfs_entry_t* vfs, const char* src_path)
 
 const vfs_entry_t* get_vfs_for_path(const char* path)
 {
-    const vfs_entry_t* best_match = NULL;
-    ssize_t best_match_prefix_len = -1;
+    // Candidate prefixes are the whole path and the path up to each separator,
+    // longest first; i.e. for "/dev/uart/1" path, "/dev/uart/1", "/dev/uart"
+    // and "/dev" are looked up in this order, so "/dev/uart" is preferred over
+    // "/dev" and "/data" prefix never matches "/data1/foo.txt" path.
     size_t len = strlen(path);
-    for (size_t i = 0; i < s_vfs_count; ++i) {
-        const vfs_entry_t* vfs = s_vfs[i];
-        if (!vfs || vfs->path_prefix_len == LEN_PATH_PREFIX_IGNORED) {
-            continue;
-        }
-        // match path prefix
-        if (len < vfs->path_prefix_len ||
-            memcmp(path, vfs->path_prefix, vfs->path_prefix_len) != 0) {
-            continue;
-        }
-        // this is the default VFS and we don't have a better match yet.
-        if (vfs->path_prefix_len == 0 && !best_match) {
-            best_match = vfs;
-            continue;
-        }
-        // if path is not equal to the prefix, expect to see a path separator
-        // i.e. don't match "/data" prefix for "/data1/foo.txt" path
-        if (len > vfs->path_prefix_len &&
-                path[vfs->path_prefix_len] != '/') {
-            continue;
-        }
-        // Out of all matching path prefixes, select the longest one;
-        // i.e. if "/dev" and "/dev/uart" both match, for "/dev/uart/1" path,
-        // choose "/dev/uart",
-        // This causes all s_vfs_count VFS entries to be scanned when opening
-        // a file by name. This can be optimized by introducing a table for
-        // FS search order, sorted so that longer prefixes are checked first.
-        if (best_match_prefix_len < (ssize_t) vfs->path_prefix_len) {
-            best_match_prefix_len = (ssize_t) vfs->path_prefix_len;
-            best_match = vfs;
+    while (len > 0) {
+        if (len > 1 && len <= ESP_VFS_PATH_MAX) {
+            const vfs_entry_t* vfs = vfs_sorted_find(path, len);
+            if (vfs) {
+                return vfs;
+            }
         }
+        do {
+            --len;
+        } while (len > 0 && path[len] != '/');
     }
-    return best_match;
+    // No match, fall back to the default VFS (if any)
+    return vfs_sorted_find("", 0);
 }
 
 /*
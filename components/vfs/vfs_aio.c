@@ -0,0 +1,244 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_vfs_aio.h"
+#include "esp_vfs_eventfd.h"
+
+static const char *TAG = "vfs_aio";
+
+/* Submitted to each worker by esp_vfs_aio_delete() */
+#define VFS_AIO_OP_EXIT ((esp_vfs_aio_op_t) -1)
+
+struct esp_vfs_aio_ctx {
+    QueueHandle_t submission_queue;     /* esp_vfs_aio_request_t */
+    QueueHandle_t completion_queue;     /* esp_vfs_aio_completion_t */
+    SemaphoreHandle_t workers_done;     /* given by each worker on exit */
+    size_t worker_count;                /* number of running workers */
+    int event_fd;
+    esp_vfs_aio_discard_cb_t discard_cb;
+    void *discard_cb_arg;
+};
+
+static ssize_t vfs_aio_execute(const esp_vfs_aio_request_t *req)
+{
+    switch (req->op) {
+    case ESP_VFS_AIO_OP_OPEN:
+        return open(req->path, req->flags, req->mode);
+    case ESP_VFS_AIO_OP_CLOSE:
+        return close(req->fd);
+    case ESP_VFS_AIO_OP_READ:
+        return read(req->fd, req->buf, req->len);
+    case ESP_VFS_AIO_OP_WRITE:
+        return write(req->fd, req->buf, req->len);
+    case ESP_VFS_AIO_OP_PREAD:
+        return pread(req->fd, req->buf, req->len, req->offset);
+    case ESP_VFS_AIO_OP_PWRITE:
+        return pwrite(req->fd, req->buf, req->len, req->offset);
+    case ESP_VFS_AIO_OP_FSYNC:
+        return fsync(req->fd);
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+static void vfs_aio_worker(void *arg)
+{
+    esp_vfs_aio_handle_t ctx = (esp_vfs_aio_handle_t) arg;
+    esp_vfs_aio_request_t req;
+
+    while (xQueueReceive(ctx->submission_queue, &req, portMAX_DELAY) == pdTRUE) {
+        if (req.op == VFS_AIO_OP_EXIT) {
+            break;
+        }
+
+        errno = 0;
+        esp_vfs_aio_completion_t completion = {
+            .op = req.op,
+            .user_data = req.user_data,
+        };
+        completion.result = vfs_aio_execute(&req);
+        completion.error = (completion.result < 0) ? errno : 0;
+
+        xQueueSend(ctx->completion_queue, &completion, portMAX_DELAY);
+
+        if (ctx->event_fd >= 0) {
+            uint64_t one = 1;
+            if (write(ctx->event_fd, &one, sizeof(one)) != sizeof(one)) {
+                ESP_LOGW(TAG, "Failed to signal completion eventfd (%d)", errno);
+            }
+        }
+    }
+
+    xSemaphoreGive(ctx->workers_done);
+    vTaskDelete(NULL);
+}
+
+static void vfs_aio_free(esp_vfs_aio_handle_t ctx)
+{
+    if (ctx->event_fd >= 0) {
+        close(ctx->event_fd);
+    }
+    if (ctx->workers_done) {
+        vSemaphoreDelete(ctx->workers_done);
+    }
+    if (ctx->completion_queue) {
+        vQueueDelete(ctx->completion_queue);
+    }
+    if (ctx->submission_queue) {
+        vQueueDelete(ctx->submission_queue);
+    }
+    free(ctx);
+}
+
+static void vfs_aio_discard_completions(esp_vfs_aio_handle_t ctx)
+{
+    esp_vfs_aio_completion_t completion;
+    while (xQueueReceive(ctx->completion_queue, &completion, 0) == pdTRUE) {
+        if (ctx->discard_cb) {
+            ctx->discard_cb(&completion, ctx->discard_cb_arg);
+        }
+    }
+}
+
+static void vfs_aio_stop_workers(esp_vfs_aio_handle_t ctx)
+{
+    const esp_vfs_aio_request_t exit_req = { .op = VFS_AIO_OP_EXIT };
+    size_t exits_sent = 0;
+    size_t stopped = 0;
+
+    /* Nothing blocks here: the workers may wait for room in the completion queue
+     * while the submission queue is full, so both queues are drained until all
+     * the workers have taken their exit request */
+    while (stopped < ctx->worker_count) {
+        if (exits_sent < ctx->worker_count) {
+            esp_vfs_aio_request_t req;
+            while (xQueueReceive(ctx->submission_queue, &req, 0) == pdTRUE) {
+                const esp_vfs_aio_completion_t cancelled = {
+                    .op = req.op,
+                    .user_data = req.user_data,
+                    .result = -1,
+                    .error = ECANCELED,
+                };
+                if (ctx->discard_cb) {
+                    ctx->discard_cb(&cancelled, ctx->discard_cb_arg);
+                }
+            }
+            while (exits_sent < ctx->worker_count &&
+                    xQueueSend(ctx->submission_queue, &exit_req, 0) == pdTRUE) {
+                exits_sent++;
+            }
+        }
+        vfs_aio_discard_completions(ctx);
+        if (xSemaphoreTake(ctx->workers_done, pdMS_TO_TICKS(10)) == pdTRUE) {
+            stopped++;
+        }
+    }
+    vfs_aio_discard_completions(ctx);
+    ctx->worker_count = 0;
+}
+
+esp_err_t esp_vfs_aio_create(const esp_vfs_aio_config_t *config, esp_vfs_aio_handle_t *handle)
+{
+    if (config == NULL || handle == NULL || config->queue_size == 0 || config->worker_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_vfs_aio_handle_t ctx = calloc(1, sizeof(struct esp_vfs_aio_ctx));
+    if (ctx == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->event_fd = -1;
+    ctx->discard_cb = config->discard_cb;
+    ctx->discard_cb_arg = config->discard_cb_arg;
+
+    /* Room for every queued and every in-flight request, so workers only block
+     * on completions if the application stops retrieving them */
+    ctx->submission_queue = xQueueCreate(config->queue_size, sizeof(esp_vfs_aio_request_t));
+    ctx->completion_queue = xQueueCreate(config->queue_size + config->worker_count, sizeof(esp_vfs_aio_completion_t));
+    ctx->workers_done = xSemaphoreCreateCounting(config->worker_count, 0);
+    if (!ctx->submission_queue || !ctx->completion_queue || !ctx->workers_done) {
+        vfs_aio_free(ctx);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (config->use_eventfd) {
+        ctx->event_fd = eventfd(0, 0);
+        if (ctx->event_fd < 0) {
+            ESP_LOGE(TAG, "Failed to create eventfd, is the eventfd VFS registered?");
+            vfs_aio_free(ctx);
+            return ESP_FAIL;
+        }
+    }
+
+    for (size_t i = 0; i < config->worker_count; i++) {
+        if (xTaskCreatePinnedToCore(vfs_aio_worker, "vfs_aio", config->worker_stack_size, ctx,
+                                    config->worker_priority, NULL, config->worker_core_id) != pdPASS) {
+            vfs_aio_stop_workers(ctx);
+            vfs_aio_free(ctx);
+            return ESP_ERR_NO_MEM;
+        }
+        ctx->worker_count++;
+    }
+
+    *handle = ctx;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_aio_delete(esp_vfs_aio_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    vfs_aio_stop_workers(handle);
+    vfs_aio_free(handle);
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_aio_submit(esp_vfs_aio_handle_t handle, const esp_vfs_aio_request_t *request, TickType_t ticks_to_wait)
+{
+    if (handle == NULL || request == NULL || (int) request->op < ESP_VFS_AIO_OP_OPEN || (int) request->op > ESP_VFS_AIO_OP_FSYNC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (xQueueSend(handle->submission_queue, request, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_aio_get_completions(esp_vfs_aio_handle_t handle, esp_vfs_aio_completion_t *completions,
+                                      size_t max_count, size_t *count, TickType_t ticks_to_wait)
+{
+    if (handle == NULL || completions == NULL || max_count == 0 || count == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *count = 0;
+    if (xQueueReceive(handle->completion_queue, &completions[0], ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    size_t n = 1;
+    while (n < max_count && xQueueReceive(handle->completion_queue, &completions[n], 0) == pdTRUE) {
+        n++;
+    }
+    *count = n;
+    return ESP_OK;
+}
+
+int esp_vfs_aio_get_eventfd(esp_vfs_aio_handle_t handle)
+{
+    return handle ? handle->event_fd : -1;
+}
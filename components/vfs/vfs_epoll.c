@@ -0,0 +1,412 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "esp_vfs_epoll.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/fcntl.h>
+#include <sys/lock.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_vfs.h"
+
+#define FD_INVALID -1
+
+#define EPOLL_ITEMS_GROW    4
+#define EPOLL_READ_EVENTS   (EPOLLIN | EPOLLPRI)
+#define EPOLL_SUPPORTED     (EPOLLIN | EPOLLPRI | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLONESHOT)
+
+typedef struct {
+    int                 fd;
+    uint32_t            events;     // requested events, 0 for a disabled EPOLLONESHOT entry
+    epoll_data_t        data;
+} epoll_item_t;
+
+/*
+ * The interest set of each instance is kept both as a list (for reporting)
+ * and as precomputed fd_sets (for select()), so epoll_wait() neither rebuilds
+ * the sets nor scans all MAX_FDS descriptors.
+ */
+typedef struct {
+    int                 fd;         // local fd, FD_INVALID if unused
+    int                 global_fd;
+    _lock_t             lock;
+    epoll_item_t        *items;
+    size_t              count;
+    size_t              capacity;
+    size_t              next;       // round-robin start of reporting
+    int                 nfds;
+    fd_set              readfds;
+    fd_set              writefds;
+    fd_set              errorfds;
+} epoll_context_t;
+
+static esp_vfs_id_t s_epoll_vfs_id = -1;
+
+static size_t s_epoll_size;
+static epoll_context_t *s_epolls;
+
+static void epoll_rebuild_sets(epoll_context_t *ep)
+{
+    FD_ZERO(&ep->readfds);
+    FD_ZERO(&ep->writefds);
+    FD_ZERO(&ep->errorfds);
+    ep->nfds = 0;
+    for (size_t i = 0; i < ep->count; i++) {
+        const epoll_item_t *item = &ep->items[i];
+        if (item->events == 0) {
+            continue;
+        }
+        if (item->events & EPOLL_READ_EVENTS) {
+            FD_SET(item->fd, &ep->readfds);
+        }
+        if (item->events & EPOLLOUT) {
+            FD_SET(item->fd, &ep->writefds);
+        }
+        FD_SET(item->fd, &ep->errorfds);
+        if (item->fd + 1 > ep->nfds) {
+            ep->nfds = item->fd + 1;
+        }
+    }
+}
+
+static epoll_context_t *epoll_get_context(int epfd)
+{
+    for (size_t i = 0; i < s_epoll_size; i++) {
+        if (s_epolls[i].fd != FD_INVALID && s_epolls[i].global_fd == epfd) {
+            return &s_epolls[i];
+        }
+    }
+    return NULL;
+}
+
+static epoll_item_t *epoll_find_item(epoll_context_t *ep, int fd)
+{
+    for (size_t i = 0; i < ep->count; i++) {
+        if (ep->items[i].fd == fd) {
+            return &ep->items[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Descriptors closed without EPOLL_CTL_DEL would make every select() fail with EBADF,
+ * so they are dropped from the interest set, as Linux does on close.
+ * Returns the number of dropped items.
+ */
+static size_t epoll_drop_closed(epoll_context_t *ep)
+{
+    size_t dropped = 0;
+    for (size_t i = 0; i < ep->count;) {
+        if (fcntl(ep->items[i].fd, F_GETFL, 0) < 0 && errno == EBADF) {
+            ep->items[i] = ep->items[--ep->count];
+            dropped++;
+        } else {
+            i++;
+        }
+    }
+    if (dropped) {
+        ep->next = 0;
+        epoll_rebuild_sets(ep);
+    }
+    return dropped;
+}
+
+static int epoll_close(int fd)
+{
+    if (fd < 0 || (size_t)fd >= s_epoll_size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int ret = -1;
+    _lock_acquire(&s_epolls[fd].lock);
+    if (s_epolls[fd].fd == fd) {
+        free(s_epolls[fd].items);
+        s_epolls[fd].items = NULL;
+        s_epolls[fd].count = 0;
+        s_epolls[fd].capacity = 0;
+        s_epolls[fd].fd = FD_INVALID;
+        s_epolls[fd].global_fd = FD_INVALID;
+        ret = 0;
+    } else {
+        errno = EBADF;
+    }
+    _lock_release(&s_epolls[fd].lock);
+    return ret;
+}
+
+esp_err_t esp_vfs_epoll_register(const esp_vfs_epoll_config_t *config)
+{
+    if (config == NULL || config->max_fds == 0 || config->max_fds >= MAX_FDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_epoll_vfs_id != -1) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_epolls = (epoll_context_t *)calloc(config->max_fds, sizeof(epoll_context_t));
+    if (s_epolls == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_epoll_size = config->max_fds;
+    for (size_t i = 0; i < s_epoll_size; i++) {
+        _lock_init(&s_epolls[i].lock);
+        s_epolls[i].fd = FD_INVALID;
+        s_epolls[i].global_fd = FD_INVALID;
+    }
+
+    esp_vfs_t vfs = {
+        .flags        = ESP_VFS_FLAG_DEFAULT,
+        .close        = &epoll_close,
+    };
+    esp_err_t error = esp_vfs_register_with_id(&vfs, NULL, &s_epoll_vfs_id);
+    if (error != ESP_OK) {
+        for (size_t i = 0; i < s_epoll_size; i++) {
+            _lock_close(&s_epolls[i].lock);
+        }
+        free(s_epolls);
+        s_epolls = NULL;
+        s_epoll_size = 0;
+    }
+    return error;
+}
+
+esp_err_t esp_vfs_epoll_unregister(void)
+{
+    if (s_epoll_vfs_id == -1) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t error = esp_vfs_unregister_with_id(s_epoll_vfs_id);
+    if (error == ESP_OK) {
+        s_epoll_vfs_id = -1;
+    }
+    for (size_t i = 0; i < s_epoll_size; i++) {
+        free(s_epolls[i].items);
+        _lock_close(&s_epolls[i].lock);
+    }
+    free(s_epolls);
+    s_epolls = NULL;
+    s_epoll_size = 0;
+    return error;
+}
+
+int epoll_create1(int flags)
+{
+    if (flags != 0) {
+        errno = EINVAL;
+        return FD_INVALID;
+    }
+    if (s_epoll_vfs_id == -1) {
+        errno = EACCES;
+        return FD_INVALID;
+    }
+
+    for (size_t i = 0; i < s_epoll_size; i++) {
+        _lock_acquire(&s_epolls[i].lock);
+        if (s_epolls[i].fd == FD_INVALID) {
+            int global_fd = FD_INVALID;
+            esp_err_t error = esp_vfs_register_fd_with_local_fd(s_epoll_vfs_id, i, /*permanent=*/false, &global_fd);
+            if (error != ESP_OK) {
+                _lock_release(&s_epolls[i].lock);
+                errno = (error == ESP_ERR_NO_MEM) ? ENFILE : EINVAL;
+                return FD_INVALID;
+            }
+            s_epolls[i].fd = i;
+            s_epolls[i].global_fd = global_fd;
+            s_epolls[i].count = 0;
+            s_epolls[i].next = 0;
+            epoll_rebuild_sets(&s_epolls[i]);
+            _lock_release(&s_epolls[i].lock);
+            return global_fd;
+        }
+        _lock_release(&s_epolls[i].lock);
+    }
+
+    errno = ENOMEM;
+    return FD_INVALID;
+}
+
+int epoll_create(int size)
+{
+    if (size <= 0) {
+        errno = EINVAL;
+        return FD_INVALID;
+    }
+    return epoll_create1(0);
+}
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    if (fd < 0 || fd >= MAX_FDS) {
+        errno = EBADF;
+        return -1;
+    }
+    if (fd == epfd) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (op != EPOLL_CTL_DEL && (event == NULL || (event->events & ~EPOLL_SUPPORTED) != 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    epoll_context_t *ep = epoll_get_context(epfd);
+    if (ep == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    int ret = 0;
+    _lock_acquire(&ep->lock);
+    epoll_item_t *item = epoll_find_item(ep, fd);
+    switch (op) {
+    case EPOLL_CTL_ADD:
+        if (item) {
+            errno = EEXIST;
+            ret = -1;
+            break;
+        }
+        if (ep->count == ep->capacity) {
+            epoll_item_t *items = realloc(ep->items, (ep->capacity + EPOLL_ITEMS_GROW) * sizeof(epoll_item_t));
+            if (items == NULL) {
+                errno = ENOMEM;
+                ret = -1;
+                break;
+            }
+            ep->items = items;
+            ep->capacity += EPOLL_ITEMS_GROW;
+        }
+        item = &ep->items[ep->count++];
+        item->fd = fd;
+        item->events = event->events;
+        item->data = event->data;
+        break;
+    case EPOLL_CTL_MOD:
+        if (item == NULL) {
+            errno = ENOENT;
+            ret = -1;
+            break;
+        }
+        item->events = event->events;
+        item->data = event->data;
+        break;
+    case EPOLL_CTL_DEL:
+        if (item == NULL) {
+            errno = ENOENT;
+            ret = -1;
+            break;
+        }
+        *item = ep->items[--ep->count];
+        break;
+    default:
+        errno = EINVAL;
+        ret = -1;
+        break;
+    }
+    if (ret == 0) {
+        epoll_rebuild_sets(ep);
+    }
+    _lock_release(&ep->lock);
+    return ret;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    if (events == NULL || maxevents <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    epoll_context_t *ep = epoll_get_context(epfd);
+    if (ep == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    // A retry after dropping closed descriptors only waits for the rest of the timeout
+    const TickType_t start_tick = xTaskGetTickCount();
+    struct timeval tv;
+    fd_set readfds, writefds, errorfds;
+    int ready;
+    while (true) {
+        if (timeout >= 0) {
+            int remaining = timeout - (int)pdTICKS_TO_MS(xTaskGetTickCount() - start_tick);
+            if (remaining < 0) {
+                remaining = 0;
+            }
+            tv.tv_sec = remaining / 1000;
+            tv.tv_usec = (remaining % 1000) * 1000;
+        }
+        _lock_acquire(&ep->lock);
+        int nfds = ep->nfds;
+        readfds = ep->readfds;
+        writefds = ep->writefds;
+        errorfds = ep->errorfds;
+        _lock_release(&ep->lock);
+
+        ready = select(nfds, &readfds, &writefds, &errorfds, timeout < 0 ? NULL : &tv);
+        if (ready >= 0 || errno != EBADF) {
+            break;
+        }
+        _lock_acquire(&ep->lock);
+        size_t dropped = epoll_drop_closed(ep);
+        _lock_release(&ep->lock);
+        if (dropped == 0) {
+            return ready;
+        }
+    }
+    if (ready <= 0) {
+        return ready;
+    }
+
+    // Report only the ready descriptors, starting where the previous call stopped
+    int n = 0;
+    _lock_acquire(&ep->lock);
+    size_t count = ep->count;
+    size_t start = count ? ep->next % count : 0;
+    size_t last = start;
+    for (size_t k = 0; k < count && n < maxevents; k++) {
+        size_t i = (start + k) % count;
+        epoll_item_t *item = &ep->items[i];
+        if (item->events == 0) {
+            continue;
+        }
+        uint32_t revents = 0;
+        if ((item->events & EPOLL_READ_EVENTS) && FD_ISSET(item->fd, &readfds)) {
+            revents |= EPOLLIN;
+        }
+        if ((item->events & EPOLLOUT) && FD_ISSET(item->fd, &writefds)) {
+            revents |= EPOLLOUT;
+        }
+        if (FD_ISSET(item->fd, &errorfds)) {
+            revents |= EPOLLERR;
+        }
+        if (revents == 0) {
+            continue;
+        }
+        events[n].events = revents;
+        events[n].data = item->data;
+        n++;
+        if (item->events & EPOLLONESHOT) {
+            item->events = 0;
+        }
+        last = i + 1;
+    }
+    if (count) {
+        ep->next = last % count;
+    }
+    epoll_rebuild_sets(ep);
+    _lock_release(&ep->lock);
+
+    return n;
+}
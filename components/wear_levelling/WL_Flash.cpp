@@ -1,11 +1,12 @@
 /*
- * SPDX-FileCopyrightText: 2015-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2015-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <stdio.h>
 #include "esp_random.h"
 #include "esp_log.h"
+#include "sdkconfig.h"
 #include "Partition.h"
 #include "WL_Flash.h"
 #include <stdlib.h>
@@ -427,11 +428,49 @@ esp_err_t WL_Flash::updateWL()
     esp_err_t result = ESP_OK;
     this->state.wl_sec_erase_cycle_count++;
     if (this->state.wl_sec_erase_cycle_count < this->state.wl_max_sec_erase_cycle_count) {
+#if CONFIG_WL_INCREMENTAL_MIGRATION
+        // Each erase carries at most one step of a pending move
+        if (this->migration_active) {
+            return this->migrateStep();
+        }
+#endif
         return result;
     }
     // Here we have to move the block and increase the state
     this->state.wl_sec_erase_cycle_count = 0;
     ESP_LOGV(TAG, "%s - wl_sec_erase_cycle_count= 0x%08" PRIx32 ", pos= 0x%08" PRIx32 , __func__, this->state.wl_sec_erase_cycle_count, this->state.wl_dummy_sec_pos);
+    if (!this->migration_active) {
+        this->migration_active = true;
+        this->migration_step = 0;
+    }
+#if CONFIG_WL_INCREMENTAL_MIGRATION
+    return this->migrateStep();
+#else
+    result = this->completeMigration();
+    if (result != ESP_OK) {
+        // Start the move from the beginning next time
+        this->migration_active = false;
+        this->state.wl_sec_erase_cycle_count = this->state.wl_max_sec_erase_cycle_count - 1; // we will update next time
+    }
+    return result;
+#endif
+}
+
+esp_err_t WL_Flash::completeMigration()
+{
+    esp_err_t result = ESP_OK;
+    while (this->migration_active) {
+        result = this->migrateStep();
+        if (result != ESP_OK) {
+            break;
+        }
+    }
+    return result;
+}
+
+esp_err_t WL_Flash::migrateStep()
+{
+    esp_err_t result = ESP_OK;
     // copy data to dummy block
     size_t data_addr = this->state.wl_dummy_sec_pos + 1; // next block, [pos+1] copy to [pos]
     if (data_addr >= this->state.wl_part_max_sec_pos) {
@@ -439,28 +478,34 @@ esp_err_t WL_Flash::updateWL()
     }
     data_addr = this->cfg.wl_partition_start_addr + data_addr * this->cfg.wl_page_size;
     this->dummy_addr = this->cfg.wl_partition_start_addr + this->state.wl_dummy_sec_pos * this->cfg.wl_page_size;
-    result = this->partition->erase_range(this->dummy_addr, this->cfg.wl_page_size);
-    if (result != ESP_OK) {
-        ESP_LOGE(TAG, "%s - erase wl dummy sector result= 0x%08x" , __func__, result);
-        this->state.wl_sec_erase_cycle_count = this->state.wl_max_sec_erase_cycle_count - 1; // we will update next time
+    size_t copy_count = this->cfg.wl_page_size / this->cfg.wl_temp_buff_size;
+
+    if (this->migration_step == 0) {
+        result = this->partition->erase_range(this->dummy_addr, this->cfg.wl_page_size);
+        if (result != ESP_OK) {
+            ESP_LOGE(TAG, "%s - erase wl dummy sector result= 0x%08x" , __func__, result);
+            return result;
+        }
+        this->migration_step++;
         return result;
     }
 
-    size_t copy_count = this->cfg.wl_page_size / this->cfg.wl_temp_buff_size;
-    for (size_t i = 0; i < copy_count; i++) {
+    if (this->migration_step <= copy_count) {
+        size_t i = this->migration_step - 1;
         result = this->partition->read(data_addr + i * this->cfg.wl_temp_buff_size, this->temp_buff, this->cfg.wl_temp_buff_size);
         if (result != ESP_OK) {
             ESP_LOGE(TAG, "%s - not possible to read buffer, will try next time, result= 0x%08x" , __func__, result);
-            this->state.wl_sec_erase_cycle_count = this->state.wl_max_sec_erase_cycle_count - 1; // we will update next time
             return result;
         }
         result = this->partition->write(this->dummy_addr + i * this->cfg.wl_temp_buff_size, this->temp_buff, this->cfg.wl_temp_buff_size);
         if (result != ESP_OK) {
             ESP_LOGE(TAG, "%s - not possible to write buffer, will try next time, result= 0x%08x" , __func__, result);
-            this->state.wl_sec_erase_cycle_count = this->state.wl_max_sec_erase_cycle_count - 1; // we will update next time
             return result;
         }
+        this->migration_step++;
+        return result;
     }
+
     // done... block moved.
     // Here we will update structures...
     // Update bits and save to flash:
@@ -470,17 +515,17 @@ esp_err_t WL_Flash::updateWL()
     result |= this->partition->write(this->addr_state1 + sizeof(wl_state_t) + byte_pos, this->temp_buff, this->cfg.wl_pos_update_record_size);
     if (result != ESP_OK) {
         ESP_LOGE(TAG, "%s - update position 1 result= 0x%08x" , __func__, result);
-        this->state.wl_sec_erase_cycle_count = this->state.wl_max_sec_erase_cycle_count - 1; // we will update next time
         return result;
     }
     this->fillOkBuff(this->state.wl_dummy_sec_pos);
     result |= this->partition->write(this->addr_state2 + sizeof(wl_state_t) + byte_pos, this->temp_buff, this->cfg.wl_pos_update_record_size);
     if (result != ESP_OK) {
         ESP_LOGE(TAG, "%s - update position 2 result= 0x%08x" , __func__, result);
-        this->state.wl_sec_erase_cycle_count = this->state.wl_max_sec_erase_cycle_count - 1; // we will update next time
         return result;
     }
 
+    this->migration_active = false;
+    this->migration_step = 0;
     this->state.wl_dummy_sec_pos++;
     if (this->state.wl_dummy_sec_pos >= this->state.wl_part_max_sec_pos) {
         this->state.wl_dummy_sec_pos = 0;
@@ -511,6 +556,39 @@ esp_err_t WL_Flash::updateWL()
     return result;
 }
 
+esp_err_t WL_Flash::checkMigrationConflict(size_t phys_addr, size_t size)
+{
+    if (!this->migration_active || this->migration_step == 0) {
+        return ESP_OK;
+    }
+    size_t data_addr = this->state.wl_dummy_sec_pos + 1;
+    if (data_addr >= this->state.wl_part_max_sec_pos) {
+        data_addr = 0;
+    }
+    data_addr = this->cfg.wl_partition_start_addr + data_addr * this->cfg.wl_page_size;
+    if (phys_addr + size <= data_addr || phys_addr >= data_addr + this->cfg.wl_page_size) {
+        return ESP_OK;
+    }
+    // The sector being moved is about to change at its current location, so the part
+    // already copied is stale: start the copy again with the next step
+    ESP_LOGD(TAG, "%s - restarting move of 0x%08" PRIx32, __func__, (uint32_t) data_addr);
+    this->migration_step = 0;
+    return ESP_OK;
+}
+
+esp_err_t WL_Flash::migrate_step(bool *pending)
+{
+    esp_err_t result = ESP_OK;
+    if (!this->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (this->migration_active) {
+        result = this->migrateStep();
+    }
+    *pending = this->migration_active;
+    return result;
+}
+
 size_t WL_Flash::calcAddr(size_t addr)
 {
     size_t result = (this->flash_size - this->state.wl_dummy_sec_move_count * this->cfg.wl_page_size + addr) % this->flash_size;
@@ -550,6 +628,9 @@ esp_err_t WL_Flash::erase_sector(size_t sector)
     result = this->updateWL();
     WL_RESULT_CHECK(result);
     size_t virt_addr = this->calcAddr(sector * this->cfg.flash_sector_size);
+    result = this->checkMigrationConflict(this->cfg.wl_partition_start_addr + virt_addr, this->cfg.flash_sector_size);
+    WL_RESULT_CHECK(result);
+    virt_addr = this->calcAddr(sector * this->cfg.flash_sector_size);
     result = this->partition->erase_sector((this->cfg.wl_partition_start_addr + virt_addr) / this->cfg.flash_sector_size);
     WL_RESULT_CHECK(result);
     return result;
@@ -582,10 +663,16 @@ esp_err_t WL_Flash::write(size_t dest_addr, const void *src, size_t size)
     uint32_t count = (size - 1) / this->cfg.wl_page_size;
     for (size_t i = 0; i < count; i++) {
         size_t virt_addr = this->calcAddr(dest_addr + i * this->cfg.wl_page_size);
+        result = this->checkMigrationConflict(this->cfg.wl_partition_start_addr + virt_addr, this->cfg.wl_page_size);
+        WL_RESULT_CHECK(result);
+        virt_addr = this->calcAddr(dest_addr + i * this->cfg.wl_page_size);
         result = this->partition->write(this->cfg.wl_partition_start_addr + virt_addr, &((uint8_t *)src)[i * this->cfg.wl_page_size], this->cfg.wl_page_size);
         WL_RESULT_CHECK(result);
     }
     size_t virt_addr_last = this->calcAddr(dest_addr + count * this->cfg.wl_page_size);
+    result = this->checkMigrationConflict(this->cfg.wl_partition_start_addr + virt_addr_last, size - count * this->cfg.wl_page_size);
+    WL_RESULT_CHECK(result);
+    virt_addr_last = this->calcAddr(dest_addr + count * this->cfg.wl_page_size);
     result = this->partition->write(this->cfg.wl_partition_start_addr + virt_addr_last, &((uint8_t *)src)[count * this->cfg.wl_page_size], size - count * this->cfg.wl_page_size);
     WL_RESULT_CHECK(result);
     return result;
@@ -622,9 +709,13 @@ wl_config_t *WL_Flash::get_cfg()
 
 esp_err_t WL_Flash::flush()
 {
-    esp_err_t result = ESP_OK;
+    esp_err_t result = this->completeMigration();
+    WL_RESULT_CHECK(result);
     this->state.wl_sec_erase_cycle_count = this->state.wl_max_sec_erase_cycle_count - 1;
     result = this->updateWL();
+    if (result == ESP_OK) {
+        result = this->completeMigration();
+    }
     ESP_LOGD(TAG, "%s - result= 0x%08x, wl_dummy_sec_move_count= 0x%08" PRIx32, __func__, result, this->state.wl_dummy_sec_move_count);
     return result;
 }
@@ -0,0 +1,258 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "ff.h"
+#include "diskio.h"
+#include "esp_partition.h"
+#include "esp_private/partition_linux.h"
+#include "wear_levelling.h"
+#include "diskio_impl.h"
+#include "diskio_wl.h"
+#include "sdkconfig.h"
+
+#define HISTOGRAM_BUCKETS   10
+#define HISTOGRAM_WIDTH     50
+
+typedef struct {
+    const char *name;
+    const char *description;
+    FRESULT (*prepare)(void);               /* optional, not measured */
+    FRESULT (*run)(uint64_t *logical_bytes);
+} benchmark_profile_t;
+
+static uint32_t s_rand_state = 1;
+
+static uint32_t bench_rand(void)
+{
+    // xorshift32, deterministic so that runs are comparable
+    s_rand_state ^= s_rand_state << 13;
+    s_rand_state ^= s_rand_state >> 17;
+    s_rand_state ^= s_rand_state << 5;
+    return s_rand_state;
+}
+
+static void fill_buf(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t) bench_rand();
+    }
+}
+
+#define BENCH_CHECK(x) do { FRESULT _res = (x); if (_res != FR_OK) { \
+            printf("%s:%d: %s failed (%d)\n", __func__, __LINE__, #x, _res); \
+            return _res; } } while (0)
+
+/* Data logger: 64 byte records appended to one file, synced every 16 records */
+static FRESULT profile_log_append(uint64_t *logical_bytes)
+{
+    FIL file;
+    uint8_t record[64];
+    UINT bw;
+
+    BENCH_CHECK(f_open(&file, "log.bin", FA_OPEN_APPEND | FA_WRITE));
+    for (int i = 0; i < 4000; i++) {
+        fill_buf(record, sizeof(record));
+        BENCH_CHECK(f_write(&file, record, sizeof(record), &bw));
+        *logical_bytes += bw;
+        if (i % 16 == 15) {
+            BENCH_CHECK(f_sync(&file));
+        }
+    }
+    BENCH_CHECK(f_close(&file));
+    return FR_OK;
+}
+
+/* Small files of 100..2000 bytes created and written in one go, keeping the 32 newest */
+static FRESULT profile_small_file_churn(uint64_t *logical_bytes)
+{
+    FIL file;
+    static uint8_t data[2000];
+    char name[16];
+    UINT bw;
+
+    for (int i = 0; i < 1000; i++) {
+        size_t len = 100 + bench_rand() % (sizeof(data) - 100);
+        fill_buf(data, len);
+        snprintf(name, sizeof(name), "f%04d.bin", i);
+        BENCH_CHECK(f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE));
+        BENCH_CHECK(f_write(&file, data, len, &bw));
+        *logical_bytes += bw;
+        BENCH_CHECK(f_close(&file));
+        if (i >= 32) {
+            snprintf(name, sizeof(name), "f%04d.bin", i - 32);
+            BENCH_CHECK(f_unlink(name));
+        }
+    }
+    return FR_OK;
+}
+
+#define DB_FILE_SIZE    (256 * 1024)
+
+static FRESULT prepare_db_random(void)
+{
+    FIL file;
+    static uint8_t zeros[4096];
+    UINT bw;
+
+    BENCH_CHECK(f_open(&file, "db.bin", FA_CREATE_ALWAYS | FA_WRITE));
+    for (int i = 0; i < DB_FILE_SIZE / sizeof(zeros); i++) {
+        BENCH_CHECK(f_write(&file, zeros, sizeof(zeros), &bw));
+    }
+    BENCH_CHECK(f_close(&file));
+    return FR_OK;
+}
+
+/* Database: 128 byte records updated at random positions of a 256 KB file, synced every 8 updates */
+static FRESULT profile_db_random(uint64_t *logical_bytes)
+{
+    FIL file;
+    uint8_t record[128];
+    const FSIZE_t file_size = DB_FILE_SIZE;
+    UINT bw;
+
+    BENCH_CHECK(f_open(&file, "db.bin", FA_OPEN_EXISTING | FA_WRITE));
+    for (int i = 0; i < 4000; i++) {
+        fill_buf(record, sizeof(record));
+        BENCH_CHECK(f_lseek(&file, (bench_rand() % (file_size / sizeof(record))) * sizeof(record)));
+        BENCH_CHECK(f_write(&file, record, sizeof(record), &bw));
+        *logical_bytes += bw;
+        if (i % 8 == 7) {
+            BENCH_CHECK(f_sync(&file));
+        }
+    }
+    BENCH_CHECK(f_close(&file));
+    return FR_OK;
+}
+
+static const benchmark_profile_t s_profiles[] = {
+    { "log_append", "append 64 B records, sync every 16", NULL, profile_log_append },
+    { "small_file_churn", "create 100..2000 B files, keep 32 newest", NULL, profile_small_file_churn },
+    { "db_random", "overwrite random 128 B records, sync every 8", prepare_db_random, profile_db_random },
+};
+
+static void print_wear_report(const esp_partition_t *partition)
+{
+    size_t first = partition->address / ESP_PARTITION_EMULATED_SECTOR_SIZE;
+    size_t count = partition->size / ESP_PARTITION_EMULATED_SECTOR_SIZE;
+    size_t min = SIZE_MAX, max = 0;
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t n = esp_partition_get_sector_erase_count(first + i);
+        min = n < min ? n : min;
+        max = n > max ? n : max;
+        sum += n;
+    }
+    double mean = (double) sum / count;
+    printf("  erases per sector     : min %zu, max %zu, mean %.1f, max/mean %.2f\n",
+           min, max, mean, mean > 0 ? max / mean : 0.0);
+
+    size_t buckets[HISTOGRAM_BUCKETS] = { 0 };
+    size_t bucket_width = (max - min) / HISTOGRAM_BUCKETS + 1;
+    size_t largest = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t b = (esp_partition_get_sector_erase_count(first + i) - min) / bucket_width;
+        buckets[b]++;
+        largest = buckets[b] > largest ? buckets[b] : largest;
+    }
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        size_t lo = min + b * bucket_width;
+        if (lo > max) {
+            break;
+        }
+        int bar = (int)(buckets[b] * HISTOGRAM_WIDTH / largest);
+        printf("    %6zu..%-6zu %5zu |%.*s\n", lo, lo + bucket_width - 1, buckets[b], bar,
+               "##################################################");
+    }
+}
+
+static int run_profile(const benchmark_profile_t *profile, const esp_partition_t *partition)
+{
+    wl_handle_t wl_handle;
+    BYTE pdrv;
+    FATFS fs;
+    BYTE work_area[FF_MAX_SS];
+
+    // Start from blank flash and format outside of the measurement. Profiles use
+    // paths without drive number, so the volume has to be the default drive 0
+    esp_partition_erase_range(partition, 0, partition->size);
+    if (wl_mount(partition, &wl_handle) != ESP_OK || ff_diskio_get_drive(&pdrv) != ESP_OK || pdrv != 0 ||
+            ff_diskio_register_wl_partition(pdrv, wl_handle) != ESP_OK) {
+        printf("failed to set up the volume\n");
+        return 1;
+    }
+    const MKFS_PARM opt = {(BYTE)FM_ANY, 0, 0, 0, 0};
+    if (f_mkfs("", &opt, work_area, sizeof(work_area)) != FR_OK || f_mount(&fs, "", 1) != FR_OK) {
+        printf("failed to create the filesystem\n");
+        return 1;
+    }
+
+    s_rand_state = 1;
+    FRESULT res = profile->prepare ? profile->prepare() : FR_OK;
+    esp_partition_clear_stats();
+    uint64_t logical_bytes = 0;
+    if (res == FR_OK) {
+        res = profile->run(&logical_bytes);
+        // Let caching layers write back, the data is part of the workload
+        if (res == FR_OK && disk_ioctl(pdrv, CTRL_SYNC, NULL) != RES_OK) {
+            res = FR_DISK_ERR;
+        }
+    }
+    f_mount(NULL, "", 0);
+    ff_diskio_unregister(pdrv);
+    ff_diskio_clear_pdrv_wl(wl_handle);
+    wl_unmount(wl_handle);
+    if (res != FR_OK) {
+        return 1;
+    }
+
+    size_t write_bytes = esp_partition_get_write_bytes();
+    size_t erase_ops = esp_partition_get_erase_ops();
+    size_t time_ms = esp_partition_get_total_time();
+    printf("\nProfile %s (%s)\n", profile->name, profile->description);
+    printf("  logical bytes written : %" PRIu64 "\n", logical_bytes);
+    printf("  flash bytes written   : %zu, amplification %.2f\n", write_bytes, (double) write_bytes / logical_bytes);
+    printf("  flash sector erases   : %zu, amplification %.2f\n", erase_ops,
+           (double) erase_ops * ESP_PARTITION_EMULATED_SECTOR_SIZE / logical_bytes);
+    printf("  flash reads           : %zu ops, %zu bytes\n", esp_partition_get_read_ops(), esp_partition_get_read_bytes());
+    printf("  estimated flash time  : %zu ms, %.1f KB/s\n", time_ms,
+           time_ms ? (double) logical_bytes / 1024 * 1000 / time_ms : 0.0);
+    print_wear_report(partition);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, "storage");
+    if (partition == NULL) {
+        printf("storage partition not found\n");
+        return 1;
+    }
+
+#if CONFIG_WL_SECTOR_SIZE_4096
+    const char *mode = "4096";
+#elif CONFIG_WL_SECTOR_MODE_PERF
+    const char *mode = "512 performance";
+#else
+    const char *mode = "512 safety";
+#endif
+    printf("Wear levelling benchmark, sector size %s, partition size %" PRIu32 " KB\n", mode, partition->size / 1024);
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(s_profiles) / sizeof(s_profiles[0]); i++) {
+        if (argc > 1 && strcmp(argv[1], s_profiles[i].name) != 0) {
+            continue;
+        }
+        failed |= run_profile(&s_profiles[i], partition);
+    }
+
+    printf("\nBenchmark %s\n", failed ? "failed" : "done");
+    return failed;
+}
@@ -0,0 +1,15 @@
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+import pytest
+from pytest_embedded import Dut
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+@pytest.mark.parametrize('config', [
+    '4k',
+    '512perf',
+    '512safe',
+], indirect=True)
+def test_wear_levelling_benchmark_linux(dut: Dut) -> None:
+    dut.expect_exact('Benchmark done', timeout=300)
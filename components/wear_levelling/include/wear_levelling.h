@@ -8,6 +8,7 @@
 #define _wear_levelling_H_
 
 #include "esp_log.h"
+#include <stdbool.h>
 #include "esp_partition.h"
 
 #ifdef __cplusplus
@@ -120,6 +121,28 @@ size_t wl_size(wl_handle_t handle);
 */
 size_t wl_sector_size(wl_handle_t handle);
 
+/**
+* @brief Perform one step of pending wear levelling work
+*
+* With CONFIG_WL_INCREMENTAL_MIGRATION enabled, moving the dummy sector is split into
+* bounded steps (one erase, or one copy of a temporary buffer, or one state update).
+* Each erase performed through the WL instance carries at most one step; calling this
+* function from a low priority task or during idle periods advances the move without
+* adding latency to foreground writes.
+*
+* Without CONFIG_WL_INCREMENTAL_MIGRATION the move is done synchronously and there is
+* never pending work.
+*
+* @param handle WL partition handle
+* @param[out] pending set to true if more steps are pending, false otherwise
+*
+* @return
+*       - ESP_OK, if the step was performed or no work was pending;
+*       - ESP_ERR_INVALID_ARG, if pending is NULL;
+*       - or one of error codes from lower-level flash driver.
+*/
+esp_err_t wl_background_work(wl_handle_t handle, bool *pending);
+
 
 #ifdef __cplusplus
 } // extern "C"
@@ -36,6 +36,13 @@ public :
 
     esp_err_t flush() override;
 
+    /**
+     * @brief Perform one step of a pending dummy sector move
+     *
+     * @param[out] pending true if the move isn't complete yet
+     */
+    esp_err_t migrate_step(bool *pending);
+
     Partition *get_part();
     wl_config_t *get_cfg();
 
@@ -59,8 +66,16 @@ protected:
     size_t dummy_addr;
     uint32_t pos_data[4];
 
+    // State of the dummy sector move: step 0 erases the dummy sector,
+    // steps 1..copy_count copy one temp_buff each, the last step commits the new position
+    bool migration_active = false;
+    size_t migration_step = 0;
+
     esp_err_t initSections();
     esp_err_t updateWL();
+    esp_err_t migrateStep();
+    esp_err_t completeMigration();
+    esp_err_t checkMigrationConflict(size_t phys_addr, size_t size);
     esp_err_t recoverPos();
     size_t calcAddr(size_t addr);
 
@@ -267,6 +267,61 @@ TEST(wear_levelling, write_doesnt_touch_other_sectors)
     wl_unmount(handle);
 }
 
+#if CONFIG_WL_INCREMENTAL_MIGRATION
+// Rewrite one sector, advancing dummy sector moves from "background" steps
+// in between, and check that the data survives moves and remount
+TEST(wear_levelling, background_work_moves_dummy_sector)
+{
+    const esp_partition_t *partition = get_test_data_partition();
+    esp_partition_t fake_partition;
+    memcpy(&fake_partition, partition, sizeof(fake_partition));
+
+    fake_partition.size = SPI_FLASH_SEC_SIZE * (4 + TEST_SECTORS_COUNT);
+
+    wl_handle_t handle;
+    TEST_ESP_OK(wl_mount(&fake_partition, &handle));
+
+    size_t sector_size = wl_sector_size(handle);
+    uint32_t init_val = rand();
+    uint32_t *buff = (uint32_t *)malloc(sector_size);
+    TEST_ASSERT_NOT_NULL(buff);
+    for (int m = 0; m < TEST_SECTORS_COUNT; m++) {
+        for (int i = 0; i < sector_size / sizeof(uint32_t); i++) {
+            buff[i] = init_val + i +  m * sector_size;
+        }
+        TEST_ESP_OK(wl_erase_range(handle, sector_size * m, sector_size));
+        TEST_ESP_OK(wl_write(handle, sector_size * m, buff, sector_size));
+    }
+
+    int steps = 0;
+    for (int m = 0; m < 1000; m++) {
+        for (int i = 0; i < sector_size / sizeof(uint32_t); i++) {
+            buff[i] = init_val + i;
+        }
+        TEST_ESP_OK(wl_erase_range(handle, 0, sector_size));
+        TEST_ESP_OK(wl_write(handle, 0, buff, sector_size));
+
+        // Advance a pending move by a few steps only, the rest is left to foreground erases
+        bool pending = false;
+        for (int k = 0; k < 3; k++) {
+            TEST_ESP_OK(wl_background_work(handle, &pending));
+            if (!pending) {
+                break;
+            }
+            steps++;
+        }
+        check_mem_data(handle, init_val, buff);
+    }
+    TEST_ASSERT_GREATER_THAN(0, steps);
+
+    TEST_ESP_OK(wl_unmount(handle));
+    TEST_ESP_OK(wl_mount(&fake_partition, &handle));
+    check_mem_data(handle, init_val, buff);
+
+    free(buff);
+    wl_unmount(handle);
+}
+#endif // CONFIG_WL_INCREMENTAL_MIGRATION
 
 #if CONFIG_WL_SECTOR_SIZE_4096
 // This test runs for 4k sector size only, since the original (version 1) partition binary is generated this way
@@ -326,6 +381,9 @@ TEST_GROUP_RUNNER(wear_levelling)
     RUN_TEST_CASE(wear_levelling, wl_mount_checks_partition_params)
     RUN_TEST_CASE(wear_levelling, multiple_tasks_single_handle)
     RUN_TEST_CASE(wear_levelling, write_doesnt_touch_other_sectors)
+#if CONFIG_WL_INCREMENTAL_MIGRATION
+    RUN_TEST_CASE(wear_levelling, background_work_moves_dummy_sector)
+#endif
 
 #if CONFIG_WL_SECTOR_SIZE_4096
     RUN_TEST_CASE(wear_levelling, version_update)
@@ -12,6 +12,7 @@ from pytest_embedded import Dut
     '4k',
     '512perf',
     '512safe',
+    'incremental',
     'release',
 ], indirect=True)
 def test_wear_levelling(dut: Dut) -> None:
@@ -251,6 +251,22 @@ size_t wl_sector_size(wl_handle_t handle)
     return result;
 }
 
+esp_err_t wl_background_work(wl_handle_t handle, bool *pending)
+{
+    if (pending == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *pending = false;
+    esp_err_t result = check_handle(handle, __func__);
+    if (result != ESP_OK) {
+        return result;
+    }
+    _lock_acquire(&s_instances[handle].lock);
+    result = s_instances[handle].instance->migrate_step(pending);
+    _lock_release(&s_instances[handle].lock);
+    return result;
+}
+
 static esp_err_t check_handle(wl_handle_t handle, const char *func)
 {
     if (handle == WL_INVALID_HANDLE) {